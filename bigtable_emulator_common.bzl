@@ -14,31 +14,62 @@
 #
 
 bigtable_emulator_common_hdrs = [
+    "cell_map.h",
     "cell_view.h",
     "cluster.h",
     "column_family.h",
     "filter.h",
     "filtered_map.h",
+    "frozen_segment.h",
+    "gc_expiry_index.h",
+    "gc_read_mask.h",
+    "gc_scheduler.h",
+    "hll_sketch.h",
     "bigtable_limits.h",
+    "parallel_scan.h",
+    "persistent_map.h",
+    "qualifier_dictionary.h",
     "range_set.h",
+    "reclaimer.h",
+    "regex_matcher.h",
+    "row_lock_manager.h",
     "row_streamer.h",
     "server.h",
     "table.h",
+    "table_stats.h",
+    "tablet.h",
     "test_util.h",
+    "thread_pool.h",
     "to_grpc_status.h",
+    "value_arena.h",
     "storage.h",
     "constants.h"
 ]
 
 bigtable_emulator_common_srcs = [
+    "cell_map.cc",
     "cluster.cc",
     "column_family.cc",
     "filter.cc",
+    "frozen_segment.cc",
+    "gc_expiry_index.cc",
+    "gc_read_mask.cc",
+    "gc_scheduler.cc",
+    "hll_sketch.cc",
+    "parallel_scan.cc",
+    "qualifier_dictionary.cc",
     "range_set.cc",
+    "reclaimer.cc",
+    "regex_matcher.cc",
+    "row_lock_manager.cc",
     "row_streamer.cc",
     "server.cc",
     "table.cc",
+    "table_stats.cc",
+    "tablet.cc",
     "test_util.cc",
+    "thread_pool.cc",
     "to_grpc_status.cc",
+    "value_arena.cc",
     "storage.cc"
 ]
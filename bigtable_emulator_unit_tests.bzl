@@ -13,16 +13,32 @@
 # limitations under the License.
 
 bigtable_emulator_unit_tests = [
+    "cell_map_test.cc",
+    "cluster_test.cc",
     "column_family_test.cc",
     "conditional_mutations_test.cc",
     "drop_row_range_test.cc",
     "filter_test.cc",
     "filtered_map_test.cc",
+    "frozen_segment_test.cc",
+    "gc_expiry_index_test.cc",
+    "gc_read_mask_test.cc",
+    "gc_scheduler_test.cc",
     "gc_test.cc",
+    "hll_sketch_test.cc",
     "mutations_test.cc",
+    "parallel_scan_test.cc",
+    "persistent_map_test.cc",
+    "qualifier_dictionary_test.cc",
     "range_set_test.cc",
+    "reclaimer_test.cc",
+    "regex_matcher_test.cc",
+    "row_lock_manager_test.cc",
     "server_test.cc",
     "storage_test.cc",
     "table_persistence_test.cc",
+    "table_stats_test.cc",
     "table_test.cc",
+    "tablet_test.cc",
+    "value_arena_test.cc",
 ]
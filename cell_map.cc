@@ -0,0 +1,162 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cell_map.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+CellMap::CellMap(CellMap const& other)
+    : inline_(other.inline_),
+      tree_(other.tree_ ? std::make_unique<Tree>(*other.tree_) : nullptr) {}
+
+CellMap::CellMap(CellMap&& other) noexcept
+    : inline_(std::move(other.inline_)), tree_(std::move(other.tree_)) {
+  other.clear();
+}
+
+CellMap& CellMap::operator=(CellMap const& other) {
+  if (this != &other) *this = CellMap(other);
+  return *this;
+}
+
+CellMap& CellMap::operator=(CellMap&& other) noexcept {
+  if (this != &other) {
+    ReplaceInline(std::move(other.inline_));
+    tree_ = std::move(other.tree_);
+    other.clear();
+  }
+  return *this;
+}
+
+CellMap::iterator CellMap::lower_bound(key_type timestamp) {
+  if (tree_) return iterator(tree_->lower_bound(timestamp));
+  return iterator(inline_.data() + InlineLowerBound(timestamp));
+}
+
+CellMap::const_iterator CellMap::lower_bound(key_type timestamp) const {
+  if (tree_) return const_iterator(tree_->lower_bound(timestamp));
+  return const_iterator(inline_.data() + InlineLowerBound(timestamp));
+}
+
+CellMap::iterator CellMap::upper_bound(key_type timestamp) {
+  if (tree_) return iterator(tree_->upper_bound(timestamp));
+  auto it = lower_bound(timestamp);
+  if (it != end() && it->first == timestamp) ++it;
+  return it;
+}
+
+CellMap::const_iterator CellMap::upper_bound(key_type timestamp) const {
+  if (tree_) return const_iterator(tree_->upper_bound(timestamp));
+  auto it = lower_bound(timestamp);
+  if (it != end() && it->first == timestamp) ++it;
+  return it;
+}
+
+CellMap::iterator CellMap::find(key_type timestamp) {
+  auto it = lower_bound(timestamp);
+  return it != end() && it->first == timestamp ? it : end();
+}
+
+CellMap::const_iterator CellMap::find(key_type timestamp) const {
+  auto it = lower_bound(timestamp);
+  return it != end() && it->first == timestamp ? it : end();
+}
+
+CellMap::mapped_type& CellMap::operator[](key_type timestamp) {
+  if (tree_) return (*tree_)[timestamp];
+  auto const pos = InlineLowerBound(timestamp);
+  if (pos != inline_.size() && inline_[pos].first == timestamp) {
+    return inline_[pos].second;
+  }
+  if (inline_.size() == kInlineCells) {
+    // Moving the cells to the tree only moves their values.
+    tree_ = std::make_unique<Tree>();
+    for (auto& cell : inline_) {
+      tree_->emplace_hint(tree_->end(), cell.first, std::move(cell.second));
+    }
+    inline_.clear();
+    return (*tree_)[timestamp];
+  }
+  Inline cells;
+  for (std::size_t i = 0; i != inline_.size(); ++i) {
+    if (i == pos) cells.emplace_back(timestamp, mapped_type());
+    cells.emplace_back(std::move(inline_[i]));
+  }
+  if (pos == inline_.size()) cells.emplace_back(timestamp, mapped_type());
+  ReplaceInline(std::move(cells));
+  return inline_[pos].second;
+}
+
+CellMap::iterator CellMap::erase(const_iterator pos) {
+  auto last = pos;
+  return erase(pos, ++last);
+}
+
+CellMap::iterator CellMap::erase(const_iterator first, const_iterator last) {
+  if (tree_) {
+    auto next = tree_->erase(first.tree_pos_, last.tree_pos_);
+    if (tree_->size() > kShrinkCells) return iterator(next);
+    // Few enough cells are left to store them inline again.
+    auto const next_index =
+        static_cast<std::size_t>(std::distance(tree_->begin(), next));
+    inline_.clear();
+    for (auto& cell : *tree_) {
+      inline_.emplace_back(cell.first, std::move(cell.second));
+    }
+    tree_.reset();
+    return iterator(inline_.data() + next_index);
+  }
+  auto const first_index =
+      static_cast<std::size_t>(first.inline_pos_ - inline_.data());
+  auto const last_index =
+      static_cast<std::size_t>(last.inline_pos_ - inline_.data());
+  Inline cells;
+  for (std::size_t i = 0; i != inline_.size(); ++i) {
+    if (i < first_index || i >= last_index) {
+      cells.emplace_back(std::move(inline_[i]));
+    }
+  }
+  ReplaceInline(std::move(cells));
+  return iterator(inline_.data() + first_index);
+}
+
+void CellMap::clear() {
+  inline_.clear();
+  tree_.reset();
+}
+
+std::size_t CellMap::InlineLowerBound(key_type timestamp) const {
+  auto it = std::lower_bound(
+      inline_.begin(), inline_.end(), timestamp,
+      [](value_type const& cell, key_type t) { return cell.first > t; });
+  return static_cast<std::size_t>(it - inline_.begin());
+}
+
+void CellMap::ReplaceInline(Inline cells) {
+  inline_.clear();
+  for (auto& cell : cells) inline_.emplace_back(std::move(cell));
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
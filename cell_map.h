@@ -0,0 +1,207 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_CELL_MAP_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_CELL_MAP_H
+
+#include "absl/container/inlined_vector.h"
+#include "absl/strings/string_view.h"
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * The cells of a column: a map from timestamps to values, newest first.
+ *
+ * The values are views of the bytes stored in the column family's
+ * `ValueArena`; this class doesn't own them.
+ *
+ * Most columns hold only a few versions, so up to `kInlineCells` cells are
+ * stored inline, in an array sorted by descending timestamp, which takes no
+ * allocations. A column which grows beyond that is
+ * moved to a `std::map`, and moved back only once it shrinks to
+ * `kShrinkCells` cells, so that a column whose size hovers around
+ * `kInlineCells` isn't moved back and forth on every write and delete.
+ *
+ * It implements the subset of the `std::map` API which `ColumnRow` needs.
+ * Unlike with `std::map`, inserting or erasing a cell invalidates iterators
+ * and references to the other cells.
+ */
+class CellMap {
+ public:
+  using key_type = std::chrono::milliseconds;
+  using mapped_type = absl::string_view;
+  using value_type = std::pair<key_type const, mapped_type>;
+  using size_type = std::size_t;
+
+  static std::size_t constexpr kInlineCells = 3;
+  static std::size_t constexpr kShrinkCells = 1;
+
+ private:
+  using Tree = std::map<key_type, mapped_type, std::greater<>>;
+  using Inline = absl::InlinedVector<value_type, kInlineCells>;
+
+  template <bool kConst>
+  class Iterator {
+   public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = CellMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<kConst, value_type const*, value_type*>;
+    using reference =
+        std::conditional_t<kConst, value_type const&, value_type&>;
+
+    Iterator() = default;
+    // Like with `std::map`, an `iterator` converts to a `const_iterator`.
+    template <bool kOtherConst,
+              std::enable_if_t<kConst && !kOtherConst, int> = 0>
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    Iterator(Iterator<kOtherConst> const& other)
+        : inline_pos_(other.inline_pos_),
+          tree_pos_(other.tree_pos_),
+          in_tree_(other.in_tree_) {}
+
+    reference operator*() const {
+      return in_tree_ ? *tree_pos_ : *inline_pos_;
+    }
+    pointer operator->() const { return &**this; }
+
+    Iterator& operator++() {
+      if (in_tree_) {
+        ++tree_pos_;
+      } else {
+        ++inline_pos_;
+      }
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto res = *this;
+      ++*this;
+      return res;
+    }
+    Iterator& operator--() {
+      if (in_tree_) {
+        --tree_pos_;
+      } else {
+        --inline_pos_;
+      }
+      return *this;
+    }
+    Iterator operator--(int) {
+      auto res = *this;
+      --*this;
+      return res;
+    }
+
+    friend bool operator==(Iterator const& lhs, Iterator const& rhs) {
+      return lhs.in_tree_ ? lhs.tree_pos_ == rhs.tree_pos_
+                          : lhs.inline_pos_ == rhs.inline_pos_;
+    }
+    friend bool operator!=(Iterator const& lhs, Iterator const& rhs) {
+      return !(lhs == rhs);
+    }
+
+   private:
+    friend class CellMap;
+    template <bool>
+    friend class Iterator;
+
+    using InlinePos = pointer;
+    using TreePos =
+        std::conditional_t<kConst, Tree::const_iterator, Tree::iterator>;
+
+    explicit Iterator(InlinePos pos) : inline_pos_(pos) {}
+    explicit Iterator(TreePos pos) : tree_pos_(pos), in_tree_(true) {}
+
+    InlinePos inline_pos_ = nullptr;
+    TreePos tree_pos_;
+    bool in_tree_ = false;
+  };
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  CellMap() = default;
+  CellMap(CellMap const& other);
+  CellMap(CellMap&& other) noexcept;
+  CellMap& operator=(CellMap const& other);
+  CellMap& operator=(CellMap&& other) noexcept;
+  ~CellMap() = default;
+
+  bool empty() const { return size() == 0; }
+  size_type size() const { return tree_ ? tree_->size() : inline_.size(); }
+
+  iterator begin() {
+    return tree_ ? iterator(tree_->begin()) : iterator(inline_.data());
+  }
+  const_iterator begin() const {
+    return tree_ ? const_iterator(tree_->cbegin())
+                 : const_iterator(inline_.data());
+  }
+  iterator end() {
+    return tree_ ? iterator(tree_->end())
+                 : iterator(inline_.data() + inline_.size());
+  }
+  const_iterator end() const {
+    return tree_ ? const_iterator(tree_->cend())
+                 : const_iterator(inline_.data() + inline_.size());
+  }
+
+  /// The first cell not newer than `timestamp`.
+  iterator lower_bound(key_type timestamp);
+  const_iterator lower_bound(key_type timestamp) const;
+  /// The first cell older than `timestamp`.
+  iterator upper_bound(key_type timestamp);
+  const_iterator upper_bound(key_type timestamp) const;
+  iterator find(key_type timestamp);
+  const_iterator find(key_type timestamp) const;
+
+  /// The value at `timestamp`, inserting an empty one if there is none.
+  mapped_type& operator[](key_type timestamp);
+
+  iterator erase(const_iterator pos);
+  iterator erase(const_iterator first, const_iterator last);
+  void clear();
+
+ private:
+  // The index of the first inline cell not newer than `timestamp`.
+  std::size_t InlineLowerBound(key_type timestamp) const;
+  // Replace the inline cells with `cells`. The cells are not assignable, so
+  // `Inline::insert()` and `Inline::erase()` can't be used.
+  void ReplaceInline(Inline cells);
+
+  // Only one of them holds the cells: `tree_` once there were more than
+  // `kInlineCells` of them and until at most `kShrinkCells` are left,
+  // `inline_` otherwise.
+  Inline inline_;
+  std::unique_ptr<Tree> tree_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_CELL_MAP_H
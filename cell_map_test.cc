@@ -0,0 +1,184 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cell_map.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using std::chrono::milliseconds;
+using Cells = std::vector<std::pair<std::int64_t, std::string>>;
+
+// The values are not owned by `CellMap`.
+char const* const kValues[] = {"0", "1", "2", "3", "4", "5", "6"};
+
+Cells Dump(CellMap const& cells) {
+  Cells res;
+  for (auto const& cell : cells) {
+    res.emplace_back(cell.first.count(), cell.second);
+  }
+  return res;
+}
+
+TEST(CellMap, Empty) {
+  CellMap cells;
+  EXPECT_TRUE(cells.empty());
+  EXPECT_EQ(0U, cells.size());
+  EXPECT_TRUE(cells.begin() == cells.end());
+  EXPECT_TRUE(cells.find(milliseconds(1)) == cells.end());
+  EXPECT_TRUE(cells.lower_bound(milliseconds(1)) == cells.end());
+}
+
+TEST(CellMap, NewestFirstAcrossPromotion) {
+  CellMap cells;
+  cells[milliseconds(20)] = "b";
+  cells[milliseconds(40)] = "d";
+  cells[milliseconds(10)] = "a";
+  EXPECT_EQ((Cells{{40, "d"}, {20, "b"}, {10, "a"}}), Dump(cells));
+  cells[milliseconds(20)] = "B";
+  EXPECT_EQ(3U, cells.size());
+
+  // Beyond `kInlineCells`.
+  cells[milliseconds(30)] = "c";
+  cells[milliseconds(50)] = "e";
+  EXPECT_EQ((Cells{{50, "e"}, {40, "d"}, {30, "c"}, {20, "B"}, {10, "a"}}),
+            Dump(cells));
+}
+
+TEST(CellMap, Bounds) {
+  for (std::size_t count : {3, 6}) {
+    CellMap cells;
+    for (std::size_t i = 1; i <= count; ++i) {
+      cells[milliseconds(10 * i)] = kValues[i];
+    }
+    SCOPED_TRACE("count=" + std::to_string(count));
+    EXPECT_EQ(milliseconds(20), cells.lower_bound(milliseconds(20))->first);
+    EXPECT_EQ(milliseconds(10), cells.upper_bound(milliseconds(20))->first);
+    EXPECT_EQ(milliseconds(10), cells.lower_bound(milliseconds(15))->first);
+    EXPECT_EQ(milliseconds(10), cells.upper_bound(milliseconds(15))->first);
+    EXPECT_TRUE(cells.upper_bound(milliseconds(10)) == cells.end());
+    EXPECT_TRUE(cells.lower_bound(milliseconds(5)) == cells.end());
+    EXPECT_TRUE(cells.lower_bound(milliseconds(1000)) == cells.begin());
+    EXPECT_EQ("2", cells.find(milliseconds(20))->second);
+    EXPECT_TRUE(cells.find(milliseconds(15)) == cells.end());
+    EXPECT_EQ(milliseconds(10), std::prev(cells.end())->first);
+  }
+}
+
+TEST(CellMap, EraseMovesCellsBackInline) {
+  CellMap cells;
+  for (int i = 1; i <= 5; ++i) cells[milliseconds(i)] = kValues[i];
+  auto it = cells.erase(cells.find(milliseconds(4)));
+  EXPECT_EQ(milliseconds(3), it->first);
+  // 4 cells are left, and then 3, which stay in the tree.
+  it = cells.erase(it);
+  EXPECT_EQ(milliseconds(2), it->first);
+  EXPECT_EQ((Cells{{5, "5"}, {2, "2"}, {1, "1"}}), Dump(cells));
+  it->second = "two";
+  EXPECT_EQ("two", cells.find(milliseconds(2))->second);
+  // Growing back beyond `kInlineCells` while still in the tree.
+  cells[milliseconds(3)] = "3";
+  cells[milliseconds(4)] = "4";
+  EXPECT_EQ((Cells{{5, "5"}, {4, "4"}, {3, "3"}, {2, "two"}, {1, "1"}}),
+            Dump(cells));
+
+  // Only `kShrinkCells` cells are moved back inline.
+  it = cells.erase(cells.begin(), cells.lower_bound(milliseconds(1)));
+  EXPECT_TRUE(it == cells.begin());
+  EXPECT_EQ((Cells{{1, "1"}}), Dump(cells));
+  cells[milliseconds(2)] = "2";
+  EXPECT_EQ((Cells{{2, "2"}, {1, "1"}}), Dump(cells));
+  it = cells.erase(cells.begin());
+  it = cells.erase(cells.begin());
+  EXPECT_TRUE(it == cells.end());
+  EXPECT_TRUE(cells.empty());
+}
+
+TEST(CellMap, CopiesAreIndependent) {
+  for (int count : {2, 5}) {
+    CellMap cells;
+    for (int i = 1; i <= count; ++i) cells[milliseconds(i)] = "v";
+    CellMap copy = cells;
+    copy[milliseconds(1)] = "changed";
+    copy.erase(copy.find(milliseconds(2)));
+    EXPECT_EQ("v", cells.find(milliseconds(1))->second);
+    EXPECT_EQ(static_cast<std::size_t>(count), cells.size());
+
+    CellMap moved = std::move(copy);
+    EXPECT_EQ(static_cast<std::size_t>(count - 1), moved.size());
+    EXPECT_EQ("changed", moved.find(milliseconds(1))->second);
+    cells = moved;
+    EXPECT_EQ(Dump(moved), Dump(cells));
+  }
+}
+
+TEST(CellMap, MatchesStdMap) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int> timestamp(0, 8);
+  std::uniform_int_distribution<int> operation(0, 3);
+  int constexpr kOperations = 2000;
+  std::vector<std::string> values;
+  values.reserve(kOperations);
+  CellMap cells;
+  std::map<milliseconds, std::string, std::greater<>> expected;
+  for (int i = 0; i != kOperations; ++i) {
+    auto const ts = milliseconds(timestamp(gen));
+    values.push_back(std::to_string(i));
+    switch (operation(gen)) {
+      case 0:
+      case 1:
+        cells[ts] = values.back();
+        expected[ts] = values.back();
+        break;
+      case 2: {
+        auto it = cells.find(ts);
+        ASSERT_EQ(expected.count(ts) != 0, it != cells.end());
+        if (it != cells.end()) cells.erase(it);
+        expected.erase(ts);
+        break;
+      }
+      default:
+        cells.erase(cells.upper_bound(ts), cells.end());
+        expected.erase(expected.upper_bound(ts), expected.end());
+        break;
+    }
+    ASSERT_EQ(expected.size(), cells.size());
+    auto it = cells.begin();
+    for (auto const& cell : expected) {
+      ASSERT_EQ(cell.first, it->first);
+      ASSERT_EQ(cell.second, it->second);
+      ++it;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
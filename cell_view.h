@@ -15,6 +15,7 @@
 #ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_CELL_VIEW_H
 #define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_CELL_VIEW_H
 
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include <chrono>
 #include <functional>
@@ -35,7 +36,7 @@ class CellView {
  public:
   CellView(std::string const& row_key, std::string const& column_family,
            std::string const& column_qualifier,
-           std::chrono::milliseconds timestamp, std::string const& value)
+           std::chrono::milliseconds timestamp, absl::string_view value)
       : row_key_(row_key),
         column_family_(column_family),
         column_qualifier_(column_qualifier),
@@ -48,18 +49,18 @@ class CellView {
     return column_qualifier_.get();
   }
   std::chrono::milliseconds timestamp() const { return timestamp_; }
-  std::string const& value() const { return value_.get(); }
+  absl::string_view value() const { return value_; }
   bool HasLabel() const { return label_.has_value(); }
   std::string const& label() const { return label_.value().get(); }
   void SetLabel(std::string const& label) { label_ = label; }
-  void SetValue(std::string const& value) { value_ = value; }
+  void SetValue(absl::string_view value) { value_ = value; }
 
  private:
   std::reference_wrapper<std::string const> row_key_;
   std::reference_wrapper<std::string const> column_family_;
   std::reference_wrapper<std::string const> column_qualifier_;
   std::chrono::milliseconds timestamp_;
-  std::reference_wrapper<std::string const> value_;
+  absl::string_view value_;
   absl::optional<std::reference_wrapper<std::string const>> label_;
 };
 
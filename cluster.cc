@@ -17,8 +17,11 @@
 #include "google/cloud/status.h"
 #include "google/cloud/status_or.h"
 #include "absl/strings/match.h"
+#include "reclaimer.h"
 #include "table.h"
+#include "table_stats.h"
 #include <google/bigtable/admin/v2/table.pb.h>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -79,6 +82,17 @@ StatusOr<btadmin::Table> ApplyView(std::string const& table_name,
           std::move(*before_view.mutable_cluster_states());
       return res;
     }
+    case btadmin::Table::STATS_VIEW: {
+      btadmin::Table res;
+      res.set_name(table_name);
+      auto const stats = table.GetStats();
+      *res.mutable_stats() = ToProto(stats);
+      for (auto const& column_family : stats.column_families) {
+        *(*res.mutable_column_families())[column_family.first]
+             .mutable_stats() = ToProto(column_family.second);
+      }
+      return res;
+    }
     case btadmin::Table::FULL:
       return table.GetSchema();
     default:
@@ -90,40 +104,47 @@ StatusOr<btadmin::Table> ApplyView(std::string const& table_name,
 
 }  // anonymous namespace
 
-StatusOr<btadmin::Table> Cluster::CreateTable(std::string const& table_name,
-                                              btadmin::Table schema) {
+Cluster::Cluster() : directory_(new TableDirectory const()) {}
+
+Cluster::~Cluster() { delete directory_.load(); }
+
+StatusOr<btadmin::Table> Cluster::CreateTable(
+    std::string const& table_name, btadmin::Table schema,
+    StorageLayout storage_layout, std::vector<std::string> initial_splits) {
+  // The data of a dropped table by this name must be gone before the new
+  // table persists its own.
+  GlobalReclaimer().WaitFor(table_name);
   schema.set_name(table_name);
-  auto maybe_table = Table::Create(std::move(schema));
+  auto maybe_table = Table::Create(std::move(schema), storage_layout,
+                                   std::move(initial_splits));
   if (!maybe_table) {
     return maybe_table.status();
   }
-  {
-    std::lock_guard<std::mutex> lock(mu_);
-    if (!table_by_name_.emplace(table_name, *maybe_table).second) {
-      return google::cloud::internal::AlreadyExistsError(
-          "Table already exists.",
-          GCP_ERROR_INFO().WithMetadata("table_name", table_name));
-    }
-  }
+  auto status = AttachTable(table_name, *maybe_table);
+  if (!status.ok()) return status;
   return (*maybe_table)->GetSchema();
 }
 
 StatusOr<std::vector<btadmin::Table>> Cluster::ListTables(
     std::string const& instance_name, btadmin::Table_View view) const {
-  std::map<std::string, std::shared_ptr<Table>> table_by_name_copy;
+  std::vector<std::pair<std::string, std::shared_ptr<Table>>> tables;
+  std::string const prefix = instance_name + "/tables/";
   {
-    std::lock_guard<std::mutex> lock(mu_);
-    table_by_name_copy = table_by_name_;
+    // The views take the tables' locks, so they are applied after the
+    // reader is released, rather than make `Publish()` wait for them.
+    DirectoryReader const directory(*this);
+    for (auto name_and_table_it = directory->upper_bound(prefix);
+         name_and_table_it != directory->end() &&
+         absl::StartsWith(name_and_table_it->first, prefix);
+         ++name_and_table_it) {
+      tables.emplace_back(*name_and_table_it);
+    }
   }
   std::vector<btadmin::Table> res;
-  std::string const prefix = instance_name + "/tables/";
-  for (auto name_and_table_it = table_by_name_copy.upper_bound(prefix);
-       name_and_table_it != table_by_name_copy.end() &&
-       absl::StartsWith(name_and_table_it->first, prefix);
-       ++name_and_table_it) {
-    auto maybe_view =
-        ApplyView(name_and_table_it->first, *name_and_table_it->second, view,
-                  btadmin::Table::NAME_ONLY);
+  res.reserve(tables.size());
+  for (auto const& name_and_table : tables) {
+    auto maybe_view = ApplyView(name_and_table.first, *name_and_table.second,
+                                view, btadmin::Table::NAME_ONLY);
     if (!maybe_view) {
       return maybe_view.status();
     }
@@ -134,24 +155,20 @@ StatusOr<std::vector<btadmin::Table>> Cluster::ListTables(
 
 StatusOr<btadmin::Table> Cluster::GetTable(std::string const& table_name,
                                            btadmin::Table_View view) const {
-  std::shared_ptr<Table> found_table;
-  {
-    std::lock_guard<std::mutex> lock(mu_);
-    auto it = table_by_name_.find(table_name);
-    if (it == table_by_name_.end()) {
-      return NotFoundError("No such table.", GCP_ERROR_INFO().WithMetadata(
-                                                 "table_name", table_name));
-    }
-    found_table = it->second;
-  }
-  return ApplyView(table_name, *found_table, view, btadmin::Table::SCHEMA_VIEW);
+  auto found_table = FindTable(table_name);
+  if (!found_table) return std::move(found_table).status();
+  return ApplyView(table_name, **found_table, view,
+                   btadmin::Table::SCHEMA_VIEW);
 }
 
 Status Cluster::DeleteTable(std::string const& table_name) {
+  std::shared_ptr<Table> table;
+  Storage* storage = GetGlobalStorage();
   {
     std::lock_guard<std::mutex> lock(mu_);
-    auto it = table_by_name_.find(table_name);
-    if (it == table_by_name_.end()) {
+    auto directory = std::make_unique<TableDirectory>(*directory_.load());
+    auto it = directory->find(table_name);
+    if (it == directory->end()) {
       return NotFoundError("No such table.", GCP_ERROR_INFO().WithMetadata(
                                                  "table_name", table_name));
     }
@@ -160,31 +177,44 @@ Status Cluster::DeleteTable(std::string const& table_name) {
           "The table has deletion protection.",
           GCP_ERROR_INFO().WithMetadata("table_name", table_name));
     }
-    Storage* storage = GetGlobalStorage();
-    if (storage != nullptr) {
-      storage->DeleteTable(table_name);
-    }
-    table_by_name_.erase(it);
+    // Only the manifest is updated synchronously, so that the table is not
+    // loaded again on restart even if its data isn't removed yet.
+    if (storage != nullptr) storage->RemoveTableFromManifest(table_name);
+    table = std::move(it->second);
+    directory->erase(it);
+    // RPCs still using the table, or an older directory, keep it alive until
+    // they finish, and may still write its column families. So they are only
+    // removed once the table is destroyed. Meanwhile, the reservation makes
+    // `CreateTable()` of a new table by this name wait.
+    GlobalReclaimer().Reserve(table_name);
+    table->OnDestroyed([storage, table_name] {
+      GlobalReclaimer().ScheduleReserved(table_name, [storage, table_name] {
+        if (storage != nullptr) storage->DeleteTableData(table_name);
+      });
+    });
+    Publish(std::move(directory));
   }
+  // The table's cells are released in the background, unless an RPC still
+  // holds it, in which case the RPC releases them.
+  GlobalReclaimer().Schedule(
+      table_name, [table = std::move(table)]() mutable { table.reset(); });
   return Status();
 }
 
 bool Cluster::HasTable(std::string const& table_name) const {
-  std::lock_guard<std::mutex> lock(mu_);
-  return table_by_name_.find(table_name) != table_by_name_.end();
+  DirectoryReader const directory(*this);
+  return directory->find(table_name) != directory->end();
 }
 
 StatusOr<std::shared_ptr<Table>> Cluster::FindTable(
-    std::string const& table_name) {
-  {
-    std::lock_guard<std::mutex> lock(mu_);
-    auto it = table_by_name_.find(table_name);
-    if (it == table_by_name_.end()) {
-      return NotFoundError("No such table.", GCP_ERROR_INFO().WithMetadata(
-                                                 "table_name", table_name));
-    }
-    return it->second;
+    std::string const& table_name) const {
+  DirectoryReader const directory(*this);
+  auto it = directory->find(table_name);
+  if (it == directory->end()) {
+    return NotFoundError("No such table.", GCP_ERROR_INFO().WithMetadata(
+                                               "table_name", table_name));
   }
+  return it->second;
 }
 
 Status Cluster::AttachTable(std::string const& table_name,
@@ -194,17 +224,58 @@ Status Cluster::AttachTable(std::string const& table_name,
         "null table pointer",
         GCP_ERROR_INFO().WithMetadata("table_name", table_name));
   }
-  {
-    std::lock_guard<std::mutex> lock(mu_);
-    if (!table_by_name_.emplace(table_name, std::move(table)).second) {
-      return google::cloud::internal::AlreadyExistsError(
-          "Table already exists.",
-          GCP_ERROR_INFO().WithMetadata("table_name", table_name));
-    }
+  std::lock_guard<std::mutex> lock(mu_);
+  auto directory = std::make_unique<TableDirectory>(*directory_.load());
+  if (!directory->emplace(table_name, std::move(table)).second) {
+    return google::cloud::internal::AlreadyExistsError(
+        "Table already exists.",
+        GCP_ERROR_INFO().WithMetadata("table_name", table_name));
   }
+  Publish(std::move(directory));
   return Status();
 }
 
+Cluster::DirectoryReader::DirectoryReader(Cluster const& cluster)
+    : cluster_(cluster) {
+  for (;;) {
+    auto const epoch = cluster.epoch_.load();
+    readers_ = &cluster.readers_[epoch % 2];
+    readers_->fetch_add(1);
+    // Registered before the epoch changed, so the next `Publish()` waits
+    // for this reader.
+    if (cluster.epoch_.load() == epoch) break;
+    cluster.Unregister(*readers_);
+  }
+  directory_ = cluster.directory_.load();
+}
+
+Cluster::DirectoryReader::~DirectoryReader() { cluster_.Unregister(*readers_); }
+
+void Cluster::Unregister(std::atomic<std::int64_t>& readers) const {
+  // The last reader of an epoch wakes up the `Publish()` waiting for it. The
+  // atomics are sequentially consistent, so either this sees
+  // `publish_waiting_`, or `Publish()` sees that the count dropped to zero.
+  if (readers.fetch_sub(1) == 1 && publish_waiting_.load()) {
+    std::lock_guard<std::mutex> lock(readers_mu_);
+    readers_done_.notify_all();
+  }
+}
+
+void Cluster::Publish(std::unique_ptr<TableDirectory const> directory) {
+  auto const* old = directory_.exchange(directory.release());
+  // The readers of the new epoch see the new directory, so only those of
+  // the previous one may still use `old`. Those of the epoch before were
+  // waited for by the previous `Publish()`.
+  auto const epoch = epoch_.fetch_add(1);
+  auto const& readers = readers_[epoch % 2];
+  if (readers.load() != 0) {
+    std::unique_lock<std::mutex> lock(readers_mu_);
+    publish_waiting_ = true;
+    readers_done_.wait(lock, [&readers] { return readers.load() == 0; });
+    publish_waiting_ = false;
+  }
+  delete old;
+}
 
 }  // namespace emulator
 }  // namespace bigtable
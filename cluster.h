@@ -17,8 +17,12 @@
 
 #include "google/cloud/status.h"
 #include "google/cloud/status_or.h"
+#include "storage.h"
 #include "table.h"
 #include <google/bigtable/admin/v2/table.pb.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -35,19 +39,44 @@ namespace emulator {
  *
  * This emulated cluster holds tables from all projects and instances - they are
  * merely components of table names.
+ *
+ * The tables are looked up in an immutable directory, which is replaced
+ * (copied, modified and atomically published) whenever a table is created or
+ * deleted. Looking up a table therefore takes no lock, and only the rare
+ * table creations and deletions serialize on `mu_`.
+ *
+ * Readers don't share ownership of the directory. They register in one of
+ * two reader counts, chosen by the publication epoch, and a replaced
+ * directory is freed once the count of the epoch it was read in drops to
+ * zero. Readers only do atomic increments, decrements and loads, while
+ * creating or deleting a table waits for the readers of the previous
+ * directory, which only copy the `shared_ptr` of the tables they look up.
+ * It sleeps on a condition variable, which only the last of those readers
+ * locks, to signal it.
  */
 class Cluster {
  public:
+  Cluster();
+  ~Cluster();
+  Cluster(Cluster const&) = delete;
+  Cluster& operator=(Cluster const&) = delete;
+
   /**
    * Create a new table according to schema.
    *
    * @param table_name table's name in the form of
    *     `/projects/{}/instances/{}/tables/{}`.
    * @param schema the schema of the newly create table.
+   * @param storage_layout how the table's cells are laid out in the
+   *     persistent storage.
+   * @param initial_splits the row keys at which the table is initially split
+   *     into tablets.
    * @return the schema of the newly created table.
    */
   StatusOr<google::bigtable::admin::v2::Table> CreateTable(
-      std::string const& table_name, google::bigtable::admin::v2::Table schema);
+      std::string const& table_name, google::bigtable::admin::v2::Table schema,
+      StorageLayout storage_layout = StorageLayout::kColumnFamilyPerFamily,
+      std::vector<std::string> initial_splits = {});
 
   /**
    * List tables in the clustera.
@@ -102,7 +131,8 @@ class Cluster {
    *     `/projects/{}/instances/{}/tables/{}`.
    * @return a pointer to the table or error if it doesn't exist.
    */
-  StatusOr<std::shared_ptr<Table>> FindTable(std::string const& table_name);
+  StatusOr<std::shared_ptr<Table>> FindTable(
+      std::string const& table_name) const;
 
   // Attach a pre-built table instance into the cluster registry.
   // Returns an error if a table with the same name already exists.
@@ -111,17 +141,60 @@ class Cluster {
 
 
  private:
-  mutable std::mutex mu_;
+  using TableDirectory = std::map<std::string, std::shared_ptr<Table>>;
+
+  /**
+   * A read-only view of the current directory, which is not freed while the
+   * reader exists.
+   *
+   * Readers should be short-lived, and a thread holding one must not create
+   * or delete tables, which wait for it.
+   */
+  class DirectoryReader {
+   public:
+    explicit DirectoryReader(Cluster const& cluster);
+    ~DirectoryReader();
+    DirectoryReader(DirectoryReader const&) = delete;
+    DirectoryReader& operator=(DirectoryReader const&) = delete;
+
+    TableDirectory const& operator*() const { return *directory_; }
+    TableDirectory const* operator->() const { return directory_; }
+
+   private:
+    Cluster const& cluster_;
+    std::atomic<std::int64_t>* readers_;
+    TableDirectory const* directory_;
+  };
+
+  // Replace the directory, and free the old one once no `DirectoryReader`
+  // uses it. Requires `mu_`.
+  void Publish(std::unique_ptr<TableDirectory const> directory);
+  // Remove a reader from `readers`, one of `readers_`.
+  void Unregister(std::atomic<std::int64_t>& readers) const;
+
+  // Serializes the changes of the directory.
+  std::mutex mu_;
 
   /**
-   * All the tables indexed by their names.
+   * All the tables indexed by their names, only read through
+   * `DirectoryReader` and replaced by `Publish()`.
    *
-   * The names are in the form `/projects/{}/instances/{}/tables/{}`. We're
-   * holding the tables by `shared_ptr`s in order to be able to allow for more
-   * concurrency - every access to a table should start with creating a copy of
-   * the shared pointer.
+   * The names are in the form `/projects/{}/instances/{}/tables/{}`. The
+   * directory is ordered, so that `ListTables()` only visits one instance's
+   * tables. We're holding the tables by `shared_ptr`s in order to be able to
+   * allow for more concurrency - every access to a table should start with
+   * creating a copy of the shared pointer.
    */
-  std::map<std::string, std::shared_ptr<Table>> table_by_name_;
+  std::atomic<TableDirectory const*> directory_;
+  // Incremented by every `Publish()`.
+  std::atomic<std::uint64_t> epoch_{0};
+  // The number of `DirectoryReader`s registered in even and odd epochs.
+  mutable std::atomic<std::int64_t> readers_[2] = {{0}, {0}};
+  // Whether `Publish()` waits on `readers_done_` for the readers of the
+  // previous epoch. Only the last of them takes `readers_mu_` to signal it.
+  std::atomic<bool> publish_waiting_{false};
+  mutable std::mutex readers_mu_;
+  mutable std::condition_variable readers_done_;
 };
 
 }  // namespace emulator
@@ -0,0 +1,135 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cluster.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "reclaimer.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+
+std::string const kInstance = "projects/p/instances/i";
+
+btadmin::Table Schema() {
+  btadmin::Table schema;
+  (*schema.mutable_column_families())["cf"] = btadmin::ColumnFamily();
+  return schema;
+}
+
+std::vector<std::string> TableNames(Cluster const& cluster,
+                                    std::string const& instance) {
+  auto tables = cluster.ListTables(instance, btadmin::Table::NAME_ONLY);
+  EXPECT_STATUS_OK(tables);
+  std::vector<std::string> res;
+  if (!tables) return res;
+  for (auto const& table : *tables) res.push_back(table.name());
+  return res;
+}
+
+TEST(Cluster, CreateFindListDelete) {
+  Cluster cluster;
+  auto const t1 = kInstance + "/tables/t1";
+  auto const t2 = kInstance + "/tables/t2";
+  auto const other = kInstance + "2/tables/t1";
+  for (auto const& name : {t1, t2, other}) {
+    ASSERT_STATUS_OK(cluster.CreateTable(name, Schema()));
+  }
+  EXPECT_EQ(StatusCode::kAlreadyExists,
+            cluster.CreateTable(t1, Schema()).status().code());
+  EXPECT_EQ((std::vector<std::string>{t1, t2}), TableNames(cluster, kInstance));
+
+  auto found = cluster.FindTable(t1);
+  ASSERT_STATUS_OK(found);
+  EXPECT_TRUE(cluster.HasTable(t1));
+
+  ASSERT_STATUS_OK(cluster.DeleteTable(t1));
+  EXPECT_FALSE(cluster.HasTable(t1));
+  EXPECT_EQ(StatusCode::kNotFound, cluster.FindTable(t1).status().code());
+  EXPECT_EQ(StatusCode::kNotFound,
+            cluster.GetTable(t1, btadmin::Table::NAME_ONLY).status().code());
+  EXPECT_EQ(StatusCode::kNotFound, cluster.DeleteTable(t1).code());
+  EXPECT_EQ((std::vector<std::string>{t2}), TableNames(cluster, kInstance));
+
+  // A handle found before the deletion remains usable.
+  EXPECT_EQ(1, (*found)->GetSchema().column_families_size());
+  GlobalReclaimer().Drain();
+  EXPECT_EQ(1, (*found)->GetSchema().column_families_size());
+}
+
+TEST(Cluster, RecreatingWaitsForTheLastReferenceToTheDroppedTable) {
+  Cluster cluster;
+  auto const name = kInstance + "/tables/t";
+  ASSERT_STATUS_OK(cluster.CreateTable(name, Schema()));
+  auto found = cluster.FindTable(name);
+  ASSERT_STATUS_OK(found);
+  ASSERT_STATUS_OK(cluster.DeleteTable(name));
+  GlobalReclaimer().Drain();
+
+  std::atomic<bool> created{false};
+  std::thread creator([&] {
+    EXPECT_STATUS_OK(cluster.CreateTable(name, Schema()));
+    created = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(created);
+  found->reset();
+  creator.join();
+  EXPECT_TRUE(created);
+}
+
+TEST(Cluster, LookupsDuringCreatesAndDeletes) {
+  Cluster cluster;
+  auto const stable = kInstance + "/tables/stable";
+  ASSERT_STATUS_OK(cluster.CreateTable(stable, Schema()));
+
+  std::atomic<bool> stop{false};
+  std::atomic<int> missing{0};
+  std::vector<std::thread> readers;
+  for (int i = 0; i != 4; ++i) {
+    readers.emplace_back([&] {
+      while (!stop) {
+        if (!cluster.FindTable(stable)) ++missing;
+        (void)cluster.FindTable(kInstance + "/tables/churn0");
+      }
+    });
+  }
+  for (int i = 0; i != 50; ++i) {
+    auto const name = kInstance + "/tables/churn" + std::to_string(i % 3);
+    ASSERT_STATUS_OK(cluster.CreateTable(name, Schema()));
+    ASSERT_STATUS_OK(cluster.DeleteTable(name));
+  }
+  stop = true;
+  for (auto& reader : readers) reader.join();
+  EXPECT_EQ(0, missing);
+  EXPECT_EQ((std::vector<std::string>{stable}), TableNames(cluster, kInstance));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -16,6 +16,7 @@
 #include "google/cloud/internal/big_endian.h"
 #include "google/cloud/internal/make_status.h"
 #include "google/cloud/status_or.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
@@ -23,6 +24,7 @@
 #include "cell_view.h"
 #include "filter.h"
 #include "filtered_map.h"
+#include "hll_sketch.h"
 #include "storage.h"
 
 #include <google/bigtable/admin/v2/table.pb.h>
@@ -30,11 +32,14 @@
 #include <google/bigtable/v2/data.pb.h>
 #include <google/protobuf/util/time_util.h>
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
@@ -154,117 +159,63 @@ Status CheckGCRuleSizeIsBelowLimit(
 
   return Status();
 }
-}  // namespace
-
-StatusOr<ReadModifyWriteCellResult> ColumnRow::ReadModifyWrite(
-    std::int64_t inc_value) {
-  auto system_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::system_clock::now().time_since_epoch());
-
-  if (cells_.empty()) {
-    std::string value = google::cloud::internal::EncodeBigEndian(inc_value);
-    cells_[system_ms] = value;
-
-    return ReadModifyWriteCellResult{system_ms, std::move(value),
-                                     absl::nullopt};
-  }
-
-  auto latest_it = cells_.begin();
-
-  auto maybe_old_value =
-      google::cloud::internal::DecodeBigEndian<std::int64_t>(latest_it->second);
-  if (!maybe_old_value) {
-    return maybe_old_value.status();
-  }
 
-  auto value = google::cloud::internal::EncodeBigEndian(
-      inc_value + maybe_old_value.value());
-
-  if (latest_it->first < system_ms) {
-    // We need to add a cell with the current system timestamp
-    cells_[system_ms] = value;
-
-    return ReadModifyWriteCellResult{system_ms, std::move(value),
-                                     absl::nullopt};
+// The int64 cells of aggregate column families are 8-byte big-endian.
+absl::string_view EncodeInt64(std::int64_t value,
+                              char (&buffer)[sizeof(std::int64_t)]) {
+  auto bits = static_cast<std::uint64_t>(value);
+  for (auto i = sizeof(buffer); i != 0; --i) {
+    buffer[i - 1] = static_cast<char>(bits & 0xFF);
+    bits >>= 8;
   }
-
-  // Latest timestamp is >= system time. Overwrite latest timestamp
-  auto old_value = std::move(latest_it->second);
-  latest_it->second = value;
-
-  return ReadModifyWriteCellResult{latest_it->first, std::move(value),
-                                   std::move(old_value)};
+  return absl::string_view(buffer, sizeof(buffer));
 }
 
-ReadModifyWriteCellResult ColumnRow::ReadModifyWrite(
-    std::string const& append_value) {
-  auto system_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::system_clock::now().time_since_epoch());
-  if (cells_.empty()) {
-    cells_[system_ms] = append_value;
-
-    return ReadModifyWriteCellResult{system_ms, std::move(append_value),
-                                     absl::nullopt};
-  }
-
-  auto latest_it = cells_.begin();
-
-  auto value = latest_it->second + append_value;
-
-  if (latest_it->first < system_ms) {
-    // We need to add a cell with the current system timestamp
-    cells_[system_ms] = value;
-
-    return ReadModifyWriteCellResult{system_ms, std::move(value),
-                                     absl::nullopt};
-  }
-
-  // Latest timestamp is >= system time. Overwrite latest timestamp
-  auto old_value = std::move(latest_it->second);
-  latest_it->second = value;
-
-  return ReadModifyWriteCellResult{latest_it->first, value,
-                                   std::move(old_value)};
+std::int64_t DecodeInt64(absl::string_view bytes) {
+  std::uint64_t bits = 0;
+  for (auto c : bytes) bits = (bits << 8) | static_cast<unsigned char>(c);
+  return static_cast<std::int64_t>(bits);
 }
 
-absl::optional<std::string> ColumnRow::SetCell(
-    std::chrono::milliseconds timestamp, std::string const& value) {
-  absl::optional<std::string> ret = absl::nullopt;
-
-  auto cell_it = cells_.find(timestamp);
-  if (!(cell_it == cells_.end())) {
-    ret = std::move(cell_it->second);
+// A switch rather than a `std::function`, so that the aggregation inlines.
+std::int64_t Aggregate(Int64Aggregator aggregator, std::int64_t existing,
+                       std::int64_t input) {
+  switch (aggregator) {
+    case Int64Aggregator::kSum:
+      // Wrap around rather than overflow, which is undefined.
+      return static_cast<std::int64_t>(static_cast<std::uint64_t>(existing) +
+                                       static_cast<std::uint64_t>(input));
+    case Int64Aggregator::kMin:
+      return std::min(existing, input);
+    case Int64Aggregator::kMax:
+      return std::max(existing, input);
   }
-
-  cells_[timestamp] = value;
-
-  return ret;
+  return input;
 }
+}  // namespace
 
-StatusOr<absl::optional<std::string>> ColumnRow::UpdateCell(
-    std::chrono::milliseconds timestamp, std::string& value,
-    std::function<StatusOr<std::string>(std::string const&,
-                                        std::string&&)> const& update_fn) {
+absl::optional<std::string> ColumnRow::SetCell(
+    std::chrono::milliseconds timestamp, absl::string_view value,
+    ValueArena& arena) {
   absl::optional<std::string> ret = absl::nullopt;
 
   auto cell_it = cells_.find(timestamp);
   if (!(cell_it == cells_.end())) {
-    auto maybe_update_value = update_fn(cell_it->second, std::move(value));
-    if (!maybe_update_value) {
-      return maybe_update_value.status();
-    }
-    ret = std::move(cell_it->second);
-    maybe_update_value.value().swap(cell_it->second);
-    return ret;
+    ret = std::string(cell_it->second);
+    if (arena.Overwrite(cell_it->second, value)) return ret;
+    value_bytes_ -= cell_it->second.size();
+    arena.Release(cell_it->second);
   }
 
-  cells_[timestamp] = value;
+  cells_[timestamp] = arena.Store(value);
+  value_bytes_ += value.size();
 
   return ret;
 }
 
 std::vector<Cell> ColumnRow::DeleteTimeRange(
-    ::google::bigtable::v2::TimestampRange const& time_range) {
+    ::google::bigtable::v2::TimestampRange const& time_range,
+    ValueArena& arena) {
   std::vector<Cell> deleted_cells;
   absl::optional<std::int64_t> maybe_end_micros =
       time_range.end_timestamp_micros();
@@ -281,42 +232,47 @@ std::vector<Cell> ColumnRow::DeleteTimeRange(
        cell_it->first >= std::chrono::duration_cast<std::chrono::milliseconds>(
                              std::chrono::microseconds(
                                  time_range.start_timestamp_micros()));) {
-    Cell cell = {std::move(cell_it->first), std::move(cell_it->second)};
+    Cell cell = {cell_it->first, std::string(cell_it->second)};
     deleted_cells.emplace_back(std::move(cell));
-    cells_.erase(cell_it++);
+    value_bytes_ -= cell_it->second.size();
+    arena.Release(cell_it->second);
+    cell_it = cells_.erase(cell_it);
   }
   return deleted_cells;
 }
 
 absl::optional<Cell> ColumnRow::DeleteTimeStamp(
-    std::chrono::milliseconds timestamp) {
+    std::chrono::milliseconds timestamp, ValueArena& arena) {
   absl::optional<Cell> ret = absl::nullopt;
 
   auto cell_it = cells_.find(timestamp);
   if (cell_it != cells_.end()) {
-    Cell cell = {std::move(cell_it->first), std::move(cell_it->second)};
+    Cell cell = {cell_it->first, std::string(cell_it->second)};
     ret.emplace(std::move(cell));
+    value_bytes_ -= cell_it->second.size();
+    arena.Release(cell_it->second);
     cells_.erase(cell_it);
   }
 
   return ret;
 }
 
-void ColumnRow::RunGC(google::bigtable::admin::v2::GcRule const& gc_rule) {
+void ColumnRow::RunGC(google::bigtable::admin::v2::GcRule const& gc_rule,
+                      ValueArena& arena) {
   assert(CheckGCRuleIsValid(gc_rule).ok());
   switch (gc_rule.rule_case()) {
     case google::bigtable::admin::v2::GcRule::kMaxAge: {
-      ApplyGCRuleMaxAge(gc_rule.max_age());
+      ApplyGCRuleMaxAge(gc_rule.max_age(), arena);
       break;
     }
     case google::bigtable::admin::v2::GcRule::kMaxNumVersions: {
       ApplyGCRuleMaxNumVersions(
-          static_cast<std::size_t>(gc_rule.max_num_versions()));
+          static_cast<std::size_t>(gc_rule.max_num_versions()), arena);
       break;
     }
     case google::bigtable::admin::v2::GcRule::kIntersection:
     case google::bigtable::admin::v2::GcRule::kUnion: {
-      ApplyGCRuleVerdict(gc_rule);
+      ApplyGCRuleVerdict(gc_rule, arena);
       break;
     }
     case google::bigtable::admin::v2::GcRule::RULE_NOT_SET:
@@ -326,14 +282,30 @@ void ColumnRow::RunGC(google::bigtable::admin::v2::GcRule const& gc_rule) {
   }
 }
 
-void ColumnRow::ApplyGCRuleMaxNumVersions(std::size_t n) {
+void ColumnRow::MoveValues(ValueArena const& from, ValueArena& to) {
+  for (auto& cell : cells_) {
+    if (from.Owns(cell.second)) cell.second = to.Store(cell.second);
+  }
+}
+
+ColumnRow::iterator ColumnRow::EraseCells(const_iterator first,
+                                          const_iterator last,
+                                          ValueArena& arena) {
+  for (auto it = first; it != last; ++it) {
+    value_bytes_ -= it->second.size();
+    arena.Release(it->second);
+  }
+  return cells_.erase(first, last);
+}
+
+void ColumnRow::ApplyGCRuleMaxNumVersions(std::size_t n, ValueArena& arena) {
   if (n >= cells_.size()) {
     return;
   }
 
-  auto it = cells_.begin();
+  auto it = begin();
   std::advance(it, n);
-  cells_.erase(it, cells_.end());
+  EraseCells(it, end(), arena);
 }
 
 std::chrono::milliseconds GetMaxAgeCutOffTimestamp(
@@ -345,12 +317,10 @@ std::chrono::milliseconds GetMaxAgeCutOffTimestamp(
          max_age_ms;
 }
 
-void ColumnRow::ApplyGCRuleMaxAge(protobuf::Duration const& max_age) {
-  std::chrono::milliseconds max_age_ms(
-      protobuf::util::TimeUtil::DurationToMilliseconds(max_age));
+void ColumnRow::ApplyGCRuleMaxAge(protobuf::Duration const& max_age,
+                                  ValueArena& arena) {
   auto cut_off_ms = GetMaxAgeCutOffTimestamp(max_age);
-  auto newest_to_delete = cells_.upper_bound(cut_off_ms);
-  cells_.erase(newest_to_delete, cells_.end());
+  EraseCells(upper_bound(cut_off_ms), end(), arena);
 }
 
 // See comment next to `static_assert(kMaxGCRuleSize ==` for the proof of
@@ -358,9 +328,7 @@ void ColumnRow::ApplyGCRuleMaxAge(protobuf::Duration const& max_age) {
 // NOLINTBEGIN(misc-no-recursion)
 bool ColumnRow::GCRuleEraseVerdict(
     google::bigtable::admin::v2::GcRule const& rule,
-    std::map<std::chrono::milliseconds, std::string,
-             std::greater<>>::const_iterator it,
-    int32_t const version_rank) {
+    ColumnRow::const_iterator it, int32_t const version_rank) {
   assert(CheckGCRuleIsValid(rule).ok());
   switch (rule.rule_case()) {
     case google::bigtable::admin::v2::GcRule::kMaxAge: {
@@ -394,11 +362,12 @@ bool ColumnRow::GCRuleEraseVerdict(
 // NOLINTEND(misc-no-recursion)
 
 void ColumnRow::ApplyGCRuleVerdict(
-    google::bigtable::admin::v2::GcRule const& rule) {
+    google::bigtable::admin::v2::GcRule const& rule, ValueArena& arena) {
   int32_t version_rank = 0;
-  for (auto it = cells_.begin(); it != cells_.end();) {
+  for (const_iterator it = cells_.begin(); it != cells_.end();) {
     if (GCRuleEraseVerdict(rule, it, version_rank)) {
-      it = cells_.erase(it);
+      auto next = it;
+      it = EraseCells(it, ++next, arena);
     } else {
       it++;
       version_rank++;
@@ -406,94 +375,237 @@ void ColumnRow::ApplyGCRuleVerdict(
   }
 }
 
-absl::optional<std::string> ColumnFamilyRow::SetCell(
-    std::string const& column_qualifier, std::chrono::milliseconds timestamp,
-    std::string const& value) {
-  return columns_[column_qualifier].SetCell(timestamp, value);
+void ColumnFamilyRow::Totals::AddColumn(std::size_t qualifier_size,
+                                        ColumnRow const& column) {
+  if (!column.HasCells()) return;
+  auto const cells = static_cast<std::int64_t>(column.size());
+  this->cells += cells;
+  bytes += cells * static_cast<std::int64_t>(qualifier_size) +
+           static_cast<std::int64_t>(column.value_bytes());
+  ++versions_histogram[VersionsHistogramBucket(column.size())];
+}
+
+void ColumnFamilyRow::Totals::RemoveColumn(std::size_t qualifier_size,
+                                           ColumnRow const& column) {
+  if (!column.HasCells()) return;
+  auto const cells = static_cast<std::int64_t>(column.size());
+  this->cells -= cells;
+  bytes -= cells * static_cast<std::int64_t>(qualifier_size) +
+           static_cast<std::int64_t>(column.value_bytes());
+  --versions_histogram[VersionsHistogramBucket(column.size())];
 }
 
-StatusOr<absl::optional<std::string>> ColumnFamilyRow::UpdateCell(
+absl::optional<std::string> ColumnFamilyRow::SetCell(
     std::string const& column_qualifier, std::chrono::milliseconds timestamp,
-    std::string& value,
-    std::function<StatusOr<std::string>(std::string const&,
-                                        std::string&&)> const& update_fn) {
-  return columns_[column_qualifier].UpdateCell(timestamp, value,
-                                               std::move(update_fn));
+    absl::string_view value, QualifierDictionary& qualifiers,
+    ValueArena& arena) {
+  return SetCell(MutableColumns(), column_qualifier, timestamp, value,
+                 qualifiers, arena);
 }
 
 std::vector<Cell> ColumnFamilyRow::DeleteColumn(
     std::string const& column_qualifier,
-    ::google::bigtable::v2::TimestampRange const& time_range) {
-  auto column_it = columns_.find(column_qualifier);
-  if (column_it == columns_.end()) {
+    ::google::bigtable::v2::TimestampRange const& time_range,
+    ValueArena& arena) {
+  if (columns_->find(column_qualifier) == columns_->end()) {
     return {};
   }
-  auto res = column_it->second.DeleteTimeRange(time_range);
+  auto& columns = MutableColumns();
+  auto column_it = columns.mutable_find(column_qualifier);
+  columns.totals.RemoveColumn(column_qualifier.size(), column_it->second);
+  auto res = column_it->second.DeleteTimeRange(time_range, arena);
+  columns.totals.AddColumn(column_qualifier.size(), column_it->second);
   if (!column_it->second.HasCells()) {
-    columns_.erase(column_it);
+    columns.erase(column_it);
   }
   return res;
 }
 
 absl::optional<Cell> ColumnFamilyRow::DeleteTimeStamp(
-    std::string const& column_qualifier, std::chrono::milliseconds timestamp) {
-  auto column_it = columns_.find(column_qualifier);
-  if (column_it == columns_.end()) {
+    std::string const& column_qualifier, std::chrono::milliseconds timestamp,
+    ValueArena& arena) {
+  auto const found = columns_->find(column_qualifier);
+  if (found == columns_->end() ||
+      found->second.lower_bound(timestamp) ==
+          found->second.upper_bound(timestamp)) {
     return absl::nullopt;
   }
 
-  auto ret = column_it->second.DeleteTimeStamp(timestamp);
+  auto& columns = MutableColumns();
+  auto column_it = columns.mutable_find(column_qualifier);
+  columns.totals.RemoveColumn(column_qualifier.size(), column_it->second);
+  auto ret = column_it->second.DeleteTimeStamp(timestamp, arena);
+  columns.totals.AddColumn(column_qualifier.size(), column_it->second);
   if (!column_it->second.HasCells()) {
-    columns_.erase(column_it);
+    columns.erase(column_it);
   }
 
   return ret;
 }
 
-void ColumnFamilyRow::RunGC(
-    google::bigtable::admin::v2::GcRule const& gc_rule) {
+void ColumnFamilyRow::RunGC(google::bigtable::admin::v2::GcRule const& gc_rule,
+                            ValueArena& arena) {
   assert(CheckGCRuleIsValid(gc_rule).ok());
-  for (auto it = columns_.begin(); it != columns_.end();) {
-    it->second.RunGC(gc_rule);
+  auto& columns = MutableColumns();
+  for (auto it = columns.mutable_begin(); it != columns.end();) {
+    auto const qualifier_size = it->first.name().size();
+    columns.totals.RemoveColumn(qualifier_size, it->second);
+    it->second.RunGC(gc_rule, arena);
+    columns.totals.AddColumn(qualifier_size, it->second);
     if (!it->second.HasCells()) {
-      it = erase(it);
+      it = columns.erase(it);
     } else {
       it++;
     }
   }
 }
 
+ColumnFamilyRow::Columns& ColumnFamilyRow::MutableColumns() {
+  // Copies of this row are only made by the thread modifying it (see
+  // `ColumnFamily::Snapshot()`), so once the count drops to 1 it cannot grow
+  // again behind our back. The fence orders our writes after the reads of
+  // whoever dropped the last other reference. The copy shares the nodes of
+  // the map, which are copied as they are modified.
+  if (columns_.use_count() > 1) {
+    columns_ = std::make_shared<Columns>(*columns_);
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  // `columns_` is only const so that reads don't copy nodes by accident.
+  return const_cast<Columns&>(*columns_);
+}
+
+absl::optional<std::string> ColumnFamilyRow::SetCell(
+    Columns& columns, std::string const& column_qualifier,
+    std::chrono::milliseconds timestamp, absl::string_view value,
+    QualifierDictionary& qualifiers, ValueArena& arena) {
+  auto it = columns.mutable_lower_bound(column_qualifier);
+  if (it == columns.end() || it->first != column_qualifier) {
+    // Only columns new to the row pay for the dictionary lookup.
+    it = columns.try_emplace(qualifiers.Intern(column_qualifier)).first;
+  }
+  auto& column = it->second;
+  columns.totals.RemoveColumn(column_qualifier.size(), column);
+  auto res = column.SetCell(timestamp, value, arena);
+  columns.totals.AddColumn(column_qualifier.size(), column);
+  return res;
+}
+
 absl::optional<std::string> ColumnFamily::SetCell(
     std::string const& row_key, std::string const& column_qualifier,
-    std::chrono::milliseconds timestamp, std::string const& value) {
-      return rows_[row_key].SetCell(column_qualifier, timestamp, value);
+    std::chrono::milliseconds timestamp, absl::string_view value) {
+  auto res = ColumnFamilyRow::SetCell(MutableColumns(row_key),
+                                      column_qualifier, timestamp, value,
+                                      *qualifiers_, *arena_);
+  IndexCell(row_key, column_qualifier, timestamp);
+  return res;
 }
 
-StatusOr<absl::optional<std::string>> ColumnFamily::UpdateCell(
-    std::string const& row_key, std::string const& column_qualifier,
-    std::chrono::milliseconds timestamp, std::string& value) {
-  return rows_[row_key].UpdateCell(column_qualifier, timestamp, value,
-                                   update_cell_);
+StatusOr<std::string> ColumnFamily::AddToValue(
+    absl::optional<absl::string_view> existing, std::int64_t input) const {
+  char buffer[sizeof(std::int64_t)];
+  if (unique_count_) {
+    return AddToValue(existing, EncodeInt64(input, buffer));
+  }
+  if (!aggregator_.has_value()) {
+    return InvalidArgumentError(
+        "column family is not configured to contain aggregation cells",
+        GCP_ERROR_INFO());
+  }
+  if (!existing) return std::string(EncodeInt64(input, buffer));
+  if (existing->size() != sizeof(std::int64_t)) {
+    // Report the same error as the other conversions of int64 cells.
+    return google::cloud::internal::DecodeBigEndian<std::int64_t>(
+               std::string(*existing))
+        .status();
+  }
+  // It fits in the small string buffer, so it is not allocated.
+  return std::string(EncodeInt64(
+      Aggregate(*aggregator_, DecodeInt64(*existing), input), buffer));
 }
 
-std::map<std::string, std::vector<Cell>> ColumnFamily::DeleteRow(
-    std::string const& row_key) {
-  std::map<std::string, std::vector<Cell>> res;
+StatusOr<std::string> ColumnFamily::AddToValue(
+    absl::optional<absl::string_view> existing, absl::string_view input) const {
+  if (!unique_count_) {
+    return InvalidArgumentError(
+        "only hllpp_unique_count column families accept non-int64 inputs",
+        GCP_ERROR_INFO());
+  }
+  std::string res = existing ? std::string(*existing) : std::string();
+  auto status = HllSketch::AddToEncoded(res, HllSketch::Hash(input));
+  if (!status.ok()) return status;
+  return res;
+}
 
-  auto row_it = rows_.find(row_key);
-  if (row_it == rows_.end()) {
-    return {};
+StatusOr<std::string> ColumnFamily::MergeToValue(
+    absl::optional<absl::string_view> existing,
+    absl::string_view sketch) const {
+  if (!unique_count_) {
+    return InvalidArgumentError(
+        "column family is not configured to contain HyperLogLog++ sketches",
+        GCP_ERROR_INFO());
   }
+  auto decoded = HllSketch::Decode(sketch);
+  if (!decoded) return std::move(decoded).status();
+  return MergeSketch(existing, *decoded);
+}
+
+StatusOr<std::string> ColumnFamily::MergeSketch(
+    absl::optional<absl::string_view> existing, HllSketch const& sketch) {
+  if (!existing) return sketch.Encode();
+  std::string res(*existing);
+  auto status = sketch.MergeIntoEncoded(res);
+  if (!status.ok()) return status;
+  return res;
+}
 
-  for (auto& column : row_it->second.columns_) {
-    // Not setting start and end timestamps will select all cells for deletion
-    ::google::bigtable::v2::TimestampRange time_range;
-    auto deleted_cells = column.second.DeleteTimeRange(time_range);
-    if (!deleted_cells.empty()) {
-      res[column.first] = std::move(deleted_cells);
+StatusOr<absl::optional<std::string>> ColumnFamily::AddToCell(
+    std::string const& row_key, std::string const& column_qualifier,
+    std::chrono::milliseconds timestamp, std::int64_t input) {
+  auto value =
+      AddToValue(FindCell(row_key, column_qualifier, timestamp), input);
+  if (!value) return std::move(value).status();
+  return SetCell(row_key, column_qualifier, timestamp, *value);
+}
+
+ColumnFamilyStats ColumnFamily::DeleteRow(std::string const& row_key) {
+  ColumnFamilyStats res;
+  // Only the cells' count contributes the row key and timestamp sizes.
+  auto const cell_bytes =
+      LogicalCellSize(row_key, absl::string_view(), absl::string_view());
+  if (!row_index_.contains(row_key)) {
+    // There is no need to thaw a frozen row only to delete it. Locating it
+    // decodes its column headers already, so they are summed up instead.
+    auto frozen = FindFrozenRow(row_key);
+    if (!frozen) return res;
+    FrozenSegment::RowCursor cursor(*segments_[frozen->first].segment,
+                                    frozen->second);
+    for (auto const& column : cursor.columns()) {
+      res.AddColumn(column.cells);
+      res.cells += static_cast<std::int64_t>(column.cells);
+      res.logical_bytes +=
+          static_cast<std::int64_t>(column.cells) *
+              (cell_bytes +
+               static_cast<std::int64_t>(column.qualifier.name().size())) +
+          static_cast<std::int64_t>(column.value_bytes);
     }
+    ++res.rows;
+    RemoveFrozenRow(frozen->first, frozen->second);
+    return res;
   }
 
+  auto row_it = std::as_const(rows_).find(row_key);
+  if (row_it == rows_.end()) return res;
+
+  auto const& row = row_it->second;
+  auto const& totals = row.totals();
+  res.rows = 1;
+  res.columns = static_cast<std::int64_t>(row.columns_->size());
+  res.cells = totals.cells;
+  res.logical_bytes = totals.cells * cell_bytes + totals.bytes;
+  res.versions_histogram = totals.versions_histogram;
+  deleted_rows_.push_back(row);
+  row_index_.erase(row_key);
   rows_.erase(row_it);
 
   return res;
@@ -502,20 +614,19 @@ std::map<std::string, std::vector<Cell>> ColumnFamily::DeleteRow(
 std::vector<Cell> ColumnFamily::DeleteColumn(
     std::string const& row_key, std::string const& column_qualifier,
     ::google::bigtable::v2::TimestampRange const& time_range) {
-  auto row_it = rows_.find(row_key);
-
-  return DeleteColumn(row_it, column_qualifier, time_range);
-}
-
-std::vector<Cell> ColumnFamily::DeleteColumn(
-    std::map<std::string, ColumnFamilyRow>::iterator row_it,
-    std::string const& column_qualifier,
-    ::google::bigtable::v2::TimestampRange const& time_range) {
-  if (row_it != rows_.end()) {
+  ThawRow(row_key);
+  auto row_it = rows_.mutable_find(row_key);
+  if (row_it != end()) {
     auto erased_cells =
-        row_it->second.DeleteColumn(column_qualifier, time_range);
+        row_it->second.DeleteColumn(column_qualifier, time_range, *arena_);
     if (!row_it->second.HasColumns()) {
-      rows_.erase(row_it);
+      erase(row_it);
+    } else {
+      // Only modified columns are not shared with a snapshot.
+      if (!erased_cells.empty()) {
+        row_it->second.MutableColumns().write_epoch = write_epoch_;
+      }
+      IndexRow(row_it);
     }
     return erased_cells;
   }
@@ -525,31 +636,660 @@ std::vector<Cell> ColumnFamily::DeleteColumn(
 absl::optional<Cell> ColumnFamily::DeleteTimeStamp(
     std::string const& row_key, std::string const& column_qualifier,
     std::chrono::milliseconds timestamp) {
-  auto row_it = rows_.find(row_key);
-  if (row_it == rows_.end()) {
+  ThawRow(row_key);
+  auto row_it = rows_.mutable_find(row_key);
+  if (row_it == end()) {
     return absl::nullopt;
   }
 
-  auto ret = row_it->second.DeleteTimeStamp(column_qualifier, timestamp);
+  auto ret =
+      row_it->second.DeleteTimeStamp(column_qualifier, timestamp, *arena_);
   if (!row_it->second.HasColumns()) {
-    rows_.erase(row_it);
+    erase(row_it);
+  } else {
+    if (ret) row_it->second.MutableColumns().write_epoch = write_epoch_;
+    IndexRow(row_it);
   }
 
   return ret;
 }
 
-void ColumnFamily::RunGC() {
+void ColumnFamily::RunGC(ColumnFamilyStats* stats_delta,
+                         std::vector<std::string>* emptied_rows) {
+  RunGC(std::string(), std::string(),
+        std::chrono::steady_clock::time_point::max(), stats_delta,
+        emptied_rows);
+}
+
+absl::optional<std::string> ColumnFamily::RunGC(
+    std::string const& start_row, std::string const& end_row,
+    std::chrono::steady_clock::time_point deadline,
+    ColumnFamilyStats* stats_delta, std::vector<std::string>* emptied_rows) {
+  if (!gc_rule_.has_value()) return absl::nullopt;
+  assert(CheckGCRuleIsValid(gc_rule_.value()).ok());
+  gc_index_.Advance(std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()));
+  std::size_t collected = 0;
+  for (auto row_key = gc_index_.FirstDueRow(start_row);
+       row_key && (end_row.empty() || *row_key < end_row);
+       row_key = gc_index_.NextDueRow(*row_key)) {
+    // Reading the clock is cheap, but not free compared to small rows.
+    if (collected++ % 16 == 1 && std::chrono::steady_clock::now() >= deadline) {
+      return row_key;
+    }
+    if (rows_.count(*row_key) == 0 && !ThawRow(*row_key)) {
+      gc_index_.RowCollected(*row_key, 0, absl::nullopt);
+      continue;
+    }
+    auto it = rows_.mutable_find(*row_key);
+    if (stats_delta != nullptr) {
+      ColumnFamilyStats before;
+      before.AddRow(it->first, it->second);
+      *stats_delta -= before;
+    }
+    it->second.RunGC(gc_rule_.value(), *arena_);
+    if (!it->second.HasColumns()) {
+      if (emptied_rows != nullptr) emptied_rows->push_back(it->first);
+      row_index_.erase(it->first);
+      rows_.erase(it);
+      gc_index_.RowCollected(*row_key, 0, absl::nullopt);
+      continue;
+    }
+    IndexRow(it);
+    if (stats_delta != nullptr) {
+      stats_delta->AddRow(it->first, it->second);
+    }
+    std::size_t max_versions = 0;
+    absl::optional<std::chrono::milliseconds> oldest;
+    for (auto const& column : *it->second.columns_) {
+      max_versions = std::max(max_versions, column.second.size());
+      // The cells are sorted newest first.
+      auto const column_oldest = std::prev(column.second.end())->first;
+      if (!oldest || column_oldest < *oldest) oldest = column_oldest;
+    }
+    gc_index_.RowCollected(*row_key, max_versions, oldest);
+  }
+  return absl::nullopt;
+}
+
+void ColumnFamily::SetGCRule(
+    google::bigtable::admin::v2::GcRule const& gc_rule) {
+  gc_rule_ = gc_rule;
+  gc_index_ = GcExpiryIndex(gc_rule);
+  ForEachRow(std::string(), std::string(),
+             [this](std::string const& row_key, ColumnFamilyRow const& row) {
+               for (auto const& column : row) {
+                 // Only the oldest cell matters for `max_age`.
+                 gc_index_.AddCell(row_key,
+                                   std::prev(column.second.end())->first,
+                                   column.second.size());
+               }
+             });
+}
+
+void ColumnFamily::IndexCell(std::string const& row_key,
+                             std::string const& column_qualifier,
+                             std::chrono::milliseconds timestamp) {
+  if (!gc_rule_.has_value()) return;
+  gc_index_.AddCell(row_key, timestamp,
+                    FindColumn(row_key, column_qualifier)->size());
+}
+
+ColumnRow const* ColumnFamily::FindColumn(
+    std::string const& row_key, std::string const& column_qualifier) const {
+  ColumnFamilyRow::Columns const* columns = nullptr;
+  auto indexed = row_index_.find(row_key);
+  if (indexed != row_index_.end() &&
+      indexed->second.generation == snapshot_generation_) {
+    columns = indexed->second.columns;
+  } else if (has_row_index_ && indexed == row_index_.end()) {
+    return nullptr;
+  } else {
+    auto row_it = rows_.find(row_key);
+    if (row_it == rows_.end()) return nullptr;
+    columns = row_it->second.columns_.get();
+  }
+  auto column_it = columns->find(column_qualifier);
+  return column_it == columns->end() ? nullptr : &column_it->second;
+}
+
+ColumnFamilyRow::Columns& ColumnFamily::MutableColumns(
+    std::string const& row_key) {
+  auto indexed = row_index_.find(row_key);
+  if (indexed == row_index_.end() && ThawRow(row_key)) {
+    indexed = row_index_.find(row_key);
+  }
+  if (indexed == row_index_.end() ||
+      indexed->second.generation != snapshot_generation_) {
+    auto& columns = rows_[row_key].MutableColumns();
+    indexed = row_index_
+                  .insert_or_assign(
+                      row_key, IndexedRow{&columns, snapshot_generation_})
+                  .first;
+  }
+  // The generation shows that no snapshot shares them, see `IndexRow()`.
+  auto& columns =
+      const_cast<ColumnFamilyRow::Columns&>(*indexed->second.columns);
+  columns.write_epoch = write_epoch_;
+  return columns;
+}
+
+void ColumnFamily::IndexRow(Rows::const_iterator row_it) {
+  auto const& columns = row_it->second.columns_;
+  row_index_.insert_or_assign(
+      row_it->first,
+      IndexedRow{columns.get(), columns.use_count() == 1 ? snapshot_generation_
+                                                         : kSharedRow});
+}
+
+std::size_t ColumnFamily::size() const {
+  auto res = rows_.size();
+  for (auto const& frozen : segments_) res += frozen.live_rows();
+  return res;
+}
+
+bool ColumnFamily::HasRow(std::string const& row_key) const {
+  auto const in_rows = has_row_index_ ? row_index_.contains(row_key)
+                                      : rows_.count(row_key) != 0;
+  return in_rows || FindFrozenRow(row_key).has_value();
+}
+
+absl::optional<absl::string_view> ColumnFamily::FindCell(
+    std::string const& row_key, std::string const& column_qualifier,
+    std::chrono::milliseconds timestamp) const {
+  auto const* column = FindColumn(row_key, column_qualifier);
+  if (column != nullptr) {
+    auto cell_it = column->find(timestamp);
+    if (cell_it == column->end()) return absl::nullopt;
+    return cell_it->second;
+  }
+  auto frozen = FindFrozenRow(row_key);
+  if (!frozen) return absl::nullopt;
+  FrozenSegment::RowCursor cursor(*segments_[frozen->first].segment,
+                                  frozen->second);
+  for (auto const& frozen_column : cursor.columns()) {
+    if (frozen_column.qualifier == column_qualifier) {
+      for (FrozenSegment::CellReader cell(frozen_column); cell.Valid();
+           cell.Next()) {
+        if (cell.timestamp() == timestamp) return cell.value();
+      }
+    }
+  }
+  return absl::nullopt;
+}
+
+std::size_t ColumnFamily::CountCells(
+    std::string const& row_key, std::string const& column_qualifier) const {
+  auto const* column = FindColumn(row_key, column_qualifier);
+  if (column != nullptr) return column->size();
+  auto frozen = FindFrozenRow(row_key);
+  if (!frozen) return 0;
+  FrozenSegment::RowCursor cursor(*segments_[frozen->first].segment,
+                                  frozen->second);
+  for (auto const& frozen_column : cursor.columns()) {
+    if (frozen_column.qualifier == column_qualifier) {
+      return frozen_column.cells;
+    }
+  }
+  return 0;
+}
+
+void ColumnFamily::ForEachRow(
+    std::string const& start_row, std::string const& end_row,
+    std::function<void(std::string const&, ColumnFamilyRow const&)> const& fn)
+    const {
+  auto const end =
+      end_row.empty() ? rows_.end() : rows_.lower_bound(end_row);
+  for (auto it = rows_.lower_bound(start_row); it != end; ++it) {
+    fn(it->first, it->second);
+  }
+  for (auto const& frozen : segments_) {
+    auto const& segment = *frozen.segment;
+    for (FrozenSegment::RowCursor cursor(segment,
+                                         segment.LowerBound(start_row));
+         cursor.Valid() && (end_row.empty() || cursor.row_key() < end_row);
+         cursor.Next()) {
+      if ((*frozen.removed)[cursor.row()]) continue;
+      fn(cursor.row_key(), DecodeRow(cursor, nullptr, nullptr));
+    }
+  }
+}
+
+absl::optional<std::pair<std::size_t, std::size_t>>
+ColumnFamily::FindFrozenRow(std::string const& row_key) const {
+  for (std::size_t i = 0; i != segments_.size(); ++i) {
+    auto const& frozen = segments_[i];
+    auto row = frozen.segment->Find(row_key);
+    if (row && !(*frozen.removed)[*row]) return std::make_pair(i, *row);
+  }
+  return absl::nullopt;
+}
+
+void ColumnFamily::RemoveFrozenRow(std::size_t segment, std::size_t row) {
+  auto& frozen = segments_[segment];
+  // Like `ColumnFamilyRow::MutableColumns()`.
+  if (frozen.removed.use_count() > 1) {
+    frozen.removed = std::make_shared<std::vector<bool>>(*frozen.removed);
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  (*frozen.removed)[row] = true;
+  ++frozen.removed_rows;
+}
+
+bool ColumnFamily::ThawRow(std::string const& row_key) {
+  if (segments_.empty() || row_index_.contains(row_key)) return false;
+  auto frozen = FindFrozenRow(row_key);
+  if (!frozen) return false;
+  FrozenSegment::RowCursor cursor(*segments_[frozen->first].segment,
+                                  frozen->second);
+  auto row_it =
+      rows_
+          .try_emplace(row_key,
+                       DecodeRow(cursor, qualifiers_.get(), arena_.get()))
+          .first;
+  IndexRow(row_it);
+  RemoveFrozenRow(frozen->first, frozen->second);
+  return true;
+}
+
+void ColumnFamily::ThawRows(std::string const& start_row,
+                            std::string const& end_row) {
+  for (std::size_t i = 0; i != segments_.size(); ++i) {
+    auto const& segment = *segments_[i].segment;
+    for (FrozenSegment::RowCursor cursor(segment,
+                                         segment.LowerBound(start_row));
+         cursor.Valid() && (end_row.empty() || cursor.row_key() < end_row);
+         cursor.Next()) {
+      if ((*segments_[i].removed)[cursor.row()]) continue;
+      auto row_it = rows_
+                        .try_emplace(cursor.row_key(),
+                                     DecodeRow(cursor, qualifiers_.get(),
+                                               arena_.get()))
+                        .first;
+      IndexRow(row_it);
+      RemoveFrozenRow(i, cursor.row());
+    }
+  }
+}
+
+ColumnFamilyRow ColumnFamily::DecodeRow(FrozenSegment::RowCursor const& cursor,
+                                        QualifierDictionary* qualifiers,
+                                        ValueArena* arena) {
+  ColumnFamilyRow res;
+  auto& columns = res.MutableColumns();
+  for (auto const& column : cursor.columns()) {
+    // The segment may have been built with a dictionary replaced since.
+    auto const qualifier = qualifiers == nullptr
+                               ? column.qualifier
+                               : qualifiers->Intern(column.qualifier);
+    auto& column_row = columns.try_emplace(qualifier).first->second;
+    column_row.value_bytes_ = column.value_bytes;
+    auto& cells = column_row.cells_;
+    // The cells are decoded newest first, so they are appended.
+    for (FrozenSegment::CellReader cell(column); cell.Valid(); cell.Next()) {
+      cells[cell.timestamp()] =
+          arena == nullptr ? cell.value() : arena->Store(cell.value());
+    }
+    columns.totals.AddColumn(qualifier.name().size(), column_row);
+  }
+  return res;
+}
+
+bool ColumnFamily::NeedsFreeze() const {
+  return (rows_.size() >= kFreezeRows &&
+          (!freeze_complete_ ||
+           std::chrono::steady_clock::now() >= next_write_epoch_)) ||
+         std::any_of(segments_.begin(), segments_.end(),
+                     [](FrozenRows const& frozen) {
+                       return frozen.removed_rows * 2 > frozen.segment->size();
+                     });
+}
+
+std::unique_ptr<ColumnFamily::FreezeJob> ColumnFamily::PrepareFreeze(
+    std::chrono::steady_clock::time_point now) {
+  if (now >= next_write_epoch_) {
+    ++write_epoch_;
+    next_write_epoch_ = now + kFreezeInterval;
+  }
+  // The rows written in the previous epoch may have been written just now.
+  auto const hot_epoch = write_epoch_ == 0 ? 0 : write_epoch_ - 1;
+  return std::unique_ptr<FreezeJob>(new FreezeJob(Snapshot(), hot_epoch));
+}
+
+void ColumnFamily::Freeze() {
+  FreezeJob job(Snapshot(), std::numeric_limits<std::uint64_t>::max());
+  job.Build(std::chrono::steady_clock::time_point::max());
+  InstallFreeze(job);
+}
+
+void ColumnFamily::FreezeJob::Build(
+    std::chrono::steady_clock::time_point deadline) {
+  auto const& snapshot = *snapshot_;
+  auto const segments = snapshot.segments_.size();
+  for (std::size_t i = 0; i != segments; ++i) {
+    outputs_.push_back(Output{snapshot.segments_[i], i, i + 1, false, false});
+  }
+  complete_ = true;
+  // The segments have dictionaries of their own, since the family's is
+  // modified concurrently.
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  FrozenSegment::Builder builder(dictionary);
+  bool frozen_any = false;
+  std::size_t visited = 0;
+  for (auto const& row : snapshot.rows_) {
+    if (visited++ % 16 == 1 && std::chrono::steady_clock::now() >= deadline) {
+      complete_ = false;
+      break;
+    }
+    if (row.second.columns_->write_epoch >= hot_epoch_) continue;
+    frozen_any = true;
+    builder.StartRow(row.first);
+    for (auto const& column : row.second) {
+      builder.StartColumn(dictionary->Intern(column.first));
+      for (auto const& cell : column.second) {
+        builder.AddCell(cell.first, cell.second);
+      }
+    }
+  }
+  if (frozen_any) {
+    cold_rows_ = std::move(builder).Build();
+    auto removed = std::make_shared<std::vector<bool>>(cold_rows_->size());
+    outputs_.push_back(Output{FrozenRows{cold_rows_, std::move(removed), 0},
+                              segments, segments, true, true});
+  }
+  for (auto& output : outputs_) {
+    if (!complete_) break;
+    if (output.frozen.removed_rows * 2 > output.frozen.segment->size()) {
+      auto rewritten = MergeSegments({output.frozen}, deadline);
+      if (!rewritten) {
+        complete_ = false;
+        break;
+      }
+      output.frozen = *std::move(rewritten);
+      output.built = true;
+    }
+  }
+  outputs_.erase(std::remove_if(outputs_.begin(), outputs_.end(),
+                                [](Output const& output) {
+                                  return output.frozen.live_rows() == 0;
+                                }),
+                 outputs_.end());
+  while (complete_ && outputs_.size() >= 2) {
+    auto const& last = outputs_.back();
+    auto const& previous = outputs_[outputs_.size() - 2];
+    if (previous.frozen.live_rows() > 2 * last.frozen.live_rows() ||
+        previous.frozen.live_rows() + last.frozen.live_rows() >
+            kMaxSegmentRows) {
+      break;
+    }
+    auto merged = MergeSegments({previous.frozen, last.frozen}, deadline);
+    if (!merged) {
+      complete_ = false;
+      break;
+    }
+    Output output{*std::move(merged), previous.first, last.last,
+                  previous.cold_rows || last.cold_rows, true};
+    outputs_.pop_back();
+    outputs_.back() = std::move(output);
+  }
+}
+
+void ColumnFamily::InstallFreeze(FreezeJob& job) {
+  auto const& before = job.snapshot_->segments_;
+  auto const unchanged =
+      segments_.size() == before.size() &&
+      std::equal(segments_.begin(), segments_.end(), before.begin(),
+                 [](FrozenRows const& lhs, FrozenRows const& rhs) {
+                   return lhs.segment == rhs.segment;
+                 });
+  freeze_complete_ = unchanged && job.complete_;
+  if (!unchanged) return;
+
+  std::vector<FrozenRows> segments;
+  for (auto& output : job.outputs_) {
+    if (!output.built) {
+      segments.push_back(segments_[output.first]);
+      continue;
+    }
+    auto& frozen = output.frozen;
+    auto remove = [&frozen](std::string const& row_key) {
+      auto row = frozen.segment->Find(row_key);
+      if (!row || (*frozen.removed)[*row]) return;
+      (*frozen.removed)[*row] = true;
+      ++frozen.removed_rows;
+    };
+    // The rows thawed or deleted since the snapshot.
+    for (auto i = output.first; i != output.last; ++i) {
+      if (segments_[i].removed_rows == before[i].removed_rows) continue;
+      auto const& removed_before = *before[i].removed;
+      auto const& removed_now = *segments_[i].removed;
+      for (std::size_t row = 0; row != removed_now.size(); ++row) {
+        if (!removed_now[row] || removed_before[row]) continue;
+        remove(FrozenSegment::RowCursor(*before[i].segment, row).row_key());
+      }
+    }
+    if (output.cold_rows) {
+      auto const& snapshot_rows = job.snapshot_->rows_;
+      for (FrozenSegment::RowCursor cursor(*job.cold_rows_, 0);
+           cursor.Valid(); cursor.Next()) {
+        auto const& row_key = cursor.row_key();
+        auto row_it = std::as_const(rows_).find(row_key);
+        // A modified row has new columns, see `MutableColumns()`.
+        if (row_it == rows_.end() || row_it->second.columns_ !=
+                                         snapshot_rows.find(row_key)
+                                             ->second.columns_) {
+          remove(row_key);
+          continue;
+        }
+        deleted_rows_.push_back(row_it->second);
+        row_index_.erase(row_key);
+        rows_.erase(row_it);
+      }
+    }
+    if (frozen.live_rows() != 0) segments.push_back(std::move(frozen));
+  }
+  segments_ = std::move(segments);
+}
+
+absl::optional<ColumnFamily::FrozenRows> ColumnFamily::MergeSegments(
+    std::vector<FrozenRows> const& segments,
+    std::chrono::steady_clock::time_point deadline) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  FrozenSegment::Builder builder(dictionary);
+  std::vector<FrozenSegment::RowCursor> cursors;
+  cursors.reserve(segments.size());
+  for (auto const& frozen : segments) cursors.emplace_back(*frozen.segment, 0);
+  for (std::size_t merged = 0;; ++merged) {
+    if (merged % 16 == 1 && std::chrono::steady_clock::now() >= deadline) {
+      return absl::nullopt;
+    }
+    // The segments have no rows in common, so there are no ties.
+    absl::optional<std::size_t> next;
+    for (std::size_t i = 0; i != cursors.size(); ++i) {
+      auto& cursor = cursors[i];
+      while (cursor.Valid() && (*segments[i].removed)[cursor.row()]) {
+        cursor.Next();
+      }
+      if (cursor.Valid() &&
+          (!next || cursor.row_key() < cursors[*next].row_key())) {
+        next = i;
+      }
+    }
+    if (!next) break;
+    auto& cursor = cursors[*next];
+    builder.StartRow(cursor.row_key());
+    for (auto const& column : cursor.columns()) {
+      builder.StartColumn(dictionary->Intern(column.qualifier));
+      for (FrozenSegment::CellReader cell(column); cell.Valid(); cell.Next()) {
+        builder.AddCell(cell.timestamp(), cell.value());
+      }
+    }
+    cursor.Next();
+  }
+  auto segment = std::move(builder).Build();
+  auto removed = std::make_shared<std::vector<bool>>(segment->size());
+  return FrozenRows{std::move(segment), std::move(removed), 0};
+}
+
+std::vector<std::unique_ptr<FrozenSegmentStream>>
+ColumnFamily::CreateFrozenStreams(
+    std::string const& column_family_name,
+    std::shared_ptr<StringRangeSet const> const& row_set) const {
+  std::vector<std::unique_ptr<FrozenSegmentStream>> res;
+  if (segments_.empty()) return res;
+  GcReadMask gc_mask;
   if (gc_rule_.has_value()) {
-    assert(CheckGCRuleIsValid(gc_rule_.value()).ok());
-    for (auto it = rows_.begin(); it != rows_.end();) {
-      it->second.RunGC(gc_rule_.value());
-      if (!it->second.HasColumns()) {
-        it = erase(it);
-      } else {
-        it++;
+    gc_mask = GcReadMask(
+        *gc_rule_, std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::system_clock::now().time_since_epoch()));
+  }
+  res.reserve(segments_.size());
+  for (auto const& frozen : segments_) {
+    res.push_back(std::make_unique<FrozenSegmentStream>(
+        frozen.segment, frozen.removed, column_family_name, row_set,
+        gc_mask));
+  }
+  return res;
+}
+
+ColumnFamily::const_iterator ColumnFamily::erase(const_iterator row_it) {
+  for (auto const& column : *row_it->second.columns_) {
+    for (auto const& cell : column.second) arena_->Release(cell.second);
+  }
+  row_index_.erase(row_it->first);
+  return rows_.erase(row_it);
+}
+
+bool ColumnFamily::ReleaseDeletedRows(
+    std::chrono::steady_clock::time_point deadline) {
+  std::size_t released = 0;
+  // Releasing a cell is cheaper than reading the clock.
+  auto const out_of_time = [&] {
+    return ++released % 1024 == 0 &&
+           std::chrono::steady_clock::now() >= deadline;
+  };
+  while (!deleted_rows_.empty()) {
+    auto& row = deleted_rows_.front();
+    // The row's columns may be shared with a snapshot, which keeps them.
+    // Otherwise they are freed as their values are released. A deleted row
+    // is not copied anymore, so it never becomes shared again.
+    if (row.columns_.use_count() == 1) {
+      auto& columns = row.MutableColumns();
+      if (release_cursor_) {
+        // Free what was released while the row was shared.
+        auto const& cursor = *release_cursor_;
+        auto column =
+            columns.erase(columns.begin(), columns.lower_bound(cursor.column));
+        auto& cells = column->second.cells_;
+        cells.erase(cells.begin(), cells.lower_bound(cursor.cell));
+        release_cursor_.reset();
+      }
+      while (!columns.empty()) {
+        auto column = columns.mutable_begin();
+        auto& cells = column->second.cells_;
+        while (!cells.empty()) {
+          if (out_of_time()) return false;
+          arena_->Release(cells.begin()->second);
+          cells.erase(cells.begin());
+        }
+        columns.erase(column);
+      }
+    } else {
+      auto const& columns = *row.columns_;
+      auto column = release_cursor_
+                        ? columns.lower_bound(release_cursor_->column)
+                        : columns.begin();
+      auto cell = release_cursor_
+                      ? column->second.lower_bound(release_cursor_->cell)
+                      : column->second.begin();
+      for (;;) {
+        for (; cell != column->second.end(); ++cell) {
+          if (out_of_time()) {
+            release_cursor_ = ReleaseCursor{column->first, cell->first};
+            return false;
+          }
+          arena_->Release(cell->second);
+        }
+        if (++column == columns.end()) break;
+        cell = column->second.begin();
       }
+      release_cursor_.reset();
+    }
+    deleted_rows_.pop_front();
+  }
+  return true;
+}
+
+bool ColumnFamily::NeedsValueCompaction() const {
+  if (old_arena_) return true;
+  auto const garbage = arena_->stored_bytes() - arena_->live_bytes();
+  if (garbage >= kMinCompactionGarbage && garbage > arena_->live_bytes()) {
+    return true;
+  }
+  return qualifiers_->size() >= kMinCompactionQualifiers &&
+         qualifiers_->size() > 2 * compacted_qualifiers_;
+}
+
+bool ColumnFamily::CompactValues(
+    std::chrono::steady_clock::time_point deadline) {
+  if (!old_arena_) {
+    if (!NeedsValueCompaction()) return true;
+    old_arena_ = std::move(arena_);
+    arena_ = std::make_shared<ValueArena>();
+    old_qualifiers_ = std::move(qualifiers_);
+    qualifiers_ = std::make_shared<QualifierDictionary>();
+    compaction_cursor_.clear();
+  }
+  std::size_t moved = 0;
+  for (auto it = rows_.mutable_lower_bound(compaction_cursor_);
+       it != rows_.end(); ++it) {
+    if (moved++ % 16 == 1 && std::chrono::steady_clock::now() >= deadline) {
+      compaction_cursor_ = it->first;
+      return false;
     }
+    auto& columns = it->second.MutableColumns();
+    // The columns move to a new map, since the inner nodes of the old one
+    // may keep qualifiers of the old dictionary after they are re-interned.
+    ColumnFamilyRow::Columns compacted;
+    compacted.totals = columns.totals;
+    compacted.write_epoch = columns.write_epoch;
+    for (auto column = columns.mutable_begin(); column != columns.end();
+         ++column) {
+      auto& column_row =
+          compacted
+              .try_emplace(qualifiers_->Intern(column->first),
+                           std::move(column->second))
+              .first->second;
+      column_row.MoveValues(*old_arena_, *arena_);
+    }
+    columns = std::move(compacted);
+    IndexRow(it);
   }
+  old_arena_.reset();
+  old_qualifiers_.reset();
+  compaction_cursor_.clear();
+  compacted_qualifiers_ = qualifiers_->size();
+  return true;
+}
+
+std::shared_ptr<ColumnFamily const> ColumnFamily::Snapshot() const {
+  // From now on, the rows' columns and values are shared with the snapshot.
+  ++snapshot_generation_;
+  arena_->Seal();
+  auto res = std::make_shared<ColumnFamily>();
+  res->has_row_index_ = false;
+  res->rows_ = rows_;
+  res->qualifiers_ = qualifiers_;
+  res->old_qualifiers_ = old_qualifiers_;
+  res->arena_ = arena_;
+  res->old_arena_ = old_arena_;
+  res->segments_ = segments_;
+  res->value_type_ = value_type_;
+  res->gc_rule_ = gc_rule_;
+  res->aggregator_ = aggregator_;
+  res->unique_count_ = unique_count_;
+  return res;
 }
 
 class FilteredColumnFamilyStream::FilterApply {
@@ -577,6 +1317,8 @@ class FilteredColumnFamilyStream::FilterApply {
 
   bool operator()(ColumnRegex const& column_regex) {
     parent_.column_regexes_.emplace_back(column_regex.regex);
+    parent_.column_regex_memo_.assign(
+        1, std::make_shared<QualifierRegexMemo>(parent_.column_regexes_));
     return true;
   }
 
@@ -593,7 +1335,23 @@ FilteredColumnFamilyStream::FilteredColumnFamilyStream(
       timestamp_ranges_(TimestampRangeSet::All()),
       rows_(
           StringRangeFilteredMapView<ColumnFamily>(column_family, *row_ranges_),
-          std::cref(row_regexes_)) {}
+          std::cref(row_regexes_)) {
+  if (column_family.gc_rule().has_value()) {
+    gc_mask_ = GcReadMask(
+        *column_family.gc_rule(),
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()));
+  }
+}
+
+FilteredColumnFamilyStream::FilteredColumnFamilyStream(
+    std::shared_ptr<ColumnFamily const> column_family,
+    std::string column_family_name,
+    std::shared_ptr<StringRangeSet const> row_set)
+    : FilteredColumnFamilyStream(*column_family, std::move(column_family_name),
+                                 std::move(row_set)) {
+  column_family_ = std::move(column_family);
+}
 
 bool FilteredColumnFamilyStream::ApplyFilter(
     InternalFilter const& internal_filter) {
@@ -624,7 +1382,7 @@ bool FilteredColumnFamilyStream::Next(NextMode mode) {
 
   if (mode == NextMode::kCell) {
     ++(cell_it_.value());
-    if (cell_it_.value() != cells_.value().end()) {
+    if (SkipMaskedCells()) {
       return true;
     }
   }
@@ -649,22 +1407,46 @@ void FilteredColumnFamilyStream::InitializeIfNeeded() const {
 
 bool FilteredColumnFamilyStream::PointToFirstCellAfterColumnChange() const {
   for (; column_it_.value() != columns_.value().end(); ++(column_it_.value())) {
-    cells_ = TimestampRangeFilteredMapView<ColumnRow>(
-        column_it_.value()->second, timestamp_ranges_);
+    auto const& column = column_it_.value()->second;
+    cells_ = TimestampRangeFilteredMapView<ColumnRow>(column, timestamp_ranges_);
     cell_it_ = cells_.value().begin();
-    if (cell_it_.value() != cells_.value().end()) {
+    if (!gc_mask_.empty()) {
+      auto const& limits = gc_mask_.version_limits();
+      gc_limit_timestamps_.assign(limits.size(), absl::nullopt);
+      auto it = column.begin();
+      std::size_t rank = 0;
+      for (std::size_t i = 0; i != limits.size() && limits[i] < column.size();
+           ++i) {
+        std::advance(it, limits[i] - rank);
+        rank = limits[i];
+        gc_limit_timestamps_[i] = it->first;
+      }
+    }
+    if (SkipMaskedCells()) {
       return true;
     }
   }
   return false;
 }
 
+bool FilteredColumnFamilyStream::SkipMaskedCells() const {
+  auto& cell_it = cell_it_.value();
+  auto const end = cells_.value().end();
+  if (gc_mask_.empty()) return cell_it != end;
+  while (cell_it != end &&
+         gc_mask_.Hides(cell_it->first, gc_limit_timestamps_)) {
+    ++cell_it;
+  }
+  return cell_it != end;
+}
+
 bool FilteredColumnFamilyStream::PointToFirstCellAfterRowChange() const {
   for (; (*row_it_) != rows_.end(); ++(*row_it_)) {
-    columns_ = RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamilyRow>>(
+    columns_ = RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamilyRow>,
+                                   QualifierRegexMemo>(
         StringRangeFilteredMapView<ColumnFamilyRow>((*row_it_)->second,
                                                     column_ranges_),
-        column_regexes_);
+        column_regex_memo_);
     column_it_ = columns_.value().begin();
     if (PointToFirstCellAfterColumnChange()) {
       return true;
@@ -687,13 +1469,16 @@ StatusOr<std::shared_ptr<ColumnFamily>> ColumnFamily::ConstructColumnFamily(
       auto const& aggregate_type = value_type.aggregate_type();
       switch (aggregate_type.aggregator_case()) {
         case google::bigtable::admin::v2::Type::Aggregate::kSum:
-          cf->update_cell_ = cf->SumUpdateCellBEInt64;
+          cf->aggregator_ = Int64Aggregator::kSum;
           break;
         case google::bigtable::admin::v2::Type::Aggregate::kMin:
-          cf->update_cell_ = cf->MinUpdateCellBEInt64;
+          cf->aggregator_ = Int64Aggregator::kMin;
           break;
         case google::bigtable::admin::v2::Type::Aggregate::kMax:
-          cf->update_cell_ = cf->MaxUpdateCellBEInt64;
+          cf->aggregator_ = Int64Aggregator::kMax;
+          break;
+        case google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount:
+          cf->unique_count_ = true;
           break;
         default:
           return InvalidArgumentError(
@@ -720,6 +1505,7 @@ StatusOr<std::shared_ptr<ColumnFamily>> ColumnFamily::ConstructColumnFamily(
       return status;
     }
 
+    cf->gc_index_ = GcExpiryIndex(gc_rule);
     cf->gc_rule_ = std::move(gc_rule);
   }
 
@@ -734,10 +1520,52 @@ Status CheckGCRuleIsValid(google::bigtable::admin::v2::GcRule const& rule) {
   return CheckGCRuleTreeHasValidFields(rule);
 }
 
+std::int64_t EstimateGCEligibleCells(
+    google::bigtable::admin::v2::GcRule const& rule,
+    ColumnFamilyStats const& stats) {
+  if (rule.has_max_num_versions()) {
+    auto const keep = static_cast<std::int64_t>(rule.max_num_versions());
+    std::int64_t kept = 0;
+    bool may_exceed = false;
+    for (std::size_t i = 0; i != stats.versions_histogram.size(); ++i) {
+      auto const columns = stats.versions_histogram[i];
+      if (columns == 0) continue;
+      auto const min_versions = std::int64_t{1} << i;
+      // The last bucket has no upper bound.
+      may_exceed = may_exceed || i + 1 == stats.versions_histogram.size() ||
+                   2 * min_versions - 1 > keep;
+      kept += columns * std::min(min_versions, keep);
+    }
+    if (!may_exceed) return 0;
+    return std::max<std::int64_t>(stats.cells - kept, 0);
+  }
+  if (rule.has_max_age()) return stats.cells;
+  if (rule.has_union_()) {
+    std::int64_t res = 0;
+    for (auto const& sub_rule : rule.union_().rules()) {
+      res += EstimateGCEligibleCells(sub_rule, stats);
+    }
+    return std::min(res, stats.cells);
+  }
+  if (rule.has_intersection()) {
+    auto const& rules = rule.intersection().rules();
+    if (rules.empty()) return 0;
+    auto res = stats.cells;
+    for (auto const& sub_rule : rules) {
+      res = std::min(res, EstimateGCEligibleCells(sub_rule, stats));
+    }
+    return res;
+  }
+  return 0;
+}
+
 PersistentFilteredColumnFamilyStream::PersistentFilteredColumnFamilyStream(
     std::string const& table_name, std::string const& family,
-    std::string const& start_row_key)
+    std::string const& start_row_key,
+    std::shared_ptr<StringRangeSet const> row_ranges,
+    std::shared_ptr<rocksdb::Snapshot const> snapshot, GcReadMask gc_mask)
     : storage_(GetGlobalStorage()),
+      snapshot_(std::move(snapshot)),
       start_row_key_(start_row_key),
       cur_family_(family) {
   // Define the prefix specifically for this table
@@ -747,9 +1575,15 @@ PersistentFilteredColumnFamilyStream::PersistentFilteredColumnFamilyStream(
   auto const pos = family.find(prefix);
   cur_family_bare_ =
       pos == std::string::npos ? family : family.substr(pos + prefix.length());
-  row_ranges_ = std::make_shared<StringRangeSet const>(StringRangeSet::All());
+  row_ranges_ = row_ranges ? std::move(row_ranges)
+                           : std::make_shared<StringRangeSet const>(
+                                 StringRangeSet::All());
   column_ranges_ = StringRangeSet::All();
   timestamp_ranges_ = TimestampRangeSet::All();
+  gc_mask_ = std::move(gc_mask);
+  if (storage_ != nullptr) {
+    it_.reset(storage_->NewIterator(cur_family_, snapshot_.get()));
+  }
 }
 
 PersistentFilteredColumnFamilyStream::~PersistentFilteredColumnFamilyStream() = default;
@@ -792,14 +1626,12 @@ bool PersistentFilteredColumnFamilyStream::ApplyFilter(InternalFilter const& int
 
 void PersistentFilteredColumnFamilyStream::InitializeIfNeeded() const {
   if (initialized_) return;
-  if (storage_ == nullptr) {
+  if (!it_) {
     initialized_ = true;
     has_value_ = false;
     return;
   }
 
-  it_.reset(storage_->NewIterator(cur_family_));
-
   // Build seek key. Prefer explicit start_row_key_; if not set, use earliest
   // finite start from the row_ranges_ (if any), otherwise seek to table prefix.
   std::string search_key = table_prefix_;
@@ -936,9 +1768,8 @@ bool PersistentFilteredColumnFamilyStream::ParseCurrentKey() {
     // Row range test
     if (row_ranges_) {
       bool found = false;
-      StringRangeSet::Range::Value rowv = cur_row_;
       for (auto const& r : row_ranges_->disjoint_ranges()) {
-        if (r.IsWithin(rowv)) {
+        if (r.IsWithin(cur_row_)) {
           found = true;
           break;
         }
@@ -950,7 +1781,7 @@ bool PersistentFilteredColumnFamilyStream::ParseCurrentKey() {
     if (!row_regexes_.empty()) {
       bool matched = false;
       for (auto const& rx : row_regexes_) {
-        if (re2::RE2::PartialMatch(cur_row_, *rx)) {
+        if (rx->PartialMatch(cur_row_)) {
           matched = true;
           break;
         }
@@ -961,9 +1792,8 @@ bool PersistentFilteredColumnFamilyStream::ParseCurrentKey() {
     // Column range test
     {
       bool in_some = false;
-      StringRangeSet::Range::Value vq = cur_qualifier_;
       for (auto const& r : column_ranges_.disjoint_ranges()) {
-        if (r.IsWithin(vq)) {
+        if (r.IsWithin(cur_qualifier_)) {
           in_some = true;
           break;
         }
@@ -975,7 +1805,7 @@ bool PersistentFilteredColumnFamilyStream::ParseCurrentKey() {
     if (!column_regexes_.empty()) {
       bool matched = false;
       for (auto const& rx : column_regexes_) {
-        if (re2::RE2::PartialMatch(cur_qualifier_, *rx)) {
+        if (rx->PartialMatch(cur_qualifier_)) {
           matched = true;
           break;
         }
@@ -995,6 +1825,22 @@ bool PersistentFilteredColumnFamilyStream::ParseCurrentKey() {
       if (!in_some) { it_->Next(); continue; }
     }
 
+    // The keys don't order the cells by timestamp, so the column's
+    // timestamps are read ahead to rank its cells, once per column.
+    if (!gc_mask_.version_limits().empty()) {
+      absl::string_view const column_prefix(key.data(),
+                                            table_prefix_.size() + pos2 + 1);
+      if (column_prefix != ranked_column_) {
+        gc_limit_timestamps_ = gc_mask_.FindLimitTimestamps(
+            ReadColumnTimestamps(*it_, column_prefix, key));
+        ranked_column_.assign(column_prefix.data(), column_prefix.size());
+      }
+    }
+    if (gc_mask_.Hides(cur_timestamp_, gc_limit_timestamps_)) {
+      it_->Next();
+      continue;
+    }
+
     // All filters passed for this key.
     return true;
   }
@@ -15,30 +15,45 @@
 #ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_COLUMN_FAMILY_H
 #define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_COLUMN_FAMILY_H
 
-#include "google/cloud/internal/big_endian.h"
 #include "google/cloud/status_or.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "bigtable_limits.h"
+#include "cell_map.h"
 #include "cell_view.h"
 #include "filter.h"
 #include "filtered_map.h"
+#include "frozen_segment.h"
+#include "gc_expiry_index.h"
+#include "gc_read_mask.h"
+#include "hll_sketch.h"
+#include "persistent_map.h"
+#include "qualifier_dictionary.h"
 #include "range_set.h"
+#include "regex_matcher.h"
 #include "storage.h"
+#include "table_stats.h"
+#include "value_arena.h"
 #include <google/bigtable/admin/v2/table.pb.h>
 #include <google/bigtable/admin/v2/types.pb.h>
 #include <google/bigtable/v2/data.pb.h>
 #include <google/protobuf/duration.pb.h>
 #include <google/protobuf/repeated_field.h>
 #include <google/protobuf/stubs/mutex.h>
+#include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <rocksdb/iterator.h>
+#include <rocksdb/snapshot.h>
 
 namespace google {
 namespace cloud {
@@ -77,44 +92,36 @@ static_assert(kMaxGCRuleSize == 500,
  */
 Status CheckGCRuleIsValid(google::bigtable::admin::v2::GcRule const& rule);
 
+/**
+ * An upper bound of the number of cells of a column family with `stats`
+ * which `rule` may garbage collect.
+ *
+ * It is 0 if no cell is eligible, e.g. because no column has more versions
+ * than a `max_num_versions` rule keeps. `max_age` rules are assumed to make
+ * all cells eligible.
+ */
+std::int64_t EstimateGCEligibleCells(
+    google::bigtable::admin::v2::GcRule const& rule,
+    ColumnFamilyStats const& stats);
+
 struct Cell {
   std::chrono::milliseconds timestamp;
   std::string value;
 };
 
-// ReadModifyWriteCellResult supports undo and return value
-// construction for the ReadModifyWrite RPC.
-//
-// The timestamp and value written are always returned in timestamp
-// and value and will be used to construct the Row returned by the
-// RPC.
-//
-// If maybe_old_value has a value, then a timestamp was overwritten
-// and the ReadModifyWriteCellResult will be used to create a
-// RestoreValue for undo log. Otherwise, a new cell was added and the
-// ReadmodifyWriteCellResult will be used to create a DeleteValue for
-// the undo log.
-struct ReadModifyWriteCellResult {
-  std::chrono::milliseconds timestamp;
-  std::string value;
-  absl::optional<std::string> maybe_old_value;
-};
+/// How `AddToValue()` combines the int64 values of an aggregate column
+/// family.
+enum class Int64Aggregator { kSum, kMin, kMax };
 
 /**
  * Objects of this class hold contents of a specific column in a specific row.
  *
- * This is essentially a blessed map from timestamps to values.
+ * This is essentially a blessed map from timestamps to values. It is copied
+ * when it is modified while shared with a snapshot (see `ColumnFamilyRow`).
  */
 class ColumnRow {
  public:
   ColumnRow() = default;
-  // Disable copying.
-  ColumnRow(ColumnRow const&) = delete;
-  ColumnRow& operator=(ColumnRow const&) = delete;
-
-  StatusOr<ReadModifyWriteCellResult> ReadModifyWrite(std::int64_t inc_value);
-
-  ReadModifyWriteCellResult ReadModifyWrite(std::string const& append_value);
 
   /**
    * Insert or update and existing cell at a given timestamp.
@@ -122,17 +129,16 @@ class ColumnRow {
    * @param timestamp the time stamp at which the value will be inserted or
    *     updated.
    * @param value the value to insert/update.
+   * @param arena the arena the value is copied to, and the overwritten
+   *     value is released from. A value of the same size is overwritten in
+   *     place if the arena allows it (see `ValueArena::Overwrite()`).
    *
    * @return no value if the timestamp had no value before, otherwise
    * the previous value of the timestamp.
    */
   absl::optional<std::string> SetCell(std::chrono::milliseconds timestamp,
-                                      std::string const& value);
-
-  StatusOr<absl::optional<std::string>> UpdateCell(
-      std::chrono::milliseconds timestamp, std::string& value,
-      std::function<StatusOr<std::string>(std::string const&,
-                                          std::string&&)> const& update_fn);
+                                      absl::string_view value,
+                                      ValueArena& arena);
 
   /**
    * Delete cells falling into a given timestamp range.
@@ -141,7 +147,8 @@ class ColumnRow {
    * @return vector of deleted cells.
    */
   std::vector<Cell> DeleteTimeRange(
-      ::google::bigtable::v2::TimestampRange const& time_range);
+      ::google::bigtable::v2::TimestampRange const& time_range,
+      ValueArena& arena);
 
   /**
    * Delete a cell with the given timestamp.
@@ -152,15 +159,16 @@ class ColumnRow {
    * @return Cell representing deleted cell, if there
    *     was a cell with that timestamp, otherwise absl::nullopt.
    */
-  absl::optional<Cell> DeleteTimeStamp(std::chrono::milliseconds timestamp);
+  absl::optional<Cell> DeleteTimeStamp(std::chrono::milliseconds timestamp,
+                                       ValueArena& arena);
 
   bool HasCells() const { return !cells_.empty(); }
   std::size_t size() const { return cells_.size(); }
+  /// The total size of the cells' values.
+  std::size_t value_bytes() const { return value_bytes_; }
 
-  using const_iterator = std::map<std::chrono::milliseconds, std::string,
-                                  std::greater<>>::const_iterator;
-  using iterator = std::map<std::chrono::milliseconds, std::string,
-                            std::greater<>>::iterator;
+  using const_iterator = CellMap::const_iterator;
+  using iterator = CellMap::iterator;
 
   const_iterator begin() const { return cells_.begin(); }
   const_iterator end() const { return cells_.end(); }
@@ -171,11 +179,12 @@ class ColumnRow {
     return cells_.upper_bound(timestamp);
   }
 
-  const_iterator find(std::chrono::milliseconds const& timestamp) {
+  const_iterator find(std::chrono::milliseconds const& timestamp) const {
     return cells_.find(timestamp);
   }
 
   iterator erase(const_iterator timestamp_it) {
+    value_bytes_ -= timestamp_it->second.size();
     return cells_.erase(timestamp_it);
   }
 
@@ -186,25 +195,37 @@ class ColumnRow {
    * Note that it is assumed to be valid. That assumption is guarded using
    * assertions in debug build, but there are no guardrails in the release
    * build.
+   * @param arena the arena the collected values are released from.
    */
-  void RunGC(google::bigtable::admin::v2::GcRule const& gc_rule);
+  void RunGC(google::bigtable::admin::v2::GcRule const& gc_rule,
+             ValueArena& arena);
+
+  /// Copy the values stored in `from` to `to`.
+  void MoveValues(ValueArena const& from, ValueArena& to);
 
  private:
+  // Decodes frozen rows without copying their values.
+  friend class ColumnFamily;
+
   // Note the order - the iterator return the freshest cells first.
-  std::map<std::chrono::milliseconds, std::string, std::greater<>> cells_;
+  CellMap cells_;
+  std::size_t value_bytes_ = 0;
+
+  // Erase the cells in [`first`, `last`), releasing their values.
+  iterator EraseCells(const_iterator first, const_iterator last,
+                      ValueArena& arena);
 
   // GCRuleEraseVerdict returns true if the cell pointed to by the
   // iterator `it` should be erased according to the GcRule `rule`.
   // Otherwise, it returns false.
   bool GCRuleEraseVerdict(google::bigtable::admin::v2::GcRule const& rule,
-                          std::map<std::chrono::milliseconds, std::string,
-                                   std::greater<>>::const_iterator it,
-                          int32_t version_rank);
+                          const_iterator it, int32_t version_rank);
   // The following methods implement support for column family level
   // garbage collection.
-  void ApplyGCRuleMaxNumVersions(std::size_t n);
-  void ApplyGCRuleMaxAge(protobuf::Duration const& max_age);
-  void ApplyGCRuleVerdict(google::bigtable::admin::v2::GcRule const& gc_rule);
+  void ApplyGCRuleMaxNumVersions(std::size_t n, ValueArena& arena);
+  void ApplyGCRuleMaxAge(protobuf::Duration const& max_age, ValueArena& arena);
+  void ApplyGCRuleVerdict(google::bigtable::admin::v2::GcRule const& gc_rule,
+                          ValueArena& arena);
 };
 
 /**
@@ -214,19 +235,18 @@ class ColumnRow {
  * references to `ColumnRow`.
  *
  * It is guaranteed that every returned `ColumnRow` contains at least one cell.
+ *
+ * Copies of a row share its columns until either of them is modified (through
+ * a non-const member function), which makes copying rows, and so snapshotting
+ * a `ColumnFamily`, cheap. The columns are a `PersistentMap`, so modifying a
+ * shared row only copies the B-tree leaf of the modified column and the path
+ * to it.
+ *
+ * The row keeps the `Totals` of its columns up to date. Its columns are only
+ * modified through its members, since it hands out const iterators only.
  */
 class ColumnFamilyRow {
  public:
-  StatusOr<ReadModifyWriteCellResult> ReadModifyWrite(
-      std::string const& column_qualifier, std::int64_t inc_value) {
-    return columns_[column_qualifier].ReadModifyWrite(inc_value);
-  };
-
-  ReadModifyWriteCellResult ReadModifyWrite(std::string const& column_qualifier,
-                                            std::string const& append_value) {
-    return columns_[column_qualifier].ReadModifyWrite(append_value);
-  }
-
   /**
    * Insert or update and existing cell at a given column and timestamp.
    *
@@ -234,6 +254,9 @@ class ColumnFamilyRow {
    * @param timestamp the time stamp at which the value will be inserted or
    *     updated.
    * @param value the value to insert/update.
+   * @param qualifiers the dictionary the qualifier is interned in if the
+   *     column is new.
+   * @param arena the arena the value is copied to.
    *
    * @return no value if the timestamp had no value before, otherwise
    * the previous value of the timestamp.
@@ -241,13 +264,9 @@ class ColumnFamilyRow {
    */
   absl::optional<std::string> SetCell(std::string const& column_qualifier,
                                       std::chrono::milliseconds timestamp,
-                                      std::string const& value);
-
-  StatusOr<absl::optional<std::string>> UpdateCell(
-      std::string const& column_qualifier, std::chrono::milliseconds timestamp,
-      std::string& value,
-      std::function<StatusOr<std::string>(std::string const&,
-                                          std::string&&)> const& update_fn);
+                                      absl::string_view value,
+                                      QualifierDictionary& qualifiers,
+                                      ValueArena& arena);
 
   /**
    * Delete cells falling into a given timestamp range in one column.
@@ -259,7 +278,8 @@ class ColumnFamilyRow {
    */
   std::vector<Cell> DeleteColumn(
       std::string const& column_qualifier,
-      ::google::bigtable::v2::TimestampRange const& time_range);
+      ::google::bigtable::v2::TimestampRange const& time_range,
+      ValueArena& arena);
   /**
    * Delete a cell with the given timestamp from the column given by
    *     the given column qualifier.
@@ -273,35 +293,66 @@ class ColumnFamilyRow {
    *     that timestamp in then given column,  otherwise absl::nullopt.
    */
   absl::optional<Cell> DeleteTimeStamp(std::string const& column_qualifier,
-                                       std::chrono::milliseconds timestamp);
-
-  bool HasColumns() { return !columns_.empty(); }
-  using const_iterator = std::map<std::string, ColumnRow>::const_iterator;
-  using iterator = std::map<std::string, ColumnRow>::iterator;
-  const_iterator begin() const { return columns_.begin(); }
-  const_iterator end() const { return columns_.end(); }
+                                       std::chrono::milliseconds timestamp,
+                                       ValueArena& arena);
+
+  bool HasColumns() const { return !columns_->empty(); }
+
+  /// The sizes of a row's columns, which only change with them.
+  struct Totals {
+    std::int64_t cells = 0;
+    /// The total size of the cells' qualifiers and values.
+    std::int64_t bytes = 0;
+    /// Like `ColumnFamilyStats::versions_histogram`.
+    std::array<std::int64_t, kVersionsHistogramBuckets> versions_histogram{};
+
+    /// Account for `column`, whose qualifier has `qualifier_size` bytes.
+    void AddColumn(std::size_t qualifier_size, ColumnRow const& column);
+    /// Undo `AddColumn()`.
+    void RemoveColumn(std::size_t qualifier_size, ColumnRow const& column);
+  };
+  Totals const& totals() const { return columns_->totals; }
+
+  // The columns are keyed by qualifiers interned in the family's
+  // `QualifierDictionary`. They can be looked up by plain strings. They are
+  // shared with the row's `Totals`, so that the row index of `ColumnFamily`
+  // can update both.
+  struct Columns : PersistentMap<Qualifier, ColumnRow, QualifierLess> {
+    Totals totals;
+    // The family's write epoch when the row was last written, see
+    // `ColumnFamily::PrepareFreeze()`.
+    std::uint64_t write_epoch = 0;
+  };
+  using const_iterator = Columns::const_iterator;
+  const_iterator begin() const { return columns_->begin(); }
+  const_iterator end() const { return columns_->end(); }
   const_iterator lower_bound(std::string const& column_qualifier) const {
-    return columns_.lower_bound(column_qualifier);
+    return columns_->lower_bound(column_qualifier);
   }
   const_iterator upper_bound(std::string const& column_qualifier) const {
-    return columns_.upper_bound(column_qualifier);
+    return columns_->upper_bound(column_qualifier);
   }
-
-  std::map<std::string, ColumnRow>::iterator find(
-      std::string const& column_qualifier) {
-    return columns_.find(column_qualifier);
-  }
-
-  iterator erase(std::map<std::string, ColumnRow>::iterator column_it) {
-    return columns_.erase(column_it);
+  const_iterator find(std::string const& column_qualifier) const {
+    return columns_->find(column_qualifier);
   }
 
-  void RunGC(google::bigtable::admin::v2::GcRule const& gc_rule);
+  void RunGC(google::bigtable::admin::v2::GcRule const& gc_rule,
+             ValueArena& arena);
 
  private:
   friend class ColumnFamily;
 
-  std::map<std::string, ColumnRow> columns_;
+  // The columns, copied first if they are shared with another row.
+  Columns& MutableColumns();
+  // Like `SetCell()` above, for the given columns of a row.
+  static absl::optional<std::string> SetCell(
+      Columns& columns, std::string const& column_qualifier,
+      std::chrono::milliseconds timestamp, absl::string_view value,
+      QualifierDictionary& qualifiers, ValueArena& arena);
+
+  // Only `MutableColumns()` modifies them, since even looking up a column
+  // for modification copies the shared nodes of the map.
+  std::shared_ptr<Columns const> columns_ = std::make_shared<Columns>();
 };
 
 /**
@@ -312,6 +363,29 @@ class ColumnFamilyRow {
  *
  * It is guaranteed that every returned `ColumnFamilyRow` contains at least one
  * `ColumnRow`.
+ *
+ * The rows are copy-on-write, so `Snapshot()` is cheap and the snapshots can be
+ * read without any locking while this object is modified. The rows are a
+ * `PersistentMap`, a B-tree whose nodes the snapshots share, so modifying a
+ * row shared with a snapshot copies the row's leaf and the path to it, but
+ * not the rest of the tree. Only const iterators to the rows are handed out,
+ * and the rows are modified through the members taking a row key, so that
+ * no reader copies the tree by accident.
+ *
+ * The cells' values are stored in a `ValueArena` and the column qualifiers
+ * are interned in a `QualifierDictionary`, which the snapshots share too.
+ * `CompactValues()` replaces both, so that neither keeps what the rows no
+ * longer use.
+ *
+ * Besides the ordered tree of rows used by scans, the family keeps a hash
+ * index of its rows, so that the point lookups and writes of single-row
+ * transactions don't search the tree. Snapshots have no index.
+ *
+ * Once there are many rows, the ones which are no longer written are moved to
+ * compactly encoded, immutable `FrozenSegment`s (see `PrepareFreeze()`). A
+ * frozen row is thawed, i.e. moved back to the tree, when it is modified.
+ * Iterating the family only visits the rows in the tree; `ForEachRow()` and
+ * `CreateFrozenStreams()` cover the frozen ones.
  */
 class ColumnFamily {
  public:
@@ -333,20 +407,9 @@ class ColumnFamily {
   ColumnFamily(ColumnFamily const&) = delete;
   ColumnFamily& operator=(ColumnFamily const&) = delete;
 
-  using const_iterator = std::map<std::string, ColumnFamilyRow>::const_iterator;
-  using iterator = std::map<std::string, ColumnFamilyRow>::iterator;
+  using const_iterator =
+      PersistentMap<std::string, ColumnFamilyRow>::const_iterator;
 
-  StatusOr<ReadModifyWriteCellResult> ReadModifyWrite(
-      std::string const& row_key, std::string const& column_qualifier,
-      std::int64_t inc_value) {
-    return rows_[row_key].ReadModifyWrite(column_qualifier, inc_value);
-  };
-
-  ReadModifyWriteCellResult ReadModifyWrite(std::string const& row_key,
-                                            std::string const& column_qualifier,
-                                            std::string const& append_value) {
-    return rows_[row_key].ReadModifyWrite(column_qualifier, append_value);
-  };
 
   /**
    * Insert or update and existing cell at a given row, column and timestamp.
@@ -364,37 +427,57 @@ class ColumnFamily {
   absl::optional<std::string> SetCell(std::string const& row_key,
                                       std::string const& column_qualifier,
                                       std::chrono::milliseconds timestamp,
-                                      std::string const& value);
+                                      absl::string_view value);
 
   /**
-   * UpdateCell is like SetCell except that, when a cell exists with
-   * the same timestamp, an update function (that depends on the column
-   * family type) is called to derive a new value from the new and
-   * existing value, and that is the value that is written.
+   * The value of a cell after `input` is aggregated into it, given its
+   * value `existing` if it has one.
    *
-   * Simple (non-aggregate) column families have a default update
-   * function that just returns the new value.
+   * The int64 aggregators combine 8-byte big-endian integers, without
+   * converting them to `std::string`s. A `hllpp_unique_count` family adds
+   * `input` to the cell's `HllSketch`. Only aggregate column families
+   * support it.
+   */
+  StatusOr<std::string> AddToValue(absl::optional<absl::string_view> existing,
+                                   std::int64_t input) const;
+  /// Add the bytes `input` to the sketch of a `hllpp_unique_count` family,
+  /// which is the only kind with non-int64 inputs.
+  StatusOr<std::string> AddToValue(absl::optional<absl::string_view> existing,
+                                   absl::string_view input) const;
+  /// The value of a cell of a `hllpp_unique_count` family after the encoded
+  /// `HllSketch` `sketch` is merged into it.
+  StatusOr<std::string> MergeToValue(
+      absl::optional<absl::string_view> existing,
+      absl::string_view sketch) const;
+
+  /**
+   * AddToCell is like SetCell except that, when a cell exists with the
+   * same timestamp, `input` is combined with its value (see
+   * `AddToValue()`).
    *
+   * @return no value if the timestamp had no value before, otherwise
+   *     the previous value of the timestamp.
    */
-  StatusOr<absl::optional<std::string>> UpdateCell(
+  StatusOr<absl::optional<std::string>> AddToCell(
       std::string const& row_key, std::string const& column_qualifier,
-      std::chrono::milliseconds timestamp, std::string& value);
+      std::chrono::milliseconds timestamp, std::int64_t input);
 
   /**
    * Delete the whole row from this column family.
    *
+   * The row is only unlinked, and its stats come from its `Totals`, so this
+   * takes time independent of its number of columns and cells; its values
+   * are released and its memory freed later, by `ReleaseDeletedRows()`.
+   *
    * @param row_key the row key to remove.
-   * @return map from deleted column qualifiers to deleted cells.
+   * @return the stats of the deleted row, zero if there was none.
    */
-  std::map<std::string, std::vector<Cell>> DeleteRow(
-      std::string const& row_key);
+  ColumnFamilyStats DeleteRow(std::string const& row_key);
   /**
    * Delete cells from a row falling into a given timestamp range in one column.
    *
-   * @param row_key the row key to remove the cells from (or the
-   *     iterator to the row - row_it - in the 2nd overloaded form of the
-   *     function).
-
+   * @param row_key the row key to remove the cells from.
+   *
    * @param column_qualifier the column qualifier from which to delete
    *     the values.
    *
@@ -406,11 +489,6 @@ class ColumnFamily {
       std::string const& row_key, std::string const& column_qualifier,
       ::google::bigtable::v2::TimestampRange const& time_range);
 
-  std::vector<Cell> DeleteColumn(
-      std::map<std::string, ColumnFamilyRow>::iterator row_it,
-      std::string const& column_qualifier,
-      ::google::bigtable::v2::TimestampRange const& time_range);
-
   /**
    * Delete a cell with the given timestamp from the column given by
    *     the given column qualifier from the row given by row_key.
@@ -430,119 +508,393 @@ class ColumnFamily {
                                        std::string const& column_qualifier,
                                        std::chrono::milliseconds timestamp);
 
+  // The iterators only visit the rows which are not frozen.
   const_iterator begin() const { return rows_.begin(); }
-  iterator begin() { return rows_.begin(); }
   const_iterator end() const { return rows_.end(); }
-  iterator end() { return rows_.end(); }
   const_iterator lower_bound(std::string const& row_key) const {
     return rows_.lower_bound(row_key);
   }
-  iterator lower_bound(std::string const& row_key) {
-    return rows_.lower_bound(row_key);
-  }
   const_iterator upper_bound(std::string const& row_key) const {
     return rows_.upper_bound(row_key);
   }
-  iterator upper_bound(std::string const& row_key) {
-    return rows_.upper_bound(row_key);
-  }
 
-  std::size_t size() { return rows_.size(); }
+  /// The number of rows, including the frozen ones.
+  std::size_t size() const;
+
+  /// Whether the row has any cells in this column family.
+  bool HasRow(std::string const& row_key) const;
+
+  /**
+   * The given column of the given row, or null if it has no cells.
+   *
+   * The rows which are frozen are not searched, so this is only meant for
+   * rows which were just modified.
+   */
+  ColumnRow const* FindColumn(std::string const& row_key,
+                              std::string const& column_qualifier) const;
+
+  /// The value of the given cell, including in the frozen rows. It is valid
+  /// until this object is modified.
+  absl::optional<absl::string_view> FindCell(
+      std::string const& row_key, std::string const& column_qualifier,
+      std::chrono::milliseconds timestamp) const;
+
+  /// The number of cells in the given column of the given row.
+  std::size_t CountCells(std::string const& row_key,
+                         std::string const& column_qualifier) const;
 
-  std::map<std::string, ColumnFamilyRow>::iterator find(
-      std::string const& row_key) {
+  /**
+   * Calls `fn` with each row in [`start_row`, `end_row`), including the
+   * frozen ones, in no particular order.
+   *
+   * An empty `end_row` means the end of the column family. The frozen rows
+   * are decoded for the duration of the call only.
+   */
+  void ForEachRow(
+      std::string const& start_row, std::string const& end_row,
+      std::function<void(std::string const&, ColumnFamilyRow const&)> const&
+          fn) const;
+
+  const_iterator find(std::string const& row_key) const {
     return rows_.find(row_key);
   }
 
-  iterator erase(std::map<std::string, ColumnFamilyRow>::iterator row_it) {
-    return rows_.erase(row_it);
+  /// Deletes the row at `row_it` and returns the one after it.
+  const_iterator erase(const_iterator row_it);
+
+  void clear() {
+    rows_.clear();
+    row_index_.clear();
+    segments_.clear();
+    qualifiers_ = std::make_shared<QualifierDictionary>();
+    old_qualifiers_.reset();
+    compacted_qualifiers_ = 0;
+    arena_ = std::make_shared<ValueArena>();
+    old_arena_.reset();
+    compaction_cursor_.clear();
+    deleted_rows_.clear();
+    release_cursor_.reset();
+    gc_index_.Clear();
   }
 
-  void clear() { rows_.clear(); }
+  /**
+   * A read-only copy of the column family's current contents.
+   *
+   * It shares the rows with this object, so taking it doesn't copy any
+   * cells. It is unaffected by later modifications of this object and may be
+   * read concurrently with them, e.g. after the table's lock is released.
+   */
+  std::shared_ptr<ColumnFamily const> Snapshot() const;
+
   absl::optional<google::bigtable::admin::v2::Type> GetValueType() {
     return value_type_;
   };
 
-  void RunGC();
+  /**
+   * Runs garbage collection as defined by the column family's GC rule.
+   *
+   * Only the rows in the family's `GcExpiryIndex` are visited, so the cost
+   * depends on the number of rows with eligible cells rather than on the
+   * size of the family.
+   *
+   * @param stats_delta if not null, the change in the column family's stats
+   *     is added to it.
+   * @param emptied_rows if not null, the rows which no longer have any cells
+   *     in this column family are appended to it.
+   */
+  void RunGC(ColumnFamilyStats* stats_delta = nullptr,
+             std::vector<std::string>* emptied_rows = nullptr);
 
-  void SetGCRule(google::bigtable::admin::v2::GcRule const& gc_rule) {
-    gc_rule_ = gc_rule;
-  }
+  /**
+   * Like `RunGC()` above, but only for the rows in [`start_row`, `end_row`),
+   * and only until `deadline`.
+   *
+   * At least one row is collected, even if `deadline` has passed already.
+   * An empty `end_row` means the end of the column family.
+   *
+   * @return the first row which was not collected, or `absl::nullopt` if
+   *     all rows in the range were.
+   */
+  absl::optional<std::string> RunGC(
+      std::string const& start_row, std::string const& end_row,
+      std::chrono::steady_clock::time_point deadline,
+      ColumnFamilyStats* stats_delta = nullptr,
+      std::vector<std::string>* emptied_rows = nullptr);
 
- private:
-  std::map<std::string, ColumnFamilyRow> rows_;
+  /**
+   * Whether `CompactValues()` has any work to do.
+   *
+   * That is the case if a compaction is in progress, or if over half of the
+   * bytes stored in the values' arena, and at least `kMinCompactionGarbage`
+   * bytes, belong to values which were overwritten, deleted or garbage
+   * collected. It is also the case if the qualifier dictionary has at least
+   * `kMinCompactionQualifiers` entries and doubled since the last compaction.
+   */
+  bool NeedsValueCompaction() const;
 
-  // Support for aggregate and other complex types.
-  absl::optional<google::bigtable::admin::v2::Type> value_type_ = absl::nullopt;
+  /**
+   * Reclaims the space of released values by copying the live ones to a new
+   * arena, until `deadline`.
+   *
+   * The rows' qualifiers are interned in a new dictionary at the same time,
+   * which drops the qualifiers no row uses anymore.
+   *
+   * A compaction is only started if `NeedsValueCompaction()`, and then
+   * continues where the previous call left off. Snapshots keep the old arena
+   * and dictionary alive for as long as they need them.
+   *
+   * @return whether no compaction is in progress anymore.
+   */
+  bool CompactValues(std::chrono::steady_clock::time_point deadline);
 
-  // Support for garbage collection (GcRule)
-  absl::optional<google::bigtable::admin::v2::GcRule> gc_rule_ = absl::nullopt;
+  /// Whether `ReleaseDeletedRows()` has any work to do.
+  bool HasDeletedRows() const { return !deleted_rows_.empty(); }
+
+  /**
+   * Releases the values of the rows deleted by `DeleteRow()` and frees
+   * them, until `deadline`.
+   *
+   * Large rows are released a few cells at a time, continuing where the
+   * previous call stopped.
+   *
+   * @return whether all the deleted rows were released.
+   */
+  bool ReleaseDeletedRows(std::chrono::steady_clock::time_point deadline);
+
+  /// The arena holding the values of the cells written from now on.
+  ValueArena const& arena() const { return *arena_; }
+  /// The dictionary the rows' column qualifiers are interned in.
+  QualifierDictionary const& qualifiers() const { return *qualifiers_; }
+
+  static std::size_t constexpr kMinCompactionGarbage = 1 << 20;
+  static std::size_t constexpr kMinCompactionQualifiers = 1 << 12;
 
-  static StatusOr<std::string> DefaultUpdateCell(
-      std::string const& /*existing_value*/, std::string&& new_value) {
-    return new_value;
+  /**
+   * Whether a freeze has any work to do.
+   *
+   * That is the case if at least `kFreezeRows` rows are not frozen and the
+   * previous freeze was cut short or is `kFreezeInterval` ago, or if over
+   * half of the rows of a segment were thawed or deleted.
+   */
+  bool NeedsFreeze() const;
+
+  class FreezeJob;
+
+  /**
+   * Starts moving the rows not written for at least `kFreezeInterval` to a
+   * new `FrozenSegment`.
+   *
+   * Like the runs of an LSM tree, a new segment is merged with the previous
+   * one while that is at most twice as large, so that there are only
+   * logarithmically many segments, up to `kMaxSegmentRows` rows each.
+   * Segments which lost over half of their rows are rewritten.
+   *
+   * The segments are built by `FreezeJob::Build()` from a snapshot, so only
+   * this function and `InstallFreeze()` need to exclude the modifications
+   * of the family.
+   *
+   * @param now the time at which the rows are checked for writes.
+   */
+  std::unique_ptr<FreezeJob> PrepareFreeze(
+      std::chrono::steady_clock::time_point now);
+
+  /**
+   * Swaps in the segments built by `job`.
+   *
+   * The rows modified since `PrepareFreeze()` are left as they are now, and
+   * the rows moved to the new segments have their values released later,
+   * by `ReleaseDeletedRows()`. Nothing changes if another freeze was
+   * installed in the meantime.
+   */
+  void InstallFreeze(FreezeJob& job);
+
+  /// Freezes all the rows which are not frozen, and waits for it.
+  void Freeze();
+
+  /**
+   * Thaws the frozen rows in [`start_row`, `end_row`).
+   *
+   * Afterwards, the rows in the range can be iterated and erased. An empty
+   * `end_row` means the end of the column family.
+   */
+  void ThawRows(std::string const& start_row, std::string const& end_row);
+
+  /// Streams of the frozen rows in `row_set`, one per segment.
+  std::vector<std::unique_ptr<FrozenSegmentStream>> CreateFrozenStreams(
+      std::string const& column_family_name,
+      std::shared_ptr<StringRangeSet const> const& row_set) const;
+
+  /// The number of segments, see `Freeze()`.
+  std::size_t frozen_segments() const { return segments_.size(); }
+
+  static std::size_t constexpr kFreezeRows = 1 << 16;
+  static std::size_t constexpr kMaxSegmentRows = 1 << 20;
+  static std::chrono::steady_clock::duration constexpr kFreezeInterval =
+      std::chrono::seconds(10);
+
+  /// Sets the GC rule and rebuilds the index of rows with eligible cells.
+  void SetGCRule(google::bigtable::admin::v2::GcRule const& gc_rule);
+  absl::optional<google::bigtable::admin::v2::GcRule> const& gc_rule() const {
+    return gc_rule_;
+  }
+
+ private:
+  // Inserting or erasing a row invalidates iterators, so they must not be
+  // held across modifications.
+  using Rows = PersistentMap<std::string, ColumnFamilyRow>;
+
+  // An entry of `row_index_`.
+  struct IndexedRow {
+    // The row's columns, i.e. its `ColumnFamilyRow::columns_`.
+    ColumnFamilyRow::Columns const* columns;
+    // The `snapshot_generation_` in which `columns` was last known not to be
+    // shared with a snapshot, or `kSharedRow`.
+    std::uint64_t generation;
   };
+  static std::uint64_t constexpr kSharedRow = ~std::uint64_t{0};
+
+  // A segment of frozen rows, and which of them were thawed or deleted
+  // since. Snapshots share `removed`, so it is copied before it is modified
+  // if it is shared.
+  struct FrozenRows {
+    std::shared_ptr<FrozenSegment const> segment;
+    std::shared_ptr<std::vector<bool>> removed;
+    std::size_t removed_rows;
 
-  static StatusOr<std::string> SumUpdateCellBEInt64(
-      std::string const& existing_value, std::string&& new_value) {
-    auto existing_value_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(existing_value);
-    if (!existing_value_int) {
-      return existing_value_int.status();
-    }
-
-    auto new_value_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(new_value);
-    if (!new_value_int) {
-      return new_value_int.status();
-    }
-
-    return google::cloud::internal::EncodeBigEndian(existing_value_int.value() +
-                                                    new_value_int.value());
+    std::size_t live_rows() const { return segment->size() - removed_rows; }
   };
 
-  static StatusOr<std::string> MaxUpdateCellBEInt64(
-      std::string const& existing_value, std::string&& new_value) {
-    auto existing_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(existing_value);
-    if (!existing_int) {
-      return existing_int.status();
-    }
-    auto new_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(new_value);
-    if (!new_int) {
-      return new_int.status();
-    }
-
-    if (existing_int.value() > new_int.value()) {
-      return existing_value;
-    }
-
-    return new_value;
+ public:
+  /**
+   * A freeze started by `PrepareFreeze()`.
+   *
+   * `Build()` only reads a snapshot of the family, so it can run while the
+   * family is modified.
+   */
+  class FreezeJob {
+   public:
+    /**
+     * Encodes the new segments, until `deadline`.
+     *
+     * The rows encoded until then are frozen, and the merges of segments
+     * which don't finish in time are skipped.
+     */
+    void Build(std::chrono::steady_clock::time_point deadline);
+
+   private:
+    friend class ColumnFamily;
+
+    FreezeJob(std::shared_ptr<ColumnFamily const> snapshot,
+              std::uint64_t hot_epoch)
+        : snapshot_(std::move(snapshot)), hot_epoch_(hot_epoch) {}
+
+    // A segment of the result. It replaces the snapshot's segments in
+    // [first, last), and the frozen rows if `cold_rows`. Unless `built`, it
+    // is the snapshot's segment `first`.
+    struct Output {
+      FrozenRows frozen;
+      std::size_t first;
+      std::size_t last;
+      bool cold_rows;
+      bool built;
+    };
+
+    std::shared_ptr<ColumnFamily const> snapshot_;
+    // The rows written in this write epoch or later are not frozen.
+    std::uint64_t hot_epoch_;
+    std::vector<Output> outputs_;
+    // The snapshot's rows which were frozen, if any.
+    std::shared_ptr<FrozenSegment const> cold_rows_;
+    bool complete_ = false;
   };
 
-  static StatusOr<std::string> MinUpdateCellBEInt64(
-      std::string const& existing_value, std::string&& new_value) {
-    auto existing_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(existing_value);
-    if (!existing_int) {
-      return existing_int.status();
-    }
-    auto new_int =
-        google::cloud::internal::DecodeBigEndian<std::int64_t>(new_value);
-    if (!new_int) {
-      return new_int.status();
-    }
-
-    if (existing_int.value() < new_int.value()) {
-      return existing_value;
-    }
-
-    return new_value;
+ private:
+  // The columns of an existing or new row, ready to be modified. Unless the
+  // row was shared with a snapshot, they are found in `row_index_`.
+  ColumnFamilyRow::Columns& MutableColumns(std::string const& row_key);
+  // Update the `row_index_` entry of a row after it was modified.
+  void IndexRow(Rows::const_iterator row_it);
+  // The index in `segments_` and the position of the frozen row `row_key`,
+  // if it is frozen.
+  absl::optional<std::pair<std::size_t, std::size_t>> FindFrozenRow(
+      std::string const& row_key) const;
+  void RemoveFrozenRow(std::size_t segment, std::size_t row);
+  // If the row is frozen, move it to `rows_`. Returns whether it was.
+  bool ThawRow(std::string const& row_key);
+  // The row at `cursor`. Its qualifiers are interned in `qualifiers` and its
+  // values copied to `arena`, or both refer to the segment if null.
+  static ColumnFamilyRow DecodeRow(FrozenSegment::RowCursor const& cursor,
+                                   QualifierDictionary* qualifiers,
+                                   ValueArena* arena);
+  // A segment with the rows of `segments` which were not removed, unless
+  // `deadline` passes first.
+  static absl::optional<FrozenRows> MergeSegments(
+      std::vector<FrozenRows> const& segments,
+      std::chrono::steady_clock::time_point deadline);
+  // Add a cell written to the given column to `gc_index_`.
+  void IndexCell(std::string const& row_key,
+                 std::string const& column_qualifier,
+                 std::chrono::milliseconds timestamp);
+  // The value of a cell of a `hllpp_unique_count` family after `sketch` is
+  // merged into it.
+  static StatusOr<std::string> MergeSketch(
+      absl::optional<absl::string_view> existing, HllSketch const& sketch);
+
+  Rows rows_;
+  // Has an entry for each row in `rows_`, unless this is a snapshot. The
+  // entries only refer to the rows' columns, which unlike the rows
+  // themselves don't move when `rows_` changes. A row's columns may be
+  // replaced when the row is modified after a snapshot was taken, so they
+  // are only used while `generation` is current.
+  bool has_row_index_ = true;
+  absl::flat_hash_map<std::string, IndexedRow> row_index_;
+  // Incremented by `Snapshot()`, which is not called concurrently with
+  // modifications.
+  mutable std::uint64_t snapshot_generation_ = 0;
+  std::shared_ptr<QualifierDictionary> qualifiers_ =
+      std::make_shared<QualifierDictionary>();
+  // While a compaction is in progress, the rows after `compaction_cursor_`
+  // may still have qualifiers interned in `old_qualifiers_`.
+  std::shared_ptr<QualifierDictionary> old_qualifiers_;
+  // The size of `qualifiers_` when the last compaction finished.
+  std::size_t compacted_qualifiers_ = 0;
+  // The cells' values. While a compaction is in progress, the values not
+  // copied yet are in `old_arena_`, and the rows before
+  // `compaction_cursor_` have been copied.
+  std::shared_ptr<ValueArena> arena_ = std::make_shared<ValueArena>();
+  std::shared_ptr<ValueArena> old_arena_;
+  std::string compaction_cursor_;
+  // The rows removed by `DeleteRow()` or moved to a segment, whose values
+  // were not released yet, oldest first. If the first one is shared with a
+  // snapshot, which keeps its cells, `release_cursor_` is the next cell to
+  // release, if `ReleaseDeletedRows()` stopped in it.
+  std::deque<ColumnFamilyRow> deleted_rows_;
+  struct ReleaseCursor {
+    Qualifier column;
+    std::chrono::milliseconds cell;
   };
+  absl::optional<ReleaseCursor> release_cursor_;
+  // From the oldest. A row is in at most one of the segments and `rows_`.
+  std::vector<FrozenRows> segments_;
+  // Advanced by `PrepareFreeze()` at most once per `kFreezeInterval`. A row
+  // written in epoch `e` was not written for that long once it is `e + 2`.
+  std::uint64_t write_epoch_ = 0;
+  std::chrono::steady_clock::time_point next_write_epoch_;
+  // Whether the last freeze froze all the rows it could.
+  bool freeze_complete_ = true;
 
-  std::function<StatusOr<std::string>(std::string const&, std::string&&)>
-      update_cell_ = DefaultUpdateCell;
+  // Support for aggregate and other complex types.
+  absl::optional<google::bigtable::admin::v2::Type> value_type_ = absl::nullopt;
+  // Set iff `value_type_` is an aggregate type.
+  absl::optional<Int64Aggregator> aggregator_;
+  // Set iff `value_type_` is a `hllpp_unique_count` aggregate type. The
+  // cells hold `HllSketch`es then.
+  bool unique_count_ = false;
+
+  // Support for garbage collection (GcRule)
+  absl::optional<google::bigtable::admin::v2::GcRule> gc_rule_ = absl::nullopt;
+  // Only maintained if `gc_rule_` is set, and not by snapshots.
+  GcExpiryIndex gc_index_;
 };
 
 /**
@@ -559,7 +911,8 @@ class ColumnFamily {
  * * timestamp ranges - to only stream cells with timestamps in given ranges
  *
  * Objects of this class are not thread safe. Their users need to ensure that
- * underlying `ColumnFamily` object tree doesn't change.
+ * underlying `ColumnFamily` object tree doesn't change, e.g. by streaming a
+ * `ColumnFamily::Snapshot()`.
  */
 class FilteredColumnFamilyStream : public AbstractCellStreamImpl {
  public:
@@ -572,10 +925,17 @@ class FilteredColumnFamilyStream : public AbstractCellStreamImpl {
    *     populate the returned `CellView`s.
    * @row_set the row set indicating which row keys include in the returned
    *     values.
+   *
+   * The cells which the family's GC rule would collect at the time of the
+   * construction are never returned, see `GcReadMask`.
    */
   FilteredColumnFamilyStream(ColumnFamily const& column_family,
                              std::string column_family_name,
                              std::shared_ptr<StringRangeSet const> row_set);
+  /// Stream `column_family`, keeping it alive as long as this object.
+  FilteredColumnFamilyStream(std::shared_ptr<ColumnFamily const> column_family,
+                             std::string column_family_name,
+                             std::shared_ptr<StringRangeSet const> row_set);
   bool ApplyFilter(InternalFilter const& internal_filter) override;
   bool HasValue() const override;
   CellView const& Value() const override;
@@ -607,18 +967,31 @@ class FilteredColumnFamilyStream : public AbstractCellStreamImpl {
    * @return whether we've managed to find another cell
    */
   bool PointToFirstCellAfterRowChange() const;
+  // Advance `cell_it_` past the cells hidden by `gc_mask_`, returning false
+  // if it reaches the end of the column.
+  bool SkipMaskedCells() const;
 
+  // Only set if the stream owns the family, e.g. a snapshot.
+  std::shared_ptr<ColumnFamily const> column_family_;
   std::string column_family_name_;
 
   std::shared_ptr<StringRangeSet const> row_ranges_;
-  std::vector<std::shared_ptr<re2::RE2 const>> row_regexes_;
+  std::vector<std::shared_ptr<RegexMatcher const>> row_regexes_;
   mutable StringRangeSet column_ranges_;
-  std::vector<std::shared_ptr<re2::RE2 const>> column_regexes_;
+  std::vector<std::shared_ptr<RegexMatcher const>> column_regexes_;
+  // `column_regexes_`, if any, remembering the result for each qualifier.
+  std::vector<std::shared_ptr<QualifierRegexMemo const>> column_regex_memo_;
   mutable TimestampRangeSet timestamp_ranges_;
-
-  RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamily>> rows_;
-  mutable absl::optional<
-      RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamilyRow>>>
+  GcReadMask gc_mask_;
+  // The timestamps of the current column's cells at the ranks of
+  // `gc_mask_.version_limits()`.
+  mutable std::vector<absl::optional<std::chrono::milliseconds>>
+      gc_limit_timestamps_;
+
+  RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamily>, RegexMatcher>
+      rows_;
+  mutable absl::optional<RegexFiteredMapView<
+      StringRangeFilteredMapView<ColumnFamilyRow>, QualifierRegexMemo>>
       columns_;
   mutable absl::optional<TimestampRangeFilteredMapView<ColumnRow>> cells_;
 
@@ -627,10 +1000,11 @@ class FilteredColumnFamilyStream : public AbstractCellStreamImpl {
   //   if (row_it_ != rows_.end()) then
   //   cell_it_ != cells.end() && column_it_ != columns_.end().
   mutable absl::optional<RegexFiteredMapView<
-      StringRangeFilteredMapView<ColumnFamily>>::const_iterator>
+      StringRangeFilteredMapView<ColumnFamily>, RegexMatcher>::const_iterator>
       row_it_;
-  mutable absl::optional<RegexFiteredMapView<
-      StringRangeFilteredMapView<ColumnFamilyRow>>::const_iterator>
+  mutable absl::optional<
+      RegexFiteredMapView<StringRangeFilteredMapView<ColumnFamilyRow>,
+                          QualifierRegexMemo>::const_iterator>
       column_it_;
   mutable absl::optional<
       TimestampRangeFilteredMapView<ColumnRow>::const_iterator>
@@ -642,9 +1016,15 @@ class FilteredColumnFamilyStream : public AbstractCellStreamImpl {
 
 class PersistentFilteredColumnFamilyStream : public AbstractCellStreamImpl {
   public:
-   PersistentFilteredColumnFamilyStream(const std::string& table_name, 
-                                        const std::string& family, 
-                                        const std::string& start_row_key = "");
+   // If `snapshot` is not null, the stream reads from it. The RocksDB
+   // iterator is created here, so the stream doesn't use the table (or the
+   // storage's column family handles) after it is constructed.
+   PersistentFilteredColumnFamilyStream(
+       const std::string& table_name, const std::string& family,
+       const std::string& start_row_key = "",
+       std::shared_ptr<StringRangeSet const> row_ranges = nullptr,
+       std::shared_ptr<rocksdb::Snapshot const> snapshot = nullptr,
+       GcReadMask gc_mask = {});
    
    ~PersistentFilteredColumnFamilyStream() override;
  
@@ -652,7 +1032,7 @@ class PersistentFilteredColumnFamilyStream : public AbstractCellStreamImpl {
    bool HasValue() const override;
    CellView const& Value() const override;
    bool Next(NextMode mode) override;
-   std::string const& column_family_name() const { return cur_family_; }
+   std::string const& column_family_name() const { return cur_family_bare_; }
 
  
   private:
@@ -663,6 +1043,8 @@ class PersistentFilteredColumnFamilyStream : public AbstractCellStreamImpl {
    void InitializeIfNeeded() const;
  
    Storage* storage_;
+   // Declared before `it_`, which has to be destroyed first.
+   std::shared_ptr<rocksdb::Snapshot const> snapshot_;
    mutable std::unique_ptr<rocksdb::Iterator> it_;
    std::string table_prefix_;
    std::string start_row_key_;
@@ -682,10 +1064,16 @@ class PersistentFilteredColumnFamilyStream : public AbstractCellStreamImpl {
    mutable std::optional<CellView> current_view_;
 
    std::shared_ptr<StringRangeSet const> row_ranges_;
-   std::vector<std::shared_ptr<re2::RE2 const>> row_regexes_;
+   std::vector<std::shared_ptr<RegexMatcher const>> row_regexes_;
    mutable StringRangeSet column_ranges_;
-   std::vector<std::shared_ptr<re2::RE2 const>> column_regexes_;
+   std::vector<std::shared_ptr<RegexMatcher const>> column_regexes_;
    mutable TimestampRangeSet timestamp_ranges_;
+   GcReadMask gc_mask_;
+   // The key prefix of the column whose cells are ranked in
+   // `gc_limit_timestamps_`, see `GcReadMask::Hides()`.
+   mutable std::string ranked_column_;
+   mutable std::vector<absl::optional<std::chrono::milliseconds>>
+       gc_limit_timestamps_;
 };
 
 }  // namespace emulator
@@ -20,10 +20,13 @@
 #include <google/bigtable/v2/data.pb.h>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace google {
 namespace cloud {
@@ -45,7 +48,7 @@ std::string DumpColumnFamilyRow(ColumnFamilyRow const& fam_row,
                                 std::string const& prefix = "") {
   std::stringstream ss;
   for (auto const& col_row : fam_row) {
-    ss << DumpColumnRow(col_row.second, prefix + col_row.first + " ");
+    ss << DumpColumnRow(col_row.second, prefix + col_row.first.name() + " ");
   }
   return ss.str();
 }
@@ -63,16 +66,17 @@ std::string DumpColumnFamily(ColumnFamily const& fam,
 TEST(ColumnRow, Trivial) {
   using testing_util::chrono_literals::operator""_ms;
 
+  ValueArena arena;
   ColumnRow col_row;
   EXPECT_FALSE(col_row.HasCells());
-  col_row.SetCell(10_ms, "foo");
+  col_row.SetCell(10_ms, "foo", arena);
   EXPECT_TRUE(col_row.HasCells());
-  col_row.SetCell(10_ms, "bar");
+  col_row.SetCell(10_ms, "bar", arena);
   EXPECT_EQ(std::next(col_row.begin()), col_row.end());
   EXPECT_EQ("bar", col_row.begin()->second);
 
-  col_row.SetCell(0_ms, "baz");
-  col_row.SetCell(20_ms, "qux");
+  col_row.SetCell(0_ms, "baz", arena);
+  col_row.SetCell(20_ms, "qux", arena);
   EXPECT_EQ("qux", col_row.lower_bound(30_ms)->second);
   EXPECT_EQ("qux", col_row.lower_bound(20_ms)->second);
   EXPECT_EQ("bar", col_row.lower_bound(10_ms)->second);
@@ -86,15 +90,16 @@ TEST(ColumnRow, Trivial) {
 TEST(ColumnRow, DeleteTimeRangeFinite) {
   using testing_util::chrono_literals::operator""_ms;
 
+  ValueArena arena;
   ColumnRow col_row;
-  col_row.SetCell(10_ms, "foo");
-  col_row.SetCell(20_ms, "bar");
-  col_row.SetCell(30_ms, "baz");
-  col_row.SetCell(40_ms, "qux");
+  col_row.SetCell(10_ms, "foo", arena);
+  col_row.SetCell(20_ms, "bar", arena);
+  col_row.SetCell(30_ms, "baz", arena);
+  col_row.SetCell(40_ms, "qux", arena);
   google::bigtable::v2::TimestampRange range;
   range.set_start_timestamp_micros(5000);
   range.set_end_timestamp_micros(40000);
-  col_row.DeleteTimeRange(range);
+  col_row.DeleteTimeRange(range, arena);
 
   EXPECT_EQ("@40ms: qux\n", DumpColumnRow(col_row));
 }
@@ -102,14 +107,15 @@ TEST(ColumnRow, DeleteTimeRangeFinite) {
 TEST(ColumnRow, DeleteTimeRangeInfinite) {
   using testing_util::chrono_literals::operator""_ms;
 
+  ValueArena arena;
   ColumnRow col_row;
-  col_row.SetCell(10_ms, "foo");
-  col_row.SetCell(20_ms, "bar");
-  col_row.SetCell(30_ms, "baz");
-  col_row.SetCell(40_ms, "qux");
+  col_row.SetCell(10_ms, "foo", arena);
+  col_row.SetCell(20_ms, "bar", arena);
+  col_row.SetCell(30_ms, "baz", arena);
+  col_row.SetCell(40_ms, "qux", arena);
   google::bigtable::v2::TimestampRange range;
   range.set_start_timestamp_micros(20000);
-  col_row.DeleteTimeRange(range);
+  col_row.DeleteTimeRange(range, arena);
 
   EXPECT_EQ("@10ms: foo\n", DumpColumnRow(col_row));
 }
@@ -117,16 +123,18 @@ TEST(ColumnRow, DeleteTimeRangeInfinite) {
 TEST(ColumnFamilyRow, Trivial) {
   using testing_util::chrono_literals::operator""_ms;
 
+  QualifierDictionary qualifiers;
+  ValueArena arena;
   ColumnFamilyRow fam_row;
   EXPECT_FALSE(fam_row.HasColumns());
-  fam_row.SetCell("col1", 10_ms, "foo");
+  fam_row.SetCell("col1", 10_ms, "foo", qualifiers, arena);
   EXPECT_TRUE(fam_row.HasColumns());
-  fam_row.SetCell("col1", 10_ms, "bar");
+  fam_row.SetCell("col1", 10_ms, "bar", qualifiers, arena);
   EXPECT_EQ(std::next(fam_row.begin()), fam_row.end());
   EXPECT_EQ("bar", fam_row.begin()->second.begin()->second);
 
-  fam_row.SetCell("col0", 10_ms, "baz");
-  fam_row.SetCell("col2", 10_ms, "qux");
+  fam_row.SetCell("col0", 10_ms, "baz", qualifiers, arena);
+  fam_row.SetCell("col2", 10_ms, "qux", qualifiers, arena);
 
   EXPECT_EQ(R"""(
 col0 @10ms: baz
@@ -138,9 +146,11 @@ col2 @10ms: qux
   EXPECT_EQ("bar", fam_row.lower_bound("col1")->second.begin()->second);
   EXPECT_EQ("qux", fam_row.upper_bound("col1")->second.begin()->second);
 
-  EXPECT_EQ(
-      1, fam_row.DeleteColumn("col1", ::google::bigtable::v2::TimestampRange{})
-             .size());
+  EXPECT_EQ(1, fam_row
+                   .DeleteColumn("col1",
+                                 ::google::bigtable::v2::TimestampRange{},
+                                 arena)
+                   .size());
 
   // Verify that there is no empty column.
   EXPECT_EQ(2, std::distance(fam_row.begin(), fam_row.end()));
@@ -148,7 +158,7 @@ col2 @10ms: qux
   google::bigtable::v2::TimestampRange not_matching_range;
   not_matching_range.set_start_timestamp_micros(10);
   not_matching_range.set_end_timestamp_micros(20);
-  EXPECT_EQ(0, fam_row.DeleteColumn("col2", not_matching_range).size());
+  EXPECT_EQ(0, fam_row.DeleteColumn("col2", not_matching_range, arena).size());
 
   EXPECT_EQ(R"""(
 col0 @10ms: baz
@@ -157,10 +167,34 @@ col2 @10ms: qux
             "\n" + DumpColumnFamilyRow(fam_row));
 }
 
+TEST(ColumnFamilyRow, CopySharesUnmodifiedColumns) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  QualifierDictionary qualifiers;
+  ValueArena arena;
+  ColumnFamilyRow fam_row;
+  for (int i = 0; i != 100; ++i) {
+    fam_row.SetCell("col" + std::to_string(i), 10_ms, "foo", qualifiers,
+                    arena);
+  }
+  auto const copy = fam_row;
+  fam_row.SetCell("col50", 20_ms, "bar", qualifiers, arena);
+
+  auto const& row = fam_row;
+  EXPECT_EQ(&copy.find("col0")->second, &row.find("col0")->second);
+  EXPECT_EQ(&copy.find("col99")->second, &row.find("col99")->second);
+  EXPECT_NE(&copy.find("col50")->second, &row.find("col50")->second);
+  EXPECT_EQ("@10ms: foo\n", DumpColumnRow(copy.find("col50")->second));
+  EXPECT_EQ("@20ms: bar\n@10ms: foo\n",
+            DumpColumnRow(row.find("col50")->second));
+}
+
 TEST(ColumnFamily, Trivial) {
   using testing_util::chrono_literals::operator""_ms;
 
   ColumnFamily fam;
+  // The non-const accessors are for modifications.
+  auto const& cfam = fam;
   fam.SetCell("row1", "col0", 10_ms, "foo");
   fam.SetCell("row1", "col0", 10_ms, "bar");
   EXPECT_EQ("row1 :col0 @10ms: bar\n", DumpColumnFamily(fam));
@@ -176,16 +210,16 @@ row2 :col0 @10ms: qux
             "\n" + DumpColumnFamily(fam));
 
   EXPECT_EQ("col0 @10ms: bar\n",
-            DumpColumnFamilyRow(fam.lower_bound("row1")->second));
+            DumpColumnFamilyRow(cfam.lower_bound("row1")->second));
   EXPECT_EQ("col0 @10ms: qux\n",
-            DumpColumnFamilyRow(fam.upper_bound("row1")->second));
+            DumpColumnFamilyRow(cfam.upper_bound("row1")->second));
 
   EXPECT_EQ(1, fam.DeleteColumn("row1", "col0",
                                 ::google::bigtable::v2::TimestampRange{})
                    .size());
 
   // Verify that there is no empty row
-  EXPECT_EQ(2, std::distance(fam.begin(), fam.end()));
+  EXPECT_EQ(2, std::distance(cfam.begin(), cfam.end()));
 
   EXPECT_EQ(R"""(
 row0 :col0 @10ms: baz
@@ -193,8 +227,8 @@ row2 :col0 @10ms: qux
 )""",
             "\n" + DumpColumnFamily(fam));
 
-  EXPECT_GT(fam.DeleteRow("row2").size(), 0);
-  EXPECT_TRUE(fam.DeleteRow("row_nonexistent").empty());
+  EXPECT_EQ(1, fam.DeleteRow("row2").rows);
+  EXPECT_TRUE(fam.DeleteRow("row_nonexistent").IsZero());
 
   EXPECT_EQ("row0 :col0 @10ms: baz\n", DumpColumnFamily(fam));
 }
@@ -333,8 +367,10 @@ TEST(FilteredColumnFamilyStream, FilterByColumnRegex) {
   fam.SetCell("row2", "col0", 300_ms, "foo");
   auto included_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
   FilteredColumnFamilyStream filtered_stream(fam, "cf1", included_rows);
-  filtered_stream.ApplyFilter(ColumnRegex{pattern1});
-  filtered_stream.ApplyFilter(ColumnRegex{pattern2});
+  filtered_stream.ApplyFilter(
+      ColumnRegex{std::make_shared<RegexMatcher const>(pattern1)});
+  filtered_stream.ApplyFilter(
+      ColumnRegex{std::make_shared<RegexMatcher const>(pattern2)});
   EXPECT_EQ(R"""(
 row0 cf1:col0 @10ms: foo
 row0 cf1:col2 @200ms: foo
@@ -358,8 +394,10 @@ TEST(FilteredColumnFamilyStream, FilterRowKeyRegex) {
   fam.SetCell("row3", "col3", 300_ms, "foo");  // Filter out
   auto included_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
   FilteredColumnFamilyStream filtered_stream(fam, "cf1", included_rows);
-  filtered_stream.ApplyFilter(RowKeyRegex{pattern1});
-  filtered_stream.ApplyFilter(RowKeyRegex{pattern2});
+  filtered_stream.ApplyFilter(
+      RowKeyRegex{std::make_shared<RegexMatcher const>(pattern1)});
+  filtered_stream.ApplyFilter(
+      RowKeyRegex{std::make_shared<RegexMatcher const>(pattern2)});
   EXPECT_EQ(R"""(
 row0 cf1:col0 @10ms: foo
 row2 cf1:col2 @200ms: foo
@@ -389,6 +427,242 @@ row3 cf1:col3 @300ms: foo
             "\n" + DumpFilteredColumnFamilyStream(filtered_stream));
 }
 
+TEST(ColumnFamily, SnapshotIsUnaffectedByModifications) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  fam.SetCell("row1", "col1", 10_ms, "foo");
+  fam.SetCell("row1", "col2", 10_ms, "bar");
+  fam.SetCell("row2", "col1", 10_ms, "baz");
+  auto snapshot = fam.Snapshot();
+
+  fam.SetCell("row0", "col1", 10_ms, "new");
+  fam.SetCell("row1", "col1", 20_ms, "newer");
+  fam.DeleteRow("row2");
+  ::google::bigtable::v2::TimestampRange all;
+  fam.DeleteColumn("row1", "col2", all);
+
+  EXPECT_EQ(R"""(
+row1 :col1 @10ms: foo
+row1 :col2 @10ms: bar
+row2 :col1 @10ms: baz
+)""",
+            "\n" + DumpColumnFamily(*snapshot));
+  EXPECT_EQ(R"""(
+row0 :col1 @10ms: new
+row1 :col1 @20ms: newer
+row1 :col1 @10ms: foo
+)""",
+            "\n" + DumpColumnFamily(fam));
+}
+
+TEST(ColumnFamily, SnapshotSharesUnmodifiedRows) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  fam.SetCell("row1", "col1", 10_ms, "foo");
+  fam.SetCell("row2", "col1", 10_ms, "bar");
+  auto snapshot = fam.Snapshot();
+  fam.SetCell("row2", "col1", 20_ms, "baz");
+
+  auto cells = [](ColumnFamily const& family, std::string const& row_key) {
+    return &family.lower_bound(row_key)->second.begin()->second;
+  };
+  EXPECT_EQ(cells(*snapshot, "row1"), cells(fam, "row1"));
+  EXPECT_NE(cells(*snapshot, "row2"), cells(fam, "row2"));
+  EXPECT_EQ(1U, cells(*snapshot, "row2")->size());
+  EXPECT_EQ(2U, cells(fam, "row2")->size());
+}
+
+TEST(ColumnFamily, RowsShareInternedQualifiers) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  fam.SetCell("row1", "col1", 10_ms, "foo");
+  fam.SetCell("row1", "col2", 10_ms, "foo");
+  fam.SetCell("row2", "col1", 10_ms, "bar");
+  fam.SetCell("row2", "col1", 20_ms, "bar");
+  EXPECT_EQ(2U, fam.qualifiers().size());
+
+  auto column = [](ColumnFamily const& family, std::string const& row_key) {
+    return family.lower_bound(row_key)->second.begin()->first;
+  };
+  EXPECT_EQ("col1", column(fam, "row2"));
+  EXPECT_EQ(&column(fam, "row1").name(), &column(fam, "row2").name());
+  EXPECT_EQ(column(fam, "row1").id(), column(fam, "row2").id());
+
+  fam.clear();
+  EXPECT_EQ(0U, fam.qualifiers().size());
+}
+
+TEST(ColumnFamily, PointAccessFollowsSnapshots) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  fam.SetCell("row1", "col1", 10_ms, "foo");
+  fam.SetCell("row2", "col1", 10_ms, "foo");
+  ASSERT_NE(nullptr, fam.FindColumn("row1", "col1"));
+  EXPECT_EQ(1U, fam.FindColumn("row1", "col1")->size());
+  EXPECT_EQ(nullptr, fam.FindColumn("row1", "col2"));
+  EXPECT_EQ(nullptr, fam.FindColumn("row3", "col1"));
+
+  auto snapshot = fam.Snapshot();
+  fam.SetCell("row1", "col1", 20_ms, "bar");
+  fam.SetCell("row3", "col1", 10_ms, "baz");
+  fam.DeleteRow("row2");
+  fam.SetCell("row1", "col1", 30_ms, "bar");
+
+  EXPECT_EQ(3U, fam.FindColumn("row1", "col1")->size());
+  EXPECT_EQ(1U, fam.FindColumn("row3", "col1")->size());
+  EXPECT_EQ(nullptr, fam.FindColumn("row2", "col1"));
+  EXPECT_TRUE(fam.HasRow("row3"));
+  EXPECT_FALSE(fam.HasRow("row2"));
+
+  // The snapshot still sees the rows as they were.
+  EXPECT_EQ(1U, snapshot->FindColumn("row1", "col1")->size());
+  EXPECT_EQ(nullptr, snapshot->FindColumn("row3", "col1"));
+  EXPECT_TRUE(snapshot->HasRow("row2"));
+  EXPECT_FALSE(snapshot->HasRow("row3"));
+
+  fam.DeleteColumn("row1", "col1", ::google::bigtable::v2::TimestampRange{});
+  EXPECT_FALSE(fam.HasRow("row1"));
+  EXPECT_EQ(nullptr, fam.FindColumn("row1", "col1"));
+  EXPECT_EQ(1U, snapshot->FindColumn("row1", "col1")->size());
+}
+
+TEST(ColumnFamily, FrozenRowsThawWhenModified) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  fam.SetCell("row0", "col0", 10_ms, "foo");
+  fam.SetCell("row1", "col0", 10_ms, "bar");
+  fam.SetCell("row1", "col1", 20_ms, "baz");
+  fam.SetCell("row2", "col0", 30_ms, "qux");
+  fam.Freeze();
+  auto const& cfam = fam;
+  EXPECT_EQ(1U, fam.frozen_segments());
+  EXPECT_EQ(cfam.begin(), cfam.end());
+  EXPECT_EQ(3U, fam.size());
+  EXPECT_TRUE(fam.HasRow("row1"));
+  EXPECT_FALSE(fam.HasRow("row3"));
+  EXPECT_EQ(1U, fam.CountCells("row1", "col1"));
+  EXPECT_EQ(0U, fam.CountCells("row1", "col2"));
+  auto snapshot = fam.Snapshot();
+
+  // Writing a frozen row thaws it with all its cells.
+  fam.SetCell("row1", "col1", 40_ms, "new");
+  ASSERT_NE(cfam.begin(), cfam.end());
+  EXPECT_EQ("row1", cfam.begin()->first);
+  EXPECT_EQ(R"""(
+row1 cf1:col0 @10ms: bar
+row1 cf1:col1 @40ms: new
+row1 cf1:col1 @20ms: baz
+)""",
+            "\n" + DumpColumnFamily(fam, "cf1"));
+  EXPECT_EQ(3U, fam.size());
+
+  auto deleted = fam.DeleteRow("row2");
+  EXPECT_EQ(1, deleted.rows);
+  EXPECT_EQ(1, deleted.columns);
+  EXPECT_EQ(1, deleted.cells);
+  EXPECT_EQ(LogicalCellSize("row2", "col0", "qux"), deleted.logical_bytes);
+  EXPECT_FALSE(fam.HasRow("row2"));
+  EXPECT_EQ(2U, fam.size());
+
+  std::map<std::string, std::size_t> rows;
+  fam.ForEachRow("row1", "",
+                 [&](std::string const& row_key, ColumnFamilyRow const& row) {
+                   rows[row_key] = std::distance(row.begin(), row.end());
+                 });
+  EXPECT_EQ((std::map<std::string, std::size_t>{{"row1", 2}}), rows);
+
+  auto stream = [](ColumnFamily const& fam) {
+    auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+    std::string res;
+    FilteredColumnFamilyStream rows_stream(fam, "cf1", all_rows);
+    res += DumpFilteredColumnFamilyStream(rows_stream);
+    for (auto& frozen : fam.CreateFrozenStreams("cf1", all_rows)) {
+      res += DumpFilteredColumnFamilyStream(*frozen);
+    }
+    return res;
+  };
+  EXPECT_EQ(R"""(
+row1 cf1:col0 @10ms: bar
+row1 cf1:col1 @40ms: new
+row1 cf1:col1 @20ms: baz
+row0 cf1:col0 @10ms: foo
+)""",
+            "\n" + stream(fam));
+  // The snapshot still reads all the rows from the segment.
+  EXPECT_EQ(R"""(
+row0 cf1:col0 @10ms: foo
+row1 cf1:col0 @10ms: bar
+row1 cf1:col1 @20ms: baz
+row2 cf1:col0 @30ms: qux
+)""",
+            "\n" + stream(*snapshot));
+
+  // Freezing again merges the segments, without the removed rows.
+  fam.Freeze();
+  EXPECT_EQ(1U, fam.frozen_segments());
+  EXPECT_EQ(2U, fam.size());
+  EXPECT_EQ(R"""(
+row0 cf1:col0 @10ms: foo
+row1 cf1:col0 @10ms: bar
+row1 cf1:col1 @40ms: new
+row1 cf1:col1 @20ms: baz
+)""",
+            "\n" + stream(fam));
+
+  fam.ThawRows("row0", "row1");
+  EXPECT_EQ("row0 cf1:col0 @10ms: foo\n", DumpColumnFamily(fam, "cf1"));
+  EXPECT_EQ(2U, fam.size());
+}
+
+TEST(ColumnFamily, FreezesRowsNotWrittenForAnInterval) {
+  using testing_util::chrono_literals::operator""_ms;
+
+  ColumnFamily fam;
+  auto const start = std::chrono::steady_clock::now();
+  auto const deadline = std::chrono::steady_clock::time_point::max();
+  fam.SetCell("row0", "col0", 10_ms, "foo");
+  fam.SetCell("row1", "col0", 10_ms, "bar");
+  fam.SetCell("row2", "col0", 10_ms, "baz");
+
+  // The rows may have been written just before the epoch started.
+  auto job = fam.PrepareFreeze(start);
+  job->Build(deadline);
+  fam.InstallFreeze(*job);
+  EXPECT_EQ(0U, fam.frozen_segments());
+  fam.SetCell("row3", "col0", 10_ms, "qux");
+
+  job = fam.PrepareFreeze(start + ColumnFamily::kFreezeInterval);
+  job->Build(deadline);
+  // Modified while the segment is built, so it stays in the tree.
+  fam.SetCell("row1", "col0", 20_ms, "new");
+  fam.DeleteRow("row2");
+  fam.InstallFreeze(*job);
+  EXPECT_EQ(1U, fam.frozen_segments());
+  EXPECT_EQ(3U, fam.size());
+  EXPECT_TRUE(fam.HasRow("row0"));
+  EXPECT_FALSE(fam.HasRow("row2"));
+  EXPECT_EQ(R"""(
+row1 cf1:col0 @20ms: new
+row1 cf1:col0 @10ms: bar
+row3 cf1:col0 @10ms: qux
+)""",
+            "\n" + DumpColumnFamily(fam, "cf1"));
+
+  // Another freeze installed first makes the job's segments stale.
+  job = fam.PrepareFreeze(start + 2 * ColumnFamily::kFreezeInterval);
+  job->Build(deadline);
+  fam.Freeze();
+  EXPECT_EQ(std::as_const(fam).begin(), std::as_const(fam).end());
+  fam.InstallFreeze(*job);
+  EXPECT_EQ(1U, fam.frozen_segments());
+  EXPECT_EQ(3U, fam.size());
+}
+
 // Add Next Column, Next Row tests
 
 }  // anonymous namespace
@@ -1,4 +1,12 @@
 #include <iostream>
 
 static const std::string kTablesPrefix = "/sys/tables/";
-static const std::string kManifestKey = "/sys/tables/_manifest";
\ No newline at end of file
+static const std::string kManifestKey = "/sys/tables/_manifest";
+static const std::string kLayoutsPrefix = "/sys/layouts/";
+static const std::string kStatsPrefix = "/sys/stats/";
+static const std::string kTabletsPrefix = "/sys/tablets/";
+// Tables and column families which are dropped, but whose data may not be
+// removed yet. The values of the column family markers are the table's
+// storage layout.
+static const std::string kDroppedTablesPrefix = "/sys/dropped_tables/";
+static const std::string kDroppedFamiliesPrefix = "/sys/dropped_families/";
@@ -101,9 +101,9 @@ Status HasCell(std::shared_ptr<google::cloud::bigtable::emulator::Table>& table,
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return NotFoundError("no row key found in column family",
                          GCP_ERROR_INFO()
                              .WithMetadata("row key", row_key)
@@ -133,7 +133,8 @@ Status HasCell(std::shared_ptr<google::cloud::bigtable::emulator::Table>& table,
     return NotFoundError("wrong value",
                          GCP_ERROR_INFO()
                              .WithMetadata("expected", value)
-                             .WithMetadata("found", timestamp_it->second));
+                             .WithMetadata("found",
+                                           std::string(timestamp_it->second)));
   }
 
   return Status();
@@ -149,9 +150,9 @@ StatusOr<bool> HasRow(
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return false;
   }
 
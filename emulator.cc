@@ -81,7 +81,8 @@ int main(int argc, char* argv[]) {
       }
 
       // Create runtime Table object from the persisted schema
-      auto maybe_table = google::cloud::bigtable::emulator::Table::Create(schema);
+      auto maybe_table = google::cloud::bigtable::emulator::Table::Create(
+          schema, storage->GetTableLayout(schema.name()));
       if (!maybe_table) {
         std::cerr << "Table::Create failed for persisted schema: " << schema.DebugString()
                   << " error: " << maybe_table.status() << std::endl;
@@ -21,6 +21,7 @@
 #include "absl/types/variant.h"
 #include "range_set.h"
 #include "re2/re2.h"
+#include "regex_matcher.h"
 #include <google/bigtable/v2/data.pb.h>
 #include <algorithm>
 #include <cassert>
@@ -379,127 +380,154 @@ CellStream MakePerRowStateFilter(
 bool MergeCellStreams::CellStreamGreater::operator()(
     std::unique_ptr<CellStream> const& lhs,
     std::unique_ptr<CellStream> const& rhs) const {
-  auto row_key_cmp =
-      internal::CompareRowKey((*lhs)->row_key(), (*rhs)->row_key());
-  if (row_key_cmp != 0) {
-    return row_key_cmp > 0;
-  }
-  auto cf_cmp = internal::CompareColumnQualifiers((*lhs)->column_family(),
-                                                  (*rhs)->column_family());
-  if (cf_cmp != 0) {
-    return cf_cmp > 0;
-  }
-  auto col_cmp = internal::CompareColumnQualifiers((*lhs)->column_qualifier(),
-                                                   (*rhs)->column_qualifier());
-  if (col_cmp != 0) {
-    return col_cmp > 0;
-  }
-  return (*lhs)->timestamp() > (*rhs)->timestamp();
+  return HeadLess(MakeHead(*rhs), MakeHead(*lhs));
 }
 
-MergeCellStreams::MergeCellStreams(std::vector<CellStream> streams) {
-  for (auto& stream : streams) {
-    unfinished_streams_.emplace_back(
-        std::make_unique<CellStream>(std::move(stream)));
-  }
-}
+MergeCellStreams::MergeCellStreams(std::vector<CellStream> streams)
+    : streams_(std::move(streams)) {}
 
 bool MergeCellStreams::ApplyFilter(InternalFilter const& internal_filter) {
   assert(!initialized_);
   bool res = true;
-  for (auto& stream : unfinished_streams_) {
-    res = stream->ApplyFilter(internal_filter) && res;
+  for (auto& stream : streams_) {
+    res = stream.ApplyFilter(internal_filter) && res;
   }
   return res;
 }
 
 bool MergeCellStreams::HasValue() const {
   InitializeIfNeeded();
-  return !unfinished_streams_.empty();
+  return !streams_.empty() && !heads_[tree_[0]].finished;
 }
 
 CellView const& MergeCellStreams::Value() const {
   InitializeIfNeeded();
-  return unfinished_streams_.front()->Value();
+  return streams_[tree_[0]].Value();
 }
 
 bool MergeCellStreams::Next(NextMode mode) {
   InitializeIfNeeded();
-  assert(!unfinished_streams_.empty());
+  assert(HasValue());
 
+  auto const first = tree_[0];
+  if (mode == NextMode::kCell || streams_.size() == 1) {
+    Advance(first, mode);
+    return true;
+  }
   // If we're skipping to the next column/row, we need to advance all streams
-  // that currently point to that column/row.
-  //
-  // To do this, we temporarily remove those streams from the heap
-  // (since advancing them would require re-adjusting the heap).
-  // These streams remain at the end of the `unfinished_streams_` vector,
-  // but are not considered part of the heap. The `to_readd_begin` iterator
-  // marks the start of the range in `unfinished_streams_` that is outside
-  // the heap.
-
-  std::pop_heap(unfinished_streams_.begin(), unfinished_streams_.end(),
-                CellStreamGreater());
-  auto first_to_advance = std::prev(unfinished_streams_.end());
-  auto to_readd_begin = first_to_advance;
-
-  auto all_streams_to_advance_removed_from_heap = [&]() {
-    if (unfinished_streams_.begin() == to_readd_begin) {
-      // All streams removed.
-      return true;
-    }
-    if (mode == NextMode::kCell) {
-      // We only need to remove one stream, which we already did.
-      return true;
-    }
-    if (mode == NextMode::kRow) {
-      return unfinished_streams_.front()->Value().row_key() !=
-             (*first_to_advance)->Value().row_key();
+  // that currently point to that column/row. They are the consecutive winners
+  // of the tournament. The cached views die once `first` is advanced, so we
+  // need copies to compare against.
+  std::string const row_key(heads_[first].row_key);
+  std::string column_family;
+  std::string column_qualifier;
+  if (mode == NextMode::kColumn) {
+    column_family = std::string(heads_[first].column_family);
+    column_qualifier = std::string(heads_[first].column_qualifier);
+  }
+  auto at_same_position = [&](Head const& head) {
+    if (head.finished || head.row_key != row_key) {
+      return false;
     }
-    assert(mode == NextMode::kColumn);
-    return unfinished_streams_.front()->Value().column_qualifier() !=
-               (*first_to_advance)->Value().column_qualifier() ||
-           unfinished_streams_.front()->Value().column_family() !=
-               (*first_to_advance)->Value().column_family() ||
-           unfinished_streams_.front()->Value().row_key() !=
-               (*first_to_advance)->Value().row_key();
+    assert(mode == NextMode::kRow || mode == NextMode::kColumn);
+    return mode == NextMode::kRow ||
+           (head.column_family == column_family &&
+            head.column_qualifier == column_qualifier);
   };
-  while (!all_streams_to_advance_removed_from_heap()) {
-    std::pop_heap(unfinished_streams_.begin(), to_readd_begin,
-                  CellStreamGreater());
-    --to_readd_begin;
+  do {
+    Advance(tree_[0], mode);
+  } while (at_same_position(heads_[tree_[0]]));
+  return true;
+}
+
+MergeCellStreams::Head MergeCellStreams::MakeHead(CellStream const& stream) {
+  if (!stream.HasValue()) {
+    return Head{{}, {}, {}, std::chrono::milliseconds(0), true};
+  }
+  auto const& cell = stream.Value();
+  return Head{cell.row_key(), cell.column_family(), cell.column_qualifier(),
+              cell.timestamp(), false};
+}
+
+bool MergeCellStreams::HeadLess(Head const& lhs, Head const& rhs) {
+  if (lhs.finished || rhs.finished) {
+    return !lhs.finished;
+  }
+  // Row keys and qualifiers are compared as unsigned bytes, which is what
+  // `string_view::compare()` does.
+  if (auto cmp = lhs.row_key.compare(rhs.row_key); cmp != 0) {
+    return cmp < 0;
+  }
+  if (auto cmp = lhs.column_family.compare(rhs.column_family); cmp != 0) {
+    return cmp < 0;
+  }
+  if (auto cmp = lhs.column_qualifier.compare(rhs.column_qualifier);
+      cmp != 0) {
+    return cmp < 0;
+  }
+  return lhs.timestamp < rhs.timestamp;
+}
+
+void MergeCellStreams::Advance(std::size_t idx, NextMode mode) {
+  streams_[idx].Next(mode);
+  heads_[idx] = MakeHead(streams_[idx]);
+  Replay(idx);
+}
+
+void MergeCellStreams::Replay(std::size_t idx) const {
+  auto const num_streams = streams_.size();
+  if (num_streams == 1) {
+    return;
   }
-  while (to_readd_begin != unfinished_streams_.end()) {
-    (*to_readd_begin)->Next(mode);
-    if ((*to_readd_begin)->HasValue()) {
-      ++to_readd_begin;
-      std::push_heap(unfinished_streams_.begin(), to_readd_begin,
-                     CellStreamGreater());
-      continue;
+  if (num_streams == 2) {
+    tree_[0] = HeadLess(heads_[1], heads_[0]) ? 1 : 0;
+    return;
+  }
+  // Walk from the leaf to the root. At each node the stored loser plays the
+  // current candidate; whoever loses stays at the node.
+  auto winner = idx;
+  for (auto node = (num_streams + idx) / 2; node > 0; node /= 2) {
+    if (HeadLess(heads_[tree_[node]], heads_[winner])) {
+      std::swap(tree_[node], winner);
     }
-    // The stream is finished, delete it.
-    to_readd_begin->swap(unfinished_streams_.back());
-    unfinished_streams_.pop_back();
-    // Don't advance `to_readd_begin` since it points to a different stream
-    // after `swap()`.
   }
-  return true;
+  tree_[0] = winner;
 }
 
 void MergeCellStreams::InitializeIfNeeded() const {
-  if (!initialized_) {
-    for (auto stream_it = unfinished_streams_.begin();
-         stream_it != unfinished_streams_.end();) {
-      if (!(*stream_it)->HasValue()) {
-        stream_it->swap(unfinished_streams_.back());
-        unfinished_streams_.pop_back();
-      } else {
-        ++stream_it;
-      }
+  if (initialized_) {
+    return;
+  }
+  initialized_ = true;
+  auto const num_streams = streams_.size();
+  heads_.clear();
+  heads_.reserve(num_streams);
+  for (auto const& stream : streams_) {
+    heads_.emplace_back(MakeHead(stream));
+  }
+  tree_.assign(std::max<std::size_t>(num_streams, 1), 0);
+  if (num_streams <= 2) {
+    if (num_streams == 2) {
+      Replay(0);
     }
-    std::make_heap(unfinished_streams_.begin(), unfinished_streams_.end(),
-                   CellStreamGreater());
-    initialized_ = true;
+    return;
+  }
+  // Play all the matches bottom-up. `winners[node]` is the winner of the
+  // subtree rooted at `node`.
+  std::vector<std::size_t> winners(2 * num_streams);
+  for (std::size_t i = 0; i != num_streams; ++i) {
+    winners[num_streams + i] = i;
+  }
+  for (auto node = num_streams - 1; node > 0; --node) {
+    auto lhs = winners[2 * node];
+    auto rhs = winners[2 * node + 1];
+    if (HeadLess(heads_[rhs], heads_[lhs])) {
+      std::swap(lhs, rhs);
+    }
+    winners[node] = lhs;
+    tree_[node] = rhs;
   }
+  tree_[0] = winners[1];
 }
 
 /// A cell stream for handling a Condition filter.
@@ -694,8 +722,9 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
               .WithMetadata("filter", filter.DebugString())
               .WithMetadata("description", pattern->error()));
     }
-    CellStreamConstructor res = [source_ctor = std::move(source_ctor),
-                                 pattern = std::move(pattern)] {
+    CellStreamConstructor res =
+        [source_ctor = std::move(source_ctor),
+         pattern = std::make_shared<RegexMatcher const>(std::move(pattern))] {
       auto source = source_ctor();
       if (source.ApplyFilter(RowKeyRegex{pattern})) {
         return source;
@@ -704,7 +733,7 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
           std::move(source),
           [pattern = pattern](
               CellView const& cell_view) mutable -> absl::optional<NextMode> {
-            if (re2::RE2::PartialMatch(cell_view.row_key(), *pattern)) {
+            if (pattern->PartialMatch(cell_view.row_key())) {
               return {};
             }
             return NextMode::kCell;
@@ -721,14 +750,15 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
               .WithMetadata("filter", filter.DebugString())
               .WithMetadata("description", pattern->error()));
     }
-    CellStreamConstructor res = [source_ctor = std::move(source_ctor),
-                                 pattern = std::move(pattern)] {
+    CellStreamConstructor res =
+        [source_ctor = std::move(source_ctor),
+         pattern = std::make_shared<RegexMatcher const>(std::move(pattern))] {
       auto source = source_ctor();
       return MakeTrivialFilter(
           std::move(source),
           [pattern = pattern](
               CellView const& cell_view) mutable -> absl::optional<NextMode> {
-            if (re2::RE2::PartialMatch(cell_view.value(), *pattern)) {
+            if (pattern->PartialMatch(cell_view.value())) {
               return {};
             }
             return NextMode::kCell;
@@ -772,8 +802,9 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
               .WithMetadata("filter", filter.DebugString())
               .WithMetadata("description", pattern->error()));
     }
-    CellStreamConstructor res = [source_ctor = std::move(source_ctor),
-                                 pattern = std::move(pattern)] {
+    CellStreamConstructor res =
+        [source_ctor = std::move(source_ctor),
+         pattern = std::make_shared<RegexMatcher const>(std::move(pattern))] {
       auto source = source_ctor();
       if (source.ApplyFilter(FamilyNameRegex{pattern})) {
         return source;
@@ -782,7 +813,7 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
           std::move(source),
           [pattern = pattern](
               CellView const& cell_view) mutable -> absl::optional<NextMode> {
-            if (re2::RE2::PartialMatch(cell_view.column_family(), *pattern)) {
+            if (pattern->PartialMatch(cell_view.column_family())) {
               return {};
             }
             // FIXME we could introduce even column family skipping
@@ -801,8 +832,9 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
               .WithMetadata("filter", filter.DebugString())
               .WithMetadata("description", pattern->error()));
     }
-    CellStreamConstructor res = [source_ctor = std::move(source_ctor),
-                                 pattern = std::move(pattern)] {
+    CellStreamConstructor res =
+        [source_ctor = std::move(source_ctor),
+         pattern = std::make_shared<RegexMatcher const>(std::move(pattern))] {
       auto source = source_ctor();
       if (source.ApplyFilter(ColumnRegex{pattern})) {
         return source;
@@ -811,8 +843,7 @@ StatusOr<CellStreamConstructor> CreateFilterImpl(
           std::move(source),
           [pattern](
               CellView const& cell_view) mutable -> absl::optional<NextMode> {
-            if (re2::RE2::PartialMatch(cell_view.column_qualifier(),
-                                       *pattern)) {
+            if (pattern->PartialMatch(cell_view.column_qualifier())) {
               return {};
             }
             return NextMode::kColumn;
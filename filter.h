@@ -16,20 +16,20 @@
 #define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_FILTER_H
 
 #include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/internal/variant.h"
 #include "cell_view.h"
 #include "range_set.h"
+#include "regex_matcher.h"
 #include <google/bigtable/v2/data.pb.h>
+#include <chrono>
+#include <cstddef>
 #include <functional>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
-namespace re2 {
-class RE2;
-}  // namespace re2
-
 namespace google {
 namespace cloud {
 namespace bigtable {
@@ -75,15 +75,15 @@ namespace emulator {
 
 /// Only return cells from rows whose keys match `regex`.
 struct RowKeyRegex {
-  std::shared_ptr<re2::RE2> regex;
+  std::shared_ptr<RegexMatcher const> regex;
 };
 /// Only return cells from column families whose names match `regex`.
 struct FamilyNameRegex {
-  std::shared_ptr<re2::RE2> regex;
+  std::shared_ptr<RegexMatcher const> regex;
 };
 /// Only return cells from columns whose qualifiers match `regex`.
 struct ColumnRegex {
-  std::shared_ptr<re2::RE2> regex;
+  std::shared_ptr<RegexMatcher const> regex;
 };
 /// Only return cells from columns which fall into `range`.
 struct ColumnRange {
@@ -232,6 +232,13 @@ class CellStream {
 
 /**
  * A stream which merges multiple stream while maintaining ordering.
+ *
+ * The streams are kept in a flat array and merged with a tournament (loser)
+ * tree, so advancing the merged stream replays only the matches on the path
+ * from the advanced stream to the root and never moves the streams around.
+ * The row key, column family and column qualifier of each stream's current
+ * cell are cached as `absl::string_view`s, so a match doesn't go through the
+ * virtual `Value()`. Merging one or two streams bypasses the tree.
  */
 class MergeCellStreams : public AbstractCellStreamImpl {
  public:
@@ -247,15 +254,38 @@ class MergeCellStreams : public AbstractCellStreamImpl {
   CellView const& Value() const override;
   bool Next(NextMode mode) override;
 
+ protected:
+  // The merged streams. Subclasses may only remove streams before the first
+  // access to the merged stream, i.e. in `ApplyFilter()`.
+  std::vector<CellStream> streams_;
+
  private:
+  // The position of a stream's current cell, cached after every advance.
+  struct Head {
+    absl::string_view row_key;
+    absl::string_view column_family;
+    absl::string_view column_qualifier;
+    std::chrono::milliseconds timestamp;
+    bool finished;
+  };
+
+  static Head MakeHead(CellStream const& stream);
+  // Whether `lhs` should be streamed before `rhs`; finished streams go last.
+  static bool HeadLess(Head const& lhs, Head const& rhs);
+
   void InitializeIfNeeded() const;
+  // Advance `streams_[idx]` and replay its matches.
+  void Advance(std::size_t idx, NextMode mode);
+  // Recompute the winner after the head of `streams_[idx]` has changed.
+  void Replay(std::size_t idx) const;
 
+  mutable std::vector<Head> heads_;
+  // `tree_[0]` is the index of the stream with the smallest cell; for more
+  // than two streams `tree_[node]` holds the loser of the match played at
+  // `node`, where the children of `node` are `2 * node` and `2 * node + 1`
+  // and stream `i` sits at leaf `streams_.size() + i`.
+  mutable std::vector<std::size_t> tree_;
   mutable bool initialized_{false};
-
- protected:
-  // A priority queue of streams which still have data.
-  // `std::priority_queue` can't be used because it cannot be iterated over.
-  mutable std::vector<std::unique_ptr<CellStream>> unfinished_streams_;
 };
 
 /**
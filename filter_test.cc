@@ -708,6 +708,91 @@ TEST(MergeCellStreams, AdvancingColumnAdvancesAllRelevantStreams) {
   ASSERT_FALSE(stream.HasValue());
 }
 
+TEST(MergeCellStreams, ManyStreams) {
+  // More than two streams, and not a power of two, so that the tournament tree
+  // has an unbalanced last level.
+  auto const num_streams = 11;
+  auto make_stream_data = [&] {
+    std::vector<std::unique_ptr<TestStreamData>> res;
+    for (int i = 0; i != num_streams; ++i) {
+      std::vector<TestCell> cells;
+      for (int row = 0; row != 4 && i != 5; ++row) {
+        if ((row + i) % 3 == 0) continue;
+        cells.emplace_back("row" + std::to_string(row),
+                           std::string(1, static_cast<char>('a' + i)), "col",
+                           0_ms, "val");
+      }
+      res.emplace_back(std::make_unique<TestStreamData>(std::move(cells)));
+    }
+    return res;
+  };
+  auto prepare_stream = [](TestStreamData& stream_data) {
+    EXPECT_CALL(*stream_data.stream, Next(NextMode::kCell))
+        .WillRepeatedly([&]() {
+          ++stream_data.cur_cell;
+          return true;
+        });
+    // Let `CellStream` emulate skipping columns and rows.
+    EXPECT_CALL(*stream_data.stream, Next(::testing::Ne(NextMode::kCell)))
+        .WillRepeatedly(Return(false));
+    EXPECT_CALL(*stream_data.stream, Value)
+        .WillRepeatedly([&]() -> CellView const& {
+          return stream_data.cur_cell->AsCellView();
+        });
+    EXPECT_CALL(*stream_data.stream, HasValue).WillRepeatedly([&] {
+      return stream_data.cur_cell != stream_data.cells.end();
+    });
+    return CellStream(std::move(stream_data.stream));
+  };
+  auto make_merged_stream =
+      [&](std::vector<std::unique_ptr<TestStreamData>>& stream_data) {
+        std::vector<CellStream> streams;
+        for (auto& data : stream_data) {
+          streams.push_back(prepare_stream(*data));
+        }
+        return CellStream(
+            std::make_unique<MergeCellStreams>(std::move(streams)));
+      };
+
+  std::vector<TestCell> expected;
+  for (int row = 0; row != 4; ++row) {
+    for (int i = 0; i != num_streams; ++i) {
+      if (i == 5 || (row + i) % 3 == 0) continue;
+      expected.emplace_back("row" + std::to_string(row),
+                            std::string(1, static_cast<char>('a' + i)), "col",
+                            0_ms, "val");
+    }
+  }
+  {
+    auto stream_data = make_stream_data();
+    auto stream = make_merged_stream(stream_data);
+    std::vector<TestCell> actual;
+    for (; stream.HasValue(); stream.Next(NextMode::kCell)) {
+      actual.emplace_back(stream->row_key(), stream->column_family(),
+                          stream->column_qualifier(), stream->timestamp(),
+                          std::string(stream->value()));
+    }
+    EXPECT_EQ(expected, actual);
+  }
+  {
+    auto stream_data = make_stream_data();
+    auto stream = make_merged_stream(stream_data);
+    ASSERT_TRUE(stream.HasValue());
+    EXPECT_EQ("row0", stream->row_key());
+    // Skipping the row has to advance all the streams pointing at row0.
+    stream.Next(NextMode::kRow);
+    ASSERT_TRUE(stream.HasValue());
+    EXPECT_EQ("row1", stream->row_key());
+    EXPECT_EQ("a", stream->column_family());
+    stream.Next(NextMode::kRow);
+    stream.Next(NextMode::kRow);
+    ASSERT_TRUE(stream.HasValue());
+    EXPECT_EQ("row3", stream->row_key());
+    stream.Next(NextMode::kRow);
+    EXPECT_FALSE(stream.HasValue());
+  }
+}
+
 class InvalidFilterProtoTest : public ::testing::Test {
  protected:
   ::google::bigtable::v2::RowFilter filter_;
@@ -957,7 +1042,8 @@ class FilterApplicationPropagation : public ::testing::Test {
   };
 
   FilterApplicationPropagation()
-      : sample_regex_(std::make_shared<re2::RE2>("foo.*")),
+      : sample_regex_(std::make_shared<RegexMatcher const>(
+            std::make_shared<re2::RE2>("foo.*"))),
         sample_string_range_("a", true, "b", false),
         sample_ts_range_(std::chrono::milliseconds(10),
                          std::chrono::milliseconds(20)) {
@@ -982,7 +1068,7 @@ class FilterApplicationPropagation : public ::testing::Test {
     filter_type_it->second.should_propagate = false;
   }
 
-  std::shared_ptr<re2::RE2> sample_regex_;
+  std::shared_ptr<RegexMatcher const> sample_regex_;
   StringRangeSet::Range sample_string_range_;
   TimestampRangeSet::Range sample_ts_range_;
   std::map<std::string, InternalFilterType> internal_filters_;
@@ -1325,7 +1411,7 @@ class FilterWorkTest : public ::testing::Test {
       auto& v = maybe_stream.value();
       filter_output.emplace_back(
           v->row_key(), v->column_family(), v->column_qualifier(),
-          v->timestamp(), v->value(),
+          v->timestamp(), std::string(v->value()),
           v->HasLabel() ? absl::optional<std::string>{v->label()}
                         : absl::optional<std::string>{});
       maybe_stream->Next();
@@ -1944,7 +2030,7 @@ TEST(FiltersEndToEnd, ColumnRange) {
   for (; stream; ++stream) {
     actual.emplace_back(stream->row_key(), stream->column_family(),
                         stream->column_qualifier(), stream->timestamp(),
-                        stream->value());
+                        std::string(stream->value()));
   }
 
   ASSERT_EQ(expected, actual);
@@ -17,10 +17,13 @@
 
 #include "range_set.h"
 #include "re2/re2.h"
+#include "regex_matcher.h"
 #include <functional>
 #include <iterator>
 #include <memory>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 namespace google {
@@ -93,6 +96,10 @@ class StringRangeFilteredMapView {
     pointer operator->() const { return &*unfiltered_pos_; }
 
    private:
+    // The keys may also be of types convertible to `std::string`, e.g.
+    // interned column qualifiers.
+    static std::string const& Key(std::string const& key) { return key; }
+
     // Adjust `unfiltered_pos_` after we transition to a different range.
     void AdvanceToNextRange() {
       if (filter_pos_ == parent_.get().filter_.get().disjoint_ranges().end()) {
@@ -104,7 +111,7 @@ class StringRangeFilteredMapView {
         // unfiltered_pos_ is already pointing far enough.
         return;
       }
-      if (!filter_pos_->IsBelowStart(unfiltered_pos_->first)) {
+      if (!filter_pos_->IsBelowStart(Key(unfiltered_pos_->first))) {
         // unfiltered_pos_ is already pointing far enough.
         return;
       }
@@ -127,7 +134,7 @@ class StringRangeFilteredMapView {
       while (unfiltered_pos_ != parent_.get().unfiltered_.get().end() &&
              filter_pos_ !=
                  parent_.get().filter_.get().disjoint_ranges().end() &&
-             filter_pos_->IsAboveEnd(unfiltered_pos_->first)) {
+             filter_pos_->IsAboveEnd(Key(unfiltered_pos_->first))) {
         ++filter_pos_;
         AdvanceToNextRange();
       }
@@ -325,8 +332,9 @@ class TimestampRangeFilteredMapView {
  * Elements whose keys match all regexes are not filtered out.
  *
  * @tparam Map the type of the map-like object to be wrapped.
+ * @tparam Regex either `re2::RE2` or `RegexMatcher`.
  */
-template <typename Map>
+template <typename Map, typename Regex = re2::RE2>
 class RegexFiteredMapView {
  public:
   // NOLINTNEXTLINE(readability-identifier-naming)
@@ -376,9 +384,9 @@ class RegexFiteredMapView {
       for (; unfiltered_pos_ != parent_.get().unfiltered_.end() &&
              std::any_of(parent_.get().filters_.get().begin(),
                          parent_.get().filters_.get().end(),
-                         [&](std::shared_ptr<re2::RE2 const> const& filter) {
-                           return !re2::RE2::PartialMatch(
-                               unfiltered_pos_->first, *filter);
+                         [&](std::shared_ptr<Regex const> const& filter) {
+                           return !PartialMatch(unfiltered_pos_->first,
+                                                *filter);
                          });
            ++unfiltered_pos_) {
       }
@@ -400,9 +408,8 @@ class RegexFiteredMapView {
    * @filters the regexes which element's keys have match to not be filtered
    *   out.
    */
-  RegexFiteredMapView(
-      Map unfiltered,
-      std::vector<std::shared_ptr<re2::RE2 const>> const& filters)
+  RegexFiteredMapView(Map unfiltered,
+                      std::vector<std::shared_ptr<Regex const>> const& filters)
       : unfiltered_(std::move(unfiltered)), filters_(std::cref(filters)) {}
 
   const_iterator begin() const {
@@ -413,8 +420,22 @@ class RegexFiteredMapView {
   }
 
  private:
+  static bool PartialMatch(std::string const& key, re2::RE2 const& regex) {
+    return re2::RE2::PartialMatch(key, regex);
+  }
+  static bool PartialMatch(std::string const& key, RegexMatcher const& regex) {
+    return regex.PartialMatch(key);
+  }
+  // Matchers for other key types, e.g. `QualifierRegexMemo`.
+  template <typename Key, typename Matcher,
+            typename = decltype(std::declval<Matcher const&>().PartialMatch(
+                std::declval<Key const&>()))>
+  static bool PartialMatch(Key const& key, Matcher const& regex) {
+    return regex.PartialMatch(key);
+  }
+
   Map unfiltered_;
-  std::reference_wrapper<std::vector<std::shared_ptr<re2::RE2 const>> const>
+  std::reference_wrapper<std::vector<std::shared_ptr<Regex const>> const>
       filters_;
 };
 
@@ -0,0 +1,461 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frozen_segment.h"
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+void PutVarint(std::string& out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+// The data is trusted, since only `FrozenSegment::Builder` writes it.
+std::uint64_t GetVarint(absl::string_view& in) {
+  std::uint64_t res = 0;
+  for (int shift = 0;; shift += 7) {
+    auto const byte = static_cast<unsigned char>(in.front());
+    in.remove_prefix(1);
+    res |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return res;
+  }
+}
+
+// The first timestamp of a column may be negative, so it is zigzag encoded.
+std::uint64_t ZigZagEncode(std::int64_t value) {
+  return (static_cast<std::uint64_t>(value) << 1) ^
+         static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t ZigZagDecode(std::uint64_t value) {
+  return static_cast<std::int64_t>(value >> 1) ^
+         -static_cast<std::int64_t>(value & 1);
+}
+
+// Read the key of the row at the start of `data`, given the previous
+// row's key in `key`, and skip the rest of the row.
+void SkipRow(absl::string_view& data, std::string& key) {
+  auto const shared = GetVarint(data);
+  auto const unshared = GetVarint(data);
+  key.resize(shared);
+  key.append(data.data(), unshared);
+  data.remove_prefix(unshared);
+  data.remove_prefix(GetVarint(data));
+}
+
+}  // namespace
+
+std::size_t FrozenSegment::memory_bytes() const {
+  return data_.capacity() + restarts_.capacity() * sizeof(std::size_t) +
+         last_key_.capacity() + qualifiers_.capacity() * sizeof(Qualifier);
+}
+
+absl::string_view FrozenSegment::RestartKey(std::size_t restart) const {
+  absl::string_view data(data_);
+  data.remove_prefix(restarts_[restart]);
+  auto const shared = GetVarint(data);
+  assert(shared == 0);
+  (void)shared;
+  return data.substr(0, GetVarint(data));
+}
+
+std::size_t FrozenSegment::LowerBound(absl::string_view row_key) const {
+  // Appends to a time series usually look past the end.
+  if (rows_ == 0 || row_key > last_key_) return rows_;
+  // The last restart whose key is not greater than `row_key`.
+  std::size_t lo = 0;
+  std::size_t hi = restarts_.size();
+  while (lo < hi) {
+    auto const mid = lo + (hi - lo) / 2;
+    if (RestartKey(mid) <= row_key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) return 0;
+  auto row = (lo - 1) * kRestartInterval;
+  absl::string_view data(data_);
+  data.remove_prefix(restarts_[lo - 1]);
+  std::string key;
+  for (; row != rows_; ++row) {
+    SkipRow(data, key);
+    if (key >= row_key) return row;
+  }
+  return rows_;
+}
+
+absl::optional<std::size_t> FrozenSegment::Find(
+    absl::string_view row_key) const {
+  auto const row = LowerBound(row_key);
+  if (row == rows_) return absl::nullopt;
+  RowCursor cursor(*this, row);
+  if (cursor.row_key() != row_key) return absl::nullopt;
+  return row;
+}
+
+FrozenSegment::Builder::Builder(
+    std::shared_ptr<QualifierDictionary const> dictionary)
+    : segment_(new FrozenSegment(std::move(dictionary))) {}
+
+void FrozenSegment::Builder::StartRow(absl::string_view row_key) {
+  FinishRow();
+  assert(segment_->rows_ == 0 || row_key > segment_->last_key_);
+  row_key_.assign(row_key.data(), row_key.size());
+  in_row_ = true;
+}
+
+void FrozenSegment::Builder::StartColumn(Qualifier qualifier) {
+  assert(in_row_);
+  FinishColumn();
+  auto const inserted = qualifier_indexes_.emplace(
+      qualifier.id(),
+      static_cast<std::uint32_t>(segment_->qualifiers_.size()));
+  if (inserted.second) segment_->qualifiers_.push_back(qualifier);
+  column_qualifier_ = inserted.first->second;
+  in_column_ = true;
+}
+
+void FrozenSegment::Builder::AddCell(std::chrono::milliseconds timestamp,
+                                     absl::string_view value) {
+  assert(in_column_);
+  if (column_cell_count_ == 0) {
+    PutVarint(column_cells_, ZigZagEncode(timestamp.count()));
+  } else {
+    assert(timestamp < previous_timestamp_);
+    PutVarint(column_cells_,
+              static_cast<std::uint64_t>(previous_timestamp_.count()) -
+                  static_cast<std::uint64_t>(timestamp.count()));
+  }
+  PutVarint(column_cells_, value.size());
+  column_cells_.append(value.data(), value.size());
+  previous_timestamp_ = timestamp;
+  ++column_cell_count_;
+  column_value_bytes_ += value.size();
+}
+
+std::shared_ptr<FrozenSegment const> FrozenSegment::Builder::Build() && {
+  FinishRow();
+  segment_->data_.shrink_to_fit();
+  segment_->restarts_.shrink_to_fit();
+  segment_->qualifiers_.shrink_to_fit();
+  return std::move(segment_);
+}
+
+void FrozenSegment::Builder::FinishColumn() {
+  if (!in_column_) return;
+  assert(column_cell_count_ != 0);
+  PutVarint(row_columns_, column_qualifier_);
+  PutVarint(row_columns_, column_cell_count_);
+  PutVarint(row_columns_, column_value_bytes_);
+  PutVarint(row_columns_, column_cells_.size());
+  row_columns_ += column_cells_;
+  ++row_column_count_;
+  column_cells_.clear();
+  column_cell_count_ = 0;
+  column_value_bytes_ = 0;
+  in_column_ = false;
+}
+
+void FrozenSegment::Builder::FinishRow() {
+  FinishColumn();
+  if (!in_row_) return;
+  assert(row_column_count_ != 0);
+  auto& data = segment_->data_;
+  std::size_t shared = 0;
+  if (segment_->rows_ % kRestartInterval == 0) {
+    segment_->restarts_.push_back(data.size());
+  } else {
+    auto const& previous = segment_->last_key_;
+    auto const limit = std::min(previous.size(), row_key_.size());
+    while (shared != limit && previous[shared] == row_key_[shared]) ++shared;
+  }
+  PutVarint(data, shared);
+  PutVarint(data, row_key_.size() - shared);
+  data.append(row_key_, shared, std::string::npos);
+  std::string column_count;
+  PutVarint(column_count, row_column_count_);
+  PutVarint(data, column_count.size() + row_columns_.size());
+  data += column_count;
+  data += row_columns_;
+  segment_->last_key_.swap(row_key_);
+  ++segment_->rows_;
+  row_columns_.clear();
+  row_column_count_ = 0;
+  in_row_ = false;
+}
+
+FrozenSegment::RowCursor::RowCursor(FrozenSegment const& segment,
+                                    std::size_t row)
+    : segment_(&segment), row_(std::min(row, segment.rows_)) {
+  if (!Valid()) return;
+  offset_ = segment_->restarts_[row_ / kRestartInterval];
+  absl::string_view data(segment_->data_);
+  data.remove_prefix(offset_);
+  for (auto skipped = row_ % kRestartInterval; skipped != 0; --skipped) {
+    SkipRow(data, row_key_);
+  }
+  offset_ = segment_->data_.size() - data.size();
+  Decode();
+}
+
+void FrozenSegment::RowCursor::Next() {
+  ++row_;
+  Decode();
+}
+
+void FrozenSegment::RowCursor::Decode() {
+  columns_.clear();
+  if (!Valid()) return;
+  absl::string_view data(segment_->data_);
+  data.remove_prefix(offset_);
+  auto const shared = GetVarint(data);
+  auto const unshared = GetVarint(data);
+  row_key_.resize(shared);
+  row_key_.append(data.data(), unshared);
+  data.remove_prefix(unshared);
+  auto const body_size = GetVarint(data);
+  auto body = data.substr(0, body_size);
+  offset_ = segment_->data_.size() - data.size() + body_size;
+  auto const column_count = GetVarint(body);
+  columns_.reserve(column_count);
+  for (std::uint64_t i = 0; i != column_count; ++i) {
+    auto const& qualifier = segment_->qualifiers_[GetVarint(body)];
+    auto const cells = GetVarint(body);
+    auto const value_bytes = GetVarint(body);
+    auto const size = GetVarint(body);
+    columns_.push_back(
+        Column{qualifier, cells, value_bytes, body.substr(0, size)});
+    body.remove_prefix(size);
+  }
+}
+
+FrozenSegment::CellReader::CellReader(Column const& column)
+    : data_(column.data) {
+  Next();
+}
+
+void FrozenSegment::CellReader::Next() {
+  if (data_.empty()) {
+    valid_ = false;
+    return;
+  }
+  auto const timestamp = GetVarint(data_);
+  if (first_) {
+    timestamp_ = std::chrono::milliseconds(ZigZagDecode(timestamp));
+    first_ = false;
+  } else {
+    timestamp_ = std::chrono::milliseconds(static_cast<std::int64_t>(
+        static_cast<std::uint64_t>(timestamp_.count()) - timestamp));
+  }
+  auto const size = GetVarint(data_);
+  value_ = data_.substr(0, size);
+  data_.remove_prefix(size);
+  valid_ = true;
+}
+
+class FrozenSegmentStream::FilterApply {
+ public:
+  explicit FilterApply(FrozenSegmentStream& parent) : parent_(parent) {}
+
+  bool operator()(ColumnRange const& column_range) {
+    if (column_range.column_family == parent_.column_family_name_) {
+      parent_.column_ranges_.Intersect(column_range.range);
+    }
+    return true;
+  }
+
+  bool operator()(TimestampRange const& timestamp_range) {
+    parent_.timestamp_ranges_.Intersect(timestamp_range.range);
+    return true;
+  }
+
+  bool operator()(RowKeyRegex const& row_key_regex) {
+    parent_.row_regexes_.emplace_back(row_key_regex.regex);
+    return true;
+  }
+
+  bool operator()(FamilyNameRegex const&) { return false; }
+
+  bool operator()(ColumnRegex const& column_regex) {
+    parent_.column_regexes_.emplace_back(column_regex.regex);
+    parent_.column_regex_memo_ =
+        std::make_shared<QualifierRegexMemo>(parent_.column_regexes_);
+    return true;
+  }
+
+ private:
+  FrozenSegmentStream& parent_;
+};
+
+FrozenSegmentStream::FrozenSegmentStream(
+    std::shared_ptr<FrozenSegment const> segment,
+    std::shared_ptr<std::vector<bool> const> removed,
+    std::string column_family_name,
+    std::shared_ptr<StringRangeSet const> row_set, GcReadMask gc_mask)
+    : segment_(std::move(segment)),
+      removed_(std::move(removed)),
+      column_family_name_(std::move(column_family_name)),
+      row_ranges_(std::move(row_set)),
+      column_ranges_(StringRangeSet::All()),
+      timestamp_ranges_(TimestampRangeSet::All()),
+      gc_mask_(std::move(gc_mask)) {}
+
+bool FrozenSegmentStream::ApplyFilter(InternalFilter const& internal_filter) {
+  assert(!initialized_);
+  return absl::visit(FilterApply(*this), internal_filter);
+}
+
+bool FrozenSegmentStream::HasValue() const {
+  InitializeIfNeeded();
+  return cursor_->Valid();
+}
+
+CellView const& FrozenSegmentStream::Value() const {
+  InitializeIfNeeded();
+  if (!cur_value_) {
+    cur_value_.emplace(cursor_->row_key(), column_family_name_,
+                       cursor_->columns()[column_].qualifier.name(),
+                       cell_->timestamp(), cell_->value());
+  }
+  return *cur_value_;
+}
+
+bool FrozenSegmentStream::Next(NextMode mode) {
+  InitializeIfNeeded();
+  cur_value_.reset();
+  assert(cursor_->Valid());
+
+  if (mode == NextMode::kCell) {
+    cell_->Next();
+    if (SkipToMatchingCell()) return true;
+  }
+  if (mode == NextMode::kCell || mode == NextMode::kColumn) {
+    ++column_;
+    if (SkipToMatchingColumn()) return true;
+  }
+  cursor_->Next();
+  SkipToMatchingRow();
+  return true;
+}
+
+void FrozenSegmentStream::InitializeIfNeeded() const {
+  if (initialized_) return;
+  initialized_ = true;
+  range_it_ = row_ranges_->disjoint_ranges().begin();
+  SeekToRange();
+  SkipToMatchingRow();
+}
+
+void FrozenSegmentStream::SeekToRange() const {
+  if (range_it_ == row_ranges_->disjoint_ranges().end()) {
+    cursor_.emplace(*segment_, segment_->size());
+    return;
+  }
+  auto const& start = range_it_->start_finite();
+  cursor_.emplace(*segment_, segment_->LowerBound(start));
+  if (range_it_->start_open() && cursor_->Valid() &&
+      cursor_->row_key() == start) {
+    cursor_->Next();
+  }
+}
+
+void FrozenSegmentStream::SkipToMatchingRow() const {
+  auto const ranges_end = row_ranges_->disjoint_ranges().end();
+  while (cursor_->Valid()) {
+    auto const& row_key = cursor_->row_key();
+    if (range_it_->IsAboveEnd(row_key)) {
+      ++range_it_;
+      if (range_it_ == ranges_end || range_it_->IsBelowStart(row_key)) {
+        SeekToRange();
+      }
+      continue;
+    }
+    auto const matches =
+        !(*removed_)[cursor_->row()] &&
+        std::all_of(row_regexes_.begin(), row_regexes_.end(),
+                    [&](auto const& regex) {
+                      return regex->PartialMatch(row_key);
+                    });
+    if (matches) {
+      column_ = 0;
+      if (SkipToMatchingColumn()) return;
+    }
+    cursor_->Next();
+  }
+}
+
+bool FrozenSegmentStream::SkipToMatchingColumn() const {
+  auto const& columns = cursor_->columns();
+  for (; column_ != columns.size(); ++column_) {
+    auto const& column = columns[column_];
+    if (!ColumnMatches(column.qualifier)) continue;
+    cell_.emplace(column);
+    if (!gc_mask_.empty()) {
+      auto const& limits = gc_mask_.version_limits();
+      gc_limit_timestamps_.assign(limits.size(), absl::nullopt);
+      FrozenSegment::CellReader cell(column);
+      std::size_t rank = 0;
+      for (std::size_t i = 0; i != limits.size() && limits[i] < column.cells;
+           ++i) {
+        for (; rank != limits[i]; ++rank) cell.Next();
+        gc_limit_timestamps_[i] = cell.timestamp();
+      }
+    }
+    if (SkipToMatchingCell()) return true;
+  }
+  return false;
+}
+
+bool FrozenSegmentStream::SkipToMatchingCell() const {
+  auto const& ranges = timestamp_ranges_.disjoint_ranges();
+  for (auto& cell = *cell_; cell.Valid(); cell.Next()) {
+    auto const timestamp = cell.timestamp();
+    auto const in_range =
+        std::any_of(ranges.begin(), ranges.end(), [&](auto const& range) {
+          return range.IsWithin(timestamp);
+        });
+    if (!in_range) continue;
+    if (!gc_mask_.empty() && gc_mask_.Hides(timestamp, gc_limit_timestamps_)) {
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool FrozenSegmentStream::ColumnMatches(Qualifier qualifier) const {
+  auto const& ranges = column_ranges_.disjoint_ranges();
+  auto const in_range =
+      std::any_of(ranges.begin(), ranges.end(), [&](auto const& range) {
+        return range.IsWithin(qualifier.name());
+      });
+  return in_range &&
+         (!column_regex_memo_ || column_regex_memo_->PartialMatch(qualifier));
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
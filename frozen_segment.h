@@ -0,0 +1,273 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_FROZEN_SEGMENT_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_FROZEN_SEGMENT_H
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
+#include "cell_view.h"
+#include "filter.h"
+#include "gc_read_mask.h"
+#include "qualifier_dictionary.h"
+#include "range_set.h"
+#include "regex_matcher.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * An immutable run of rows of an in-memory column family, compactly encoded.
+ *
+ * `ColumnFamily::Freeze()` moves rows which are no longer being written to
+ * segments, where they take a fraction of the memory of the mutable rows.
+ * The rows are stored in a single buffer, in the order of their keys:
+ * - the row keys are front-coded, i.e. a key only stores the bytes which
+ *   follow the prefix it shares with the previous key, except for every
+ *   `kRestartInterval`-th key, which is stored whole so that lookups can
+ *   binary search them,
+ * - the column qualifiers are indexes into the segment's table of
+ *   `Qualifier`s, and are followed by the number of cells of the column and
+ *   the total size of their values,
+ * - the timestamps of a column's cells, newest first, are stored as the
+ *   difference from the previous one,
+ * - the values follow their lengths,
+ * and all the numbers are varints.
+ *
+ * Objects of this class are never modified once built, so they can be read
+ * concurrently.
+ */
+class FrozenSegment {
+ public:
+  static std::size_t constexpr kRestartInterval = 16;
+
+  class Builder;
+  class RowCursor;
+  class CellReader;
+
+  /// A column of a row, see `RowCursor::columns()`.
+  struct Column {
+    Qualifier qualifier;
+    std::size_t cells;
+    // The total size of the cells' values.
+    std::size_t value_bytes;
+    // The encoded cells, see `CellReader`.
+    absl::string_view data;
+  };
+
+  FrozenSegment(FrozenSegment const&) = delete;
+  FrozenSegment& operator=(FrozenSegment const&) = delete;
+
+  /// The number of rows.
+  std::size_t size() const { return rows_; }
+  /// The memory taken by the segment, other than by the object itself.
+  std::size_t memory_bytes() const;
+
+  /// The position of the first row whose key is not less than `row_key`.
+  std::size_t LowerBound(absl::string_view row_key) const;
+  /// The position of the row `row_key`, if the segment has it.
+  absl::optional<std::size_t> Find(absl::string_view row_key) const;
+
+ private:
+  explicit FrozenSegment(std::shared_ptr<QualifierDictionary const> dictionary)
+      : dictionary_(std::move(dictionary)) {}
+
+  // The whole key of the row at `restarts_[restart]`.
+  absl::string_view RestartKey(std::size_t restart) const;
+
+  std::string data_;
+  // The offsets in `data_` of every `kRestartInterval`-th row.
+  std::vector<std::size_t> restarts_;
+  std::size_t rows_ = 0;
+  std::string last_key_;
+  std::vector<Qualifier> qualifiers_;
+  // Keeps the `qualifiers_` alive.
+  std::shared_ptr<QualifierDictionary const> dictionary_;
+};
+
+/**
+ * Encodes a `FrozenSegment`.
+ *
+ * The rows have to be added in the order of their keys, the columns of a
+ * row in the order of their qualifiers, and the cells of a column newest
+ * first, like `ColumnFamily` keeps them. Empty rows and columns are not
+ * allowed.
+ */
+class FrozenSegment::Builder {
+ public:
+  /// The qualifiers of the columns have to be interned in `dictionary`.
+  explicit Builder(std::shared_ptr<QualifierDictionary const> dictionary);
+
+  void StartRow(absl::string_view row_key);
+  void StartColumn(Qualifier qualifier);
+  void AddCell(std::chrono::milliseconds timestamp, absl::string_view value);
+
+  std::shared_ptr<FrozenSegment const> Build() &&;
+
+ private:
+  void FinishColumn();
+  void FinishRow();
+
+  std::shared_ptr<FrozenSegment> segment_;
+  // The indexes into `segment_->qualifiers_`, by `Qualifier::id()`.
+  absl::flat_hash_map<std::uint32_t, std::uint32_t> qualifier_indexes_;
+  std::string row_key_;
+  bool in_row_ = false;
+  std::string row_columns_;
+  std::size_t row_column_count_ = 0;
+  bool in_column_ = false;
+  std::string column_cells_;
+  std::size_t column_cell_count_ = 0;
+  std::size_t column_value_bytes_ = 0;
+  std::uint32_t column_qualifier_ = 0;
+  std::chrono::milliseconds previous_timestamp_{0};
+};
+
+/**
+ * Reads the rows of a `FrozenSegment`, in order.
+ *
+ * The segment has to outlive the cursor.
+ */
+class FrozenSegment::RowCursor {
+ public:
+  /// A cursor at the row at position `row`, or at the end.
+  RowCursor(FrozenSegment const& segment, std::size_t row);
+
+  bool Valid() const { return row_ < segment_->rows_; }
+  /// The position of the current row.
+  std::size_t row() const { return row_; }
+  std::string const& row_key() const { return row_key_; }
+  /// The current row's columns, in the order of their qualifiers.
+  std::vector<Column> const& columns() const { return columns_; }
+
+  void Next();
+
+ private:
+  // Decode the row at `offset_` and move `offset_` past it.
+  void Decode();
+
+  FrozenSegment const* segment_;
+  std::size_t row_;
+  // The offset of the next row in the segment's data.
+  std::size_t offset_ = 0;
+  std::string row_key_;
+  std::vector<Column> columns_;
+};
+
+/// Reads the cells of a `FrozenSegment::Column`, newest first.
+class FrozenSegment::CellReader {
+ public:
+  explicit CellReader(Column const& column);
+
+  bool Valid() const { return valid_; }
+  std::chrono::milliseconds timestamp() const { return timestamp_; }
+  absl::string_view value() const { return value_; }
+
+  void Next();
+
+ private:
+  absl::string_view data_;
+  bool valid_ = false;
+  bool first_ = true;
+  std::chrono::milliseconds timestamp_{0};
+  absl::string_view value_;
+};
+
+/**
+ * A stream of the cells in a `FrozenSegment`.
+ *
+ * It filters the cells like `FilteredColumnFamilyStream` does for the
+ * mutable rows of a column family, and skips the segment's rows which were
+ * removed from it.
+ *
+ * Objects of this class are not thread safe.
+ */
+class FrozenSegmentStream : public AbstractCellStreamImpl {
+ public:
+  /**
+   * Construct a new object.
+   *
+   * @param segment the segment to read.
+   * @param removed for each row of `segment`, whether it is skipped.
+   * @param column_family_name the name of the segment's column family.
+   * @param row_set the row keys to return cells of.
+   * @param gc_mask the cells which are never returned.
+   */
+  FrozenSegmentStream(std::shared_ptr<FrozenSegment const> segment,
+                      std::shared_ptr<std::vector<bool> const> removed,
+                      std::string column_family_name,
+                      std::shared_ptr<StringRangeSet const> row_set,
+                      GcReadMask gc_mask);
+
+  bool ApplyFilter(InternalFilter const& internal_filter) override;
+  bool HasValue() const override;
+  CellView const& Value() const override;
+  bool Next(NextMode mode) override;
+  std::string const& column_family_name() const { return column_family_name_; }
+
+ private:
+  class FilterApply;
+
+  void InitializeIfNeeded() const;
+  // Position `cursor_` at the first row in the current or a later range of
+  // `row_ranges_`.
+  void SeekToRange() const;
+  // Advance to the first cell at or after the current row, column and cell
+  // which passes the filters. They return whether there is one in the
+  // current row and column respectively.
+  void SkipToMatchingRow() const;
+  bool SkipToMatchingColumn() const;
+  bool SkipToMatchingCell() const;
+  bool ColumnMatches(Qualifier qualifier) const;
+
+  std::shared_ptr<FrozenSegment const> segment_;
+  std::shared_ptr<std::vector<bool> const> removed_;
+  std::string column_family_name_;
+  std::shared_ptr<StringRangeSet const> row_ranges_;
+  std::vector<std::shared_ptr<RegexMatcher const>> row_regexes_;
+  StringRangeSet column_ranges_;
+  std::vector<std::shared_ptr<RegexMatcher const>> column_regexes_;
+  std::shared_ptr<QualifierRegexMemo const> column_regex_memo_;
+  TimestampRangeSet timestamp_ranges_;
+  GcReadMask gc_mask_;
+
+  mutable bool initialized_ = false;
+  mutable absl::optional<FrozenSegment::RowCursor> cursor_;
+  mutable std::set<StringRangeSet::Range,
+                   StringRangeSet::Range::StartLess>::const_iterator range_it_;
+  mutable std::size_t column_ = 0;
+  mutable absl::optional<FrozenSegment::CellReader> cell_;
+  // See `FilteredColumnFamilyStream::gc_limit_timestamps_`.
+  mutable std::vector<absl::optional<std::chrono::milliseconds>>
+      gc_limit_timestamps_;
+  mutable absl::optional<CellView> cur_value_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_FROZEN_SEGMENT_H
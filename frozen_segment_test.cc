@@ -0,0 +1,243 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "frozen_segment.h"
+#include "google/cloud/testing_util/chrono_literals.h"
+#include "filter.h"
+#include "gc_read_mask.h"
+#include "qualifier_dictionary.h"
+#include "range_set.h"
+#include "re2/re2.h"
+#include "regex_matcher.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using testing_util::chrono_literals::operator""_ms;
+
+// Rows "row00" to "row39", each with a column "col<row % 3>" holding cells
+// at 30ms, 20ms and 10ms, and every fifth row also with a column "x" holding
+// a cell at 5ms.
+std::shared_ptr<FrozenSegment const> MakeSegment(
+    std::shared_ptr<QualifierDictionary> const& dictionary) {
+  FrozenSegment::Builder builder(dictionary);
+  for (int i = 0; i != 40; ++i) {
+    auto const suffix = std::to_string(100 + i).substr(1);
+    builder.StartRow("row" + suffix);
+    builder.StartColumn(dictionary->Intern("col" + std::to_string(i % 3)));
+    for (auto timestamp : {30_ms, 20_ms, 10_ms}) {
+      builder.AddCell(timestamp, "v" + suffix + "@" +
+                                     std::to_string(timestamp.count()));
+    }
+    if (i % 5 == 0) {
+      builder.StartColumn(dictionary->Intern("x"));
+      builder.AddCell(5_ms, "x" + suffix);
+    }
+  }
+  return std::move(builder).Build();
+}
+
+std::string DumpStream(AbstractCellStreamImpl& stream,
+                       NextMode next_mode = NextMode::kCell) {
+  std::stringstream ss;
+  for (; stream.HasValue(); stream.Next(next_mode)) {
+    auto const& cell = stream.Value();
+    ss << cell.row_key() << " " << cell.column_family() << ":"
+       << cell.column_qualifier() << " @" << cell.timestamp().count()
+       << "ms: " << cell.value() << std::endl;
+  }
+  return ss.str();
+}
+
+std::shared_ptr<StringRangeSet const> AllRows() {
+  return std::make_shared<StringRangeSet>(StringRangeSet::All());
+}
+
+TEST(FrozenSegment, RoundTrip) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  FrozenSegment::Builder builder(dictionary);
+  builder.StartRow("a");
+  builder.StartColumn(dictionary->Intern("c1"));
+  builder.AddCell(std::chrono::milliseconds(1LL << 50), "new");
+  builder.AddCell(0_ms, std::string(1000, 'x'));
+  builder.AddCell(-7_ms, "");
+  builder.StartColumn(dictionary->Intern("c2"));
+  builder.AddCell(-3_ms, "neg");
+  builder.StartRow("ab");
+  builder.StartColumn(dictionary->Intern("c2"));
+  builder.AddCell(1_ms, "one");
+  auto segment = std::move(builder).Build();
+  ASSERT_EQ(2U, segment->size());
+  EXPECT_GT(segment->memory_bytes(), 1000U);
+
+  FrozenSegment::RowCursor cursor(*segment, 0);
+  ASSERT_TRUE(cursor.Valid());
+  EXPECT_EQ(0U, cursor.row());
+  EXPECT_EQ("a", cursor.row_key());
+  ASSERT_EQ(2U, cursor.columns().size());
+  auto const& c1 = cursor.columns()[0];
+  EXPECT_EQ("c1", c1.qualifier);
+  EXPECT_EQ(3U, c1.cells);
+  FrozenSegment::CellReader cell(c1);
+  ASSERT_TRUE(cell.Valid());
+  EXPECT_EQ(std::chrono::milliseconds(1LL << 50), cell.timestamp());
+  EXPECT_EQ("new", cell.value());
+  cell.Next();
+  ASSERT_TRUE(cell.Valid());
+  EXPECT_EQ(0_ms, cell.timestamp());
+  EXPECT_EQ(std::string(1000, 'x'), cell.value());
+  cell.Next();
+  ASSERT_TRUE(cell.Valid());
+  EXPECT_EQ(-7_ms, cell.timestamp());
+  EXPECT_EQ("", cell.value());
+  cell.Next();
+  EXPECT_FALSE(cell.Valid());
+  EXPECT_EQ("c2", cursor.columns()[1].qualifier);
+  EXPECT_EQ(-3_ms, FrozenSegment::CellReader(cursor.columns()[1]).timestamp());
+
+  cursor.Next();
+  ASSERT_TRUE(cursor.Valid());
+  EXPECT_EQ("ab", cursor.row_key());
+  ASSERT_EQ(1U, cursor.columns().size());
+  EXPECT_EQ("one", FrozenSegment::CellReader(cursor.columns()[0]).value());
+  cursor.Next();
+  EXPECT_FALSE(cursor.Valid());
+}
+
+TEST(FrozenSegment, SeeksAcrossRestarts) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  auto segment = MakeSegment(dictionary);
+  ASSERT_EQ(40U, segment->size());
+  for (std::size_t i = 0; i != 40; ++i) {
+    auto const row_key = "row" + std::to_string(100 + i).substr(1);
+    EXPECT_EQ(i, segment->LowerBound(row_key));
+    EXPECT_EQ(i, segment->Find(row_key));
+    EXPECT_EQ(i + 1, segment->LowerBound(row_key + "0"));
+    EXPECT_FALSE(segment->Find(row_key + "0").has_value());
+
+    FrozenSegment::RowCursor cursor(*segment, i);
+    ASSERT_TRUE(cursor.Valid());
+    EXPECT_EQ(row_key, cursor.row_key());
+    EXPECT_EQ(i % 5 == 0 ? 2U : 1U, cursor.columns().size());
+    EXPECT_EQ("col" + std::to_string(i % 3),
+              cursor.columns()[0].qualifier.name());
+  }
+  EXPECT_EQ(0U, segment->LowerBound(""));
+  EXPECT_EQ(40U, segment->LowerBound("s"));
+  EXPECT_FALSE(segment->Find("").has_value());
+  EXPECT_FALSE(FrozenSegment::RowCursor(*segment, 40).Valid());
+}
+
+TEST(FrozenSegmentStream, Unfiltered) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  auto segment = MakeSegment(dictionary);
+  auto removed = std::make_shared<std::vector<bool>>(segment->size());
+  auto rows = std::make_shared<StringRangeSet>(StringRangeSet::Empty());
+  rows->Sum(StringRangeSet::Range("row04", false, "row06", true));
+  rows->Sum(StringRangeSet::Range("row30", true, "row31", false));
+  FrozenSegmentStream stream(segment, removed, "cf1", rows, GcReadMask());
+  EXPECT_EQ(R"""(
+row04 cf1:col1 @30ms: v04@30
+row04 cf1:col1 @20ms: v04@20
+row04 cf1:col1 @10ms: v04@10
+row05 cf1:col2 @30ms: v05@30
+row05 cf1:col2 @20ms: v05@20
+row05 cf1:col2 @10ms: v05@10
+row05 cf1:x @5ms: x05
+row31 cf1:col1 @30ms: v31@30
+row31 cf1:col1 @20ms: v31@20
+row31 cf1:col1 @10ms: v31@10
+)""",
+            "\n" + DumpStream(stream));
+}
+
+TEST(FrozenSegmentStream, NextColumnAndRow) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  auto segment = MakeSegment(dictionary);
+  auto removed = std::make_shared<std::vector<bool>>(segment->size());
+  auto rows = std::make_shared<StringRangeSet>(StringRangeSet::Empty());
+  rows->Sum(StringRangeSet::Range("row09", false, "row11", false));
+  FrozenSegmentStream by_column(segment, removed, "cf1", rows, GcReadMask());
+  EXPECT_EQ(R"""(
+row09 cf1:col0 @30ms: v09@30
+row10 cf1:col1 @30ms: v10@30
+row10 cf1:x @5ms: x10
+row11 cf1:col2 @30ms: v11@30
+)""",
+            "\n" + DumpStream(by_column, NextMode::kColumn));
+  FrozenSegmentStream by_row(segment, removed, "cf1", rows, GcReadMask());
+  EXPECT_EQ(R"""(
+row09 cf1:col0 @30ms: v09@30
+row10 cf1:col1 @30ms: v10@30
+row11 cf1:col2 @30ms: v11@30
+)""",
+            "\n" + DumpStream(by_row, NextMode::kRow));
+}
+
+TEST(FrozenSegmentStream, Filtered) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  auto segment = MakeSegment(dictionary);
+  auto removed = std::make_shared<std::vector<bool>>(segment->size());
+  (*removed)[20] = true;
+  FrozenSegmentStream stream(segment, removed, "cf1", AllRows(), GcReadMask());
+  EXPECT_FALSE(stream.ApplyFilter(FamilyNameRegex{
+      std::make_shared<RegexMatcher const>(std::make_shared<re2::RE2>("."))}));
+  stream.ApplyFilter(RowKeyRegex{
+      std::make_shared<RegexMatcher const>(std::make_shared<re2::RE2>("0$"))});
+  stream.ApplyFilter(ColumnRegex{
+      std::make_shared<RegexMatcher const>(std::make_shared<re2::RE2>("^c"))});
+  stream.ApplyFilter(
+      ColumnRange{"cf1", StringRangeSet::Range("col0", true, "col9", false)});
+  stream.ApplyFilter(ColumnRange{
+      "other", StringRangeSet::Range("col0", false, "col0", false)});
+  stream.ApplyFilter(TimestampRange{TimestampRangeSet::Range(20_ms, 30_ms)});
+  EXPECT_EQ(R"""(
+row10 cf1:col1 @20ms: v10@20
+)""",
+            "\n" + DumpStream(stream));
+}
+
+TEST(FrozenSegmentStream, HidesCollectedCells) {
+  auto dictionary = std::make_shared<QualifierDictionary>();
+  auto segment = MakeSegment(dictionary);
+  auto removed = std::make_shared<std::vector<bool>>(segment->size());
+  google::bigtable::admin::v2::GcRule rule;
+  rule.set_max_num_versions(2);
+  auto rows = std::make_shared<StringRangeSet>(StringRangeSet::Empty());
+  rows->Sum(StringRangeSet::Range("row00", false, "row00", false));
+  FrozenSegmentStream stream(segment, removed, "cf1", rows,
+                             GcReadMask(rule, 1000_ms));
+  EXPECT_EQ(R"""(
+row00 cf1:col0 @30ms: v00@30
+row00 cf1:col0 @20ms: v00@20
+row00 cf1:x @5ms: x00
+)""",
+            "\n" + DumpStream(stream));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,163 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_expiry_index.h"
+#include <google/protobuf/util/time_util.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <tuple>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// A superset of the cells eligible under a GC rule: the cells of columns
+// with more than `max_versions` versions, and the cells older than
+// `max_age`.
+struct Thresholds {
+  std::size_t max_versions = std::numeric_limits<std::size_t>::max();
+  absl::optional<std::chrono::milliseconds> max_age;
+};
+
+// Whether `a` makes fewer cells due than `b`, as far as it can be told.
+bool Narrower(Thresholds const& a, Thresholds const& b) {
+  auto const age = [](Thresholds const& t) {
+    return t.max_age.value_or(std::chrono::milliseconds::max());
+  };
+  return std::make_tuple(a.max_versions, age(a)) >
+         std::make_tuple(b.max_versions, age(b));
+}
+
+// See comment next to `static_assert(kMaxGCRuleSize ==` for the proof of
+// safety of this function despite the recursive calls.
+// NOLINTNEXTLINE(misc-no-recursion)
+Thresholds ComputeThresholds(google::bigtable::admin::v2::GcRule const& rule) {
+  Thresholds res;
+  switch (rule.rule_case()) {
+    case google::bigtable::admin::v2::GcRule::kMaxAge:
+      res.max_age = std::chrono::milliseconds(
+          protobuf::util::TimeUtil::DurationToMilliseconds(rule.max_age()));
+      break;
+    case google::bigtable::admin::v2::GcRule::kMaxNumVersions:
+      res.max_versions = static_cast<std::size_t>(rule.max_num_versions());
+      break;
+    case google::bigtable::admin::v2::GcRule::kUnion:
+      for (auto const& r : rule.union_().rules()) {
+        auto sub = ComputeThresholds(r);
+        res.max_versions = std::min(res.max_versions, sub.max_versions);
+        if (sub.max_age && (!res.max_age || *sub.max_age < *res.max_age)) {
+          res.max_age = sub.max_age;
+        }
+      }
+      break;
+    case google::bigtable::admin::v2::GcRule::kIntersection: {
+      auto const& rules = rule.intersection().rules();
+      if (rules.empty()) break;
+      res = ComputeThresholds(rules[0]);
+      for (auto const& r : rules) {
+        auto sub = ComputeThresholds(r);
+        if (Narrower(sub, res)) res = sub;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return res;
+}
+
+}  // namespace
+
+GcExpiryIndex::GcExpiryIndex(google::bigtable::admin::v2::GcRule const& rule) {
+  auto thresholds = ComputeThresholds(rule);
+  max_versions_ = thresholds.max_versions;
+  max_age_ = thresholds.max_age;
+}
+
+void GcExpiryIndex::AddCell(std::string const& row_key,
+                            std::chrono::milliseconds timestamp,
+                            std::size_t versions) {
+  if (versions > max_versions_) due_.insert(row_key);
+  if (max_age_) Schedule(row_key, timestamp);
+}
+
+void GcExpiryIndex::RowCollected(
+    std::string const& row_key, std::size_t max_versions,
+    absl::optional<std::chrono::milliseconds> oldest_timestamp) {
+  // GC rules like an intersection of `max_num_versions` may leave more
+  // versions than tracked; keep such rows due rather than lose track of them.
+  if (max_versions <= max_versions_) due_.erase(row_key);
+  if (max_age_ && oldest_timestamp) Schedule(row_key, *oldest_timestamp);
+}
+
+void GcExpiryIndex::Advance(std::chrono::milliseconds now) {
+  auto const end = wheel_.upper_bound(now);
+  for (auto it = wheel_.begin(); it != end; ++it) {
+    for (auto const& row_key : it->second) {
+      due_.insert(row_key);
+      scheduled_.erase(row_key);
+    }
+  }
+  wheel_.erase(wheel_.begin(), end);
+}
+
+absl::optional<std::string> GcExpiryIndex::FirstDueRow(
+    std::string const& start_row) const {
+  auto it = due_.lower_bound(start_row);
+  if (it == due_.end()) return absl::nullopt;
+  return *it;
+}
+
+absl::optional<std::string> GcExpiryIndex::NextDueRow(
+    std::string const& row_key) const {
+  auto it = due_.upper_bound(row_key);
+  if (it == due_.end()) return absl::nullopt;
+  return *it;
+}
+
+void GcExpiryIndex::Clear() {
+  due_.clear();
+  scheduled_.clear();
+  wheel_.clear();
+}
+
+void GcExpiryIndex::Schedule(std::string const& row_key,
+                             std::chrono::milliseconds timestamp) {
+  // A cell is eligible once it is older than `max_age_`. Round down, so that
+  // rows are due early rather than late.
+  auto const expiry = timestamp + *max_age_;
+  auto bucket = expiry - expiry % kWheelGranularity;
+  if (expiry < bucket) bucket -= kWheelGranularity;
+  auto it = scheduled_.find(row_key);
+  if (it != scheduled_.end()) {
+    if (it->second <= bucket) return;
+    auto wheel_it = wheel_.find(it->second);
+    wheel_it->second.erase(row_key);
+    if (wheel_it->second.empty()) wheel_.erase(wheel_it);
+    it->second = bucket;
+  } else {
+    scheduled_.emplace(row_key, bucket);
+  }
+  wheel_[bucket].insert(row_key);
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
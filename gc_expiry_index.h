@@ -0,0 +1,104 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_EXPIRY_INDEX_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_EXPIRY_INDEX_H
+
+#include "absl/types/optional.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * The rows of a column family which may have cells eligible for GC.
+ *
+ * The index is conservative: a row which has eligible cells is always in
+ * it, but a row in it may turn out to have none, e.g. because the cells
+ * were deleted in the meantime. It is derived from the GC rule:
+ *
+ * - Rows with a column which has more versions than the smallest
+ *   `max_num_versions` of the rule are due immediately.
+ * - Rows with cells which are older than the smallest `max_age` of the
+ *   rule are due once the cells expire. They wait in a wheel of 1 second
+ *   buckets, keyed by the expiry time of the row's oldest cell.
+ *
+ * Of the rules of an intersection, only the one which makes the fewest
+ * cells due is tracked, since a cell has to be eligible under all of them.
+ *
+ * This class is not thread safe.
+ */
+class GcExpiryIndex {
+ public:
+  /// The granularity of the expiry wheel; rows may be due this much early.
+  static std::chrono::milliseconds constexpr kWheelGranularity{1000};
+
+  /// An index which never has any rows due.
+  GcExpiryIndex() = default;
+  explicit GcExpiryIndex(google::bigtable::admin::v2::GcRule const& rule);
+
+  /// Record a cell written at `timestamp` to a column of `row_key` which now
+  /// has `versions` versions.
+  void AddCell(std::string const& row_key, std::chrono::milliseconds timestamp,
+               std::size_t versions);
+
+  /**
+   * Record that `row_key` was collected.
+   *
+   * @param max_versions the largest number of versions of its columns.
+   * @param oldest_timestamp the timestamp of its oldest cell, if any.
+   */
+  void RowCollected(std::string const& row_key, std::size_t max_versions,
+                    absl::optional<std::chrono::milliseconds> oldest_timestamp);
+
+  /// Make the rows whose oldest cell expires before `now` due.
+  void Advance(std::chrono::milliseconds now);
+
+  /// The first due row at or after `start_row`.
+  absl::optional<std::string> FirstDueRow(std::string const& start_row) const;
+  /// The first due row after `row_key`.
+  absl::optional<std::string> NextDueRow(std::string const& row_key) const;
+
+  /// Forget all rows, e.g. after the column family is cleared.
+  void Clear();
+
+  std::size_t due_rows() const { return due_.size(); }
+  std::size_t scheduled_rows() const { return scheduled_.size(); }
+
+ private:
+  void Schedule(std::string const& row_key,
+                std::chrono::milliseconds timestamp);
+
+  std::size_t max_versions_ = std::numeric_limits<std::size_t>::max();
+  absl::optional<std::chrono::milliseconds> max_age_;
+  std::set<std::string> due_;
+  // The wheel bucket of each row in the wheel.
+  std::map<std::string, std::chrono::milliseconds> scheduled_;
+  std::map<std::chrono::milliseconds, std::set<std::string>> wheel_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_EXPIRY_INDEX_H
@@ -0,0 +1,163 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_expiry_index.h"
+#include "test_util.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+
+using std::chrono::milliseconds;
+
+std::vector<std::string> DueRows(GcExpiryIndex const& index,
+                                 std::string const& start_row = "") {
+  std::vector<std::string> res;
+  for (auto row = index.FirstDueRow(start_row); row;
+       row = index.NextDueRow(*row)) {
+    res.push_back(*row);
+  }
+  return res;
+}
+
+TEST(GcExpiryIndex, NoRule) {
+  GcExpiryIndex index;
+  index.AddCell("row", milliseconds(0), 1000);
+  index.Advance(milliseconds::max());
+  EXPECT_EQ(0U, index.due_rows());
+  EXPECT_EQ(0U, index.scheduled_rows());
+}
+
+TEST(GcExpiryIndex, MaxNumVersions) {
+  GcExpiryIndex index(MaxVersions(2));
+  index.AddCell("row1", milliseconds(1), 1);
+  index.AddCell("row1", milliseconds(2), 2);
+  index.AddCell("row2", milliseconds(1), 1);
+  EXPECT_TRUE(DueRows(index).empty());
+  index.AddCell("row1", milliseconds(3), 3);
+  index.AddCell("row3", milliseconds(3), 5);
+  EXPECT_EQ((std::vector<std::string>{"row1", "row3"}), DueRows(index));
+  EXPECT_EQ((std::vector<std::string>{"row3"}), DueRows(index, "row2"));
+  EXPECT_EQ(0U, index.scheduled_rows());
+
+  index.RowCollected("row1", 2, milliseconds(2));
+  EXPECT_EQ((std::vector<std::string>{"row3"}), DueRows(index));
+}
+
+TEST(GcExpiryIndex, MaxAge) {
+  GcExpiryIndex index(MaxAge(10));
+  index.AddCell("row1", milliseconds(5000), 1);
+  index.AddCell("row1", milliseconds(100000), 2);
+  index.AddCell("row2", milliseconds(20000), 100);
+  EXPECT_EQ(2U, index.scheduled_rows());
+  EXPECT_TRUE(DueRows(index).empty());
+
+  // row1's oldest cell expires after 15000ms, row2's after 30000ms.
+  index.Advance(milliseconds(14000));
+  EXPECT_TRUE(DueRows(index).empty());
+  index.Advance(milliseconds(15001));
+  EXPECT_EQ((std::vector<std::string>{"row1"}), DueRows(index));
+
+  // Once collected, the row waits for its next oldest cell.
+  index.RowCollected("row1", 1, milliseconds(100000));
+  EXPECT_TRUE(DueRows(index).empty());
+  index.Advance(milliseconds(110001));
+  EXPECT_EQ((std::vector<std::string>{"row1", "row2"}), DueRows(index));
+  EXPECT_EQ(0U, index.scheduled_rows());
+
+  index.RowCollected("row1", 0, absl::nullopt);
+  index.RowCollected("row2", 0, absl::nullopt);
+  EXPECT_EQ(0U, index.due_rows());
+  EXPECT_EQ(0U, index.scheduled_rows());
+}
+
+TEST(GcExpiryIndex, OlderCellReschedulesRow) {
+  GcExpiryIndex index(MaxAge(1));
+  index.AddCell("row", milliseconds(50000), 1);
+  index.AddCell("row", milliseconds(10000), 2);
+  EXPECT_EQ(1U, index.scheduled_rows());
+  index.Advance(milliseconds(11001));
+  EXPECT_EQ((std::vector<std::string>{"row"}), DueRows(index));
+}
+
+TEST(GcExpiryIndex, NegativeTimestamps) {
+  GcExpiryIndex index(MaxAge(1));
+  index.AddCell("row", milliseconds(-3500), 1);
+  index.Advance(milliseconds(-2501));
+  EXPECT_EQ((std::vector<std::string>{"row"}), DueRows(index));
+}
+
+TEST(GcExpiryIndex, Union) {
+  btadmin::GcRule rule;
+  *rule.mutable_union_()->add_rules() = MaxVersions(3);
+  *rule.mutable_union_()->add_rules() = MaxAge(10);
+  *rule.mutable_union_()->add_rules() = MaxVersions(2);
+  GcExpiryIndex index(rule);
+  index.AddCell("row1", milliseconds(100000), 3);
+  EXPECT_EQ((std::vector<std::string>{"row1"}), DueRows(index));
+  EXPECT_EQ(1U, index.scheduled_rows());
+}
+
+TEST(GcExpiryIndex, Intersection) {
+  btadmin::GcRule rule;
+  *rule.mutable_intersection()->add_rules() = MaxVersions(3);
+  *rule.mutable_intersection()->add_rules() = MaxAge(10);
+  GcExpiryIndex index(rule);
+  // Cells have to expire to be eligible, however many versions there are.
+  index.AddCell("row1", milliseconds(100000), 10);
+  EXPECT_TRUE(DueRows(index).empty());
+  EXPECT_EQ(1U, index.scheduled_rows());
+
+  btadmin::GcRule versions;
+  *versions.mutable_intersection()->add_rules() = MaxVersions(2);
+  *versions.mutable_intersection()->add_rules() = MaxVersions(4);
+  GcExpiryIndex versions_index(versions);
+  versions_index.AddCell("row1", milliseconds(1), 4);
+  EXPECT_TRUE(DueRows(versions_index).empty());
+  versions_index.AddCell("row1", milliseconds(2), 5);
+  EXPECT_EQ((std::vector<std::string>{"row1"}), DueRows(versions_index));
+
+  btadmin::GcRule empty_rule;
+  empty_rule.mutable_intersection();
+  GcExpiryIndex empty(empty_rule);
+  empty.AddCell("row1", milliseconds(1), 1000);
+  empty.Advance(milliseconds::max());
+  EXPECT_TRUE(DueRows(empty).empty());
+}
+
+TEST(GcExpiryIndex, Clear) {
+  GcExpiryIndex index(MaxAge(1));
+  index.AddCell("row1", milliseconds(0), 1);
+  index.Advance(milliseconds(5000));
+  index.AddCell("row2", milliseconds(0), 1);
+  index.Clear();
+  EXPECT_EQ(0U, index.due_rows());
+  EXPECT_EQ(0U, index.scheduled_rows());
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
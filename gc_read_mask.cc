@@ -0,0 +1,159 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_read_mask.h"
+#include <google/protobuf/util/time_util.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using ::google::bigtable::admin::v2::GcRule;
+
+// See comment next to `static_assert(kMaxGCRuleSize ==` for the proof of
+// safety of this function despite the recursive calls.
+// NOLINTNEXTLINE(misc-no-recursion)
+void CollectVersionLimits(GcRule const& rule, std::vector<std::size_t>& res) {
+  if (rule.has_max_num_versions()) {
+    res.push_back(static_cast<std::size_t>(rule.max_num_versions()));
+  }
+  for (auto const& r : rule.union_().rules()) CollectVersionLimits(r, res);
+  for (auto const& r : rule.intersection().rules()) {
+    CollectVersionLimits(r, res);
+  }
+}
+
+}  // namespace
+
+GcReadMask::GcReadMask(GcRule const& rule, std::chrono::milliseconds now) {
+  // Like `ColumnRow::GCRuleEraseVerdict()`, empty unions and intersections
+  // collect nothing.
+  if (rule.rule_case() == GcRule::RULE_NOT_SET ||
+      (rule.has_union_() && rule.union_().rules().empty()) ||
+      (rule.has_intersection() && rule.intersection().rules().empty())) {
+    return;
+  }
+  CollectVersionLimits(rule, version_limits_);
+  std::sort(version_limits_.begin(), version_limits_.end());
+  version_limits_.erase(
+      std::unique(version_limits_.begin(), version_limits_.end()),
+      version_limits_.end());
+  root_ = Compile(rule, now);
+}
+
+bool GcReadMask::Hides(
+    std::chrono::milliseconds timestamp,
+    std::vector<absl::optional<std::chrono::milliseconds>> const&
+        limit_timestamps) const {
+  return root_ && Hides(*root_, timestamp, &limit_timestamps);
+}
+
+std::vector<absl::optional<std::chrono::milliseconds>>
+GcReadMask::FindLimitTimestamps(
+    std::vector<std::chrono::milliseconds> timestamps) const {
+  std::sort(timestamps.begin(), timestamps.end(), std::greater<>());
+  std::vector<absl::optional<std::chrono::milliseconds>> res;
+  res.reserve(version_limits_.size());
+  for (auto const limit : version_limits_) {
+    if (limit < timestamps.size()) {
+      res.emplace_back(timestamps[limit]);
+    } else {
+      res.emplace_back(absl::nullopt);
+    }
+  }
+  return res;
+}
+
+bool GcReadMask::Hides(std::chrono::milliseconds timestamp) const {
+  return root_ && Hides(*root_, timestamp, nullptr);
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+GcReadMask::Node GcReadMask::Compile(GcRule const& rule,
+                                     std::chrono::milliseconds now) {
+  Node node;
+  node.rule_case = rule.rule_case();
+  switch (rule.rule_case()) {
+    case GcRule::kMaxAge:
+      node.cutoff =
+          now - std::chrono::milliseconds(
+                    protobuf::util::TimeUtil::DurationToMilliseconds(
+                        rule.max_age()));
+      break;
+    case GcRule::kMaxNumVersions:
+      node.limit_index = static_cast<std::size_t>(
+          std::lower_bound(
+              version_limits_.begin(), version_limits_.end(),
+              static_cast<std::size_t>(rule.max_num_versions())) -
+          version_limits_.begin());
+      break;
+    case GcRule::kUnion:
+      for (auto const& r : rule.union_().rules()) {
+        node.children.push_back(Compile(r, now));
+      }
+      break;
+    case GcRule::kIntersection:
+      for (auto const& r : rule.intersection().rules()) {
+        node.children.push_back(Compile(r, now));
+      }
+      break;
+    default:
+      break;
+  }
+  return node;
+}
+
+// NOLINTNEXTLINE(misc-no-recursion)
+bool GcReadMask::Hides(
+    Node const& node, std::chrono::milliseconds timestamp,
+    std::vector<absl::optional<std::chrono::milliseconds>> const*
+        limit_timestamps) const {
+  switch (node.rule_case) {
+    case GcRule::kMaxAge:
+      return timestamp < node.cutoff;
+    case GcRule::kMaxNumVersions: {
+      // The cell's rank is at least the limit iff it is not newer than the
+      // cell with that rank. Without the ranks, assume the newest one.
+      if (limit_timestamps == nullptr) return false;
+      auto const& limit = (*limit_timestamps)[node.limit_index];
+      return limit.has_value() && timestamp <= *limit;
+    }
+    case GcRule::kUnion:
+      return !node.children.empty() &&
+             std::any_of(node.children.begin(), node.children.end(),
+                         [&](Node const& child) {
+                           return Hides(child, timestamp, limit_timestamps);
+                         });
+    case GcRule::kIntersection:
+      return !node.children.empty() &&
+             std::all_of(node.children.begin(), node.children.end(),
+                         [&](Node const& child) {
+                           return Hides(child, timestamp, limit_timestamps);
+                         });
+    default:
+      return false;
+  }
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,107 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_READ_MASK_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_READ_MASK_H
+
+#include "absl/types/optional.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * The cells which a column family's GC rule would collect at a given time.
+ *
+ * The streams hide these cells, so that they are never returned between GC
+ * passes, and GC can run lazily. Whether a cell is hidden depends on its
+ * timestamp and on its version rank in its column (0 being the newest).
+ * Since the ranks are only compared against the rule's `max_num_versions`,
+ * the streams provide them as the timestamps of the cells at these ranks,
+ * see `version_limits()`.
+ */
+class GcReadMask {
+ public:
+  /// A mask which hides nothing.
+  GcReadMask() = default;
+  /// The cells `rule` would collect at `now`.
+  GcReadMask(google::bigtable::admin::v2::GcRule const& rule,
+             std::chrono::milliseconds now);
+
+  /// Whether the mask hides nothing.
+  bool empty() const { return !root_.has_value(); }
+
+  /// The distinct `max_num_versions` of the rule, in ascending order.
+  std::vector<std::size_t> const& version_limits() const {
+    return version_limits_;
+  }
+
+  /**
+   * Whether the cell at `timestamp` is hidden.
+   *
+   * @param limit_timestamps for each of `version_limits()`, the timestamp of
+   *     the column's cell with that rank, if the column has that many cells.
+   */
+  bool Hides(std::chrono::milliseconds timestamp,
+             std::vector<absl::optional<std::chrono::milliseconds>> const&
+                 limit_timestamps) const;
+
+  /**
+   * The `limit_timestamps` argument of `Hides()` for a column whose cells
+   * are at `timestamps`, which may be in any order.
+   *
+   * This is for streams which don't read the cells of a column in timestamp
+   * order, and so have to buffer the column's timestamps to rank them.
+   */
+  std::vector<absl::optional<std::chrono::milliseconds>> FindLimitTimestamps(
+      std::vector<std::chrono::milliseconds> timestamps) const;
+
+  /**
+   * Whether the cell at `timestamp` is hidden regardless of its rank.
+   *
+   * This is for streams which can't tell the ranks of the cells.
+   */
+  bool Hides(std::chrono::milliseconds timestamp) const;
+
+ private:
+  struct Node {
+    google::bigtable::admin::v2::GcRule::RuleCase rule_case;
+    // For `max_age`, the cells older than this are hidden.
+    std::chrono::milliseconds cutoff{0};
+    // For `max_num_versions`, the index into `version_limits_`.
+    std::size_t limit_index = 0;
+    std::vector<Node> children;
+  };
+
+  Node Compile(google::bigtable::admin::v2::GcRule const& rule,
+               std::chrono::milliseconds now);
+  bool Hides(Node const& node, std::chrono::milliseconds timestamp,
+             std::vector<absl::optional<std::chrono::milliseconds>> const*
+                 limit_timestamps) const;
+
+  absl::optional<Node> root_;
+  std::vector<std::size_t> version_limits_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_READ_MASK_H
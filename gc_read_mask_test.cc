@@ -0,0 +1,177 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_read_mask.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "column_family.h"
+#include "table.h"
+#include "test_util.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+using std::chrono::milliseconds;
+using LimitTimestamps = std::vector<absl::optional<milliseconds>>;
+
+milliseconds Now() {
+  return std::chrono::duration_cast<milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+}
+
+// The timestamps of the cells in `stream`.
+std::vector<std::int64_t> ReadTimestamps(CellStream& stream) {
+  std::vector<std::int64_t> res;
+  for (; stream; ++stream) res.push_back(stream->timestamp().count());
+  return res;
+}
+
+TEST(GcReadMask, Empty) {
+  EXPECT_TRUE(GcReadMask().empty());
+  EXPECT_TRUE(GcReadMask(btadmin::GcRule{}, milliseconds(0)).empty());
+  btadmin::GcRule rule;
+  rule.mutable_union_();
+  EXPECT_TRUE(GcReadMask(rule, milliseconds(0)).empty());
+  EXPECT_FALSE(GcReadMask().Hides(milliseconds(0)));
+}
+
+TEST(GcReadMask, MaxAge) {
+  GcReadMask mask(MaxAge(10), milliseconds(100000));
+  EXPECT_FALSE(mask.empty());
+  EXPECT_TRUE(mask.version_limits().empty());
+  EXPECT_TRUE(mask.Hides(milliseconds(89999)));
+  EXPECT_FALSE(mask.Hides(milliseconds(90000)));
+  EXPECT_TRUE(mask.Hides(milliseconds(89999), LimitTimestamps{}));
+}
+
+TEST(GcReadMask, MaxNumVersions) {
+  GcReadMask mask(MaxVersions(2), milliseconds(0));
+  EXPECT_EQ(std::vector<std::size_t>{2}, mask.version_limits());
+  // The cell with rank 2 is at 30ms.
+  LimitTimestamps limits{milliseconds(30)};
+  EXPECT_FALSE(mask.Hides(milliseconds(40), limits));
+  EXPECT_TRUE(mask.Hides(milliseconds(30), limits));
+  EXPECT_TRUE(mask.Hides(milliseconds(20), limits));
+  // The column has fewer versions.
+  EXPECT_FALSE(mask.Hides(milliseconds(20), LimitTimestamps{absl::nullopt}));
+  // Without the ranks nothing is hidden.
+  EXPECT_FALSE(mask.Hides(milliseconds(20)));
+}
+
+TEST(GcReadMask, FindLimitTimestamps) {
+  btadmin::GcRule rule;
+  *rule.mutable_union_()->add_rules() = MaxVersions(1);
+  *rule.mutable_union_()->add_rules() = MaxVersions(3);
+  GcReadMask mask(rule, milliseconds(0));
+  // The cells are ranked numerically, not in the order of their keys.
+  EXPECT_EQ((LimitTimestamps{milliseconds(20), milliseconds(2)}),
+            mask.FindLimitTimestamps({milliseconds(100), milliseconds(2),
+                                      milliseconds(20), milliseconds(3)}));
+  EXPECT_EQ((LimitTimestamps{milliseconds(2), absl::nullopt}),
+            mask.FindLimitTimestamps({milliseconds(2), milliseconds(10)}));
+  EXPECT_EQ((LimitTimestamps{absl::nullopt, absl::nullopt}),
+            mask.FindLimitTimestamps({}));
+}
+
+TEST(GcReadMask, Combinations) {
+  btadmin::GcRule rule;
+  auto& intersection = *rule.mutable_intersection();
+  *intersection.add_rules() = MaxVersions(3);
+  *intersection.add_rules() = MaxAge(10);
+  auto& nested = *intersection.add_rules()->mutable_union_();
+  *nested.add_rules() = MaxVersions(1);
+  *nested.add_rules() = MaxVersions(3);
+  GcReadMask mask(rule, milliseconds(100000));
+  EXPECT_EQ((std::vector<std::size_t>{1, 3}), mask.version_limits());
+
+  LimitTimestamps limits{milliseconds(95000), milliseconds(80000)};
+  // Old enough, but not enough versions.
+  EXPECT_FALSE(mask.Hides(milliseconds(85000), limits));
+  // Enough versions, but too young.
+  limits = {milliseconds(95000), milliseconds(92000)};
+  EXPECT_FALSE(mask.Hides(milliseconds(92000), limits));
+  EXPECT_TRUE(mask.Hides(milliseconds(89000), limits));
+}
+
+TEST(GcReadMask, StreamHidesCollectableCells) {
+  auto cf = ColumnFamily::ConstructColumnFamily(absl::nullopt,
+                                                MaxVersions(2));
+  ASSERT_STATUS_OK(cf);
+  for (std::int64_t ts = 1; ts <= 4; ++ts) {
+    (*cf)->SetCell("row1", "col1", milliseconds(ts), "value");
+    (*cf)->SetCell("row1", "col2", milliseconds(10 * ts), "value");
+  }
+  (*cf)->SetCell("row2", "col1", milliseconds(1), "value");
+
+  auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+  CellStream stream(std::make_unique<FilteredColumnFamilyStream>(
+      **cf, "cf", all_rows));
+  EXPECT_EQ((std::vector<std::int64_t>{4, 3, 40, 30, 1}),
+            ReadTimestamps(stream));
+
+  // The versions are ranked before the timestamp filters.
+  CellStream filtered(std::make_unique<FilteredColumnFamilyStream>(
+      **cf, "cf", all_rows));
+  filtered.ApplyFilter(TimestampRange{TimestampRangeSet::Range(
+      milliseconds(0), milliseconds(4))});
+  EXPECT_EQ((std::vector<std::int64_t>{3, 1}), ReadTimestamps(filtered));
+}
+
+TEST(GcReadMask, ReadRowsHidesExpiredCellsBeforeGC) {
+  btadmin::Table schema;
+  schema.set_name("projects/test/instances/test/tables/mask");
+  *(*schema.mutable_column_families())["cf"].mutable_gc_rule() = MaxAge(3600);
+  auto table = Table::Create(schema);
+  ASSERT_STATUS_OK(table);
+
+  auto const now = Now();
+  btproto::MutateRowRequest request;
+  request.set_table_name(schema.name());
+  request.set_row_key("row");
+  for (auto ts : {now - milliseconds(7200 * 1000), now}) {
+    auto* set_cell = request.add_mutations()->mutable_set_cell();
+    set_cell->set_family_name("cf");
+    set_cell->set_column_qualifier("col");
+    set_cell->set_timestamp_micros(ts.count() * 1000);
+    set_cell->set_value("value");
+  }
+  ASSERT_STATUS_OK((*table)->MutateRow(request));
+
+  auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+  auto stream = (*table)->CreateCellStream(all_rows, absl::nullopt,
+                                           (*table)->GetSnapshot());
+  ASSERT_STATUS_OK(stream);
+  EXPECT_EQ(std::vector<std::int64_t>{now.count()}, ReadTimestamps(*stream));
+  // The cell is still there until GC runs.
+  EXPECT_EQ(2, (*table)->GetStats().Total().cells);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
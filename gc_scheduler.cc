@@ -0,0 +1,144 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_scheduler.h"
+#include "table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+struct GcScheduler::Round {
+  struct Candidate {
+    std::weak_ptr<Table> table;
+    std::string column_family;
+    std::int64_t eligible_cells;
+  };
+
+  // Guarded by `GcScheduler::mu_`.
+  std::deque<Candidate> candidates;
+  std::size_t workers = 0;
+};
+
+GcScheduler::GcScheduler(std::size_t threads,
+                         std::chrono::steady_clock::duration interval,
+                         std::chrono::steady_clock::duration slice)
+    : interval_(interval), slice_(slice), pool_(threads) {
+  thread_ = std::thread([this] { Loop(); });
+}
+
+GcScheduler::~GcScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void GcScheduler::Register(std::weak_ptr<Table> table) {
+  std::lock_guard<std::mutex> lock(mu_);
+  tables_.emplace_back(std::move(table));
+}
+
+std::int64_t GcScheduler::rounds() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  return rounds_;
+}
+
+void GcScheduler::Loop() {
+  std::unique_lock<std::mutex> lock(mu_);
+  while (!cv_.wait_for(lock, interval_, [this] { return stopping_; })) {
+    if (!round_running_) StartRoundLocked();
+  }
+}
+
+void GcScheduler::StartRoundLocked() {
+  tables_.erase(std::remove_if(tables_.begin(), tables_.end(),
+                               [](auto const& t) { return t.expired(); }),
+                tables_.end());
+  auto round = std::make_shared<Round>();
+  for (auto const& weak : tables_) {
+    auto table = weak.lock();
+    if (!table) continue;
+    if (table->NeedsTabletSplit()) {
+      pool_.Schedule([weak] {
+        if (auto table = weak.lock()) table->SplitTablets();
+      });
+    }
+    // Takes the table lock, but the tables never wait for the scheduler.
+    for (auto& candidate : table->GetGCCandidates()) {
+      round->candidates.push_back(
+          Round::Candidate{weak, std::move(candidate.first), candidate.second});
+    }
+  }
+  std::stable_sort(round->candidates.begin(), round->candidates.end(),
+                   [](auto const& a, auto const& b) {
+                     return a.eligible_cells > b.eligible_cells;
+                   });
+  ++rounds_;
+  round->workers = std::min(pool_.size(), round->candidates.size());
+  if (round->workers == 0) return;
+  round_running_ = true;
+  for (std::size_t i = 0; i != round->workers; ++i) {
+    pool_.Schedule([this, round] { Collect(round); });
+  }
+}
+
+void GcScheduler::Collect(std::shared_ptr<Round> const& round) {
+  std::unique_lock<std::mutex> lock(mu_);
+  if (stopping_ || round->candidates.empty()) {
+    if (--round->workers == 0) round_running_ = false;
+    return;
+  }
+  auto candidate = std::move(round->candidates.front());
+  round->candidates.pop_front();
+  lock.unlock();
+
+  bool done = true;
+  if (auto table = candidate.table.lock()) {
+    done = table->RunGCSlice(candidate.column_family, slice_);
+  }
+
+  lock.lock();
+  // Keep collecting the family until its pass is over, but give up the pool
+  // thread between the slices.
+  if (!done) round->candidates.push_front(std::move(candidate));
+  lock.unlock();
+  pool_.Schedule([this, round] { Collect(round); });
+}
+
+GcScheduler& GlobalGCScheduler() {
+  // Never destroyed, so that GC doesn't race with static destructors.
+  static auto* const kScheduler =
+      new GcScheduler(std::max(1U, std::thread::hardware_concurrency() / 4));
+  return *kScheduler;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,99 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_SCHEDULER_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_SCHEDULER_H
+
+#include "thread_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+class Table;
+
+/**
+ * Runs garbage collection of all the registered tables on a shared pool.
+ *
+ * Every `interval` the scheduler collects the column families whose GC rules
+ * may make any cells eligible, most eligible cells first. Each column family
+ * is collected in slices of about `slice`, see `Table::RunGCSlice()`, and a
+ * family is only collected by one thread at a time. A round is skipped if
+ * the previous one is still running.
+ *
+ * Each round also splits the tablets which mutations grew too large, see
+ * `Table::SplitTablets()`.
+ *
+ * The scheduler only keeps weak references to the tables. This object is
+ * thread safe.
+ */
+class GcScheduler {
+ public:
+  static std::chrono::seconds constexpr kDefaultInterval{60};
+  static std::chrono::milliseconds constexpr kDefaultSlice{5};
+
+  explicit GcScheduler(
+      std::size_t threads,
+      std::chrono::steady_clock::duration interval = kDefaultInterval,
+      std::chrono::steady_clock::duration slice = kDefaultSlice);
+  /// Stops the scheduler, abandoning the running round.
+  ~GcScheduler();
+
+  GcScheduler(GcScheduler const&) = delete;
+  GcScheduler& operator=(GcScheduler const&) = delete;
+
+  void Register(std::weak_ptr<Table> table);
+
+  /// The number of rounds which were started.
+  std::int64_t rounds() const;
+
+ private:
+  struct Round;
+
+  void Loop();
+  void StartRoundLocked();
+  void Collect(std::shared_ptr<Round> const& round);
+
+  std::chrono::steady_clock::duration interval_;
+  std::chrono::steady_clock::duration slice_;
+  mutable std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<std::weak_ptr<Table>> tables_;
+  bool stopping_ = false;
+  bool round_running_ = false;
+  std::int64_t rounds_ = 0;
+  std::thread thread_;
+  // Destroyed first, so the tasks it drains may still use the members above.
+  ThreadPool pool_;
+};
+
+/// The scheduler of all tables, with a thread per 4 cores.
+GcScheduler& GlobalGCScheduler();
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_GC_SCHEDULER_H
@@ -0,0 +1,208 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gc_scheduler.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "column_family.h"
+#include "table.h"
+#include "table_stats.h"
+#include "test_util.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+using ::testing::ElementsAre;
+using ::testing::Pair;
+
+auto constexpr kTableName = "projects/test/instances/test/tables/gc";
+
+// A table with one column family per entry of `gc_rules`, without a GC rule
+// for the empty names.
+std::shared_ptr<Table> CreateTable(
+    std::vector<std::pair<std::string, btadmin::GcRule>> const& gc_rules,
+    std::vector<std::string> initial_splits = {}) {
+  btadmin::Table schema;
+  schema.set_name(kTableName);
+  for (auto const& gc_rule : gc_rules) {
+    auto& column_family = (*schema.mutable_column_families())[gc_rule.first];
+    if (gc_rule.second.rule_case() != btadmin::GcRule::RULE_NOT_SET) {
+      *column_family.mutable_gc_rule() = gc_rule.second;
+    }
+  }
+  auto maybe_table =
+      Table::Create(schema, StorageLayout::kColumnFamilyPerFamily,
+                    std::move(initial_splits));
+  EXPECT_STATUS_OK(maybe_table);
+  return maybe_table ? *maybe_table : nullptr;
+}
+
+// Write `versions` versions of a column in each of `rows` rows.
+Status WriteVersions(Table& table, std::string const& family, int rows,
+                     int versions) {
+  for (int row = 0; row != rows; ++row) {
+    btproto::MutateRowRequest request;
+    request.set_table_name(kTableName);
+    request.set_row_key("row" + std::to_string(100 + row));
+    for (int ts = 1; ts <= versions; ++ts) {
+      auto* set_cell = request.add_mutations()->mutable_set_cell();
+      set_cell->set_family_name(family);
+      set_cell->set_column_qualifier("col");
+      set_cell->set_timestamp_micros(ts * 1000);
+      set_cell->set_value("value");
+    }
+    auto status = table.MutateRow(request);
+    if (!status.ok()) return status;
+  }
+  return Status();
+}
+
+TEST(EstimateGCEligibleCells, MaxNumVersions) {
+  ColumnFamilyStats stats;
+  // 10 columns with 1 version, 5 with 2 or 3 (13 cells).
+  stats.cells = 23;
+  stats.versions_histogram[0] = 10;
+  stats.versions_histogram[1] = 5;
+  EXPECT_EQ(0, EstimateGCEligibleCells(MaxVersions(3), stats));
+  EXPECT_EQ(0, EstimateGCEligibleCells(MaxVersions(5), stats));
+  EXPECT_EQ(3, EstimateGCEligibleCells(MaxVersions(2), stats));
+  EXPECT_EQ(8, EstimateGCEligibleCells(MaxVersions(1), stats));
+
+  // The last bucket may hold any number of versions.
+  stats.cells += 200;
+  stats.versions_histogram.back() = 1;
+  EXPECT_EQ(223 - 10 - 10 - 128,
+            EstimateGCEligibleCells(MaxVersions(1000), stats));
+
+  EXPECT_EQ(0, EstimateGCEligibleCells(MaxVersions(1), ColumnFamilyStats{}));
+}
+
+TEST(EstimateGCEligibleCells, Combinations) {
+  ColumnFamilyStats stats;
+  stats.cells = 20;
+  stats.versions_histogram[0] = 10;
+  stats.versions_histogram[1] = 5;
+  EXPECT_EQ(20, EstimateGCEligibleCells(MaxAge(10), stats));
+
+  btadmin::GcRule union_rule;
+  *union_rule.mutable_union_()->add_rules() = MaxVersions(1);
+  *union_rule.mutable_union_()->add_rules() = MaxVersions(2);
+  EXPECT_EQ(5 + 0, EstimateGCEligibleCells(union_rule, stats));
+  *union_rule.mutable_union_()->add_rules() = MaxAge(10);
+  EXPECT_EQ(20, EstimateGCEligibleCells(union_rule, stats));
+
+  btadmin::GcRule intersection;
+  *intersection.mutable_intersection()->add_rules() = MaxAge(10);
+  *intersection.mutable_intersection()->add_rules() = MaxVersions(1);
+  EXPECT_EQ(5, EstimateGCEligibleCells(intersection, stats));
+  *intersection.mutable_intersection()->add_rules() = MaxVersions(3);
+  EXPECT_EQ(0, EstimateGCEligibleCells(intersection, stats));
+
+  EXPECT_EQ(0, EstimateGCEligibleCells(btadmin::GcRule{}, stats));
+}
+
+TEST(TableGCSlice, ZeroBudgetSlicesCollectEverything) {
+  auto table = CreateTable({{"cf", MaxVersions(1)}}, {"row110", "row130"});
+  ASSERT_NE(nullptr, table);
+  ASSERT_STATUS_OK(WriteVersions(*table, "cf", 40, 3));
+
+  int slices = 1;
+  while (!table->RunGCSlice("cf", std::chrono::nanoseconds(0))) ++slices;
+  // Every slice collects at least one row.
+  EXPECT_LE(3, slices);
+  EXPECT_GE(40, slices);
+
+  auto const stats = table->GetStats();
+  EXPECT_EQ(40, stats.rows);
+  EXPECT_EQ(40, stats.column_families.at("cf").cells);
+  std::int64_t tablet_bytes = 0;
+  for (auto const& tablet : table->GetTablets()) {
+    tablet_bytes += tablet.logical_bytes;
+  }
+  EXPECT_EQ(stats.Total().logical_bytes, tablet_bytes);
+
+  // The next pass starts over, and has nothing left to collect.
+  while (!table->RunGCSlice("cf", std::chrono::nanoseconds(0))) {
+  }
+  EXPECT_EQ(stats.Total().cells, table->GetStats().Total().cells);
+}
+
+TEST(TableGCSlice, UnknownColumnFamily) {
+  auto table = CreateTable({{"cf", MaxVersions(1)}});
+  ASSERT_NE(nullptr, table);
+  EXPECT_TRUE(table->RunGCSlice("unknown", std::chrono::milliseconds(1)));
+}
+
+TEST(TableGCSlice, Candidates) {
+  auto table = CreateTable({{"few", MaxVersions(2)},
+                            {"many", MaxVersions(1)},
+                            {"no_rule", {}},
+                            {"nothing", MaxVersions(4)}});
+  ASSERT_NE(nullptr, table);
+  for (auto const* family : {"few", "many", "no_rule", "nothing"}) {
+    ASSERT_STATUS_OK(WriteVersions(*table, family, 10, 3));
+  }
+  // With 3 versions per column, at most 10 and 20 cells are eligible.
+  EXPECT_THAT(table->GetGCCandidates(),
+              ElementsAre(Pair("few", 10), Pair("many", 20)));
+
+  ASSERT_STATUS_OK(table->RunGC());
+  EXPECT_THAT(table->GetGCCandidates(), ElementsAre());
+}
+
+TEST(GcScheduler, CollectsRegisteredTables) {
+  GcScheduler scheduler(2, std::chrono::milliseconds(10),
+                        std::chrono::microseconds(100));
+  auto table = CreateTable({{"cf", MaxVersions(1)}});
+  ASSERT_NE(nullptr, table);
+  ASSERT_STATUS_OK(WriteVersions(*table, "cf", 100, 2));
+  scheduler.Register(table);
+
+  auto const deadline =
+      std::chrono::steady_clock::now() + std::chrono::minutes(1);
+  while (table->GetStats().Total().cells != 100 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(100, table->GetStats().Total().cells);
+
+  // Tables which are gone are skipped.
+  table.reset();
+  auto const rounds = scheduler.rounds();
+  while (scheduler.rounds() < rounds + 2) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -22,6 +22,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <utility>
 
 namespace google {
 namespace cloud {
@@ -60,7 +61,7 @@ class GCTest : public ::testing::Test {
 
   int CountTotalCells() {
     int count = 0;
-    for (auto const& row : *cf_) {
+    for (auto const& row : std::as_const(*cf_)) {
       for (auto const& col : row.second) {
         count += static_cast<int>(col.second.size());
       }
@@ -71,8 +72,9 @@ class GCTest : public ::testing::Test {
   std::set<std::chrono::milliseconds> GetColumnTimestamps(
       std::string const& row_key, std::string const& col_key) {
     std::set<std::chrono::milliseconds> column_timestamps;
-    auto row_it = cf_->find(row_key);
-    if (row_it == cf_->end()) {
+    auto const& cf = *cf_;
+    auto row_it = cf.find(row_key);
+    if (row_it == cf.end()) {
       return column_timestamps;
     }
     auto col_it = row_it->second.find(col_key);
@@ -402,22 +404,47 @@ TEST_F(GCTest, SingleCellMaxVersionsOne) {
   EXPECT_EQ(1, CountTotalCells());
 }
 
+TEST_F(GCTest, CellsWrittenAfterSetGCRuleAreCollected) {
+  google::bigtable::admin::v2::GcRule gc_rule;
+  gc_rule.set_max_num_versions(2);
+  cf_->SetGCRule(gc_rule);
+  AddTestData();
+  // Deleted rows are dropped from the GC index.
+  cf_->DeleteRow("row2");
+  cf_->RunGC();
+
+  EXPECT_EQ(4, CountTotalCells());
+  EXPECT_EQ((std::set<std::chrono::milliseconds>{400_ms, 500_ms}),
+            GetColumnTimestamps("row1", "col1"));
+  EXPECT_EQ((std::set<std::chrono::milliseconds>{250_ms, 350_ms}),
+            GetColumnTimestamps("row1", "col2"));
+
+  cf_->SetCell("row1", "col1", 600_ms, "v12");
+  cf_->RunGC();
+  EXPECT_EQ((std::set<std::chrono::milliseconds>{500_ms, 600_ms}),
+            GetColumnTimestamps("row1", "col1"));
+}
+
 TEST_F(GCTest, ColumnRowGCDirect) {
   AddTestData();
 
-  auto row_it = cf_->find("row1");
-  ASSERT_NE(row_it, cf_->end());
+  auto const& cf = *cf_;
+  auto row_it = cf.find("row1");
+  ASSERT_NE(row_it, cf.end());
   auto col_it = row_it->second.find("col1");
   ASSERT_NE(col_it, row_it->second.end());
+  // The family's columns are only modified through the family.
+  auto column = col_it->second;
 
-  EXPECT_EQ(5, std::distance(col_it->second.begin(), col_it->second.end()));
+  EXPECT_EQ(5, std::distance(column.begin(), column.end()));
 
   google::bigtable::admin::v2::GcRule gc_rule;
   gc_rule.set_max_num_versions(3);
-  col_it->second.RunGC(gc_rule);
+  // The family's arena only accounts for the collected values.
+  ValueArena arena;
+  column.RunGC(gc_rule, arena);
 
-  EXPECT_EQ(3, static_cast<int>(std::distance(col_it->second.begin(),
-                                              col_it->second.end())));
+  EXPECT_EQ(3, static_cast<int>(std::distance(column.begin(), column.end())));
 }
 
 TEST_F(GCTest, DeepNestingHandlesRecursion) {
@@ -0,0 +1,343 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hll_sketch.h"
+#include "google/cloud/internal/make_status.h"
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_format.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using ::google::cloud::internal::InvalidArgumentError;
+
+// The largest rank, of a hash whose bits after the index are all zeros.
+std::uint32_t constexpr kMaxRank = 64 - HllSketch::kPrecision + 1;
+std::size_t constexpr kSparseEntryBytes = 3;
+
+std::uint32_t EntryIndex(std::uint32_t entry) { return entry >> 6; }
+std::uint32_t EntryRank(std::uint32_t entry) { return entry & 0x3f; }
+std::uint32_t MakeEntry(std::uint32_t index, std::uint32_t rank) {
+  return index << 6 | rank;
+}
+
+// The sparse sketch takes at least as much space as the dense one.
+bool SparseIsTooLarge(std::size_t entries) {
+  return entries * kSparseEntryBytes >= HllSketch::kRegisters;
+}
+
+Status CorruptSketch(char const* reason, absl::string_view bytes) {
+  return InvalidArgumentError(
+      reason, GCP_ERROR_INFO()
+                  .WithMetadata("sketch size",
+                                absl::StrFormat("%zu", bytes.size()))
+                  .WithMetadata("expected precision",
+                                absl::StrFormat("%d", HllSketch::kPrecision)));
+}
+
+// The register index and rank of `hash`.
+std::pair<std::uint32_t, std::uint32_t> IndexAndRank(std::uint64_t hash) {
+  auto const index =
+      static_cast<std::uint32_t>(hash >> (64 - HllSketch::kPrecision));
+  // The set bit caps the rank at `kMaxRank`.
+  auto const rest = hash << HllSketch::kPrecision |
+                    std::uint64_t{1} << (HllSketch::kPrecision - 1);
+  auto const rank = static_cast<std::uint32_t>(absl::countl_zero(rest)) + 1;
+  return {index, rank};
+}
+
+std::uint32_t ReadEntry(char const* data) {
+  return static_cast<std::uint32_t>(static_cast<unsigned char>(data[0]))
+             << 16 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(data[1]))
+             << 8 |
+         static_cast<std::uint32_t>(static_cast<unsigned char>(data[2]));
+}
+
+void WriteEntry(std::uint32_t entry, char* data) {
+  data[0] = static_cast<char>(entry >> 16);
+  data[1] = static_cast<char>(entry >> 8);
+  data[2] = static_cast<char>(entry);
+}
+
+// Whether `bytes` has the header and size of an encoded dense sketch.
+bool IsEncodedDense(absl::string_view bytes) {
+  return bytes.size() == 2 + HllSketch::kRegisters &&
+         bytes[0] == HllSketch::kDense && bytes[1] == HllSketch::kPrecision;
+}
+
+}  // namespace
+
+StatusOr<HllSketch> HllSketch::Decode(absl::string_view bytes) {
+  HllSketch res;
+  if (bytes.empty()) return res;
+  if (bytes.size() < 2 || bytes[1] != kPrecision) {
+    return CorruptSketch("not a HyperLogLog++ sketch of this precision",
+                         bytes);
+  }
+  auto const data = bytes.substr(2);
+  if (bytes[0] == kSparse) {
+    if (data.size() % kSparseEntryBytes != 0 ||
+        SparseIsTooLarge(data.size() / kSparseEntryBytes)) {
+      return CorruptSketch("malformed sparse HyperLogLog++ sketch", bytes);
+    }
+    res.sparse_.reserve(data.size() / kSparseEntryBytes);
+    for (std::size_t i = 0; i != data.size(); i += kSparseEntryBytes) {
+      auto const entry = ReadEntry(data.data() + i);
+      if (EntryIndex(entry) >= kRegisters || EntryRank(entry) == 0 ||
+          EntryRank(entry) > kMaxRank ||
+          (!res.sparse_.empty() &&
+           EntryIndex(entry) <= EntryIndex(res.sparse_.back()))) {
+        return CorruptSketch("malformed sparse HyperLogLog++ sketch", bytes);
+      }
+      res.sparse_.push_back(entry);
+    }
+    return res;
+  }
+  if (bytes[0] == kDense) {
+    if (data.size() != kRegisters) {
+      return CorruptSketch("malformed dense HyperLogLog++ sketch", bytes);
+    }
+    res.registers_.assign(data.begin(), data.end());
+    if (*std::max_element(res.registers_.begin(), res.registers_.end()) >
+        kMaxRank) {
+      return CorruptSketch("malformed dense HyperLogLog++ sketch", bytes);
+    }
+    return res;
+  }
+  return CorruptSketch("not a HyperLogLog++ sketch of this precision", bytes);
+}
+
+std::string HllSketch::Encode() const {
+  std::string res;
+  if (is_sparse()) {
+    if (sparse_.empty()) return res;
+    res.reserve(2 + sparse_.size() * kSparseEntryBytes);
+    res.push_back(kSparse);
+    res.push_back(kPrecision);
+    res.resize(2 + sparse_.size() * kSparseEntryBytes);
+    auto* data = &res[2];
+    for (auto const entry : sparse_) {
+      WriteEntry(entry, data);
+      data += kSparseEntryBytes;
+    }
+    return res;
+  }
+  res.reserve(2 + kRegisters);
+  res.push_back(kDense);
+  res.push_back(kPrecision);
+  res.append(registers_.begin(), registers_.end());
+  return res;
+}
+
+std::uint64_t HllSketch::Hash(absl::string_view value) {
+  // FNV-1a, whose low quality bits are then mixed by MurmurHash3's
+  // finalizer.
+  std::uint64_t h = 0xcbf29ce484222325ULL;
+  for (auto const c : value) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void HllSketch::Add(std::uint64_t hash) {
+  auto const index_and_rank = IndexAndRank(hash);
+  auto const index = index_and_rank.first;
+  auto const rank = index_and_rank.second;
+  if (!is_sparse()) {
+    registers_[index] =
+        std::max(registers_[index], static_cast<std::uint8_t>(rank));
+    return;
+  }
+  auto it = std::lower_bound(sparse_.begin(), sparse_.end(),
+                             MakeEntry(index, 0));
+  if (it != sparse_.end() && EntryIndex(*it) == index) {
+    *it = MakeEntry(index, std::max(EntryRank(*it), rank));
+    return;
+  }
+  sparse_.insert(it, MakeEntry(index, rank));
+  if (SparseIsTooLarge(sparse_.size())) ToDense();
+}
+
+void HllSketch::Merge(HllSketch const& other) {
+  if (is_sparse() && other.is_sparse()) {
+    std::vector<std::uint32_t> merged;
+    merged.reserve(sparse_.size() + other.sparse_.size());
+    auto a = sparse_.begin();
+    auto b = other.sparse_.begin();
+    while (a != sparse_.end() || b != other.sparse_.end()) {
+      if (b == other.sparse_.end() ||
+          (a != sparse_.end() && EntryIndex(*a) < EntryIndex(*b))) {
+        merged.push_back(*a++);
+      } else if (a == sparse_.end() || EntryIndex(*b) < EntryIndex(*a)) {
+        merged.push_back(*b++);
+      } else {
+        merged.push_back(std::max(*a++, *b++));
+      }
+    }
+    sparse_ = std::move(merged);
+    if (SparseIsTooLarge(sparse_.size())) ToDense();
+    return;
+  }
+  ToDense();
+  if (other.is_sparse()) {
+    for (auto const entry : other.sparse_) {
+      auto& reg = registers_[EntryIndex(entry)];
+      reg = std::max(reg, static_cast<std::uint8_t>(EntryRank(entry)));
+    }
+    return;
+  }
+  MaxRegisters(registers_.data(), other.registers_.data(), kRegisters);
+}
+
+Status HllSketch::AddToEncoded(std::string& bytes, std::uint64_t hash) {
+  auto const index_and_rank = IndexAndRank(hash);
+  auto const index = index_and_rank.first;
+  auto const rank = index_and_rank.second;
+  if (IsEncodedDense(bytes)) {
+    auto& reg = bytes[2 + index];
+    if (static_cast<unsigned char>(reg) < rank) reg = static_cast<char>(rank);
+    return Status();
+  }
+  if (bytes.size() >= 2 && bytes[0] == kSparse && bytes[1] == kPrecision &&
+      (bytes.size() - 2) % kSparseEntryBytes == 0) {
+    // Binary search the entries for the register.
+    std::size_t lo = 0;
+    std::size_t hi = (bytes.size() - 2) / kSparseEntryBytes;
+    while (lo != hi) {
+      auto const mid = lo + (hi - lo) / 2;
+      if (EntryIndex(ReadEntry(&bytes[2 + mid * kSparseEntryBytes])) < index) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    auto const pos = 2 + lo * kSparseEntryBytes;
+    if (pos != bytes.size() && EntryIndex(ReadEntry(&bytes[pos])) == index) {
+      auto const entry = ReadEntry(&bytes[pos]);
+      WriteEntry(MakeEntry(index, std::max(EntryRank(entry), rank)),
+                 &bytes[pos]);
+      return Status();
+    }
+    if (!SparseIsTooLarge((bytes.size() - 2) / kSparseEntryBytes + 1)) {
+      char entry[kSparseEntryBytes];
+      WriteEntry(MakeEntry(index, rank), entry);
+      bytes.insert(pos, entry, kSparseEntryBytes);
+      return Status();
+    }
+  }
+  // The empty sketch, one becoming dense, or a malformed one.
+  auto sketch = Decode(bytes);
+  if (!sketch) return std::move(sketch).status();
+  sketch->Add(hash);
+  bytes = sketch->Encode();
+  return Status();
+}
+
+Status HllSketch::MergeIntoEncoded(std::string& bytes) const {
+  if (!IsEncodedDense(bytes)) {
+    auto merged = Decode(bytes);
+    if (!merged) return std::move(merged).status();
+    merged->Merge(*this);
+    bytes = merged->Encode();
+    return Status();
+  }
+  auto* registers = reinterpret_cast<std::uint8_t*>(&bytes[2]);
+  if (is_sparse()) {
+    for (auto const entry : sparse_) {
+      auto& reg = registers[EntryIndex(entry)];
+      reg = std::max(reg, static_cast<std::uint8_t>(EntryRank(entry)));
+    }
+    return Status();
+  }
+  MaxRegisters(registers, registers_.data(), kRegisters);
+  return Status();
+}
+
+std::int64_t HllSketch::Estimate() const {
+  auto const m = static_cast<double>(kRegisters);
+  double zeros = 0;
+  double sum = 0;
+  if (is_sparse()) {
+    zeros = m - static_cast<double>(sparse_.size());
+    sum = zeros;
+    for (auto const entry : sparse_) {
+      sum += std::ldexp(1.0, -static_cast<int>(EntryRank(entry)));
+    }
+  } else {
+    for (auto const reg : registers_) {
+      if (reg == 0) ++zeros;
+      sum += std::ldexp(1.0, -static_cast<int>(reg));
+    }
+  }
+  auto const alpha = 0.7213 / (1 + 1.079 / m);
+  auto const raw = alpha * m * m / sum;
+  // The raw estimate is biased upwards for small cardinalities, where
+  // linear counting is more accurate.
+  if (raw <= 2.5 * m && zeros != 0) {
+    return std::llround(m * std::log(m / zeros));
+  }
+  return std::llround(raw);
+}
+
+void HllSketch::ToDense() {
+  if (!is_sparse()) return;
+  registers_.assign(kRegisters, 0);
+  for (auto const entry : sparse_) {
+    registers_[EntryIndex(entry)] = static_cast<std::uint8_t>(EntryRank(entry));
+  }
+  sparse_ = std::vector<std::uint32_t>();
+}
+
+void MaxRegisters(std::uint8_t* dst, std::uint8_t const* src, std::size_t n) {
+  std::size_t i = 0;
+#if defined(__SSE2__)
+  for (; i + 16 <= n; i += 16) {
+    auto const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i));
+    auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_max_epu8(a, b));
+  }
+#elif defined(__ARM_NEON)
+  for (; i + 16 <= n; i += 16) {
+    vst1q_u8(dst + i, vmaxq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+  }
+#endif
+  for (; i != n; ++i) dst[i] = std::max(dst[i], src[i]);
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,109 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_HLL_SKETCH_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_HLL_SKETCH_H
+
+#include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * A HyperLogLog++ sketch of the distinct values added to a cell of a
+ * `hllpp_unique_count` aggregate column family.
+ *
+ * The sketch has `kRegisters` registers, each holding the largest rank (the
+ * number of leading zeros plus one) of the hashes which were added to it.
+ * Like in HyperLogLog++, a sketch of few values only keeps its non-zero
+ * registers (it is sparse), and switches to an array of all the registers
+ * (it becomes dense) once that is smaller.
+ *
+ * The cells hold the sketches in the emulator's own encoding:
+ * - an empty value is the empty sketch,
+ * - otherwise the first byte is `kSparse` or `kDense` and the second
+ *   `kPrecision`,
+ * - a sparse sketch follows them with its non-zero registers in the order
+ *   of their indexes, each encoded in 3 big-endian bytes as
+ *   `index << 6 | rank`,
+ * - a dense sketch follows them with all the registers, one byte each.
+ */
+class HllSketch {
+ public:
+  static int constexpr kPrecision = 14;
+  static std::size_t constexpr kRegisters = std::size_t{1} << kPrecision;
+  static char constexpr kSparse = 1;
+  static char constexpr kDense = 2;
+
+  HllSketch() = default;
+
+  /// Decode a sketch encoded by `Encode()`.
+  static StatusOr<HllSketch> Decode(absl::string_view bytes);
+  std::string Encode() const;
+
+  /// The hash of a value added to a sketch, the same in every process.
+  static std::uint64_t Hash(absl::string_view value);
+
+  void Add(std::uint64_t hash);
+  /// Make this the sketch of the values added to it or to `other`.
+  void Merge(HllSketch const& other);
+
+  /**
+   * Add `hash` to the sketch encoded in `bytes`, like `Add()`.
+   *
+   * Only the one register the hash maps to is updated, in place, so adding
+   * to a dense sketch doesn't decode and re-encode all of its registers.
+   */
+  static Status AddToEncoded(std::string& bytes, std::uint64_t hash);
+  /// Merge this sketch into the sketch encoded in `bytes`, in place if that
+  /// is dense.
+  Status MergeIntoEncoded(std::string& bytes) const;
+
+  /**
+   * The estimated number of distinct values added to the sketch.
+   *
+   * Like the original HyperLogLog, it switches from linear counting to the
+   * raw estimate at 2.5 times `kRegisters`. HyperLogLog++'s empirical bias
+   * correction of the raw estimate is not implemented.
+   */
+  std::int64_t Estimate() const;
+
+  bool is_sparse() const { return registers_.empty(); }
+
+ private:
+  void ToDense();
+
+  // While the sketch is sparse, its non-zero registers as `index << 6 |
+  // rank`, in the order of their indexes.
+  std::vector<std::uint32_t> sparse_;
+  // Once it is dense, all the registers.
+  std::vector<std::uint8_t> registers_;
+};
+
+/// Set each of `dst[0..n)` to the larger of it and `src[i]`.
+void MaxRegisters(std::uint8_t* dst, std::uint8_t const* src, std::size_t n);
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_HLL_SKETCH_H
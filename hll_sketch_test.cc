@@ -0,0 +1,189 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hll_sketch.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+HllSketch SketchOf(int begin, int end) {
+  HllSketch sketch;
+  for (int i = begin; i != end; ++i) {
+    sketch.Add(HllSketch::Hash("value" + std::to_string(i)));
+  }
+  return sketch;
+}
+
+// Within 2%, about twice the standard error of the estimate.
+void ExpectEstimate(std::int64_t expected, HllSketch const& sketch) {
+  EXPECT_NEAR(static_cast<double>(expected),
+              static_cast<double>(sketch.Estimate()), expected * 0.02 + 1);
+}
+
+TEST(HllSketch, Empty) {
+  HllSketch sketch;
+  EXPECT_TRUE(sketch.is_sparse());
+  EXPECT_EQ(0, sketch.Estimate());
+  EXPECT_EQ("", sketch.Encode());
+  auto decoded = HllSketch::Decode("");
+  ASSERT_TRUE(decoded.ok());
+  EXPECT_EQ(0, decoded->Estimate());
+}
+
+TEST(HllSketch, HashIsStable) {
+  EXPECT_EQ(HllSketch::Hash("foo"), HllSketch::Hash(std::string("foo")));
+  EXPECT_NE(HllSketch::Hash("foo"), HllSketch::Hash("bar"));
+  // Sketches are persisted, so the hash must not depend on the process.
+  EXPECT_EQ(0xefd01f60ba992926ULL, HllSketch::Hash(""));
+}
+
+TEST(HllSketch, CountsDistinctValues) {
+  auto sketch = SketchOf(0, 100);
+  for (int i = 0; i != 100; ++i) {
+    sketch.Add(HllSketch::Hash("value" + std::to_string(i)));
+  }
+  EXPECT_TRUE(sketch.is_sparse());
+  ExpectEstimate(100, sketch);
+
+  for (int const n : {10000, 40000, 100000}) {
+    auto const large = SketchOf(0, n);
+    EXPECT_FALSE(large.is_sparse());
+    ExpectEstimate(n, large);
+  }
+}
+
+TEST(HllSketch, RoundTrip) {
+  for (int const n : {1, 100, 10000}) {
+    auto const sketch = SketchOf(0, n);
+    auto const encoded = sketch.Encode();
+    EXPECT_EQ(sketch.is_sparse() ? HllSketch::kSparse : HllSketch::kDense,
+              encoded[0]);
+    auto decoded = HllSketch::Decode(encoded);
+    ASSERT_TRUE(decoded.ok());
+    EXPECT_EQ(sketch.is_sparse(), decoded->is_sparse());
+    EXPECT_EQ(sketch.Estimate(), decoded->Estimate());
+    EXPECT_EQ(encoded, decoded->Encode());
+  }
+  // Sparse sketches are smaller than dense ones.
+  EXPECT_EQ(2 + 3 * 100, SketchOf(0, 100).Encode().size());
+  EXPECT_EQ(2 + HllSketch::kRegisters, SketchOf(0, 10000).Encode().size());
+}
+
+TEST(HllSketch, RejectsMalformedSketches) {
+  auto const sparse = SketchOf(0, 10).Encode();
+  auto const dense = SketchOf(0, 10000).Encode();
+  auto with_byte = [](std::string bytes, std::size_t pos, char c) {
+    bytes[pos] = c;
+    return bytes;
+  };
+  for (auto const& bytes : std::vector<std::string>{
+           "x",
+           with_byte(sparse, 0, 3),
+           with_byte(sparse, 1, HllSketch::kPrecision + 1),
+           sparse.substr(0, sparse.size() - 1),
+           // An entry with a rank of 0.
+           with_byte(sparse, 4, static_cast<char>(sparse[4] & 0xc0)),
+           // The entries out of order.
+           sparse.substr(0, 2) + sparse.substr(5, 3) + sparse.substr(2, 3),
+           dense.substr(0, dense.size() - 1),
+           with_byte(dense, 100, 64),
+       }) {
+    EXPECT_FALSE(HllSketch::Decode(bytes).ok());
+  }
+}
+
+TEST(HllSketch, Merge) {
+  // Sparse into sparse.
+  auto sketch = SketchOf(0, 100);
+  sketch.Merge(SketchOf(50, 150));
+  EXPECT_TRUE(sketch.is_sparse());
+  ExpectEstimate(150, sketch);
+
+  // Sparse into sparse, becoming dense.
+  sketch.Merge(SketchOf(150, 8000));
+  EXPECT_FALSE(sketch.is_sparse());
+  ExpectEstimate(8000, sketch);
+
+  // Sparse into dense.
+  sketch.Merge(SketchOf(7990, 8010));
+  ExpectEstimate(8010, sketch);
+
+  // Dense into dense.
+  sketch.Merge(SketchOf(0, 20000));
+  ExpectEstimate(20000, sketch);
+
+  // Dense into sparse.
+  auto small = SketchOf(0, 10);
+  small.Merge(sketch);
+  EXPECT_FALSE(small.is_sparse());
+  EXPECT_EQ(sketch.Encode(), small.Encode());
+}
+
+TEST(HllSketch, AddToEncodedMatchesAdd) {
+  HllSketch sketch;
+  std::string encoded;
+  // Through the sparse sketch, its conversion, and the dense one.
+  for (int i = 0; i != 8000; ++i) {
+    auto const hash = HllSketch::Hash("value" + std::to_string(i % 7000));
+    sketch.Add(hash);
+    ASSERT_TRUE(HllSketch::AddToEncoded(encoded, hash).ok());
+    if (i % 500 == 0 || i == 7999) {
+      ASSERT_EQ(sketch.Encode(), encoded);
+    }
+  }
+  EXPECT_FALSE(sketch.is_sparse());
+
+  std::string corrupt = "\x01";
+  EXPECT_FALSE(HllSketch::AddToEncoded(corrupt, HllSketch::Hash("a")).ok());
+}
+
+TEST(HllSketch, MergeIntoEncodedMatchesMerge) {
+  for (auto const& into : {SketchOf(0, 10), SketchOf(0, 20000)}) {
+    for (auto const& from : {SketchOf(5, 30), SketchOf(10000, 30000)}) {
+      auto expected = into;
+      expected.Merge(from);
+      auto encoded = into.Encode();
+      ASSERT_TRUE(from.MergeIntoEncoded(encoded).ok());
+      EXPECT_EQ(expected.Encode(), encoded);
+    }
+  }
+}
+
+TEST(HllSketch, MaxRegisters) {
+  // Not a multiple of the vector size.
+  std::vector<std::uint8_t> dst(37);
+  std::vector<std::uint8_t> src(37);
+  for (std::size_t i = 0; i != dst.size(); ++i) {
+    dst[i] = static_cast<std::uint8_t>(i % 7);
+    src[i] = static_cast<std::uint8_t>(i % 5);
+  }
+  MaxRegisters(dst.data(), src.data(), dst.size());
+  for (std::size_t i = 0; i != dst.size(); ++i) {
+    EXPECT_EQ(std::max(i % 7, i % 5), dst[i]);
+  }
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,70 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "column_family.h"
+#include "filter.h"
+#include "range_set.h"
+#include "table.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Scan `kRows` rows, each with a cell in every one of `state.range(0)` column
+// families. This is dominated by merging the per column family streams.
+std::size_t constexpr kRows = 2000;
+
+void BM_FilteredTableStreamScan(benchmark::State& state) {
+  auto const num_families = static_cast<std::size_t>(state.range(0));
+  std::vector<ColumnFamily> families(num_families);
+  for (std::size_t row = 0; row != kRows; ++row) {
+    auto row_key = "row" + std::to_string(1000000 + row);
+    for (auto& family : families) {
+      family.SetCell(row_key, "col", std::chrono::milliseconds(1), "value");
+    }
+  }
+  auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+
+  for (auto _ : state) {
+    std::vector<std::unique_ptr<FilteredColumnFamilyStream>> cf_streams;
+    for (std::size_t i = 0; i != num_families; ++i) {
+      cf_streams.emplace_back(std::make_unique<FilteredColumnFamilyStream>(
+          families[i], "cf" + std::to_string(i), all_rows));
+    }
+    CellStream stream(
+        std::make_unique<FilteredTableStream>(std::move(cf_streams)));
+    std::size_t cells = 0;
+    for (; stream.HasValue(); stream.Next(NextMode::kCell)) ++cells;
+    benchmark::DoNotOptimize(cells);
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          kRows * num_families);
+}
+
+BENCHMARK(BM_FilteredTableStreamScan)->Arg(1)->Arg(2)->Arg(4)->Arg(24);
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
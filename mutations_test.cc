@@ -19,6 +19,7 @@
 #include "google/cloud/testing_util/status_matchers.h"
 #include "absl/strings/str_format.h"
 #include "column_family.h"
+#include "hll_sketch.h"
 #include "table.h"
 #include "test_util.h"
 #include <google/bigtable/admin/v2/table.pb.h>
@@ -59,6 +60,9 @@ using std::string;
     case google::bigtable::admin::v2::Type::Aggregate::kMin:
       kind_aggregate_type->mutable_min();
       break;
+    case google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount:
+      kind_aggregate_type->mutable_hllpp_unique_count();
+      break;
     default:
       std::abort();
   }
@@ -148,9 +152,9 @@ Status HasCell(std::shared_ptr<google::cloud::bigtable::emulator::Table>& table,
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return NotFoundError("no row key found in column family",
                          GCP_ERROR_INFO()
                              .WithMetadata("row key", row_key)
@@ -180,7 +184,8 @@ Status HasCell(std::shared_ptr<google::cloud::bigtable::emulator::Table>& table,
     return NotFoundError("wrong value",
                          GCP_ERROR_INFO()
                              .WithMetadata("expected", value)
-                             .WithMetadata("found", timestamp_it->second));
+                             .WithMetadata("found",
+                                           std::string(timestamp_it->second)));
   }
 
   return Status();
@@ -197,9 +202,9 @@ Status HasColumn(
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return NotFoundError("row key not found in column family",
                          GCP_ERROR_INFO()
                              .WithMetadata("row key", row_key)
@@ -228,9 +233,9 @@ StatusOr<std::map<std::chrono::milliseconds, std::string>> GetColumn(
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return NotFoundError("row key not found in column family",
                          GCP_ERROR_INFO()
                              .WithMetadata("row key", row_key)
@@ -260,9 +265,9 @@ Status HasRow(std::shared_ptr<google::cloud::bigtable::emulator::Table>& table,
         GCP_ERROR_INFO().WithMetadata("column family", column_family));
   }
 
-  auto const& cf = column_family_it->second;
-  auto column_family_row_it = cf->find(row_key);
-  if (column_family_row_it == cf->end()) {
+  auto const& cf = *column_family_it->second;
+  auto column_family_row_it = cf.find(row_key);
+  if (column_family_row_it == cf.end()) {
     return NotFoundError("row key not found in column family",
                          GCP_ERROR_INFO()
                              .WithMetadata("row key", row_key)
@@ -880,6 +885,58 @@ TEST(TransactionRollback, DeleteFromRowBasicFunction) {
                        .ok());
 }
 
+// Do the mutations of a request see the cells written by the preceding
+// ones, although they are only applied when all of them succeed?
+TEST(TransactionRollback, MutationsSeePrecedingMutations) {
+  auto const* const table_name = "projects/test/instances/test/tables/test";
+  auto const* const row_key = "0";
+  auto const* const column_family_name = "test";
+  auto const* const column_qualifier = "test";
+  auto const timestamp_micros = 1000;
+
+  std::vector<std::string> column_families = {column_family_name};
+  auto maybe_table = CreateTable(table_name, column_families);
+  ASSERT_STATUS_OK(maybe_table);
+  auto table = maybe_table.value();
+
+  ::google::bigtable::v2::MutateRowRequest mutation_request;
+  mutation_request.set_table_name(table_name);
+  mutation_request.set_row_key(row_key);
+  auto add_set_cell = [&](char const* value) {
+    auto* set_cell = mutation_request.add_mutations()->mutable_set_cell();
+    set_cell->set_family_name(column_family_name);
+    set_cell->set_column_qualifier(column_qualifier);
+    set_cell->set_timestamp_micros(timestamp_micros);
+    set_cell->set_value(value);
+  };
+
+  // The row only exists in the request, but it can be deleted.
+  add_set_cell("first");
+  mutation_request.add_mutations()->mutable_delete_from_family()
+      ->set_family_name(column_family_name);
+  add_set_cell("second");
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  ASSERT_STATUS_OK(HasCell(table, column_family_name, row_key, column_qualifier,
+                           timestamp_micros, "second"));
+
+  mutation_request.clear_mutations();
+  add_set_cell("third");
+  mutation_request.add_mutations()->mutable_delete_from_row();
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  ASSERT_FALSE(HasRow(table, column_family_name, row_key).ok());
+
+  // Nothing was written, so there is nothing to delete.
+  mutation_request.clear_mutations();
+  add_set_cell("fourth");
+  auto* delete_from_column =
+      mutation_request.add_mutations()->mutable_delete_from_column();
+  delete_from_column->set_family_name(column_family_name);
+  delete_from_column->set_column_qualifier(column_qualifier);
+  mutation_request.add_mutations()->mutable_delete_from_row();
+  ASSERT_FALSE(table->MutateRow(mutation_request).ok());
+  ASSERT_FALSE(HasRow(table, column_family_name, row_key).ok());
+}
+
 // Does AddToCell reject requests to add to a cell in a column family
 // not provisioned for aggregation?
 TEST(TransactionRollback, AddToCellRejectsRequestsToNonAggregateColumnFamily) {
@@ -1074,6 +1131,152 @@ TEST(TransactionRollback, AddToCellTestMin) {
                 .ok());
 }
 
+// The sketch in a cell of a HyperLogLog++ unique count column family.
+StatusOr<HllSketch> GetSketch(std::shared_ptr<Table>& table,
+                              std::string const& column_family,
+                              std::string const& row_key,
+                              std::string const& column_qualifier,
+                              std::int64_t timestamp_micros) {
+  auto const& cf = *table->find(column_family)->second;
+  auto const& column =
+      cf.find(row_key)->second.find(column_qualifier)->second;
+  auto cell_it =
+      column.find(std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::microseconds(timestamp_micros)));
+  if (cell_it == column.end()) {
+    return NotFoundError("timestamp not found", GCP_ERROR_INFO());
+  }
+  return HllSketch::Decode(cell_it->second);
+}
+
+// Test basic functionality of AddToCell HyperLogLog++ unique count
+// aggregation.
+TEST(TransactionRollback, AddToCellTestHllppUniqueCount) {
+  auto const* const table_name = "projects/test/instances/test/tables/test";
+  auto const* const row_key = "0";
+  auto const* const column_family_name = "column_family_1";
+  auto const* const column_qualifier = "column_qualifier";
+  auto const timestamp_micros = 1000;
+
+  auto maybe_table = Table::Create(CreateSchema(
+      table_name,
+      {{column_family_name,
+        MakeBEAggregateCFProto(
+            google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount)}}));
+  ASSERT_STATUS_OK(maybe_table);
+
+  auto table = maybe_table.value();
+
+  ::google::bigtable::v2::MutateRowRequest mutation_request;
+  mutation_request.set_table_name(table_name);
+  mutation_request.set_row_key(row_key);
+
+  auto* mutation_request_mutation = mutation_request.add_mutations();
+  auto* add_to_cell_mutation = mutation_request_mutation->mutable_add_to_cell();
+
+  add_to_cell_mutation->set_family_name(column_family_name);
+  add_to_cell_mutation->mutable_column_qualifier()->set_raw_value(
+      column_qualifier);
+  add_to_cell_mutation->mutable_timestamp()->set_raw_timestamp_micros(
+      timestamp_micros);
+  auto* mutable_input = add_to_cell_mutation->mutable_input();
+
+  // 100 distinct int64s, each added 3 times.
+  for (int i = 0; i != 300; ++i) {
+    mutable_input->set_int_value(i % 100);
+    ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  }
+  // The string and bytes inputs are hashed the same way.
+  for (auto const* value : {"a", "b", "a"}) {
+    mutable_input->set_string_value(value);
+    ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+    mutable_input->set_bytes_value(value);
+    ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  }
+
+  auto sketch = GetSketch(table, column_family_name, row_key,
+                          column_qualifier, timestamp_micros);
+  ASSERT_STATUS_OK(sketch);
+  EXPECT_NEAR(102, sketch->Estimate(), 2);
+
+  mutable_input->set_bool_value(true);
+  EXPECT_FALSE(table->MutateRow(mutation_request).ok());
+}
+
+// Test MergeToCell of HyperLogLog++ sketches, and of int64 states.
+TEST(TransactionRollback, MergeToCellTest) {
+  auto const* const table_name = "projects/test/instances/test/tables/test";
+  auto const* const row_key = "0";
+  auto const* const unique_count_family = "unique_count";
+  auto const* const sum_family = "sum";
+  auto const* const column_qualifier = "column_qualifier";
+  auto const timestamp_micros = 1000;
+
+  auto maybe_table = Table::Create(CreateSchema(
+      table_name,
+      {{unique_count_family,
+        MakeBEAggregateCFProto(
+            google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount)},
+       {sum_family, MakeBEAggregateCFProto(
+                        google::bigtable::admin::v2::Type::Aggregate::kSum)}}));
+  ASSERT_STATUS_OK(maybe_table);
+
+  auto table = maybe_table.value();
+
+  ::google::bigtable::v2::MutateRowRequest mutation_request;
+  mutation_request.set_table_name(table_name);
+  mutation_request.set_row_key(row_key);
+
+  auto* merge_to_cell_mutation =
+      mutation_request.add_mutations()->mutable_merge_to_cell();
+  merge_to_cell_mutation->set_family_name(unique_count_family);
+  merge_to_cell_mutation->mutable_column_qualifier()->set_raw_value(
+      column_qualifier);
+  merge_to_cell_mutation->mutable_timestamp()->set_raw_timestamp_micros(
+      timestamp_micros);
+  auto* mutable_input = merge_to_cell_mutation->mutable_input();
+
+  // Two overlapping sketches, one of them dense.
+  HllSketch first;
+  HllSketch second;
+  for (int i = 0; i != 10000; ++i) {
+    auto const hash = HllSketch::Hash(std::to_string(i));
+    (i < 6000 ? first : second).Add(hash);
+    if (i >= 4000 && i < 6000) second.Add(hash);
+  }
+  mutable_input->set_bytes_value(first.Encode());
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  mutable_input->set_bytes_value(second.Encode());
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+
+  auto sketch = GetSketch(table, unique_count_family, row_key,
+                          column_qualifier, timestamp_micros);
+  ASSERT_STATUS_OK(sketch);
+  first.Merge(second);
+  EXPECT_EQ(first.Encode(), sketch->Encode());
+  EXPECT_NEAR(10000, sketch->Estimate(), 200);
+
+  // The state of a unique count is a sketch, not an int64.
+  mutable_input->set_bytes_value("not a sketch");
+  EXPECT_FALSE(table->MutateRow(mutation_request).ok());
+  mutable_input->set_int_value(1);
+  EXPECT_FALSE(table->MutateRow(mutation_request).ok());
+  ASSERT_STATUS_OK(GetSketch(table, unique_count_family, row_key,
+                             column_qualifier, timestamp_micros));
+
+  // The state of a sum is an int64, which is merged by adding it.
+  merge_to_cell_mutation->set_family_name(sum_family);
+  mutable_input->set_int_value(100);
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  mutable_input->set_int_value(23);
+  ASSERT_STATUS_OK(table->MutateRow(mutation_request));
+  ASSERT_STATUS_OK(
+      HasCell(table, sum_family, row_key, column_qualifier, timestamp_micros,
+              google::cloud::internal::EncodeBigEndian<std::int64_t>(123)));
+  mutable_input->set_bytes_value("bytes");
+  EXPECT_FALSE(table->MutateRow(mutation_request).ok());
+}
+
 StatusOr<google::bigtable::v2::Column> GetColumn(
     google::bigtable::v2::ReadModifyWriteRowResponse const& resp,
     std::string const& row_key, int family_index, std::string const& qual) {
@@ -0,0 +1,205 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel_scan.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Workers hand cells over to the consumer in chunks of about this size, so
+// that they don't synchronize on every cell.
+std::size_t constexpr kChunkBytes = 64 << 10;
+
+}  // namespace
+
+struct ParallelCellStream::Partition {
+  explicit Partition(CellStream stream) : stream(std::move(stream)) {}
+
+  // Only accessed by the worker reading the partition, or when no worker is.
+  absl::optional<CellStream> stream;
+  // The rest is guarded by `State::mu`.
+  std::deque<Chunk> chunks;
+  std::size_t buffered_bytes = 0;
+  // Whether a worker is scheduled to read the partition or is reading it.
+  bool scanning = false;
+  // Whether the stream is exhausted; `chunks` may still hold cells.
+  bool done = false;
+};
+
+struct ParallelCellStream::State {
+  explicit State(ThreadPool& pool) : pool(pool) {}
+
+  ThreadPool& pool;
+  std::size_t partition_buffer_bytes = 0;
+  std::vector<std::unique_ptr<Partition>> partitions;
+  std::atomic<bool> cancelled{false};
+  std::mutex mu;
+  std::condition_variable cv;
+};
+
+ParallelCellStream::ParallelCellStream(ThreadPool& pool,
+                                       std::vector<CellStream> streams,
+                                       std::size_t max_buffered_bytes)
+    : state_(std::make_shared<State>(pool)),
+      window_(std::max<std::size_t>(pool.size(), 1)) {
+  state_->partition_buffer_bytes =
+      std::max(max_buffered_bytes / window_, kChunkBytes);
+  state_->partitions.reserve(streams.size());
+  for (auto& stream : streams) {
+    state_->partitions.emplace_back(
+        std::make_unique<Partition>(std::move(stream)));
+  }
+  std::lock_guard<std::mutex> lock(state_->mu);
+  for (std::size_t i = 0; i < std::min(window_, state_->partitions.size());
+       ++i) {
+    StartScanLocked(state_, i);
+  }
+}
+
+ParallelCellStream::~ParallelCellStream() {
+  state_->cancelled = true;
+  std::unique_lock<std::mutex> lock(state_->mu);
+  state_->cv.wait(lock, [this] {
+    return std::none_of(state_->partitions.begin(), state_->partitions.end(),
+                        [](auto const& p) { return p->scanning; });
+  });
+  // Destroy the input streams here rather than on a worker, which may
+  // outlive the table they read.
+  for (auto& partition : state_->partitions) partition->stream.reset();
+}
+
+bool ParallelCellStream::ApplyFilter(InternalFilter const&) { return false; }
+
+bool ParallelCellStream::HasValue() const {
+  InitializeIfNeeded();
+  return chunk_pos_ < chunk_.cells.size();
+}
+
+CellView const& ParallelCellStream::Value() const {
+  InitializeIfNeeded();
+  return current_view_.value();
+}
+
+bool ParallelCellStream::Next(NextMode mode) {
+  if (mode != NextMode::kCell) return false;
+  InitializeIfNeeded();
+  if (++chunk_pos_ == chunk_.cells.size()) NextChunk();
+  UpdateView();
+  return true;
+}
+
+void ParallelCellStream::Scan(std::shared_ptr<State> const& state,
+                              std::size_t index) {
+  auto& partition = *state->partitions[index];
+  for (;;) {
+    Chunk chunk;
+    auto& stream = *partition.stream;
+    for (; stream && chunk.bytes < kChunkBytes && !state->cancelled;
+         ++stream) {
+      Cell cell{stream->row_key(), stream->column_family(),
+                stream->column_qualifier(), stream->timestamp(),
+                std::string(stream->value()), absl::nullopt};
+      if (stream->HasLabel()) cell.label = stream->label();
+      chunk.bytes += sizeof(Cell) + cell.row_key.size() +
+                     cell.column_family.size() +
+                     cell.column_qualifier.size() + cell.value.size();
+      chunk.cells.emplace_back(std::move(cell));
+    }
+    bool const finished = !stream;
+    if (finished) partition.stream.reset();
+
+    std::lock_guard<std::mutex> lock(state->mu);
+    if (!chunk.cells.empty()) {
+      partition.buffered_bytes += chunk.bytes;
+      partition.chunks.emplace_back(std::move(chunk));
+    }
+    partition.done = finished;
+    state->cv.notify_all();
+    if (finished || state->cancelled ||
+        partition.buffered_bytes >= state->partition_buffer_bytes) {
+      // The consumer resumes the scan once it drains the buffer.
+      partition.scanning = false;
+      return;
+    }
+  }
+}
+
+void ParallelCellStream::StartScanLocked(std::shared_ptr<State> const& state,
+                                         std::size_t index) {
+  auto& partition = *state->partitions[index];
+  if (partition.scanning || partition.done) return;
+  partition.scanning = true;
+  state->pool.Schedule([state, index] { Scan(state, index); });
+}
+
+void ParallelCellStream::NextChunk() const {
+  chunk_ = Chunk{};
+  chunk_pos_ = 0;
+  std::unique_lock<std::mutex> lock(state_->mu);
+  while (next_partition_ < state_->partitions.size()) {
+    auto& partition = *state_->partitions[next_partition_];
+    if (!partition.chunks.empty()) {
+      chunk_ = std::move(partition.chunks.front());
+      partition.chunks.pop_front();
+      partition.buffered_bytes -= chunk_.bytes;
+      // Resume the scan if it was paused because of a full buffer.
+      StartScanLocked(state_, next_partition_);
+      return;
+    }
+    if (partition.done) {
+      // Move the window of partitions read ahead.
+      ++next_partition_;
+      auto const last = next_partition_ + window_ - 1;
+      if (last < state_->partitions.size()) StartScanLocked(state_, last);
+      continue;
+    }
+    StartScanLocked(state_, next_partition_);
+    state_->cv.wait(lock);
+  }
+}
+
+void ParallelCellStream::InitializeIfNeeded() const {
+  if (initialized_) return;
+  initialized_ = true;
+  NextChunk();
+  UpdateView();
+}
+
+void ParallelCellStream::UpdateView() const {
+  if (chunk_pos_ >= chunk_.cells.size()) {
+    current_view_.reset();
+    return;
+  }
+  auto const& cell = chunk_.cells[chunk_pos_];
+  current_view_.emplace(cell.row_key, cell.column_family,
+                        cell.column_qualifier, cell.timestamp, cell.value);
+  if (cell.label) current_view_->SetLabel(*cell.label);
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,104 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PARALLEL_SCAN_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PARALLEL_SCAN_H
+
+#include "absl/types/optional.h"
+#include "cell_view.h"
+#include "filter.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * A `AbstractCellStreamImpl` which reads a sequence of streams in parallel.
+ *
+ * The input streams, typically consecutive row ranges of a table, are
+ * consumed on a `ThreadPool`, in chunks of cells copied out of them. The
+ * chunks are returned in the order of the input streams, so the result is
+ * the same as reading the streams one after another.
+ *
+ * Only a window of `pool.size()` streams is read ahead of the consumer, and
+ * a stream is paused once it has `max_buffered_bytes / pool.size()` bytes
+ * buffered, so the memory used by a slow consumer is bounded. The workers
+ * never wait for the consumer.
+ *
+ * Filters have to be applied to the input streams.
+ */
+class ParallelCellStream : public AbstractCellStreamImpl {
+ public:
+  static std::size_t constexpr kDefaultMaxBufferedBytes = 16 << 20;
+
+  ParallelCellStream(ThreadPool& pool, std::vector<CellStream> streams,
+                     std::size_t max_buffered_bytes = kDefaultMaxBufferedBytes);
+  // Stops the workers and waits for them to let go of the input streams.
+  ~ParallelCellStream() override;
+
+  bool ApplyFilter(InternalFilter const& internal_filter) override;
+  bool HasValue() const override;
+  CellView const& Value() const override;
+  bool Next(NextMode mode) override;
+
+ private:
+  // A copy of a cell, which unlike `CellView` doesn't refer to the stream.
+  struct Cell {
+    std::string row_key;
+    std::string column_family;
+    std::string column_qualifier;
+    std::chrono::milliseconds timestamp;
+    std::string value;
+    absl::optional<std::string> label;
+  };
+  struct Chunk {
+    std::vector<Cell> cells;
+    std::size_t bytes = 0;
+  };
+  struct Partition;
+  struct State;
+
+  static void Scan(std::shared_ptr<State> const& state, std::size_t index);
+  // Schedule reading the partition unless it is read or finished already.
+  // The caller has to hold `State::mu`.
+  static void StartScanLocked(std::shared_ptr<State> const& state,
+                              std::size_t index);
+  // Wait for the next chunk, leaving `chunk_` empty if there is none.
+  void NextChunk() const;
+  void InitializeIfNeeded() const;
+  void UpdateView() const;
+
+  std::shared_ptr<State> state_;
+  std::size_t window_;
+  mutable bool initialized_ = false;
+  // The partition `chunk_` comes from, or the next one to read from.
+  mutable std::size_t next_partition_ = 0;
+  mutable Chunk chunk_;
+  mutable std::size_t chunk_pos_ = 0;
+  mutable absl::optional<CellView> current_view_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PARALLEL_SCAN_H
@@ -0,0 +1,98 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "range_set.h"
+#include "table.h"
+#include "thread_pool.h"
+#include <benchmark/benchmark.h>
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <google/bigtable/v2/data.pb.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Scan an in-memory table of `kRows` rows with a value regex filter, either
+// sequentially or split into `state.range(0)` partitions scanned in parallel.
+std::size_t constexpr kRows = 20000;
+
+std::shared_ptr<Table> GetTable() {
+  static auto* table = [] {
+    google::bigtable::admin::v2::Table schema;
+    schema.set_name("projects/p/instances/i/tables/t");
+    (*schema.mutable_column_families())["cf"] =
+        google::bigtable::admin::v2::ColumnFamily{};
+    auto table = Table::Create(schema);
+    if (!table) std::abort();
+    for (std::size_t row = 0; row != kRows; ++row) {
+      google::bigtable::v2::MutateRowRequest request;
+      request.set_table_name(schema.name());
+      request.set_row_key("row" + std::to_string(1000000 + row));
+      for (int col = 0; col != 4; ++col) {
+        auto* set_cell = request.add_mutations()->mutable_set_cell();
+        set_cell->set_family_name("cf");
+        set_cell->set_column_qualifier("col" + std::to_string(col));
+        set_cell->set_timestamp_micros(1000);
+        set_cell->set_value(std::string(100, 'a' + col));
+      }
+      if (!(*table)->MutateRow(request).ok()) std::abort();
+    }
+    return new std::shared_ptr<Table>(*std::move(table));
+  }();
+  return *table;
+}
+
+void BM_FilteredTableScan(benchmark::State& state) {
+  auto table = GetTable();
+  auto const partitions = static_cast<std::size_t>(state.range(0));
+  std::vector<std::string> split_keys;
+  for (std::size_t i = 1; i < partitions; ++i) {
+    split_keys.emplace_back("row" +
+                            std::to_string(1000000 + kRows * i / partitions));
+  }
+  auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+  google::bigtable::v2::RowFilter filter;
+  filter.set_value_regex_filter(".*c{50}.*");
+
+  for (auto _ : state) {
+    auto stream =
+        split_keys.empty()
+            ? table->CreateCellStream(all_rows, filter, table->GetSnapshot())
+            : table->CreateParallelCellStream(all_rows, filter, split_keys,
+                                              table->GetSnapshot());
+    std::size_t cells = 0;
+    for (; stream->HasValue(); stream->Next(NextMode::kCell)) ++cells;
+    if (cells != kRows) std::abort();
+  }
+  state.counters["threads"] = static_cast<double>(ScanThreadPool().size());
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          kRows * 4);
+}
+
+BENCHMARK(BM_FilteredTableScan)->Arg(1)->Arg(2)->Arg(4)->Arg(16)->UseRealTime();
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
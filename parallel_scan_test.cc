@@ -0,0 +1,219 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel_scan.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "absl/types/optional.h"
+#include "table.h"
+#include "thread_pool.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <google/bigtable/v2/data.pb.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+std::string RowKey(std::string const& prefix, std::size_t index) {
+  auto number = std::to_string(index);
+  return prefix + std::string(4 - number.size(), '0') + number;
+}
+
+// A stream of `count` cells in rows `<prefix>0000`, `<prefix>0001`, ...
+class RowsStream : public AbstractCellStreamImpl {
+ public:
+  RowsStream(std::string prefix, std::size_t count, std::size_t value_size)
+      : prefix_(std::move(prefix)),
+        count_(count),
+        value_(value_size, 'x') {
+    UpdateView();
+  }
+
+  bool ApplyFilter(InternalFilter const&) override { return false; }
+  bool HasValue() const override { return index_ < count_; }
+  CellView const& Value() const override { return *view_; }
+  bool Next(NextMode mode) override {
+    if (mode != NextMode::kCell) return false;
+    ++index_;
+    UpdateView();
+    return true;
+  }
+
+ private:
+  void UpdateView() {
+    if (index_ >= count_) return;
+    row_key_ = RowKey(prefix_, index_);
+    view_.emplace(row_key_, family_, qualifier_, std::chrono::milliseconds(1),
+                  value_);
+    view_->SetLabel(label_);
+  }
+
+  std::string prefix_;
+  std::size_t count_;
+  std::size_t index_ = 0;
+  std::string value_;
+  std::string row_key_;
+  std::string family_ = "cf";
+  std::string qualifier_ = "col";
+  std::string label_ = "label";
+  absl::optional<CellView> view_;
+};
+
+std::vector<std::string> ReadRowKeys(CellStream& stream) {
+  std::vector<std::string> res;
+  for (; stream; ++stream) res.emplace_back(stream->row_key());
+  return res;
+}
+
+TEST(ThreadPool, RunsAllTasks) {
+  std::atomic<int> count{0};
+  {
+    ThreadPool pool(4);
+    EXPECT_EQ(4U, pool.size());
+    for (int i = 0; i != 100; ++i) pool.Schedule([&count] { ++count; });
+  }
+  EXPECT_EQ(100, count.load());
+}
+
+TEST(ParallelCellStream, PreservesOrder) {
+  ThreadPool pool(3);
+  std::vector<CellStream> streams;
+  std::vector<std::string> expected;
+  std::size_t constexpr kPartitions = 8;
+  std::size_t constexpr kCells = 300;
+  for (std::size_t i = 0; i != kPartitions; ++i) {
+    auto const prefix = "p" + std::to_string(i) + "/";
+    // 1 KiB values, so that the small buffer below pauses the workers.
+    streams.emplace_back(std::make_unique<RowsStream>(prefix, kCells, 1024));
+    for (std::size_t j = 0; j != kCells; ++j) {
+      expected.emplace_back(RowKey(prefix, j));
+    }
+  }
+  CellStream stream(
+      std::make_unique<ParallelCellStream>(pool, std::move(streams), 1));
+  ASSERT_TRUE(stream.HasValue());
+  EXPECT_EQ("cf", stream->column_family());
+  EXPECT_EQ("col", stream->column_qualifier());
+  EXPECT_EQ(1024U, stream->value().size());
+  ASSERT_TRUE(stream->HasLabel());
+  EXPECT_EQ("label", stream->label());
+  EXPECT_EQ(expected, ReadRowKeys(stream));
+}
+
+TEST(ParallelCellStream, EmptyStreams) {
+  ThreadPool pool(2);
+  std::vector<CellStream> streams;
+  streams.emplace_back(std::make_unique<RowsStream>("a", 0, 1));
+  streams.emplace_back(std::make_unique<RowsStream>("b", 2, 1));
+  streams.emplace_back(std::make_unique<RowsStream>("c", 0, 1));
+  CellStream stream(
+      std::make_unique<ParallelCellStream>(pool, std::move(streams)));
+  EXPECT_EQ((std::vector<std::string>{"b0000", "b0001"}),
+            ReadRowKeys(stream));
+
+  CellStream none(
+      std::make_unique<ParallelCellStream>(pool, std::vector<CellStream>{}));
+  EXPECT_FALSE(none.HasValue());
+}
+
+TEST(ParallelCellStream, AbandonedStreamStopsWorkers) {
+  ThreadPool pool(2);
+  std::vector<CellStream> streams;
+  for (int i = 0; i != 4; ++i) {
+    streams.emplace_back(std::make_unique<RowsStream>("p", 5000, 1024));
+  }
+  {
+    CellStream stream(
+        std::make_unique<ParallelCellStream>(pool, std::move(streams), 1));
+    ASSERT_TRUE(stream.HasValue());
+    ++stream;
+  }
+  // The pool is still usable.
+  std::atomic<bool> ran{false};
+  pool.Schedule([&ran] { ran = true; });
+  while (!ran) std::this_thread::yield();
+}
+
+TEST(TableParallelScan, MatchesSequentialScan) {
+  btadmin::Table schema;
+  schema.set_name("projects/test/instances/test/tables/parallel");
+  (*schema.mutable_column_families())["cf1"] = btadmin::ColumnFamily{};
+  (*schema.mutable_column_families())["cf2"] = btadmin::ColumnFamily{};
+  auto maybe_table = Table::Create(schema);
+  ASSERT_STATUS_OK(maybe_table);
+  auto table = *maybe_table;
+  for (std::size_t i = 0; i != 100; ++i) {
+    btproto::MutateRowRequest request;
+    request.set_table_name(schema.name());
+    request.set_row_key(RowKey("row", i));
+    for (auto const* family : {"cf1", "cf2"}) {
+      for (std::int64_t ts = 1; ts <= 2; ++ts) {
+        auto* set_cell = request.add_mutations()->mutable_set_cell();
+        set_cell->set_family_name(family);
+        set_cell->set_column_qualifier("col");
+        set_cell->set_timestamp_micros(ts * 1000);
+        set_cell->set_value("value" + std::to_string(i));
+      }
+    }
+    ASSERT_STATUS_OK(table->MutateRow(request));
+  }
+
+  btproto::RowFilter filter;
+  filter.set_cells_per_row_limit_filter(3);
+  auto row_set = std::make_shared<StringRangeSet>(StringRangeSet::Empty());
+  row_set->Sum(StringRangeSet::Range("row0010", false, "row0050", true));
+  row_set->Sum(StringRangeSet::Range("row0070", false,
+                                     StringRangeSet::Range::Infinity{}, false));
+
+  auto read = [](CellStream& stream) {
+    std::vector<std::string> res;
+    for (; stream; ++stream) {
+      res.emplace_back(stream->row_key() + "/" + stream->column_family() +
+                       "/" + std::to_string(stream->timestamp().count()));
+    }
+    return res;
+  };
+  auto sequential =
+      table->CreateCellStream(row_set, filter, table->GetSnapshot());
+  ASSERT_STATUS_OK(sequential);
+  auto const expected = read(*sequential);
+  EXPECT_EQ(3U * 70, expected.size());
+
+  auto parallel = table->CreateParallelCellStream(
+      row_set, filter, {"row0005", "row0030", "row0060", "row0085"},
+      table->GetSnapshot());
+  ASSERT_STATUS_OK(parallel);
+  EXPECT_EQ(expected, read(*parallel));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,608 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PERSISTENT_MAP_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PERSISTENT_MAP_H
+
+#include "absl/container/inlined_vector.h"
+#include "absl/types/optional.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * An ordered map whose copies share their nodes until they are modified.
+ *
+ * It is a B+tree of reference counted nodes. The entries are stored inline in
+ * the leaves, about 1KiB of them per leaf, so that like with `absl::btree_map`
+ * there is no allocation per entry and scans read contiguous memory.
+ *
+ * Copying the map takes constant time. A modification copies the shared
+ * nodes on the path to the modified entry only, i.e. O(log n) of them and
+ * the other entries of its leaf, so that the first write after a copy
+ * doesn't cost O(n).
+ *
+ * A node is modified in place if it isn't shared, so like with
+ * `ColumnFamilyRow::MutableColumns()`, the copies must only be made by the
+ * thread modifying the map. Other threads may read and destroy their copies
+ * concurrently.
+ *
+ * The lookups return `const_iterator`s, also for a non-const map. Only the
+ * members named `mutable_*()` and the ones which insert or erase return
+ * `iterator`s. They and incrementing an `iterator` copy the shared nodes they
+ * reach, since the entry may be modified through it, so a scan can't copy
+ * the whole map by accident.
+ *
+ * It implements the subset of the `std::map` API which `ColumnFamily` needs,
+ * with forward iterators only. The keys must not be modified through an
+ * `iterator`. Inserting or erasing an entry invalidates the iterators and
+ * the references to the other entries, and so does modifying the map after a
+ * copy of it was made.
+ *
+ * `Allocator` allocates the nodes. It must be stateless.
+ */
+template <typename Key, typename Value, typename Compare = std::less<>,
+          typename Allocator = std::allocator<std::pair<Key, Value>>>
+class PersistentMap {
+ public:
+  using key_type = Key;
+  using mapped_type = Value;
+  using value_type = std::pair<Key, Value>;
+  using size_type = std::size_t;
+
+ private:
+  // Like with `absl::btree_map`, the size of the leaves is fixed in bytes.
+  // Larger leaves make scans faster, but the path copied by a modification
+  // longer.
+  static std::size_t constexpr kLeafBytes = 1024;
+  static std::size_t constexpr kMaxEntries =
+      std::max<std::size_t>(4, std::min<std::size_t>(
+                                   64, kLeafBytes / sizeof(value_type)));
+  static std::size_t constexpr kMaxChildren = 16;
+
+  struct Node;
+  using NodePtr = std::shared_ptr<Node>;
+
+  struct Node {
+    bool leaf;
+  };
+  // The nodes never hold more than their inline capacity.
+  struct Leaf : Node {
+    Leaf() : Node{true} {}
+    absl::InlinedVector<value_type, kMaxEntries> entries;
+  };
+  struct Inner : Node {
+    Inner() : Node{false} {}
+    // The keys separating the children: the keys in `children[i]` are
+    // before `keys[i]`, and those in `children[i + 1]` are not.
+    absl::InlinedVector<Key, kMaxChildren - 1> keys;
+    absl::InlinedVector<NodePtr, kMaxChildren> children;
+  };
+
+  static Leaf& AsLeaf(Node& node) { return static_cast<Leaf&>(node); }
+  static Leaf const& AsLeaf(Node const& node) {
+    return static_cast<Leaf const&>(node);
+  }
+  static Inner& AsInner(Node& node) { return static_cast<Inner&>(node); }
+  static Inner const& AsInner(Node const& node) {
+    return static_cast<Inner const&>(node);
+  }
+  // The number of entries of a leaf, or of children of an inner node.
+  static std::size_t Size(Node const& node) {
+    return node.leaf ? AsLeaf(node).entries.size()
+                     : AsInner(node).children.size();
+  }
+  // Fewer entries or children than this are merged with a sibling, except in
+  // the root.
+  static std::size_t MinSize(Node const& node) {
+    return node.leaf ? kMaxEntries / 2 : kMaxChildren / 2;
+  }
+
+  template <bool kConst>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = PersistentMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<kConst, value_type const*, value_type*>;
+    using reference =
+        std::conditional_t<kConst, value_type const&, value_type&>;
+
+    Iterator() = default;
+    // Like with `std::map`, an `iterator` converts to a `const_iterator`.
+    template <bool kOtherConst,
+              std::enable_if_t<kConst && !kOtherConst, int> = 0>
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    Iterator(Iterator<kOtherConst> const& other) {
+      for (auto const& level : other.path_) {
+        path_.push_back({level.node, level.index});
+      }
+    }
+
+    reference operator*() const {
+      auto const& level = path_.back();
+      return AsLeaf(*level.node).entries[level.index];
+    }
+    pointer operator->() const { return &**this; }
+
+    Iterator& operator++() {
+      ++path_.back().index;
+      Normalize();
+      return *this;
+    }
+    Iterator operator++(int) {
+      auto res = *this;
+      ++*this;
+      return res;
+    }
+
+    // The `iterator`s compare to `const_iterator`s, e.g. to `end()`, without
+    // being converted.
+    template <bool kOtherConst>
+    bool operator==(Iterator<kOtherConst> const& other) const {
+      return current() == other.current();
+    }
+    template <bool kOtherConst>
+    bool operator!=(Iterator<kOtherConst> const& other) const {
+      return !(*this == other);
+    }
+
+   private:
+    friend class PersistentMap;
+    template <bool>
+    friend class Iterator;
+
+    using NodePointer = std::conditional_t<kConst, Node const*, Node*>;
+    using ChildPointer =
+        std::conditional_t<kConst, NodePtr const&, NodePtr&>;
+
+    // The nodes of a mutable iterator are not shared.
+    static NodePointer Child(ChildPointer child) {
+      if constexpr (kConst) {
+        return child.get();
+      } else {
+        return &Unshare(child);
+      }
+    }
+    void Descend(NodePointer node, std::size_t index) {
+      path_.push_back({node, index});
+    }
+    // Moves past the ends of the nodes, to the first entry of the next leaf.
+    void Normalize() {
+      while (!path_.empty() && path_.back().index == Size(*path_.back().node)) {
+        path_.pop_back();
+        if (!path_.empty()) ++path_.back().index;
+      }
+      if (path_.empty()) return;
+      while (!path_.back().node->leaf) {
+        auto const& level = path_.back();
+        Descend(Child(AsInner(*level.node).children[level.index]), 0);
+      }
+    }
+    value_type const* current() const {
+      return path_.empty() ? nullptr : &**this;
+    }
+
+    struct Level {
+      NodePointer node;
+      // The entry in a leaf, or the child in an inner node.
+      std::size_t index;
+    };
+    // From the root to the leaf of the entry. It is empty at the end.
+    absl::InlinedVector<Level, 8> path_;
+  };
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  PersistentMap() = default;
+  PersistentMap(PersistentMap const&) = default;
+  PersistentMap& operator=(PersistentMap const&) = default;
+  PersistentMap(PersistentMap&& other) noexcept
+      : root_(std::move(other.root_)), size_(std::exchange(other.size_, 0)) {}
+  PersistentMap& operator=(PersistentMap&& other) noexcept {
+    root_ = std::move(other.root_);
+    size_ = std::exchange(other.size_, 0);
+    return *this;
+  }
+
+  bool empty() const { return size_ == 0; }
+  size_type size() const { return size_; }
+
+  const_iterator begin() const { return First<true>(root_); }
+  const_iterator end() const { return const_iterator(); }
+  template <typename K>
+  const_iterator lower_bound(K const& key) const {
+    return Search<true>(root_, key, false);
+  }
+  template <typename K>
+  const_iterator upper_bound(K const& key) const {
+    return Search<true>(root_, key, true);
+  }
+  template <typename K>
+  const_iterator find(K const& key) const {
+    auto it = lower_bound(key);
+    return it == end() || Compare()(key, it->first) ? end() : it;
+  }
+  template <typename K>
+  size_type count(K const& key) const {
+    return find(key) == end() ? 0 : 1;
+  }
+
+  /// Like `begin()`, but the entries can be modified.
+  iterator mutable_begin() { return First<false>(root_); }
+  /// Like `lower_bound()`, but the entries can be modified.
+  template <typename K>
+  iterator mutable_lower_bound(K const& key) {
+    return Search<false>(root_, key, false);
+  }
+  /// Like `find()`, but the entry can be modified. Nothing is copied if
+  /// there is none.
+  template <typename K>
+  iterator mutable_find(K const& key) {
+    if (find(key) == end()) return iterator();
+    return mutable_lower_bound(key);
+  }
+
+  /// Inserts `Value(args...)` at `key` unless there is an entry already.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(Key const& key, Args&&... args) {
+    if (!root_) root_ = std::allocate_shared<Leaf>(Allocator());
+    iterator res;
+    bool inserted = false;
+    auto split = Insert(root_, key, res, inserted, std::forward<Args>(args)...);
+    if (split) {
+      auto root = std::allocate_shared<Inner>(Allocator());
+      root->keys.push_back(std::move(split->key));
+      root->children.push_back(std::move(root_));
+      root->children.push_back(std::move(split->right));
+      root_ = std::move(root);
+    }
+    if (inserted) ++size_;
+    // A split moved the entry.
+    if (res == end()) res = mutable_lower_bound(key);
+    return {std::move(res), inserted};
+  }
+  Value& operator[](Key const& key) { return try_emplace(key).first->second; }
+
+  /// Erases the entry at `pos` and returns the one after it.
+  iterator erase(const_iterator pos) {
+    Key const key = pos->first;
+    Erase(root_, key);
+    --size_;
+    if (root_->leaf) {
+      if (AsLeaf(*root_).entries.empty()) root_.reset();
+    } else if (AsInner(*root_).children.size() == 1) {
+      auto child = std::move(AsInner(*root_).children.front());
+      root_ = std::move(child);
+    }
+    return mutable_lower_bound(key);
+  }
+  /// Erases the entries in [`first`, `last`).
+  iterator erase(const_iterator first, const_iterator last) {
+    if (last == end()) {
+      while (first != end()) first = erase(first);
+      return iterator();
+    }
+    Key const last_key = last->first;
+    auto it = Mutable(first);
+    while (it != end() && Compare()(it->first, last_key)) it = erase(it);
+    return it;
+  }
+  void clear() {
+    root_.reset();
+    size_ = 0;
+  }
+
+ private:
+  // A node split off to the right of another one, and the key separating
+  // them.
+  struct Split {
+    Key key;
+    NodePtr right;
+  };
+
+  // Copy `node` first if another map shares it.
+  static Node& Unshare(NodePtr& node) {
+    if (node.use_count() > 1) {
+      if (node->leaf) {
+        node = std::allocate_shared<Leaf>(Allocator(), AsLeaf(*node));
+      } else {
+        node = std::allocate_shared<Inner>(Allocator(), AsInner(*node));
+      }
+    } else {
+      // See `ColumnFamilyRow::MutableColumns()`.
+      std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *node;
+  }
+
+  // The same entry as `pos`, which can be modified.
+  iterator Mutable(const_iterator pos) {
+    return pos == end() ? iterator() : mutable_lower_bound(pos->first);
+  }
+
+  // The position of the first entry of a leaf which is not before `key`.
+  template <typename K>
+  static std::size_t LowerBound(Leaf const& leaf, K const& key) {
+    return static_cast<std::size_t>(
+        std::lower_bound(leaf.entries.begin(), leaf.entries.end(), key,
+                         [](value_type const& entry, K const& k) {
+                           return Compare()(entry.first, k);
+                         }) -
+        leaf.entries.begin());
+  }
+  // The position of the first entry of a leaf which is after `key`.
+  template <typename K>
+  static std::size_t UpperBound(Leaf const& leaf, K const& key) {
+    return static_cast<std::size_t>(
+        std::upper_bound(leaf.entries.begin(), leaf.entries.end(), key,
+                         [](K const& k, value_type const& entry) {
+                           return Compare()(k, entry.first);
+                         }) -
+        leaf.entries.begin());
+  }
+  // The child of an inner node whose keys `key` would be among.
+  template <typename K>
+  static std::size_t ChildIndex(Inner const& inner, K const& key) {
+    return static_cast<std::size_t>(
+        std::upper_bound(
+            inner.keys.begin(), inner.keys.end(), key,
+            [](K const& k, Key const& other) { return Compare()(k, other); }) -
+        inner.keys.begin());
+  }
+
+  template <bool kConst>
+  static Iterator<kConst> First(typename Iterator<kConst>::ChildPointer root) {
+    Iterator<kConst> res;
+    if (!root) return res;
+    res.Descend(Iterator<kConst>::Child(root), 0);
+    res.Normalize();
+    return res;
+  }
+
+  // The first entry after `key`, or not before it.
+  template <bool kConst, typename K>
+  static Iterator<kConst> Search(typename Iterator<kConst>::ChildPointer root,
+                                 K const& key, bool after) {
+    Iterator<kConst> res;
+    if (!root) return res;
+    auto node = Iterator<kConst>::Child(root);
+    while (!node->leaf) {
+      auto& inner = AsInner(*node);
+      auto const i = ChildIndex(inner, key);
+      res.Descend(node, i);
+      node = Iterator<kConst>::Child(inner.children[i]);
+    }
+    auto const& leaf = AsLeaf(*node);
+    res.Descend(node, after ? UpperBound(leaf, key) : LowerBound(leaf, key));
+    // The entry may be in the next leaf.
+    res.Normalize();
+    return res;
+  }
+
+  // Inserts an entry at `key` into the subtree at `node`, unless there is
+  // one already, and sets `pos` to it. If a full node was split, `pos` is
+  // left at the end, and the split is returned if it was `node`.
+  template <typename... Args>
+  // NOLINTNEXTLINE(misc-no-recursion)
+  static absl::optional<Split> Insert(NodePtr& node, Key const& key,
+                                      iterator& pos, bool& inserted,
+                                      Args&&... args) {
+    auto& n = Unshare(node);
+    if (!n.leaf) {
+      auto& inner = AsInner(n);
+      auto i = ChildIndex(inner, key);
+      if (MakeRoom(inner, i)) i = ChildIndex(inner, key);
+      pos.Descend(&n, i);
+      auto split = Insert(inner.children[i], key, pos, inserted,
+                          std::forward<Args>(args)...);
+      if (!split) return absl::nullopt;
+      pos.path_.clear();
+      return InsertChild(inner, i, *std::move(split));
+    }
+    auto& entries = AsLeaf(n).entries;
+    auto const at = LowerBound(AsLeaf(n), key);
+    if (at != entries.size() && !Compare()(key, entries[at].first)) {
+      pos.Descend(&n, at);
+      return absl::nullopt;
+    }
+    inserted = true;
+    auto emplace = [&](auto& into, std::size_t index) {
+      into.emplace(into.begin() + static_cast<std::ptrdiff_t>(index),
+                   std::piecewise_construct, std::forward_as_tuple(key),
+                   std::forward_as_tuple(std::forward<Args>(args)...));
+    };
+    if (entries.size() < kMaxEntries) {
+      emplace(entries, at);
+      pos.Descend(&n, at);
+      return absl::nullopt;
+    }
+    pos.path_.clear();
+    // Rows are often inserted in order, so appending to the last leaf
+    // leaves it full.
+    auto const mid = at == entries.size() ? at : entries.size() / 2;
+    auto right = std::allocate_shared<Leaf>(Allocator());
+    MoveTail(entries, mid, right->entries);
+    if (at < mid) {
+      emplace(entries, at);
+    } else {
+      emplace(right->entries, at - mid);
+    }
+    Key separator = right->entries.front().first;
+    return Split{std::move(separator), std::move(right)};
+  }
+
+  // Adds the node split off `inner.children[i]`.
+  static absl::optional<Split> InsertChild(Inner& inner, std::size_t i,
+                                           Split split) {
+    auto add = [](Inner& into, std::size_t at, Split s) {
+      into.keys.insert(into.keys.begin() + static_cast<std::ptrdiff_t>(at),
+                       std::move(s.key));
+      into.children.insert(
+          into.children.begin() + static_cast<std::ptrdiff_t>(at + 1),
+          std::move(s.right));
+    };
+    auto const size = inner.children.size();
+    if (size < kMaxChildren) {
+      add(inner, i, std::move(split));
+      return absl::nullopt;
+    }
+    // Like for the leaves, keep the node full when the last child splits.
+    auto const mid = i + 1 == size ? size - 1 : size / 2;
+    auto right = std::allocate_shared<Inner>(Allocator());
+    Key separator = std::move(inner.keys[mid - 1]);
+    MoveTail(inner.keys, mid, right->keys);
+    MoveTail(inner.children, mid, right->children);
+    inner.keys.pop_back();
+    if (i < mid) {
+      add(inner, i, std::move(split));
+    } else {
+      add(*right, i - mid, std::move(split));
+    }
+    return Split{std::move(separator), std::move(right)};
+  }
+
+  // Erases `key`, which is in the map, from the subtree at `node`.
+  template <typename K>
+  // NOLINTNEXTLINE(misc-no-recursion)
+  static void Erase(NodePtr& node, K const& key) {
+    auto& n = Unshare(node);
+    if (n.leaf) {
+      auto& entries = AsLeaf(n).entries;
+      entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(
+                                          LowerBound(AsLeaf(n), key)));
+      return;
+    }
+    auto& inner = AsInner(n);
+    auto const i = ChildIndex(inner, key);
+    Erase(inner.children[i], key);
+    auto const& child = *inner.children[i];
+    if (Size(child) < MinSize(child)) Balance(inner, i == 0 ? 0 : i - 1);
+  }
+
+  // If the leaf `inner.children[i]` is full, moves some of its entries to a
+  // sibling with room for them, so that the leaves are fuller than if they
+  // were split. Returns whether it did.
+  static bool MakeRoom(Inner& inner, std::size_t i) {
+    auto const& child = *inner.children[i];
+    if (!child.leaf || Size(child) != kMaxEntries) return false;
+    auto has_room = [&](std::size_t j) {
+      return Size(*inner.children[j]) + 1 < kMaxEntries;
+    };
+    if (i != 0 && has_room(i - 1)) {
+      Balance(inner, i - 1);
+      return true;
+    }
+    if (i + 1 != inner.children.size() && has_room(i + 1)) {
+      Balance(inner, i);
+      return true;
+    }
+    return false;
+  }
+
+  // Merges the children `l` and `l + 1` of `inner` if they fit in one node,
+  // and otherwise moves entries or children between them until their sizes
+  // differ by at most one.
+  static void Balance(Inner& inner, std::size_t l) {
+    auto& separator = inner.keys[l];
+    auto& left = Unshare(inner.children[l]);
+    auto& right = Unshare(inner.children[l + 1]);
+    auto remove_right = [&] {
+      inner.keys.erase(inner.keys.begin() + static_cast<std::ptrdiff_t>(l));
+      inner.children.erase(inner.children.begin() +
+                           static_cast<std::ptrdiff_t>(l + 1));
+    };
+    if (left.leaf) {
+      auto& lhs = AsLeaf(left).entries;
+      auto& rhs = AsLeaf(right).entries;
+      if (lhs.size() + rhs.size() <= kMaxEntries) {
+        MoveTail(rhs, 0, lhs);
+        remove_right();
+        return;
+      }
+      if (lhs.size() < rhs.size()) {
+        auto const n =
+            static_cast<std::ptrdiff_t>(rhs.size() - lhs.size() + 1) / 2;
+        lhs.insert(lhs.end(), std::make_move_iterator(rhs.begin()),
+                   std::make_move_iterator(rhs.begin() + n));
+        rhs.erase(rhs.begin(), rhs.begin() + n);
+      } else {
+        auto const n =
+            static_cast<std::ptrdiff_t>(lhs.size() - rhs.size() + 1) / 2;
+        rhs.insert(rhs.begin(), std::make_move_iterator(lhs.end() - n),
+                   std::make_move_iterator(lhs.end()));
+        lhs.erase(lhs.end() - n, lhs.end());
+      }
+      separator = rhs.front().first;
+      return;
+    }
+    auto& lhs = AsInner(left);
+    auto& rhs = AsInner(right);
+    if (lhs.children.size() + rhs.children.size() <= kMaxChildren) {
+      lhs.keys.push_back(std::move(separator));
+      MoveTail(rhs.keys, 0, lhs.keys);
+      MoveTail(rhs.children, 0, lhs.children);
+      remove_right();
+      return;
+    }
+    // Rotate the children through the separator.
+    while (lhs.children.size() + 1 < rhs.children.size()) {
+      lhs.keys.push_back(std::move(separator));
+      lhs.children.push_back(std::move(rhs.children.front()));
+      separator = std::move(rhs.keys.front());
+      rhs.keys.erase(rhs.keys.begin());
+      rhs.children.erase(rhs.children.begin());
+    }
+    while (rhs.children.size() + 1 < lhs.children.size()) {
+      rhs.keys.insert(rhs.keys.begin(), std::move(separator));
+      rhs.children.insert(rhs.children.begin(),
+                          std::move(lhs.children.back()));
+      separator = std::move(lhs.keys.back());
+      lhs.keys.pop_back();
+      lhs.children.pop_back();
+    }
+  }
+
+  // Moves the elements of `from` starting at `first` to the end of `to`.
+  template <typename Vector>
+  static void MoveTail(Vector& from, std::size_t first, Vector& to) {
+    auto const begin = from.begin() + static_cast<std::ptrdiff_t>(first);
+    to.insert(to.end(), std::make_move_iterator(begin),
+              std::make_move_iterator(from.end()));
+    from.erase(begin, from.end());
+  }
+
+  NodePtr root_;
+  size_type size_ = 0;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_PERSISTENT_MAP_H
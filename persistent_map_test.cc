@@ -0,0 +1,189 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "persistent_map.h"
+#include <gtest/gtest.h>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using Map = PersistentMap<std::string, int>;
+using Entries = std::vector<std::pair<std::string, int>>;
+
+Entries Dump(Map const& map) {
+  Entries res;
+  for (auto const& entry : map) res.emplace_back(entry.first, entry.second);
+  return res;
+}
+
+TEST(PersistentMap, Empty) {
+  Map map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(0U, map.size());
+  EXPECT_TRUE(map.begin() == map.end());
+  EXPECT_TRUE(std::as_const(map).find("a") == std::as_const(map).end());
+  EXPECT_TRUE(std::as_const(map).lower_bound("a") == std::as_const(map).end());
+}
+
+TEST(PersistentMap, Lookups) {
+  Map map;
+  map["d"] = 4;
+  map["b"] = 2;
+  EXPECT_TRUE(map.try_emplace("f", 6).second);
+  EXPECT_FALSE(map.try_emplace("b", 3).second);
+  EXPECT_EQ((Entries{{"b", 2}, {"d", 4}, {"f", 6}}), Dump(map));
+  EXPECT_EQ(3U, map.size());
+
+  auto const& cmap = map;
+  EXPECT_EQ("d", cmap.find("d")->first);
+  EXPECT_TRUE(cmap.find("c") == cmap.end());
+  EXPECT_EQ(1U, cmap.count("f"));
+  EXPECT_EQ(0U, cmap.count("g"));
+  EXPECT_EQ("b", cmap.lower_bound("a")->first);
+  EXPECT_EQ("d", cmap.lower_bound("d")->first);
+  EXPECT_EQ("f", cmap.upper_bound("d")->first);
+  EXPECT_TRUE(cmap.upper_bound("f") == cmap.end());
+  EXPECT_EQ("f", std::next(cmap.lower_bound("c"))->first);
+}
+
+TEST(PersistentMap, Erase) {
+  Map map;
+  for (auto const* key : {"a", "b", "c", "d", "e"}) map[key] = 0;
+  auto it = map.erase(map.find("b"));
+  EXPECT_EQ("c", it->first);
+  it = map.erase(it, map.find("e"));
+  EXPECT_EQ("e", it->first);
+  EXPECT_EQ((Entries{{"a", 0}, {"e", 0}}), Dump(map));
+  EXPECT_TRUE(map.erase(map.begin(), map.end()) == map.end());
+  EXPECT_TRUE(map.empty());
+}
+
+TEST(PersistentMap, CopiesAreIndependent) {
+  Map map;
+  for (int i = 0; i != 100; ++i) map[std::to_string(i)] = i;
+  auto const copy = map;
+
+  map["5"] = -5;
+  map.erase(map.find("7"));
+  map["x"] = 1;
+  for (auto it = map.mutable_lower_bound("9"); it != map.end(); ++it) {
+    it->second = 9;
+  }
+  EXPECT_EQ(-5, std::as_const(map).find("5")->second);
+  EXPECT_EQ(0U, std::as_const(map).count("7"));
+  EXPECT_EQ(9, std::as_const(map).find("x")->second);
+  EXPECT_EQ(100U, map.size());
+
+  EXPECT_EQ(100U, copy.size());
+  EXPECT_EQ(5, copy.find("5")->second);
+  EXPECT_EQ(7, copy.find("7")->second);
+  EXPECT_EQ(0U, copy.count("x"));
+  EXPECT_EQ(99, copy.find("99")->second);
+}
+
+TEST(PersistentMap, CopiesShareUnmodifiedEntries) {
+  Map map;
+  for (int i = 0; i != 10000; ++i) map[std::to_string(i)] = i;
+  auto const copy = map;
+  map["5000"] = -1;
+  // Reading the modified map doesn't copy anything else.
+  EXPECT_EQ(10000, std::distance(map.begin(), map.end()));
+  EXPECT_EQ(9999, map.find("9999")->second);
+
+  auto const& cmap = map;
+  EXPECT_EQ(&copy.find("0")->second, &cmap.find("0")->second);
+  EXPECT_EQ(&copy.find("9999")->second, &cmap.find("9999")->second);
+  EXPECT_NE(&copy.find("5000")->second, &cmap.find("5000")->second);
+  EXPECT_EQ(5000, copy.find("5000")->second);
+}
+
+TEST(PersistentMap, InOrderInsertsAndErases) {
+  auto key = [](int i) {
+    auto res = std::to_string(i);
+    return std::string(6 - res.size(), '0') + res;
+  };
+  Map map;
+  Entries expected;
+  for (int i = 0; i != 20000; ++i) {
+    map[key(i)] = i;
+    expected.emplace_back(key(i), i);
+  }
+  EXPECT_EQ(expected, Dump(map));
+
+  for (int i = 0; i != 20000; i += 2) map.erase(map.find(key(i)));
+  Entries odd;
+  for (int i = 1; i < 20000; i += 2) odd.emplace_back(key(i), i);
+  EXPECT_EQ(odd, Dump(map));
+  EXPECT_EQ(key(3), std::as_const(map).upper_bound(key(1))->first);
+  EXPECT_EQ(key(3), std::as_const(map).lower_bound(key(2))->first);
+
+  auto it = map.erase(map.begin(), std::as_const(map).lower_bound(key(10000)));
+  EXPECT_EQ(key(10001), it->first);
+  EXPECT_EQ(5000U, map.size());
+  while (!map.empty()) map.erase(map.begin());
+  EXPECT_TRUE(std::as_const(map).begin() == std::as_const(map).end());
+}
+
+TEST(PersistentMap, MatchesStdMap) {
+  std::mt19937 generator(42);  // NOLINT(cert-msc51-cpp)
+  std::uniform_int_distribution<int> keys(0, 1999);
+  Map map;
+  std::map<std::string, int> expected;
+  std::vector<Map> copies;
+  std::vector<std::map<std::string, int>> expected_copies;
+  for (int i = 0; i != 50000; ++i) {
+    auto const key = std::to_string(keys(generator));
+    switch (i % 4) {
+      case 0:
+      case 1:
+        map[key] = i;
+        expected[key] = i;
+        break;
+      case 2: {
+        auto it = std::as_const(map).find(key);
+        if (it != std::as_const(map).end()) map.erase(it);
+        expected.erase(key);
+        break;
+      }
+      default:
+        if (i % 4000 == 3) {
+          copies.push_back(map);
+          expected_copies.push_back(expected);
+        }
+    }
+  }
+  auto dump = [](std::map<std::string, int> const& map) {
+    return Entries(map.begin(), map.end());
+  };
+  EXPECT_EQ(expected.size(), map.size());
+  EXPECT_EQ(dump(expected), Dump(map));
+  for (std::size_t i = 0; i != copies.size(); ++i) {
+    EXPECT_EQ(dump(expected_copies[i]), Dump(copies[i]));
+  }
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
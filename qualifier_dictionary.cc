@@ -0,0 +1,53 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "qualifier_dictionary.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+Qualifier QualifierDictionary::Intern(absl::string_view name) {
+  auto it = index_.find(name);
+  if (it != index_.end()) return Qualifier(it->second);
+  entries_.push_back(Qualifier::Entry{
+      std::string(name), static_cast<std::uint32_t>(entries_.size())});
+  auto const* entry = &entries_.back();
+  // The key refers to the entry's copy of the name, which never moves.
+  index_.emplace(entry->name, entry);
+  return Qualifier(entry);
+}
+
+bool QualifierRegexMemo::PartialMatch(Qualifier qualifier) const {
+  auto const id = qualifier.id();
+  if (id >= results_.size()) results_.resize(id + 1, Result{nullptr, false});
+  auto& result = results_[id];
+  if (result.entry != qualifier.entry_) {
+    result.entry = qualifier.entry_;
+    result.match =
+        std::all_of(regexes_.begin(), regexes_.end(), [&](auto const& regex) {
+          return regex->PartialMatch(qualifier.name());
+        });
+  }
+  return result.match;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
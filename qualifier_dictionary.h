@@ -0,0 +1,184 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_QUALIFIER_DICTIONARY_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_QUALIFIER_DICTIONARY_H
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "regex_matcher.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * A column qualifier interned in a `QualifierDictionary`.
+ *
+ * It is a pointer to the dictionary's single copy of the qualifier, so it is
+ * cheap to copy and compare. Qualifiers interned in the same dictionary are
+ * equal iff they have the same `id()`.
+ */
+class Qualifier {
+ public:
+  std::string const& name() const { return entry_->name; }
+  /// Dense, starting at 0, in the order the qualifiers were interned.
+  std::uint32_t id() const { return entry_->id; }
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  operator std::string const&() const { return name(); }
+
+  friend bool operator==(Qualifier lhs, Qualifier rhs) {
+    return lhs.entry_ == rhs.entry_ || lhs.name() == rhs.name();
+  }
+  friend bool operator!=(Qualifier lhs, Qualifier rhs) {
+    return !(lhs == rhs);
+  }
+  friend bool operator==(Qualifier lhs, absl::string_view rhs) {
+    return lhs.name() == rhs;
+  }
+  friend bool operator==(absl::string_view lhs, Qualifier rhs) {
+    return lhs == rhs.name();
+  }
+  friend bool operator!=(Qualifier lhs, absl::string_view rhs) {
+    return !(lhs == rhs);
+  }
+  friend bool operator!=(absl::string_view lhs, Qualifier rhs) {
+    return !(lhs == rhs);
+  }
+  friend std::ostream& operator<<(std::ostream& os, Qualifier qualifier) {
+    return os << qualifier.name();
+  }
+
+ private:
+  friend class QualifierDictionary;
+  friend class QualifierRegexMemo;
+  friend struct QualifierLess;
+
+  struct Entry {
+    std::string name;
+    std::uint32_t id;
+  };
+
+  explicit Qualifier(Entry const* entry) : entry_(entry) {}
+
+  Entry const* entry_;
+};
+
+/**
+ * Orders `Qualifier`s by their names, as unsigned bytes.
+ *
+ * It is transparent, so maps keyed by `Qualifier` can be searched for plain
+ * strings without interning them.
+ */
+struct QualifierLess {
+  using is_transparent = void;
+
+  bool operator()(Qualifier lhs, Qualifier rhs) const {
+    return lhs.entry_ != rhs.entry_ && lhs.name() < rhs.name();
+  }
+  bool operator()(Qualifier lhs, absl::string_view rhs) const {
+    return absl::string_view(lhs.name()) < rhs;
+  }
+  bool operator()(absl::string_view lhs, Qualifier rhs) const {
+    return lhs < absl::string_view(rhs.name());
+  }
+};
+
+/**
+ * The column qualifiers used in an in-memory column family.
+ *
+ * Wide tables repeat the same few qualifiers in every row. The rows only
+ * hold a `Qualifier` pointing to the single copy kept here, and code which
+ * needs to remember something per qualifier can index it by `id()`.
+ *
+ * Qualifiers are never removed from a dictionary. Instead, the family's value
+ * compaction re-interns the qualifiers of its rows in a new dictionary, and
+ * the old one is freed with the last snapshot or frozen segment using it.
+ *
+ * Like `ValueArena`, the class is not thread safe, but the interned
+ * `Qualifier`s can be read concurrently with `Intern()`.
+ */
+class QualifierDictionary {
+ public:
+  QualifierDictionary() = default;
+  QualifierDictionary(QualifierDictionary const&) = delete;
+  QualifierDictionary& operator=(QualifierDictionary const&) = delete;
+
+  /// The `Qualifier` for `name`, adding it if it isn't interned yet.
+  Qualifier Intern(absl::string_view name);
+  /// Like `Intern(qualifier.name())`, but cheap if `Owns(qualifier)`.
+  Qualifier Intern(Qualifier qualifier) {
+    return Owns(qualifier) ? qualifier : Intern(qualifier.name());
+  }
+
+  /// Whether `qualifier` was interned in this dictionary.
+  bool Owns(Qualifier qualifier) const {
+    return qualifier.id() < entries_.size() &&
+           &entries_[qualifier.id()] == qualifier.entry_;
+  }
+
+  std::size_t size() const { return entries_.size(); }
+
+ private:
+  // A deque, so that the entries never move.
+  std::deque<Qualifier::Entry> entries_;
+  absl::flat_hash_map<absl::string_view, Qualifier::Entry const*> index_;
+};
+
+/**
+ * Column qualifier regexes, evaluated once per interned qualifier.
+ *
+ * A scan with a `column_qualifier_regex_filter` would otherwise match the
+ * same few qualifiers again in every row. The results are remembered by
+ * `Qualifier::id()`. While a family's dictionary is rebuilt, its rows have
+ * qualifiers from two dictionaries, whose ids only evict each other's
+ * results.
+ *
+ * Objects of this class are not thread safe; each stream has its own.
+ */
+class QualifierRegexMemo {
+ public:
+  explicit QualifierRegexMemo(
+      std::vector<std::shared_ptr<RegexMatcher const>> regexes)
+      : regexes_(std::move(regexes)) {}
+
+  /// Whether `qualifier` partially matches all the regexes.
+  bool PartialMatch(Qualifier qualifier) const;
+
+ private:
+  struct Result {
+    // The qualifier the result is for, null if there is none yet.
+    Qualifier::Entry const* entry;
+    bool match;
+  };
+
+  std::vector<std::shared_ptr<RegexMatcher const>> regexes_;
+  mutable std::vector<Result> results_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_QUALIFIER_DICTIONARY_H
@@ -0,0 +1,123 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "qualifier_dictionary.h"
+#include "regex_matcher.h"
+#include "re2/re2.h"
+#include <gtest/gtest.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+TEST(QualifierDictionary, InternsOnce) {
+  QualifierDictionary dictionary;
+  auto const foo = dictionary.Intern("foo");
+  auto const bar = dictionary.Intern(std::string("bar"));
+  EXPECT_EQ(2U, dictionary.size());
+  EXPECT_EQ(0U, foo.id());
+  EXPECT_EQ(1U, bar.id());
+  EXPECT_EQ("foo", foo.name());
+  EXPECT_EQ("bar", bar);
+
+  auto const foo2 = dictionary.Intern(std::string("foo"));
+  EXPECT_EQ(2U, dictionary.size());
+  EXPECT_EQ(foo, foo2);
+  EXPECT_EQ(&foo.name(), &foo2.name());
+  EXPECT_NE(foo, bar);
+}
+
+TEST(QualifierDictionary, EntriesDoNotMove) {
+  QualifierDictionary dictionary;
+  // Short names are stored in the entries themselves.
+  auto const first = dictionary.Intern("a");
+  auto const* name = &first.name();
+  for (int i = 0; i != 10000; ++i) dictionary.Intern(std::to_string(i));
+  EXPECT_EQ(name, &dictionary.Intern("a").name());
+  EXPECT_EQ("a", *name);
+  EXPECT_EQ(10001U, dictionary.size());
+}
+
+TEST(QualifierDictionary, InternsFromOtherDictionaries) {
+  QualifierDictionary dictionary;
+  QualifierDictionary other;
+  auto const foo = dictionary.Intern("foo");
+  auto const other_bar = other.Intern("bar");
+  auto const other_foo = other.Intern("foo");
+  EXPECT_TRUE(dictionary.Owns(foo));
+  EXPECT_FALSE(dictionary.Owns(other_foo));
+  // The ids are the same, but the qualifiers are not.
+  EXPECT_FALSE(dictionary.Owns(other_bar));
+
+  EXPECT_EQ(&foo.name(), &dictionary.Intern(foo).name());
+  EXPECT_EQ(&foo.name(), &dictionary.Intern(other_foo).name());
+  auto const bar = dictionary.Intern(other_bar);
+  EXPECT_TRUE(dictionary.Owns(bar));
+  EXPECT_EQ(1U, bar.id());
+  EXPECT_EQ(other_bar, bar);
+  EXPECT_EQ(2U, dictionary.size());
+}
+
+TEST(QualifierLess, OrdersByName) {
+  QualifierDictionary dictionary;
+  std::map<Qualifier, int, QualifierLess> columns;
+  // Interned in a different order than the names sort in.
+  for (auto const* name : {"c", "a", "\xff", "b", ""}) {
+    columns.emplace(dictionary.Intern(name), 0);
+  }
+  std::vector<std::string> names;
+  for (auto const& column : columns) names.push_back(column.first);
+  EXPECT_EQ((std::vector<std::string>{"", "a", "b", "c", "\xff"}), names);
+
+  // Lookups by plain strings don't intern them.
+  EXPECT_EQ("b", columns.find(std::string("b"))->first);
+  EXPECT_EQ(columns.end(), columns.find(std::string("bb")));
+  EXPECT_EQ("c", columns.lower_bound(std::string("bb"))->first);
+  EXPECT_EQ(5U, dictionary.size());
+}
+
+TEST(QualifierRegexMemo, MatchesAllRegexes) {
+  auto matcher = [](std::string const& pattern) {
+    return std::make_shared<RegexMatcher const>(
+        std::make_shared<re2::RE2 const>(pattern));
+  };
+  QualifierRegexMemo memo({matcher("^col"), matcher("[02]$")});
+  QualifierDictionary dictionary;
+  EXPECT_TRUE(memo.PartialMatch(dictionary.Intern("col0")));
+  EXPECT_FALSE(memo.PartialMatch(dictionary.Intern("col1")));
+  EXPECT_FALSE(memo.PartialMatch(dictionary.Intern("foo2")));
+  EXPECT_TRUE(memo.PartialMatch(dictionary.Intern("col2")));
+  // The remembered results.
+  EXPECT_TRUE(memo.PartialMatch(dictionary.Intern("col0")));
+  EXPECT_FALSE(memo.PartialMatch(dictionary.Intern("col1")));
+
+  // Qualifiers with the same ids from another dictionary.
+  QualifierDictionary other;
+  EXPECT_FALSE(memo.PartialMatch(other.Intern("foo0")));
+  EXPECT_TRUE(memo.PartialMatch(other.Intern("col2")));
+  EXPECT_TRUE(memo.PartialMatch(dictionary.Intern("col0")));
+  EXPECT_FALSE(memo.PartialMatch(dictionary.Intern("col1")));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
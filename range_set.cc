@@ -407,7 +407,19 @@ bool StringRangeSet::Range::IsAboveEnd(Value const& value) const {
   return end_open_;
 }
 
-bool StringRangeSet::Range::IsWithin(Value const& value) const {
+bool StringRangeSet::Range::IsWithin(absl::string_view value) const {
+  // Compares without copying `value` into a `Value`, as this is called for
+  // every cell a value or column range filter visits.
+  if (absl::holds_alternative<Infinity>(start_)) return false;
+  auto const start_cmp = value.compare(absl::get<std::string>(start_));
+  if (start_cmp < 0 || (start_cmp == 0 && start_open_)) return false;
+  if (absl::holds_alternative<Infinity>(end_)) return true;
+  auto const end_cmp = value.compare(absl::get<std::string>(end_));
+  return end_cmp < 0 || (end_cmp == 0 && !end_open_);
+}
+
+bool StringRangeSet::Range::IsWithin(Infinity) const {
+  Value const value = Infinity{};
   return !IsAboveEnd(value) && !IsBelowStart(value);
 }
 
@@ -16,6 +16,7 @@
 #define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_RANGE_SET_H
 
 #include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/variant.h"
 #include <chrono>
 #include <ostream>
@@ -75,7 +76,8 @@ class StringRangeSet {
 
     bool IsBelowStart(Value const& value) const;
     bool IsAboveEnd(Value const& value) const;
-    bool IsWithin(Value const& value) const;
+    bool IsWithin(absl::string_view value) const;
+    bool IsWithin(Infinity) const;
     bool IsEmpty() const;
 
     static bool IsEmpty(StringRangeSet::Range::Value const& start,
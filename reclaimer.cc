@@ -0,0 +1,138 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reclaimer.h"
+#include "absl/strings/match.h"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+bool Covers(std::string const& name, std::string const& task_name) {
+  return absl::StartsWith(task_name, name) &&
+         (task_name.size() == name.size() || task_name[name.size()] == '/');
+}
+
+}  // namespace
+
+Reclaimer::Reclaimer() : thread_([this] { Loop(); }) {}
+
+Reclaimer::~Reclaimer() {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    stopping_ = true;
+  }
+  work_cv_.notify_all();
+  thread_.join();
+}
+
+void Reclaimer::Schedule(std::string name, std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    tasks_.emplace_back(std::move(name), std::move(task));
+    ++scheduled_;
+  }
+  work_cv_.notify_one();
+}
+
+void Reclaimer::Reserve(std::string name) {
+  std::lock_guard<std::mutex> lock(mu_);
+  reserved_.insert(std::move(name));
+}
+
+void Reclaimer::ScheduleReserved(std::string name,
+                                 std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mu_);
+    // Under one lock, so that `WaitFor()` sees the reservation or the task.
+    auto reservation = reserved_.find(name);
+    if (reservation != reserved_.end()) reserved_.erase(reservation);
+    tasks_.emplace_back(std::move(name), std::move(task));
+    ++scheduled_;
+  }
+  work_cv_.notify_one();
+}
+
+void Reclaimer::WaitFor(std::string const& name) {
+  std::unique_lock<std::mutex> lock(mu_);
+  done_cv_.wait(lock, [&] { return !HasTaskLocked(name); });
+}
+
+void Reclaimer::Drain() {
+  std::unique_lock<std::mutex> lock(mu_);
+  auto const target = scheduled_;
+  done_cv_.wait(lock, [&] { return completed_ >= target; });
+}
+
+Reclaimer::Progress Reclaimer::progress() const {
+  std::lock_guard<std::mutex> lock(mu_);
+  Progress res;
+  res.scheduled = scheduled_;
+  res.completed = completed_;
+  if (is_running_) res.running = running_;
+  return res;
+}
+
+void Reclaimer::Loop() {
+  std::unique_lock<std::mutex> lock(mu_);
+  for (;;) {
+    work_cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty()) return;
+    running_ = std::move(tasks_.front().first);
+    auto task = std::move(tasks_.front().second);
+    tasks_.pop_front();
+    is_running_ = true;
+    lock.unlock();
+    task();
+    // Release whatever the task captured, e.g. the last reference to a
+    // dropped table, before reporting it as completed.
+    task = nullptr;
+    lock.lock();
+    is_running_ = false;
+    ++completed_;
+    done_cv_.notify_all();
+  }
+}
+
+bool Reclaimer::HasTaskLocked(std::string const& name) const {
+  if (is_running_ && Covers(name, running_)) return true;
+  if (std::any_of(reserved_.begin(), reserved_.end(),
+                  [&name](auto const& reserved) {
+                    return Covers(name, reserved);
+                  })) {
+    return true;
+  }
+  return std::any_of(tasks_.begin(), tasks_.end(), [&name](auto const& task) {
+    return Covers(name, task.first);
+  });
+}
+
+Reclaimer& GlobalReclaimer() {
+  // Never destroyed, so that reclamation doesn't race with static destructors.
+  static auto* const kReclaimer = new Reclaimer;
+  return *kReclaimer;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
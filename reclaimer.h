@@ -0,0 +1,110 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_RECLAIMER_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_RECLAIMER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * Releases the memory and storage of dropped tables and column families on a
+ * background thread, so that the admin RPCs dropping them return right away.
+ *
+ * Each task is scheduled under the name of what it reclaims, e.g. the table
+ * name or `<table name>/<column family>`. Re-creating something by that name
+ * must first `WaitFor()` its reclamation, so that the new object's data is
+ * not reclaimed with the old one's. The tasks run one at a time, in the order
+ * they were scheduled. Whatever a task captures is released on the
+ * background thread as well.
+ *
+ * A name can be `Reserve()`d for a task which can't be scheduled yet, e.g.
+ * because RPCs still use what it reclaims, so that `WaitFor()` already
+ * waits for it.
+ *
+ * This object is thread safe.
+ */
+class Reclaimer {
+ public:
+  struct Progress {
+    std::int64_t scheduled = 0;
+    std::int64_t completed = 0;
+    /// The name of the task being run, empty if none is.
+    std::string running;
+
+    std::int64_t pending() const { return scheduled - completed; }
+  };
+
+  Reclaimer();
+  /// Runs the tasks which are already scheduled, then joins the thread.
+  ~Reclaimer();
+
+  Reclaimer(Reclaimer const&) = delete;
+  Reclaimer& operator=(Reclaimer const&) = delete;
+
+  void Schedule(std::string name, std::function<void()> task);
+  /// Makes `WaitFor(name)` wait for a task to be scheduled later by
+  /// `ScheduleReserved(name, ...)`.
+  void Reserve(std::string name);
+  /// Like `Schedule()`, and releases a reservation of `name`.
+  void ScheduleReserved(std::string name, std::function<void()> task);
+
+  /**
+   * Wait until no task named `name`, or named with `name + "/"` as a prefix,
+   * is scheduled or running.
+   */
+  void WaitFor(std::string const& name);
+  /// Wait until all the tasks scheduled so far have completed.
+  void Drain();
+
+  Progress progress() const;
+
+ private:
+  void Loop();
+  bool HasTaskLocked(std::string const& name) const;
+
+  mutable std::mutex mu_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  std::deque<std::pair<std::string, std::function<void()>>> tasks_;
+  std::multiset<std::string> reserved_;
+  std::string running_;
+  bool is_running_ = false;
+  std::int64_t scheduled_ = 0;
+  std::int64_t completed_ = 0;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+/// The reclaimer of the dropped tables and column families of all clusters.
+Reclaimer& GlobalReclaimer();
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_RECLAIMER_H
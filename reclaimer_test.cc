@@ -0,0 +1,131 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "reclaimer.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+TEST(Reclaimer, RunsTasksInOrderAndReportsProgress) {
+  Reclaimer reclaimer;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  std::promise<void> started;
+  std::vector<std::string> order;
+  reclaimer.Schedule("t1", [&] {
+    started.set_value();
+    released.wait();
+    order.emplace_back("t1");
+  });
+  reclaimer.Schedule("t2", [&] { order.emplace_back("t2"); });
+  started.get_future().wait();
+
+  auto progress = reclaimer.progress();
+  EXPECT_EQ(2, progress.scheduled);
+  EXPECT_EQ(0, progress.completed);
+  EXPECT_EQ(2, progress.pending());
+  EXPECT_EQ("t1", progress.running);
+
+  release.set_value();
+  reclaimer.Drain();
+  progress = reclaimer.progress();
+  EXPECT_EQ(2, progress.completed);
+  EXPECT_EQ(0, progress.pending());
+  EXPECT_EQ("", progress.running);
+  EXPECT_EQ((std::vector<std::string>{"t1", "t2"}), order);
+}
+
+TEST(Reclaimer, WaitForCoversNestedNames) {
+  Reclaimer reclaimer;
+  std::promise<void> release;
+  auto released = release.get_future().share();
+  reclaimer.Schedule("tables/t", [] {});
+  reclaimer.Schedule("tables/t/cf", [released] { released.wait(); });
+
+  // Neither a sibling nor a name sharing a prefix waits.
+  reclaimer.WaitFor("tables/t2");
+  reclaimer.WaitFor("tables/t/cf2");
+
+  std::atomic<bool> done{false};
+  std::thread waiter([&] {
+    reclaimer.WaitFor("tables/t");
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(done);
+  release.set_value();
+  waiter.join();
+  EXPECT_TRUE(done);
+}
+
+TEST(Reclaimer, WaitForWaitsForReservations) {
+  Reclaimer reclaimer;
+  reclaimer.Reserve("tables/t");
+  reclaimer.WaitFor("tables/t2");
+  EXPECT_EQ(0, reclaimer.progress().pending());
+
+  std::atomic<bool> done{false};
+  std::thread waiter([&] {
+    reclaimer.WaitFor("tables");
+    done = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(done);
+  // Only the reserved task releases the reservation.
+  reclaimer.Schedule("tables/t", [] {});
+  reclaimer.Drain();
+  EXPECT_FALSE(done);
+  bool ran = false;
+  reclaimer.ScheduleReserved("tables/t", [&ran] { ran = true; });
+  waiter.join();
+  EXPECT_TRUE(done);
+  EXPECT_TRUE(ran);
+}
+
+TEST(Reclaimer, ReleasesCapturesBeforeCompleting) {
+  Reclaimer reclaimer;
+  auto object = std::make_shared<std::vector<int>>(1000);
+  std::weak_ptr<std::vector<int>> weak = object;
+  reclaimer.Schedule("object", [object = std::move(object)] {});
+  reclaimer.WaitFor("object");
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(Reclaimer, DestructorRunsScheduledTasks) {
+  int runs = 0;
+  {
+    Reclaimer reclaimer;
+    for (int i = 0; i != 3; ++i) {
+      reclaimer.Schedule("t" + std::to_string(i), [&runs] { ++runs; });
+    }
+  }
+  EXPECT_EQ(3, runs);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
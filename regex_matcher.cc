@@ -0,0 +1,172 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "regex_matcher.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include "absl/types/optional.h"
+#include "re2/re2.h"
+#include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+struct LiteralShape {
+  RegexMatcher::Kind kind;
+  std::string literal;
+};
+
+// Whether `pattern[pos]` is preceded by an odd number of backslashes, i.e. it
+// is escaped.
+bool IsEscaped(absl::string_view pattern, std::size_t pos) {
+  std::size_t backslashes = 0;
+  while (pos > backslashes && pattern[pos - backslashes - 1] == '\\') {
+    ++backslashes;
+  }
+  return backslashes % 2 == 1;
+}
+
+bool IsMetaCharacter(char c) {
+  return std::strchr(".^$|?*+()[]{}", c) != nullptr;
+}
+
+// Unescape `pattern` if it is a literal string. Return `absl::nullopt` if it
+// contains anything but plain ASCII characters and escaped punctuation.
+//
+// Non-ASCII bytes are rejected because RE2 matches UTF-8 code points and we
+// don't want to reason about how it treats invalid sequences.
+absl::optional<std::string> ParseLiteral(absl::string_view pattern) {
+  std::string res;
+  res.reserve(pattern.size());
+  for (std::size_t i = 0; i < pattern.size(); ++i) {
+    auto const c = static_cast<unsigned char>(pattern[i]);
+    if (c >= 0x80 || IsMetaCharacter(pattern[i])) {
+      return absl::nullopt;
+    }
+    if (c != '\\') {
+      res.push_back(pattern[i]);
+      continue;
+    }
+    if (++i == pattern.size()) {
+      return absl::nullopt;
+    }
+    auto const escaped = static_cast<unsigned char>(pattern[i]);
+    // `\d`, `\b`, `\x41`, `\Q...\E` etc. are not literals.
+    if (escaped >= 0x80 || !std::ispunct(escaped)) {
+      return absl::nullopt;
+    }
+    res.push_back(pattern[i]);
+  }
+  return res;
+}
+
+// Recognize `[^]literal[$]` and `[.*]literal[.*]`.
+//
+// Note that `^.*foo` is not the same as `foo` because `.` doesn't match `\n`,
+// so `.*` is only stripped where it is not adjacent to an anchor.
+LiteralShape DetectShape(absl::string_view pattern) {
+  bool anchored_start = false;
+  bool anchored_end = false;
+  if (absl::ConsumePrefix(&pattern, "^")) {
+    anchored_start = true;
+  } else {
+    while (absl::ConsumePrefix(&pattern, ".*")) {
+    }
+  }
+  if (!pattern.empty() && pattern.back() == '$' &&
+      !IsEscaped(pattern, pattern.size() - 1)) {
+    anchored_end = true;
+    pattern.remove_suffix(1);
+  } else {
+    while (pattern.size() >= 2 &&
+           pattern.substr(pattern.size() - 2) == ".*" &&
+           !IsEscaped(pattern, pattern.size() - 2)) {
+      pattern.remove_suffix(2);
+    }
+  }
+  auto literal = ParseLiteral(pattern);
+  if (!literal) {
+    return LiteralShape{RegexMatcher::Kind::kRegex, {}};
+  }
+  if (anchored_start && anchored_end) {
+    return LiteralShape{RegexMatcher::Kind::kExact, *std::move(literal)};
+  }
+  if (literal->empty()) {
+    return LiteralShape{RegexMatcher::Kind::kAlways, {}};
+  }
+  if (anchored_start) {
+    return LiteralShape{RegexMatcher::Kind::kPrefix, *std::move(literal)};
+  }
+  if (anchored_end) {
+    return LiteralShape{RegexMatcher::Kind::kSuffix, *std::move(literal)};
+  }
+  return LiteralShape{RegexMatcher::Kind::kContains, *std::move(literal)};
+}
+
+}  // namespace
+
+RegexMatcher::RegexMatcher(std::shared_ptr<re2::RE2 const> regex)
+    : regex_(std::move(regex)) {
+  assert(regex_);
+  // Only the default options have the semantics `DetectShape()` assumes.
+  auto shape = regex_->ok() && regex_->options().case_sensitive() &&
+                       regex_->options().encoding() ==
+                           re2::RE2::Options::EncodingUTF8 &&
+                       !regex_->options().literal() &&
+                       !regex_->options().never_nl() &&
+                       !regex_->options().dot_nl()
+                   ? DetectShape(regex_->pattern())
+                   : LiteralShape{Kind::kRegex, {}};
+  kind_ = shape.kind;
+  literal_ = std::move(shape.literal);
+}
+
+bool RegexMatcher::PartialMatch(absl::string_view text) const {
+  switch (kind_) {
+    case Kind::kAlways:
+      return true;
+    case Kind::kContains:
+      // glibc's `memmem` uses a vectorized two-way search; it is several times
+      // faster than `string_view::find` on kilobyte-sized values.
+      return memmem(text.data(), text.size(), literal_.data(),
+                    literal_.size()) != nullptr;
+    case Kind::kPrefix:
+      return text.size() >= literal_.size() &&
+             std::memcmp(text.data(), literal_.data(), literal_.size()) == 0;
+    case Kind::kSuffix:
+      return text.size() >= literal_.size() &&
+             std::memcmp(text.data() + text.size() - literal_.size(),
+                         literal_.data(), literal_.size()) == 0;
+    case Kind::kExact:
+      return text == literal_;
+    case Kind::kRegex:
+      break;
+  }
+  return re2::RE2::PartialMatch(re2::StringPiece(text.data(), text.size()),
+                                *regex_);
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,89 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_REGEX_MATCHER_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_REGEX_MATCHER_H
+
+#include "absl/strings/string_view.h"
+#include "re2/re2.h"
+#include <memory>
+#include <string>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * A compiled regex with fast paths for patterns which are really literals.
+ *
+ * A large share of the regexes sent in `value_regex_filter` or
+ * `column_qualifier_regex_filter` are plain strings, `^prefix`, `suffix$`,
+ * `^exact$` or `.*substring.*`. For these shapes a partial match is equivalent
+ * to a `memcmp` or a substring search, which are vectorized by the C library
+ * and don't pay for RE2's per-byte automaton.
+ *
+ * The shape is detected once, when the object is created. Patterns which
+ * don't fit any of the shapes (or which we are not sure about) are evaluated
+ * by RE2.
+ *
+ * Objects of this class are immutable and thus thread safe.
+ */
+class RegexMatcher {
+ public:
+  /// The way `PartialMatch()` is evaluated.
+  enum class Kind {
+    // Anything we couldn't prove to be a literal; evaluated by RE2.
+    kRegex,
+    // The pattern matches every string, e.g. `` or `.*`.
+    kAlways,
+    // The text has to contain the literal.
+    kContains,
+    // The text has to start with the literal.
+    kPrefix,
+    // The text has to end with the literal.
+    kSuffix,
+    // The text has to be equal to the literal.
+    kExact,
+  };
+
+  /**
+   * Create a new object.
+   *
+   * @param regex a compiled regex. The caller should have verified that it is
+   *     `ok()`.
+   */
+  explicit RegexMatcher(std::shared_ptr<re2::RE2 const> regex);
+
+  /// Whether `text` contains a match of the pattern, like `RE2::PartialMatch`.
+  bool PartialMatch(absl::string_view text) const;
+
+  std::string const& pattern() const { return regex_->pattern(); }
+  re2::RE2 const& regex() const { return *regex_; }
+  Kind kind() const { return kind_; }
+  /// The literal used by the fast paths; empty for `kRegex` and `kAlways`.
+  std::string const& literal() const { return literal_; }
+
+ private:
+  std::shared_ptr<re2::RE2 const> regex_;
+  Kind kind_;
+  std::string literal_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_REGEX_MATCHER_H
@@ -0,0 +1,111 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "regex_matcher.h"
+#include "re2/re2.h"
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Emulates a scan over `kValues` cells with `state.range(0)` bytes of
+// printable payload each. Every 16th value contains the needle, at a random
+// position.
+std::size_t constexpr kValues = 256;
+std::string const kNeedle = "needle-7d3a";
+
+std::vector<std::string> MakeValues(std::size_t value_size) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> printable('a', 'z');
+  std::vector<std::string> values(kValues);
+  for (std::size_t i = 0; i != values.size(); ++i) {
+    auto& v = values[i];
+    v.resize(value_size);
+    for (auto& c : v) c = static_cast<char>(printable(gen));
+    if (i % 16 == 0 && value_size >= kNeedle.size()) {
+      auto pos = std::uniform_int_distribution<std::size_t>(
+          0, value_size - kNeedle.size())(gen);
+      v.replace(pos, kNeedle.size(), kNeedle);
+    }
+  }
+  return values;
+}
+
+void RunRe2(benchmark::State& state, std::string const& pattern) {
+  auto values = MakeValues(static_cast<std::size_t>(state.range(0)));
+  re2::RE2 regex(pattern);
+  for (auto _ : state) {
+    std::size_t matches = 0;
+    for (auto const& v : values) {
+      matches += re2::RE2::PartialMatch(v, regex) ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0) * kValues);
+}
+
+void RunMatcher(benchmark::State& state, std::string const& pattern) {
+  auto values = MakeValues(static_cast<std::size_t>(state.range(0)));
+  RegexMatcher matcher(std::make_shared<re2::RE2 const>(pattern));
+  for (auto _ : state) {
+    std::size_t matches = 0;
+    for (auto const& v : values) {
+      matches += matcher.PartialMatch(v) ? 1 : 0;
+    }
+    benchmark::DoNotOptimize(matches);
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0) * kValues);
+}
+
+void BM_Re2Substring(benchmark::State& state) {
+  RunRe2(state, ".*" + kNeedle + ".*");
+}
+void BM_MatcherSubstring(benchmark::State& state) {
+  RunMatcher(state, ".*" + kNeedle + ".*");
+}
+void BM_Re2Prefix(benchmark::State& state) { RunRe2(state, "^" + kNeedle); }
+void BM_MatcherPrefix(benchmark::State& state) {
+  RunMatcher(state, "^" + kNeedle);
+}
+// Not a literal - both run RE2; shows the overhead of the shape check.
+void BM_Re2Alternation(benchmark::State& state) {
+  RunRe2(state, kNeedle + "|other");
+}
+void BM_MatcherAlternation(benchmark::State& state) {
+  RunMatcher(state, kNeedle + "|other");
+}
+
+BENCHMARK(BM_Re2Substring)->Range(64, 16 << 10);
+BENCHMARK(BM_MatcherSubstring)->Range(64, 16 << 10);
+BENCHMARK(BM_Re2Prefix)->Range(64, 16 << 10);
+BENCHMARK(BM_MatcherPrefix)->Range(64, 16 << 10);
+BENCHMARK(BM_Re2Alternation)->Range(64, 16 << 10);
+BENCHMARK(BM_MatcherAlternation)->Range(64, 16 << 10);
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,110 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "regex_matcher.h"
+#include "re2/re2.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+RegexMatcher MakeMatcher(std::string const& pattern) {
+  auto regex = std::make_shared<re2::RE2 const>(pattern);
+  EXPECT_TRUE(regex->ok()) << pattern;
+  return RegexMatcher(std::move(regex));
+}
+
+TEST(RegexMatcher, DetectsShapes) {
+  struct TestCase {
+    std::string pattern;
+    RegexMatcher::Kind kind;
+    std::string literal;
+  };
+  std::vector<TestCase> const cases = {
+      {"", RegexMatcher::Kind::kAlways, ""},
+      {".*", RegexMatcher::Kind::kAlways, ""},
+      {"^", RegexMatcher::Kind::kAlways, ""},
+      {"foo", RegexMatcher::Kind::kContains, "foo"},
+      {".*foo.*", RegexMatcher::Kind::kContains, "foo"},
+      {".*foo", RegexMatcher::Kind::kContains, "foo"},
+      {"foo.*", RegexMatcher::Kind::kContains, "foo"},
+      {"^foo", RegexMatcher::Kind::kPrefix, "foo"},
+      {"foo$", RegexMatcher::Kind::kSuffix, "foo"},
+      {"^foo$", RegexMatcher::Kind::kExact, "foo"},
+      {"^$", RegexMatcher::Kind::kExact, ""},
+      {R"(^a\.b\*c)", RegexMatcher::Kind::kPrefix, "a.b*c"},
+      {R"(foo\$)", RegexMatcher::Kind::kContains, "foo$"},
+      {R"(foo\\$)", RegexMatcher::Kind::kSuffix, R"(foo\)"},
+      {R"(foo\.*)", RegexMatcher::Kind::kRegex, ""},
+      {"^.*foo", RegexMatcher::Kind::kRegex, ""},
+      {"foo.*$", RegexMatcher::Kind::kRegex, ""},
+      {"fo+", RegexMatcher::Kind::kRegex, ""},
+      {"foo|bar", RegexMatcher::Kind::kRegex, ""},
+      {"[a-z]", RegexMatcher::Kind::kRegex, ""},
+      {R"(\d)", RegexMatcher::Kind::kRegex, ""},
+      {"(?i)foo", RegexMatcher::Kind::kRegex, ""},
+      {"f\xC3\xB3o", RegexMatcher::Kind::kRegex, ""},
+  };
+  for (auto const& c : cases) {
+    SCOPED_TRACE("pattern: " + c.pattern);
+    auto matcher = MakeMatcher(c.pattern);
+    EXPECT_EQ(c.kind, matcher.kind());
+    EXPECT_EQ(c.literal, matcher.literal());
+    EXPECT_EQ(c.pattern, matcher.pattern());
+  }
+}
+
+TEST(RegexMatcher, NonDefaultOptionsUseRegex) {
+  re2::RE2::Options options;
+  options.set_case_sensitive(false);
+  RegexMatcher matcher(std::make_shared<re2::RE2 const>("foo", options));
+  EXPECT_EQ(RegexMatcher::Kind::kRegex, matcher.kind());
+  EXPECT_TRUE(matcher.PartialMatch("xFOOx"));
+}
+
+TEST(RegexMatcher, AgreesWithRe2) {
+  std::vector<std::string> const patterns = {
+      "",       ".*",      "^",          "$",           "foo",
+      ".*foo.*", "^foo",   "foo$",       "^foo$",       "^$",
+      "^.*foo", "foo.*$",  R"(a\.b)",    R"(foo\\$)",   R"(\$)",
+      "fo+",    "foo|bar", "^f[aeiou]o",
+  };
+  std::vector<std::string> const texts = {
+      "",          "foo",     "xfoo",       "foox",     "xfoox",
+      "fo",        "f",       "bar",        "\nfoo",    "foo\n",
+      "a.b",       "axb",     "foo\\",      "$",        "fofoo",
+      "FOO",       std::string("fo\0o", 4), std::string("\0foo", 4),
+      "\xff\xfe" "foo",
+  };
+  for (auto const& pattern : patterns) {
+    auto regex = std::make_shared<re2::RE2 const>(pattern);
+    ASSERT_TRUE(regex->ok()) << pattern;
+    RegexMatcher matcher(regex);
+    for (auto const& text : texts) {
+      EXPECT_EQ(re2::RE2::PartialMatch(text, *regex),
+                matcher.PartialMatch(text))
+          << "pattern=" << pattern << " text=" << text;
+    }
+  }
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,174 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "absl/container/btree_map.h"
+#include "column_family.h"
+#include "persistent_map.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Compare the maps which held the rows of `ColumnFamily`, a `std::map` and
+// then an `absl::btree_map`, with the `PersistentMap` it uses now. The rows
+// have no cells, and only the allocations of the containers themselves are
+// counted.
+std::size_t constexpr kRows = 100000;
+
+std::size_t allocated_bytes = 0;
+
+// Counts the bytes allocated by the containers, but not by the keys.
+template <typename T>
+struct CountingAllocator {
+  using value_type = T;
+
+  CountingAllocator() = default;
+  template <typename U>
+  explicit CountingAllocator(CountingAllocator<U> const&) {}
+
+  T* allocate(std::size_t n) {
+    allocated_bytes += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, std::size_t n) {
+    allocated_bytes -= n * sizeof(T);
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <typename U>
+  bool operator==(CountingAllocator<U> const&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(CountingAllocator<U> const&) const {
+    return false;
+  }
+};
+
+using Value = std::pair<std::string const, ColumnFamilyRow>;
+using StdMap = std::map<std::string, ColumnFamilyRow, std::less<>,
+                        CountingAllocator<Value>>;
+using BTreeMap = absl::btree_map<std::string, ColumnFamilyRow, std::less<>,
+                                 CountingAllocator<Value>>;
+using Persistent = PersistentMap<std::string, ColumnFamilyRow, std::less<>,
+                                 CountingAllocator<Value>>;
+
+// Row keys of the same shape as in the other benchmarks, in random order.
+std::vector<std::string> const& RowKeys() {
+  static auto const* const kKeys = [] {
+    auto* keys = new std::vector<std::string>;
+    for (std::size_t row = 0; row != kRows; ++row) {
+      keys->emplace_back("user#" + std::to_string(1000000 + row));
+    }
+    std::shuffle(keys->begin(), keys->end(), std::mt19937_64(42));
+    return keys;
+  }();
+  return *kKeys;
+}
+
+template <typename Map>
+Map const& Populated() {
+  static auto const* const kMap = [] {
+    auto* map = new Map;
+    for (auto const& key : RowKeys()) (*map)[key];
+    return map;
+  }();
+  return *kMap;
+}
+
+template <typename Map>
+void BM_RowIndexInsert(benchmark::State& state) {
+  auto const& keys = RowKeys();
+  for (auto _ : state) {
+    allocated_bytes = 0;
+    Map map;
+    for (auto const& key : keys) map[key];
+    state.PauseTiming();
+    state.counters["index_bytes_per_row"] =
+        static_cast<double>(allocated_bytes) / kRows;
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          kRows);
+}
+
+template <typename Map>
+void BM_RowIndexScan(benchmark::State& state) {
+  auto const& map = Populated<Map>();
+  for (auto _ : state) {
+    std::size_t size = 0;
+    for (auto const& row : map) size += row.first.size();
+    benchmark::DoNotOptimize(size);
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          kRows);
+}
+
+template <typename Map>
+void BM_RowIndexLowerBound(benchmark::State& state) {
+  auto const& map = Populated<Map>();
+  auto const& keys = RowKeys();
+  std::size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(map.lower_bound(keys[i]));
+    if (++i == keys.size()) i = 0;
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+// The first write after a snapshot, which copies the map.
+template <typename Map>
+void BM_RowIndexWriteAfterCopy(benchmark::State& state) {
+  auto const& map = Populated<Map>();
+  auto const& keys = RowKeys();
+  std::size_t i = 0;
+  for (auto _ : state) {
+    auto copy = map;
+    benchmark::DoNotOptimize(&copy[keys[i]]);
+    if (++i == keys.size()) i = 0;
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()));
+}
+
+BENCHMARK_TEMPLATE(BM_RowIndexInsert, StdMap);
+BENCHMARK_TEMPLATE(BM_RowIndexInsert, BTreeMap);
+BENCHMARK_TEMPLATE(BM_RowIndexInsert, Persistent);
+BENCHMARK_TEMPLATE(BM_RowIndexScan, StdMap);
+BENCHMARK_TEMPLATE(BM_RowIndexScan, BTreeMap);
+BENCHMARK_TEMPLATE(BM_RowIndexScan, Persistent);
+BENCHMARK_TEMPLATE(BM_RowIndexLowerBound, StdMap);
+BENCHMARK_TEMPLATE(BM_RowIndexLowerBound, BTreeMap);
+BENCHMARK_TEMPLATE(BM_RowIndexLowerBound, Persistent);
+BENCHMARK_TEMPLATE(BM_RowIndexWriteAfterCopy, StdMap);
+BENCHMARK_TEMPLATE(BM_RowIndexWriteAfterCopy, BTreeMap);
+BENCHMARK_TEMPLATE(BM_RowIndexWriteAfterCopy, Persistent);
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,63 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "row_lock_manager.h"
+#include "absl/hash/hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+RowLockManager::RowLockManager(std::size_t stripes)
+    : stripes_(std::max<std::size_t>(stripes, 1)),
+      mutexes_(new std::mutex[stripes_]) {}
+
+std::unique_lock<std::mutex> RowLockManager::Lock(absl::string_view row_key) {
+  auto& mu = mutexes_[Stripe(row_key)];
+  acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  std::unique_lock<std::mutex> lock(mu, std::try_to_lock);
+  if (lock.owns_lock()) return lock;
+
+  auto const start = std::chrono::steady_clock::now();
+  lock.lock();
+  auto const waited = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  contended_acquisitions_.fetch_add(1, std::memory_order_relaxed);
+  wait_nanos_.fetch_add(waited.count(), std::memory_order_relaxed);
+  return lock;
+}
+
+std::size_t RowLockManager::Stripe(absl::string_view row_key) const {
+  return absl::Hash<absl::string_view>{}(row_key) % stripes_;
+}
+
+LockContentionStats RowLockManager::Stats() const {
+  LockContentionStats res;
+  res.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+  res.contended_acquisitions =
+      contended_acquisitions_.load(std::memory_order_relaxed);
+  res.wait_time =
+      std::chrono::nanoseconds(wait_nanos_.load(std::memory_order_relaxed));
+  return res;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,75 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_ROW_LOCK_MANAGER_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_ROW_LOCK_MANAGER_H
+
+#include "absl/strings/string_view.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/// Counters describing how contended a set of locks is.
+struct LockContentionStats {
+  /// The number of times the locks were acquired.
+  std::int64_t acquisitions = 0;
+  /// The number of acquisitions which had to wait for another holder.
+  std::int64_t contended_acquisitions = 0;
+  /// The total time spent waiting in the contended acquisitions.
+  std::chrono::nanoseconds wait_time{0};
+};
+
+/**
+ * Serializes the transactions on each row of a table.
+ *
+ * Rows are hashed onto a fixed number of mutexes (stripes), so transactions
+ * on different rows only wait for each other if their rows share a stripe.
+ * This object is thread safe.
+ */
+class RowLockManager {
+ public:
+  static std::size_t constexpr kDefaultStripes = 256;
+
+  explicit RowLockManager(std::size_t stripes = kDefaultStripes);
+
+  /// Block until the lock of `row_key` is acquired.
+  std::unique_lock<std::mutex> Lock(absl::string_view row_key);
+
+  /// The index of the stripe guarding `row_key`.
+  std::size_t Stripe(absl::string_view row_key) const;
+
+  LockContentionStats Stats() const;
+
+ private:
+  std::size_t stripes_;
+  std::unique_ptr<std::mutex[]> mutexes_;
+  std::atomic<std::int64_t> acquisitions_{0};
+  std::atomic<std::int64_t> contended_acquisitions_{0};
+  std::atomic<std::int64_t> wait_nanos_{0};
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_ROW_LOCK_MANAGER_H
@@ -0,0 +1,125 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "row_lock_manager.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "table.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+TEST(RowLockManager, SameRowSameStripe) {
+  RowLockManager manager(16);
+  EXPECT_EQ(manager.Stripe("row1"), manager.Stripe("row1"));
+  for (auto const* row : {"", "row1", "row2", "a much longer row key"}) {
+    EXPECT_GT(16U, manager.Stripe(row));
+  }
+}
+
+TEST(RowLockManager, UncontendedLocks) {
+  RowLockManager manager;
+  {
+    auto lock = manager.Lock("row1");
+    EXPECT_TRUE(lock.owns_lock());
+  }
+  auto lock = manager.Lock("row1");
+  EXPECT_TRUE(lock.owns_lock());
+
+  auto const stats = manager.Stats();
+  EXPECT_EQ(2, stats.acquisitions);
+  EXPECT_EQ(0, stats.contended_acquisitions);
+  EXPECT_EQ(0, stats.wait_time.count());
+}
+
+TEST(RowLockManager, ContendedLockWaits) {
+  RowLockManager manager;
+  auto lock = manager.Lock("row1");
+  std::atomic<bool> acquired{false};
+  std::thread waiter([&] {
+    auto other = manager.Lock("row1");
+    acquired = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_FALSE(acquired);
+  lock.unlock();
+  waiter.join();
+  EXPECT_TRUE(acquired);
+
+  auto const stats = manager.Stats();
+  EXPECT_EQ(2, stats.acquisitions);
+  EXPECT_EQ(1, stats.contended_acquisitions);
+  EXPECT_LT(0, stats.wait_time.count());
+}
+
+TEST(TableRowLocks, ConcurrentMutationsOfManyRows) {
+  btadmin::Table schema;
+  schema.set_name("projects/test/instances/test/tables/row_locks");
+  (*schema.mutable_column_families())["cf"] = btadmin::ColumnFamily{};
+  auto maybe_table = Table::Create(schema);
+  ASSERT_STATUS_OK(maybe_table);
+  auto table = *maybe_table;
+
+  std::size_t constexpr kThreads = 8;
+  std::size_t constexpr kRowsPerThread = 50;
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t != kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (std::size_t i = 0; i != kRowsPerThread; ++i) {
+        btproto::MutateRowRequest request;
+        request.set_table_name(schema.name());
+        // Half of the mutations go to a row shared by all threads.
+        request.set_row_key(i % 2 == 0 ? "shared"
+                                       : "row" + std::to_string(t) + "_" +
+                                             std::to_string(i));
+        auto* set_cell = request.add_mutations()->mutable_set_cell();
+        set_cell->set_family_name("cf");
+        set_cell->set_column_qualifier("col" + std::to_string(t));
+        set_cell->set_timestamp_micros(
+            static_cast<std::int64_t>(1000 * (i + 1)));
+        set_cell->set_value("value");
+        EXPECT_STATUS_OK(table->MutateRow(request));
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  auto const mutations = static_cast<std::int64_t>(kThreads * kRowsPerThread);
+  auto const stats = table->GetStats();
+  EXPECT_EQ(1 + mutations / 2, stats.rows);
+  EXPECT_EQ(mutations, stats.column_families.at("cf").cells);
+  EXPECT_EQ(mutations, table->GetRowLockStats().acquisitions);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
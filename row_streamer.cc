@@ -55,7 +55,7 @@ bool RowStreamer::Stream(CellView const& cell) {
   chunk.set_timestamp_micros(
       std::chrono::duration_cast<std::chrono::microseconds>(cell.timestamp())
           .count());
-  chunk.set_value(cell.value());
+  chunk.set_value(cell.value().data(), cell.value().size());
   if (cell.HasLabel()) {
     *chunk.add_labels() = cell.label();
   }
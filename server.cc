@@ -38,6 +38,7 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace google {
 namespace cloud {
@@ -47,6 +48,10 @@ namespace emulator {
 namespace btproto = ::google::bigtable::v2;
 namespace btadmin = ::google::bigtable::admin::v2;
 
+// `CreateTable` request header selecting the table's `StorageLayout`, either
+// `per_family` (the default) or `single`.
+char constexpr kStorageLayoutHeader[] = "x-bigtable-emulator-storage-layout";
+
 class EmulatorService final : public btproto::Bigtable::Service {
  public:
   explicit EmulatorService(std::shared_ptr<Cluster> cluster)
@@ -73,9 +78,17 @@ class EmulatorService final : public btproto::Bigtable::Service {
       return ToGrpcStatus(maybe_table.status());
     }
 
-    auto& table = maybe_table.value();
-
-    return ToGrpcStatus(table->SampleRowKeys(0.0001, writer));
+    auto maybe_samples = (*maybe_table)->SampleRowKeys();
+    if (!maybe_samples) {
+      return ToGrpcStatus(maybe_samples.status());
+    }
+    for (std::size_t i = 0; i + 1 < maybe_samples->size(); ++i) {
+      writer->Write((*maybe_samples)[i]);
+    }
+    auto opts = grpc::WriteOptions();
+    opts.set_last_message();
+    writer->WriteLast(maybe_samples->back(), opts);
+    return grpc::Status::OK;
   }
 
   grpc::Status MutateRow(grpc::ServerContext* /* context */,
@@ -177,11 +190,33 @@ class EmulatorTableService final : public btadmin::BigtableTableAdmin::Service {
  public:
   explicit EmulatorTableService(std::shared_ptr<Cluster> cluster)
       : cluster_(std::move(cluster)) {}
-  grpc::Status CreateTable(grpc::ServerContext* /* context */,
+  grpc::Status CreateTable(grpc::ServerContext* context,
                            btadmin::CreateTableRequest const* request,
                            btadmin::Table* response) override {
     auto table_name = request->parent() + "/tables/" + request->table_id();
-    auto maybe_table = cluster_->CreateTable(table_name, request->table());
+    // The admin API has no notion of a storage layout, so it is chosen with
+    // an emulator specific request header.
+    auto storage_layout = StorageLayout::kColumnFamilyPerFamily;
+    auto const& metadata = context->client_metadata();
+    auto const layout_header = metadata.find(kStorageLayoutHeader);
+    if (layout_header != metadata.end()) {
+      auto const value = std::string(layout_header->second.data(),
+                                     layout_header->second.size());
+      auto maybe_layout = ParseStorageLayout(value);
+      if (!maybe_layout) {
+        return ToGrpcStatus(InvalidArgumentError(
+            "Unknown storage layout.",
+            GCP_ERROR_INFO().WithMetadata(kStorageLayoutHeader, value)));
+      }
+      storage_layout = *maybe_layout;
+    }
+    std::vector<std::string> initial_splits;
+    for (auto const& split : request->initial_splits()) {
+      initial_splits.push_back(split.key());
+    }
+    auto maybe_table = cluster_->CreateTable(table_name, request->table(),
+                                             storage_layout,
+                                             std::move(initial_splits));
     if (!maybe_table) {
       return ToGrpcStatus(maybe_table.status());
     }
@@ -1,6 +1,14 @@
 #include "storage.h"
 #include "constants.h"
+#include "reclaimer.h"
+#include "table_stats.h"
 #include "rocksdb/iterator.h"
+#include "rocksdb/merge_operator.h"
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "absl/strings/strip.h"
+#include <algorithm>
 #include <atomic>
 #include <iostream>
 #include <sstream>
@@ -11,6 +19,87 @@ namespace cloud {
 namespace bigtable {
 namespace emulator {
 
+std::string StorageLayoutName(StorageLayout layout) {
+    switch (layout) {
+        case StorageLayout::kColumnFamilyPerFamily:
+            return "per_family";
+        case StorageLayout::kSingleColumnFamily:
+            return "single";
+    }
+    return "per_family";
+}
+
+absl::optional<StorageLayout> ParseStorageLayout(const std::string& name) {
+    if (name == "per_family") return StorageLayout::kColumnFamilyPerFamily;
+    if (name == "single") return StorageLayout::kSingleColumnFamily;
+    return absl::nullopt;
+}
+
+std::string SingleLayoutColumnFamilyName(const std::string& table_name) {
+    // The trailing slash makes `DeleteColumnFamiliesForTable()` pick it up
+    // together with the per family ones.
+    return table_name + "/";
+}
+
+std::vector<std::chrono::milliseconds> ReadColumnTimestamps(
+    rocksdb::Iterator& it, absl::string_view column_prefix,
+    std::string const& resume_key) {
+    std::vector<std::chrono::milliseconds> res;
+    for (it.Seek(rocksdb::Slice(column_prefix.data(), column_prefix.size()));
+         it.Valid(); it.Next()) {
+        absl::string_view key(it.key().data(), it.key().size());
+        if (!absl::ConsumePrefix(&key, column_prefix)) break;
+        std::int64_t timestamp_ms;
+        if (absl::SimpleAtoi(key, &timestamp_ms)) {
+            res.emplace_back(timestamp_ms);
+        }
+    }
+    it.Seek(resume_key);
+    return res;
+}
+
+namespace {
+
+/**
+ * Adds up the `TableStats` deltas merged into the `/sys/stats/` keys.
+ *
+ * This lets row transactions write the change of the stats in the same
+ * batch as their cells, without reading the current stats. The deltas
+ * commute, so the transactions of different rows don't need to write them
+ * in the order in which they applied them in memory.
+ */
+class TableStatsMergeOperator : public rocksdb::AssociativeMergeOperator {
+ public:
+    bool Merge(rocksdb::Slice const& key,
+               rocksdb::Slice const* existing_value,
+               rocksdb::Slice const& value, std::string* new_value,
+               rocksdb::Logger*) const override {
+        StatusOr<TableStats> sum = TableStats{};
+        if (existing_value != nullptr) {
+            sum = TableStats::Parse(existing_value->ToString());
+        }
+        auto delta = TableStats::Parse(value.ToString());
+        if (!sum || !delta) {
+            std::cerr << "Cannot merge the stats under '" << key.ToString()
+                      << "'\n";
+            return false;
+        }
+        *sum += *delta;
+        *new_value = sum->Serialize();
+        return true;
+    }
+
+    char const* Name() const override { return "TableStatsMergeOperator"; }
+};
+
+rocksdb::ColumnFamilyOptions DefaultColumnFamilyOptions() {
+    rocksdb::ColumnFamilyOptions options;
+    options.merge_operator = std::make_shared<TableStatsMergeOperator>();
+    return options;
+}
+
+}  // namespace
+
 Storage::Storage(const std::string& db_path) {
     rocksdb::Options options;
     options.create_if_missing = true; 
@@ -24,10 +113,13 @@ Storage::Storage(const std::string& db_path) {
     // If DB exists but ListColumnFamilies failed (unlikely) or returned empty, 
     // we must at least open the default.
     if (!status.ok() || family_names.empty()) {
-        column_families.push_back(rocksdb::ColumnFamilyDescriptor(rocksdb::kDefaultColumnFamilyName, rocksdb::ColumnFamilyOptions()));
+        column_families.push_back(rocksdb::ColumnFamilyDescriptor(rocksdb::kDefaultColumnFamilyName, DefaultColumnFamilyOptions()));
     } else {
         for (const auto& name : family_names) {
-            column_families.push_back(rocksdb::ColumnFamilyDescriptor(name, rocksdb::ColumnFamilyOptions()));
+            column_families.push_back(rocksdb::ColumnFamilyDescriptor(
+                name, name == rocksdb::kDefaultColumnFamilyName
+                          ? DefaultColumnFamilyOptions()
+                          : rocksdb::ColumnFamilyOptions()));
         }
     }
 
@@ -67,6 +159,16 @@ rocksdb::ColumnFamilyHandle* Storage::GetOrAddHandle(const std::string& cf_name)
         return it->second;
     }
 
+    // The column families of a dropped table are not re-created, or they
+    // would outlive the removal of its data. Family ids contain no `/`.
+    auto const table_end = cf_name.rfind('/');
+    if (table_end != std::string::npos &&
+        dropped_tables_.count(cf_name.substr(0, table_end)) != 0) {
+        std::cerr << "Not creating Column Family '" << cf_name
+                  << "' of a dropped table" << std::endl;
+        return nullptr;
+    }
+
     // Create new column family
     rocksdb::ColumnFamilyHandle* handle;
     rocksdb::Status status = db_->CreateColumnFamily(rocksdb::ColumnFamilyOptions(), cf_name, &handle);
@@ -80,19 +182,70 @@ rocksdb::ColumnFamilyHandle* Storage::GetOrAddHandle(const std::string& cf_name)
     return handle;
 }
 
+rocksdb::ColumnFamilyHandle* Storage::FindHandle(const std::string& cf_name) {
+    std::lock_guard<std::mutex> lock(cf_mutex_);
+    auto it = cf_handles_.find(cf_name);
+    return it == cf_handles_.end() ? nullptr : it->second;
+}
+
+Storage::CellLocation Storage::LocateCells(const std::string& table_name,
+                                           const std::string& row_key,
+                                           const std::string& prefixed_cf_name,
+                                           StorageLayout layout) {
+    std::string key_prefix = "/tables/" + table_name + "/" + row_key + "/";
+    if (layout == StorageLayout::kColumnFamilyPerFamily) {
+        // The column family name is not part of the key because it is
+        // represented by the physical RocksDB Column Family.
+        return CellLocation{prefixed_cf_name, std::move(key_prefix)};
+    }
+    absl::string_view family = prefixed_cf_name;
+    absl::ConsumePrefix(&family, table_name + "/");
+    key_prefix.append(family.data(), family.size());
+    key_prefix.push_back('/');
+    return CellLocation{SingleLayoutColumnFamilyName(table_name),
+                        std::move(key_prefix)};
+}
+
 bool Storage::PutCell(const std::string& table_name, const std::string& row_key, const std::string& column_family,
       const std::string& column_qualifier, const std::chrono::milliseconds& timestamp, 
-      const std::string& value) {
-    
-    rocksdb::ColumnFamilyHandle* handle = GetOrAddHandle(column_family);
+      const std::string& value, StorageLayout layout) {
+    rocksdb::WriteBatch batch;
+    if (!PutCell(batch, table_name, row_key, column_family, column_qualifier,
+                 timestamp, value, layout)) {
+        return false;
+    }
+    return Write(batch);
+}
+
+bool Storage::PutCell(rocksdb::WriteBatch& batch, const std::string& table_name,
+                      const std::string& row_key,
+                      const std::string& prefixed_cf_name,
+                      const std::string& column_qualifier,
+                      std::chrono::milliseconds timestamp,
+                      absl::string_view value, StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = GetOrAddHandle(location.cf_name);
     if (!handle) return false;
 
-    // Note: column_family name is removed from the key string because 
-    // it is now represented by the physical RocksDB Column Family.
-    std::string full_key = "/tables/" + table_name + "/" + row_key + "/" + column_qualifier + "/" + std::to_string(timestamp.count());
+    std::string full_key = location.key_prefix + column_qualifier + "/" + std::to_string(timestamp.count());
+    return batch.Put(handle, full_key, rocksdb::Slice(value.data(), value.size()))
+        .ok();
+}
+
+void Storage::MergeTableStats(rocksdb::WriteBatch& batch,
+                              const std::string& table_name,
+                              const std::string& serialized_delta) {
+    batch.Merge(kStatsPrefix + table_name, serialized_delta);
+}
 
-    rocksdb::Status status = db_->Put(rocksdb::WriteOptions(), handle, full_key, value);
-    return status.ok();
+bool Storage::Write(rocksdb::WriteBatch& batch) {
+    if (batch.Count() == 0) return true;
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "Write failed: " << status.ToString() << std::endl;
+        return false;
+    }
+    return true;
 }
 
 bool Storage::PutRow(const std::string& row_key, const std::string& value) {
@@ -179,6 +332,12 @@ void Storage::GetRowData(const std::string& table_name, const std::string& row_k
 }
 
 void Storage::DeleteTable(std::string table_key) {
+    if (RemoveTableFromManifest(table_key)) {
+        DeleteTableData(table_key);
+    }
+}
+
+bool Storage::RemoveTableFromManifest(std::string const& table_key) {
     std::string table_key_to_remove = kTablesPrefix + table_key;
     std::string manifest = GetRow(kManifestKey);
 
@@ -201,11 +360,64 @@ void Storage::DeleteTable(std::string table_key) {
     }
 
     if (changed) {
-        PutRow(kManifestKey, new_manifest);
+        {
+            std::lock_guard<std::mutex> lock(cf_mutex_);
+            dropped_tables_.insert(table_key);
+        }
+        // Both or neither, so that a crash can't leave the table's data
+        // behind without a trace.
+        PutBatch({{kManifestKey, new_manifest},
+                  {kDroppedTablesPrefix + table_key, std::string()}});
+    }
+    return changed;
+}
+
+void Storage::DeleteTableData(std::string const& table_key) {
+    DeleteColumnFamiliesForTable(table_key + "/");
+
+    DeleteRow(kTablesPrefix + table_key);
+    DeleteRow(kLayoutsPrefix + table_key);
+    DeleteRow(kStatsPrefix + table_key);
+    DeleteRow(kTabletsPrefix + table_key);
+    // Last, so that the removal is retried if it is interrupted.
+    DeleteRow(kDroppedTablesPrefix + table_key);
+    // A new table by this name may create its column families now.
+    std::lock_guard<std::mutex> lock(cf_mutex_);
+    dropped_tables_.erase(table_key);
+}
 
-        DeleteColumnFamiliesForTable(table_key + "/");
+void Storage::FinishPendingDrops() {
+    std::vector<std::pair<std::string, std::string>> tables;
+    std::vector<std::pair<std::string, std::string>> families;
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(rocksdb::ReadOptions()));
+    for (auto* markers : {&tables, &families}) {
+        auto const& prefix =
+            markers == &tables ? kDroppedTablesPrefix : kDroppedFamiliesPrefix;
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+             it->Next()) {
+            markers->emplace_back(
+                it->key().ToString().substr(prefix.size()),
+                it->value().ToString());
+        }
+    }
+    it.reset();
 
-        DeleteRow(table_key_to_remove);
+    for (auto const& table : tables) {
+        DeleteTableData(table.first);
+    }
+    for (auto const& family : families) {
+        auto const& prefixed_cf_name = family.first;
+        // Family ids contain no `/`, unlike table names.
+        auto const table_end = prefixed_cf_name.rfind('/');
+        auto const layout = ParseStorageLayout(family.second);
+        if (table_end == std::string::npos || !layout) {
+            std::cerr << "Malformed dropped column family marker for '"
+                      << prefixed_cf_name << "'\n";
+            DeleteRow(kDroppedFamiliesPrefix + prefixed_cf_name);
+            continue;
+        }
+        DeleteColumnFamily(prefixed_cf_name.substr(0, table_end),
+                           prefixed_cf_name, *layout);
     }
 }
 
@@ -252,12 +464,63 @@ void Storage::DeleteColumnFamily(const std::string &prefixed_cf_name) {
     cf_handles_.erase(it);
 }
 
+void Storage::DeleteColumnFamily(const std::string& table_name,
+                                 const std::string& prefixed_cf_name,
+                                 StorageLayout layout) {
+    if (layout == StorageLayout::kColumnFamilyPerFamily) {
+        {
+            std::lock_guard<std::mutex> lock(cf_mutex_);
+            DeleteColumnFamily(prefixed_cf_name);
+        }
+        DeleteRow(kDroppedFamiliesPrefix + prefixed_cf_name);
+        return;
+    }
+    rocksdb::ColumnFamilyHandle* handle =
+        FindHandle(SingleLayoutColumnFamilyName(table_name));
+    if (handle == nullptr) {
+        DeleteRow(kDroppedFamiliesPrefix + prefixed_cf_name);
+        return;
+    }
+
+    absl::string_view family = prefixed_cf_name;
+    absl::ConsumePrefix(&family, table_name + "/");
+    std::string const table_prefix = "/tables/" + table_name + "/";
+    std::string const end_key = CalculatePrefixEnd(table_prefix);
+    rocksdb::Slice const upper_bound(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+
+    // The family is in the middle of the key, so its cells are interleaved
+    // with the other families' and have to be found one by one.
+    rocksdb::WriteBatch batch;
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(read_options, handle));
+    for (it->Seek(table_prefix); it->Valid(); it->Next()) {
+        absl::string_view key(it->key().data(), it->key().size());
+        key.remove_prefix(table_prefix.size());
+        auto const row_end = key.find('/');
+        if (row_end == absl::string_view::npos) continue;
+        key.remove_prefix(row_end + 1);
+        if (absl::ConsumePrefix(&key, family) && absl::StartsWith(key, "/")) {
+            batch.Delete(handle, it->key());
+        }
+    }
+    batch.Delete(kDroppedFamiliesPrefix + prefixed_cf_name);
+    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
+    if (!status.ok()) {
+        std::cerr << "DeleteColumnFamily failed for '" << prefixed_cf_name
+                  << "': " << status.ToString() << "\n";
+    }
+}
+
 void Storage::DeleteColumn(const std::string& table_name, const std::string& row_key, 
-                            const std::string &prefixed_cf_name, const std::string &column_name) {
-    std::string start_key = "/tables/" + table_name + "/" + row_key + "/" + column_name + "/";
+                            const std::string &prefixed_cf_name, const std::string &column_name,
+                            StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    std::string start_key = location.key_prefix + column_name + "/";
     std::string end_key = CalculatePrefixEnd(start_key);
 
-    rocksdb::ColumnFamilyHandle* handle = cf_handles_[prefixed_cf_name];
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return;
     rocksdb::WriteBatch batch;
 
     batch.DeleteRange(handle, start_key, end_key);
@@ -268,20 +531,51 @@ void Storage::DeleteColumn(const std::string& table_name, const std::string& row
     }
 }
 
+bool Storage::DeleteColumn(rocksdb::WriteBatch& batch,
+                           std::string const& table_name,
+                           std::string const& row_key,
+                           std::string const& prefixed_cf_name,
+                           std::string const& column_name,
+                           std::chrono::milliseconds start,
+                           std::chrono::milliseconds end,
+                           StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return false;
+
+    std::string const start_key = location.key_prefix + column_name + "/";
+    std::string const end_key = CalculatePrefixEnd(start_key);
+    if (start.count() <= 0 && end.count() == 0) {
+        return batch.DeleteRange(handle, start_key, end_key).ok();
+    }
+
+    // The timestamps are decimal strings, so they are not in the order of
+    // the keys and the column's cells have to be checked one by one.
+    rocksdb::Slice const upper_bound(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(read_options, handle));
+    for (it->Seek(start_key); it->Valid(); it->Next()) {
+        absl::string_view key(it->key().data(), it->key().size());
+        key.remove_prefix(start_key.size());
+        std::int64_t timestamp;
+        if (!absl::SimpleAtoi(key, &timestamp)) continue;
+        if (timestamp < start.count()) continue;
+        if (end.count() != 0 && timestamp >= end.count()) continue;
+        batch.Delete(handle, it->key());
+    }
+    return it->status().ok();
+}
+
 bool Storage::DeleteCell(
     std::string const& table_name, std::string const& row_key,
     std::string const& prefixed_cf_name, std::string const& column_name,
-    std::chrono::milliseconds const& timestamp) {
-    rocksdb::ColumnFamilyHandle* handle = nullptr;
-    {
-        std::lock_guard<std::mutex> lock(cf_mutex_);
-        auto it = cf_handles_.find(prefixed_cf_name);
-        if (it == cf_handles_.end()) return false;
-        handle = it->second;
-    }
+    std::chrono::milliseconds const& timestamp, StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return false;
 
-    std::string const full_key = "/tables/" + table_name + "/" + row_key + "/" +
-                                 column_name + "/" +
+    std::string const full_key = location.key_prefix + column_name + "/" +
                                  std::to_string(timestamp.count());
     auto const status = db_->Delete(rocksdb::WriteOptions(), handle, full_key);
     if (!status.ok()) {
@@ -292,45 +586,101 @@ bool Storage::DeleteCell(
     return true;
 }
 
+bool Storage::DeleteCell(rocksdb::WriteBatch& batch,
+                         std::string const& table_name,
+                         std::string const& row_key,
+                         std::string const& prefixed_cf_name,
+                         std::string const& column_name,
+                         std::chrono::milliseconds timestamp,
+                         StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return false;
+
+    std::string const full_key = location.key_prefix + column_name + "/" +
+                                 std::to_string(timestamp.count());
+    return batch.Delete(handle, full_key).ok();
+}
+
 void Storage::DeleteRow(const std::string& table_name, const std::string& row_key) {
+    rocksdb::WriteBatch batch;
+    DeleteRow(batch, table_name, row_key);
+    if (!Write(batch)) {
+        std::cerr << "DeleteRow failed for row '" << row_key << "'\n";
+    }
+}
+
+void Storage::DeleteRow(rocksdb::WriteBatch& batch,
+                        const std::string& table_name,
+                        const std::string& row_key) {
     std::string start_key = "/tables/" + table_name + "/" + row_key + "/";
     std::string end_key = CalculatePrefixEnd(start_key);
 
-    rocksdb::WriteBatch batch;
+    // Rows of other tables may be concurrently adding handles.
+    std::lock_guard<std::mutex> lock(cf_mutex_);
     for (const auto& pair : cf_handles_) {
         rocksdb::ColumnFamilyHandle* handle = pair.second;
         batch.DeleteRange(handle, start_key, end_key);
     }
-    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
-    if (!status.ok()) {
-        std::cerr << "DeleteRow failed for row '" << row_key
-                  << "': " << status.ToString() << "\n";
-    }
 }
 
 bool Storage::DeleteCFRow(const std::string& table_name, const std::string& row_key,
-        const std::string &prefixed_cf_name) {
-    rocksdb::ColumnFamilyHandle* handle;
-    auto it = cf_handles_.find(prefixed_cf_name);
-    if (it != cf_handles_.end()) {
-        handle = it->second;
-    } else {
+        const std::string &prefixed_cf_name, StorageLayout layout) {
+    rocksdb::WriteBatch batch;
+    if (!DeleteCFRow(batch, table_name, row_key, prefixed_cf_name, layout)) {
         return false;
     }
+    if (!Write(batch)) {
+        std::cerr << "DeleteCFRow failed for '" << prefixed_cf_name << "'\n";
+        return false;
+    }
+    return true;
+}
 
-    std::string start_key = "/tables/" + table_name + "/" + row_key + "/";
+bool Storage::DeleteCFRow(rocksdb::WriteBatch& batch,
+                          const std::string& table_name,
+                          const std::string& row_key,
+                          const std::string& prefixed_cf_name,
+                          StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return false;
+
+    std::string start_key = location.key_prefix;
     std::string end_key = CalculatePrefixEnd(start_key);
+    return batch.DeleteRange(handle, start_key, end_key).ok();
+}
 
-    rocksdb::WriteBatch batch;
-    batch.DeleteRange(handle, start_key, end_key);
-    rocksdb::Status status = db_->Write(rocksdb::WriteOptions(), &batch);
-    if (!status.ok()) {
-        std::cerr << "DeleteCFRow failed for '" << prefixed_cf_name
-                  << "': " << status.ToString() << "\n";
-        return false;
+std::map<std::string, std::map<std::chrono::milliseconds, std::size_t>>
+Storage::ReadCellSizes(std::string const& table_name,
+                       std::string const& row_key,
+                       std::string const& prefixed_cf_name,
+                       StorageLayout layout) {
+    std::map<std::string, std::map<std::chrono::milliseconds, std::size_t>>
+        res;
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return res;
+
+    std::string const end_key = CalculatePrefixEnd(location.key_prefix);
+    rocksdb::Slice const upper_bound(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+    std::unique_ptr<rocksdb::Iterator> it(db_->NewIterator(read_options, handle));
+    for (it->Seek(location.key_prefix); it->Valid(); it->Next()) {
+        absl::string_view key(it->key().data(), it->key().size());
+        key.remove_prefix(location.key_prefix.size());
+        // The qualifier may contain slashes, the timestamp doesn't.
+        auto const pos = key.rfind('/');
+        std::int64_t timestamp;
+        if (pos == absl::string_view::npos ||
+            !absl::SimpleAtoi(key.substr(pos + 1), &timestamp)) {
+            continue;
+        }
+        res[std::string(key.substr(0, pos))]
+           [std::chrono::milliseconds(timestamp)] = it->value().size();
     }
-
-    return true;
+    return res;
 }
 
 bool Storage::CFExists(const std::string &prefixed_cf_name) {
@@ -338,16 +688,24 @@ bool Storage::CFExists(const std::string &prefixed_cf_name) {
 }
 
 bool Storage::RowExistsInCF(const std::string& table_name, const std::string& row_key,
-    const std::string &prefixed_cf_name) {
-    rocksdb::ColumnFamilyHandle* handle = cf_handles_[prefixed_cf_name];
+    const std::string &prefixed_cf_name, StorageLayout layout) {
+    auto location = LocateCells(table_name, row_key, prefixed_cf_name, layout);
+    rocksdb::ColumnFamilyHandle* handle = FindHandle(location.cf_name);
+    if (handle == nullptr) return false;
 
-    std::string start_key = "/tables/" + table_name + "/" + row_key + "/";
+    std::string start_key = location.key_prefix;
     std::string end_key = CalculatePrefixEnd(start_key);
 
     return !IsRangeEmpty(handle, start_key, end_key);
 }
 
+StorageLayout Storage::GetTableLayout(const std::string& table_name) {
+    auto layout = ParseStorageLayout(GetRow(kLayoutsPrefix + table_name));
+    return layout.value_or(StorageLayout::kColumnFamilyPerFamily);
+}
+
 bool Storage::RowExists(const std::string& table_name, const std::string& row_key) {
+    std::lock_guard<std::mutex> lock(cf_mutex_);
     for (const auto& pair : cf_handles_) {
         rocksdb::ColumnFamilyHandle* handle = pair.second;
         std::string start_key = "/tables/" + table_name + "/" + row_key + "/";
@@ -361,10 +719,99 @@ bool Storage::RowExists(const std::string& table_name, const std::string& row_ke
     return false;
 }
 
-rocksdb::Iterator* Storage::NewIterator(const std::string& cf_name) {
+rocksdb::Iterator* Storage::NewIterator(const std::string& cf_name,
+                                        const rocksdb::Snapshot* snapshot) {
     rocksdb::ColumnFamilyHandle* handle = GetOrAddHandle(cf_name);
     if (!handle) return nullptr;
-    return db_->NewIterator(rocksdb::ReadOptions(), handle);
+    rocksdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    return db_->NewIterator(read_options, handle);
+}
+
+std::shared_ptr<const rocksdb::Snapshot> Storage::GetSnapshot() {
+    rocksdb::DB* db = db_.get();
+    return std::shared_ptr<const rocksdb::Snapshot>(
+        db->GetSnapshot(),
+        [db](const rocksdb::Snapshot* snapshot) {
+            db->ReleaseSnapshot(snapshot);
+        });
+}
+
+std::uint64_t Storage::GetApproximateSize(
+    const std::vector<std::string>& cf_names, const std::string& start_key,
+    const std::string& end_key) {
+    if (end_key <= start_key) return 0;
+    rocksdb::SizeApproximationOptions options;
+    options.include_memtables = true;
+    options.include_files = true;
+    rocksdb::Range const range(start_key, end_key);
+    std::uint64_t total = 0;
+    for (const auto& cf_name : cf_names) {
+        rocksdb::ColumnFamilyHandle* handle = FindHandle(cf_name);
+        if (handle == nullptr) continue;
+        std::uint64_t size = 0;
+        rocksdb::Status status =
+            db_->GetApproximateSizes(options, handle, &range, 1, &size);
+        if (status.ok()) total += size;
+    }
+    return total;
+}
+
+std::string Storage::FindApproximateSplitKey(
+    const std::vector<std::string>& cf_names, const std::string& start_key,
+    const std::string& end_key, std::uint64_t target_bytes) {
+    // Build the key one byte at a time: at each step, binary search for the
+    // largest next byte which keeps [start_key, key) within `target_bytes`.
+    // Stop once the keys starting with `key` are small enough not to matter.
+    std::size_t constexpr kMaxKeyLength = 256;
+    std::uint64_t const tolerance = target_bytes / 64;
+
+    std::string key;
+    auto const common = std::mismatch(start_key.begin(), start_key.end(),
+                                      end_key.begin(), end_key.end());
+    key.assign(start_key.begin(), common.first);
+    while (key.size() < kMaxKeyLength &&
+           GetApproximateSize(cf_names, std::max(key, start_key),
+                              CalculatePrefixEnd(key)) > tolerance) {
+        // `lo` is the largest byte known to fit, -1 if none does yet.
+        int lo = -1;
+        int hi = 256;
+        while (hi - lo > 1) {
+            int const mid = lo + (hi - lo) / 2;
+            auto const candidate = key + static_cast<char>(mid);
+            if (GetApproximateSize(cf_names, start_key, candidate) <=
+                target_bytes) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        // `key` itself holds a cell which doesn't fit.
+        if (lo < 0) break;
+        key.push_back(static_cast<char>(lo));
+    }
+    return key;
+}
+
+absl::optional<std::string> Storage::FindFirstKey(
+    const std::vector<std::string>& cf_names, const std::string& start_key,
+    const std::string& end_key) {
+    absl::optional<std::string> first;
+    rocksdb::Slice const upper_bound(end_key);
+    rocksdb::ReadOptions read_options;
+    read_options.iterate_upper_bound = &upper_bound;
+    for (const auto& cf_name : cf_names) {
+        rocksdb::ColumnFamilyHandle* handle = FindHandle(cf_name);
+        if (handle == nullptr) continue;
+        std::unique_ptr<rocksdb::Iterator> it(
+            db_->NewIterator(read_options, handle));
+        it->Seek(start_key);
+        if (!it->Valid() || it->key().compare(end_key) >= 0) continue;
+        if (!first || it->key().compare(*first) < 0) {
+            first = it->key().ToString();
+        }
+    }
+    return first;
 }
 
 bool Storage::IsRangeEmpty(rocksdb::ColumnFamilyHandle* handle, 
@@ -397,6 +844,7 @@ static void init_storage_once(void) {
     return;
   }
   g_storage = new Storage(g_storage_db_name);
+  g_storage->FinishPendingDrops();
 }
 
 int InitGlobalStorage(char const* db_name) {
@@ -424,6 +872,8 @@ Storage* GetGlobalStorage(void) {
 }
 
 void CloseGlobalStorage(void) {
+  // Reclamation tasks may still be removing dropped data from the storage.
+  GlobalReclaimer().Drain();
   pthread_mutex_lock(&g_storage_mu);
   if (g_storage) {
     delete g_storage;
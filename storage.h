@@ -1,17 +1,62 @@
 #pragma once
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "rocksdb/db.h"
+#include "rocksdb/write_batch.h"
 
 namespace google {
 namespace cloud {
 namespace bigtable {
 namespace emulator {
 
+/**
+ * How the cells of a table are laid out in RocksDB.
+ *
+ * The layout is chosen when a table is created and cannot be changed later.
+ */
+enum class StorageLayout {
+  /**
+   * Every Bigtable column family is a separate RocksDB column family named
+   * `<table_name>/<column_family>`, with keys
+   * `/tables/<table_name>/<row_key>/<column_qualifier>/<timestamp_ms>`.
+   *
+   * Dropping a column family is cheap, but scanning a table requires merging
+   * one iterator per column family.
+   */
+  kColumnFamilyPerFamily,
+  /**
+   * All column families share one RocksDB column family named
+   * `<table_name>/`, with keys
+   * `/tables/<table_name>/<row_key>/<column_family>/<column_qualifier>/<timestamp_ms>`.
+   *
+   * A table scan is a single ordered iterator, but dropping a column family
+   * has to scan the whole table.
+   */
+  kSingleColumnFamily,
+};
+
+/// The name under which `layout` is persisted, e.g. `single`.
+std::string StorageLayoutName(StorageLayout layout);
+/// The inverse of `StorageLayoutName()`.
+absl::optional<StorageLayout> ParseStorageLayout(std::string const& name);
+/// The RocksDB column family of a table in `kSingleColumnFamily` layout.
+std::string SingleLayoutColumnFamilyName(std::string const& table_name);
+/// The timestamps of the cells whose keys are `column_prefix` followed by
+/// a timestamp, in the order of their keys. Leaves `it` at `resume_key`.
+std::vector<std::chrono::milliseconds> ReadColumnTimestamps(
+    rocksdb::Iterator& it, absl::string_view column_prefix,
+    std::string const& resume_key);
+
 class Storage {
  public:
   Storage(std::string const& db_path);
@@ -21,7 +66,23 @@ class Storage {
                std::string const& column_family,
                std::string const& column_qualifier,
                std::chrono::milliseconds const& timestamp,
-               std::string const& value);
+               std::string const& value,
+               StorageLayout layout = StorageLayout::kColumnFamilyPerFamily);
+
+  // Like `PutCell()` above, but only adds the write to `batch`.
+  bool PutCell(rocksdb::WriteBatch& batch, std::string const& table_name,
+               std::string const& row_key,
+               std::string const& prefixed_cf_name,
+               std::string const& column_qualifier,
+               std::chrono::milliseconds timestamp, absl::string_view value,
+               StorageLayout layout);
+  // Add the serialized `TableStats` `serialized_delta` to the persisted
+  // stats of `table_name`, when `batch` is written.
+  void MergeTableStats(rocksdb::WriteBatch& batch,
+                       std::string const& table_name,
+                       std::string const& serialized_delta);
+  // Apply all the writes in `batch` atomically.
+  bool Write(rocksdb::WriteBatch& batch);
 
   bool PutRow(std::string const& row_key, std::string const& value);
   std::string GetRow(std::string const& row_key);
@@ -32,23 +93,91 @@ class Storage {
   void ScanDatabase(void);
   void GetRowData(std::string const& table_name, std::string const& row_key);
   void DeleteTable(std::string table_name);
+  // Forget `table_name` on restart, and record that its data is still to be
+  // removed. Until it is, writes to the table's column families which don't
+  // exist yet fail. Returns whether it was in the manifest.
+  bool RemoveTableFromManifest(std::string const& table_name);
+  // Remove the cells, schema and stats of a table no longer in the manifest.
+  void DeleteTableData(std::string const& table_name);
+  // Finish removing the tables and column families whose removal was
+  // interrupted, e.g. by a crash. Called when the storage is opened.
+  void FinishPendingDrops();
   void DeleteColumnFamiliesForTable(std::string const& table_prefix);
   void DeleteColumnFamily(std::string const& prefixed_cf_name);
-  void DeleteColumn(std::string const& table_name, std::string const& row_key,
+  // Remove all the cells of a Bigtable column family of `table_name`, and
+  // then its `kDroppedFamiliesPrefix` marker.
+  void DeleteColumnFamily(std::string const& table_name,
+                          std::string const& prefixed_cf_name,
+                          StorageLayout layout);
+  void DeleteColumn(
+      std::string const& table_name, std::string const& row_key,
+      std::string const& prefixed_cf_name, std::string const& column_name,
+      StorageLayout layout = StorageLayout::kColumnFamilyPerFamily);
+  // Add the deletion of the column's stored cells with timestamps in
+  // [start, end) to `batch`. An `end` of 0 means no upper bound.
+  bool DeleteColumn(rocksdb::WriteBatch& batch, std::string const& table_name,
+                    std::string const& row_key,
                     std::string const& prefixed_cf_name,
-                    std::string const& column_name);
-  bool DeleteCell(std::string const& table_name, std::string const& row_key,
+                    std::string const& column_name,
+                    std::chrono::milliseconds start,
+                    std::chrono::milliseconds end, StorageLayout layout);
+  bool DeleteCell(
+      std::string const& table_name, std::string const& row_key,
+      std::string const& prefixed_cf_name, std::string const& column_name,
+      std::chrono::milliseconds const& timestamp,
+      StorageLayout layout = StorageLayout::kColumnFamilyPerFamily);
+  // The overloads taking a `batch` only add the deletions to it.
+  bool DeleteCell(rocksdb::WriteBatch& batch, std::string const& table_name,
+                  std::string const& row_key,
                   std::string const& prefixed_cf_name,
                   std::string const& column_name,
-                  std::chrono::milliseconds const& timestamp);
+                  std::chrono::milliseconds timestamp, StorageLayout layout);
   void DeleteRow(std::string const& table_name, std::string const& row_key);
-  bool DeleteCFRow(std::string const& table_name, std::string const& row_key,
-                   std::string const& prefixed_cf_name);
+  void DeleteRow(rocksdb::WriteBatch& batch, std::string const& table_name,
+                 std::string const& row_key);
+  bool DeleteCFRow(
+      std::string const& table_name, std::string const& row_key,
+      std::string const& prefixed_cf_name,
+      StorageLayout layout = StorageLayout::kColumnFamilyPerFamily);
+  bool DeleteCFRow(rocksdb::WriteBatch& batch, std::string const& table_name,
+                   std::string const& row_key,
+                   std::string const& prefixed_cf_name, StorageLayout layout);
+  // The sizes of the values of the stored cells of `row_key` in
+  // `prefixed_cf_name`, by column qualifier and timestamp.
+  std::map<std::string, std::map<std::chrono::milliseconds, std::size_t>>
+  ReadCellSizes(std::string const& table_name, std::string const& row_key,
+                std::string const& prefixed_cf_name, StorageLayout layout);
   bool CFExists(std::string const& prefixed_cf_name);
-  bool RowExistsInCF(std::string const& table_name, std::string const& row_key,
-                     std::string const& prefixed_cf_name);
+  bool RowExistsInCF(
+      std::string const& table_name, std::string const& row_key,
+      std::string const& prefixed_cf_name,
+      StorageLayout layout = StorageLayout::kColumnFamilyPerFamily);
+  // The layout persisted by `store_schema()`; tables created before layouts
+  // were introduced use `kColumnFamilyPerFamily`.
+  StorageLayout GetTableLayout(std::string const& table_name);
   bool RowExists(std::string const& table_name, std::string const& row_key);
-  rocksdb::Iterator* NewIterator(std::string const& cf_name);
+  // If `snapshot` is not null, the iterator reads from it.
+  rocksdb::Iterator* NewIterator(std::string const& cf_name,
+                                 rocksdb::Snapshot const* snapshot = nullptr);
+  // A consistent view of the database, released when the last copy of the
+  // returned pointer is destroyed.
+  std::shared_ptr<rocksdb::Snapshot const> GetSnapshot();
+  // The approximate size of the keys in [start_key, end_key) in all of
+  // `cf_names`, from RocksDB's metadata (SST index blocks and memtables).
+  std::uint64_t GetApproximateSize(std::vector<std::string> const& cf_names,
+                                   std::string const& start_key,
+                                   std::string const& end_key);
+  // A key `k` such that [start_key, k) holds about `target_bytes` of data in
+  // `cf_names`. It is found using only `GetApproximateSize()`, so it need not
+  // exist.
+  std::string FindApproximateSplitKey(std::vector<std::string> const& cf_names,
+                                      std::string const& start_key,
+                                      std::string const& end_key,
+                                      std::uint64_t target_bytes);
+  // The smallest existing key in [start_key, end_key) in any of `cf_names`.
+  absl::optional<std::string> FindFirstKey(
+      std::vector<std::string> const& cf_names, std::string const& start_key,
+      std::string const& end_key);
   bool IsRangeEmpty(rocksdb::ColumnFamilyHandle* handle,
                     rocksdb::Slice const& start_key,
                     rocksdb::Slice const& end_key);
@@ -56,8 +185,23 @@ class Storage {
  private:
   std::unique_ptr<rocksdb::DB> db_;
   std::unordered_map<std::string, rocksdb::ColumnFamilyHandle*> cf_handles_;
+  // The tables removed from the manifest whose data isn't deleted yet. No
+  // column families are created for them. Guarded by `cf_mutex_`.
+  std::set<std::string> dropped_tables_;
   std::mutex cf_mutex_;
   rocksdb::ColumnFamilyHandle* GetOrAddHandle(std::string const& cf_name);
+  rocksdb::ColumnFamilyHandle* FindHandle(std::string const& cf_name);
+
+  // The RocksDB column family holding the cells of `row_key` in
+  // `prefixed_cf_name` and the prefix of their keys (ending with a `/`).
+  struct CellLocation {
+    std::string cf_name;
+    std::string key_prefix;
+  };
+  static CellLocation LocateCells(std::string const& table_name,
+                                  std::string const& row_key,
+                                  std::string const& prefixed_cf_name,
+                                  StorageLayout layout);
 };
 
 int InitGlobalStorage(char const* path);
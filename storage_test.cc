@@ -20,6 +20,7 @@
 #include <chrono>
 #include <cstddef>
 #include <filesystem>
+#include <map>
 #include <memory>
 #include <string>
 #include <system_error>
@@ -138,6 +139,33 @@ TEST_F(StorageTest, DeleteColumnRemovesOnlyTargetQualifier) {
   EXPECT_TRUE(storage_->RowExistsInCF(table, row, cf));
 }
 
+TEST_F(StorageTest, ReadCellSizesReadsOnlyTheRowsCellsInTheFamily) {
+  auto const table = "projects/p/instances/i/tables/t11";
+  auto const cf1 = std::string(table) + "/cf1";
+  auto const cf2 = std::string(table) + "/cf2";
+  auto const layout = bt_emulator::StorageLayout::kSingleColumnFamily;
+  using std::chrono::milliseconds;
+
+  EXPECT_TRUE(storage_->PutCell(table, "row-1", cf1, "c1", milliseconds(1),
+                                "v", layout));
+  EXPECT_TRUE(storage_->PutCell(table, "row-1", cf1, "c1", milliseconds(20),
+                                "value", layout));
+  EXPECT_TRUE(storage_->PutCell(table, "row-1", cf1, "c/2", milliseconds(3),
+                                "vv", layout));
+  EXPECT_TRUE(storage_->PutCell(table, "row-1", cf2, "c1", milliseconds(1),
+                                "v", layout));
+  EXPECT_TRUE(storage_->PutCell(table, "row-2", cf1, "c1", milliseconds(1),
+                                "v", layout));
+
+  using CellSizes = std::map<milliseconds, std::size_t>;
+  auto const sizes = storage_->ReadCellSizes(table, "row-1", cf1, layout);
+  EXPECT_EQ(2U, sizes.size());
+  EXPECT_EQ((CellSizes{{milliseconds(1), 1}, {milliseconds(20), 5}}),
+            sizes.at("c1"));
+  EXPECT_EQ((CellSizes{{milliseconds(3), 2}}), sizes.at("c/2"));
+  EXPECT_TRUE(storage_->ReadCellSizes(table, "row-3", cf1, layout).empty());
+}
+
 TEST_F(StorageTest, DeleteCFRowAffectsOnlySelectedColumnFamily) {
   auto const table = "projects/p/instances/i/tables/t3";
   auto const cf1 = std::string(table) + "/cf1";
@@ -157,6 +185,123 @@ TEST_F(StorageTest, DeleteCFRowAffectsOnlySelectedColumnFamily) {
   EXPECT_FALSE(storage_->DeleteCFRow(table, row, std::string(table) + "/missing"));
 }
 
+TEST_F(StorageTest, SingleColumnFamilyLayoutPutsFamilyInKey) {
+  auto const table = "projects/p/instances/i/tables/t7";
+  auto const single_cf = bt_emulator::SingleLayoutColumnFamilyName(table);
+  auto const cf1 = std::string(table) + "/cf1";
+  auto const cf2 = std::string(table) + "/cf2";
+  auto const row = "row-1";
+  auto const row_prefix = "/tables/" + std::string(table) + "/" + row + "/";
+  auto const layout = bt_emulator::StorageLayout::kSingleColumnFamily;
+
+  EXPECT_TRUE(storage_->PutCell(table, row, cf1, "c1",
+                                std::chrono::milliseconds(1), "v1", layout));
+  EXPECT_TRUE(storage_->PutCell(table, row, cf1, "c2",
+                                std::chrono::milliseconds(1), "v2", layout));
+  EXPECT_TRUE(storage_->PutCell(table, row, cf2, "c1",
+                                std::chrono::milliseconds(1), "v3", layout));
+  EXPECT_TRUE(storage_->CFExists(single_cf));
+  EXPECT_FALSE(storage_->CFExists(cf1));
+  EXPECT_FALSE(storage_->CFExists(cf2));
+  EXPECT_EQ(2U, CountKeysWithPrefix(*storage_, single_cf, row_prefix + "cf1/"));
+  EXPECT_EQ(1U, CountKeysWithPrefix(*storage_, single_cf, row_prefix + "cf2/"));
+
+  storage_->DeleteColumn(table, row, cf1, "c1", layout);
+  EXPECT_EQ(1U, CountKeysWithPrefix(*storage_, single_cf, row_prefix + "cf1/"));
+  EXPECT_TRUE(storage_->DeleteCell(table, row, cf1, "c2",
+                                   std::chrono::milliseconds(1), layout));
+  EXPECT_FALSE(storage_->RowExistsInCF(table, row, cf1, layout));
+  EXPECT_TRUE(storage_->RowExistsInCF(table, row, cf2, layout));
+
+  EXPECT_TRUE(storage_->DeleteCFRow(table, row, cf2, layout));
+  EXPECT_FALSE(storage_->RowExists(table, row));
+}
+
+TEST_F(StorageTest, SingleColumnFamilyLayoutDeleteColumnFamily) {
+  auto const table = "projects/p/instances/i/tables/t8";
+  auto const single_cf = bt_emulator::SingleLayoutColumnFamilyName(table);
+  auto const cf = std::string(table) + "/cf";
+  // A family whose name starts with the dropped one must survive.
+  auto const cf_suffixed = std::string(table) + "/cf-1";
+  auto const layout = bt_emulator::StorageLayout::kSingleColumnFamily;
+
+  for (auto const* row : {"row-1", "row-2", "row-3"}) {
+    EXPECT_TRUE(storage_->PutCell(table, row, cf, "c1",
+                                  std::chrono::milliseconds(1), "v", layout));
+    EXPECT_TRUE(storage_->PutCell(table, row, cf_suffixed, "c1",
+                                  std::chrono::milliseconds(1), "v", layout));
+  }
+
+  storage_->DeleteColumnFamily(table, cf, layout);
+
+  auto const table_prefix = "/tables/" + std::string(table) + "/";
+  EXPECT_EQ(3U, CountKeysWithPrefix(*storage_, single_cf, table_prefix));
+  for (auto const* row : {"row-1", "row-2", "row-3"}) {
+    EXPECT_FALSE(storage_->RowExistsInCF(table, row, cf, layout));
+    EXPECT_TRUE(storage_->RowExistsInCF(table, row, cf_suffixed, layout));
+  }
+}
+
+TEST_F(StorageTest, TableLayoutIsPersistedAndDeletedWithTable) {
+  auto const table = "projects/p/instances/i/tables/t9";
+  auto const layout = bt_emulator::StorageLayout::kSingleColumnFamily;
+
+  EXPECT_EQ(bt_emulator::StorageLayout::kColumnFamilyPerFamily,
+            storage_->GetTableLayout(table));
+  EXPECT_TRUE(storage_->PutRow(kManifestKey, kTablesPrefix + table + "\n"));
+  EXPECT_TRUE(storage_->PutRow(kTablesPrefix + table, "schema"));
+  EXPECT_TRUE(storage_->PutRow(kLayoutsPrefix + table,
+                               bt_emulator::StorageLayoutName(layout)));
+  EXPECT_TRUE(storage_->PutCell(table, "row-1", std::string(table) + "/cf1",
+                                "c1", std::chrono::milliseconds(1), "v",
+                                layout));
+  EXPECT_EQ(layout, storage_->GetTableLayout(table));
+
+  storage_->DeleteTable(table);
+  EXPECT_EQ(bt_emulator::StorageLayout::kColumnFamilyPerFamily,
+            storage_->GetTableLayout(table));
+  EXPECT_FALSE(
+      storage_->CFExists(bt_emulator::SingleLayoutColumnFamilyName(table)));
+}
+
+TEST_F(StorageTest, ApproximateSplitKeysAreOrdered) {
+  auto const table = "projects/p/instances/i/tables/t10";
+  auto const cf1 = std::string(table) + "/cf1";
+  auto const cf2 = std::string(table) + "/cf2";
+  std::vector<std::string> const cf_names = {cf1, cf2};
+  auto const table_prefix = "/tables/" + std::string(table) + "/";
+  auto const table_end = CalculatePrefixEnd(table_prefix);
+
+  EXPECT_EQ(0U, storage_->GetApproximateSize(cf_names, table_prefix,
+                                             table_end));
+  EXPECT_FALSE(
+      storage_->FindFirstKey(cf_names, table_prefix, table_end).has_value());
+
+  for (int i = 0; i != 100; ++i) {
+    auto const row = "row" + std::to_string(100 + i);
+    EXPECT_TRUE(storage_->PutCell(table, row, i % 2 == 0 ? cf1 : cf2, "c1",
+                                  std::chrono::milliseconds(1),
+                                  std::string(100, 'x')));
+  }
+  auto const total =
+      storage_->GetApproximateSize(cf_names, table_prefix, table_end);
+  EXPECT_LT(0U, total);
+
+  std::string previous = table_prefix;
+  for (int quarter = 1; quarter != 4; ++quarter) {
+    auto const split = storage_->FindApproximateSplitKey(
+        cf_names, table_prefix, table_end, total * quarter / 4);
+    EXPECT_LE(previous, split);
+    EXPECT_GT(table_end, split);
+    EXPECT_LE(storage_->GetApproximateSize(cf_names, table_prefix, split),
+              total * quarter / 4);
+    auto const key = storage_->FindFirstKey(cf_names, split, table_end);
+    ASSERT_TRUE(key.has_value());
+    EXPECT_LE(split, *key);
+    previous = split;
+  }
+}
+
 TEST_F(StorageTest, DeleteRowRemovesDataAcrossAllColumnFamiliesForThatRow) {
   auto const table = "projects/p/instances/i/tables/t4";
   auto const cf1 = std::string(table) + "/cf1";
@@ -207,8 +352,46 @@ TEST_F(StorageTest, DeleteTableUpdatesManifestAndDropsOnlyThatTablesFamilies) {
   EXPECT_TRUE(storage_->RowExistsInCF(table2, row, cf2));
 }
 
+TEST_F(StorageTest, InterruptedDropsAreFinishedAfterReopen) {
+  auto const table = "projects/p/instances/i/tables/t9";
+  auto const single = "projects/p/instances/i/tables/t10";
+  auto const cf1 = std::string(table) + "/cf1";
+  auto const kept = std::string(single) + "/kept";
+  auto const dropped = std::string(single) + "/dropped";
+  auto const single_layout = bt_emulator::StorageLayout::kSingleColumnFamily;
+  auto const row = "row-1";
+
+  EXPECT_TRUE(storage_->PutRow(kManifestKey,
+                               kTablesPrefix + std::string(table) + "\n"));
+  EXPECT_TRUE(storage_->PutRow(kTablesPrefix + std::string(table), "schema"));
+  EXPECT_TRUE(
+      storage_->PutCell(table, row, cf1, "c1", std::chrono::milliseconds(1), "v1"));
+  EXPECT_TRUE(storage_->PutCell(single, row, kept, "c1",
+                                std::chrono::milliseconds(1), "v1",
+                                single_layout));
+  EXPECT_TRUE(storage_->PutCell(single, row, dropped, "c1",
+                                std::chrono::milliseconds(1), "v1",
+                                single_layout));
+
+  // Dropped, but the process stops before the data is removed.
+  EXPECT_TRUE(storage_->RemoveTableFromManifest(table));
+  EXPECT_TRUE(storage_->PutRow(kDroppedFamiliesPrefix + dropped,
+                               bt_emulator::StorageLayoutName(single_layout)));
+  EXPECT_EQ("", storage_->GetRow(kManifestKey));
+  storage_.reset();
+  storage_ = std::make_unique<Storage>(db_path_);
+  EXPECT_TRUE(storage_->CFExists(cf1));
+
+  storage_->FinishPendingDrops();
+  EXPECT_FALSE(storage_->CFExists(cf1));
+  EXPECT_EQ("", storage_->GetRow(kTablesPrefix + std::string(table)));
+  EXPECT_FALSE(storage_->RowExistsInCF(single, row, dropped, single_layout));
+  EXPECT_TRUE(storage_->RowExistsInCF(single, row, kept, single_layout));
+  EXPECT_EQ(0U, CountKeysWithPrefix(*storage_, "default", "/sys/dropped_"));
+}
+
 TEST_F(StorageTest, ReopenPreservesDefaultAndNamedColumnFamilyData) {
-  auto const table = "projects/p/instances/i/tables/t7";
+  auto const table = "projects/p/instances/i/tables/t8";
   auto const cf = std::string(table) + "/cf1";
   auto const row = "row-1";
 
@@ -230,6 +413,16 @@ TEST(StorageHelpersTest, TrimRemovesOnlyNewlineAndCarriageReturnAtEdges) {
   EXPECT_EQ("", Trim("\n\r"));
 }
 
+TEST(StorageHelpersTest, StorageLayoutNamesRoundTrip) {
+  for (auto layout : {bt_emulator::StorageLayout::kColumnFamilyPerFamily,
+                      bt_emulator::StorageLayout::kSingleColumnFamily}) {
+    EXPECT_EQ(layout, bt_emulator::ParseStorageLayout(
+                          bt_emulator::StorageLayoutName(layout)));
+  }
+  EXPECT_FALSE(bt_emulator::ParseStorageLayout("").has_value());
+  EXPECT_FALSE(bt_emulator::ParseStorageLayout("bogus").has_value());
+}
+
 TEST(StorageHelpersTest, CalculatePrefixEndHandlesSimpleAndTrailingFFCases) {
   EXPECT_EQ("abd", CalculatePrefixEnd("abc"));
 
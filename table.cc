@@ -18,16 +18,23 @@
 #include "google/cloud/status.h"
 #include "google/cloud/status_or.h"
 #include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
 #include "absl/strings/str_format.h"
+#include "absl/strings/strip.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "bigtable_limits.h"
 #include "column_family.h"
 #include "filter.h"
+#include "gc_scheduler.h"
 #include "google/protobuf/util/field_mask_util.h"
+#include "parallel_scan.h"
 #include "range_set.h"
 #include "re2/re2.h"
+#include "reclaimer.h"
 #include "row_streamer.h"
+#include "table_stats.h"
+#include "thread_pool.h"
 #include <google/bigtable/admin/v2/bigtable_table_admin.pb.h>
 #include <google/bigtable/admin/v2/table.pb.h>
 #include <google/bigtable/admin/v2/types.pb.h>
@@ -35,6 +42,7 @@
 #include <google/bigtable/v2/data.pb.h>
 #include <google/protobuf/field_mask.pb.h>
 #include <grpcpp/support/sync_stream.h>
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <climits>
@@ -44,21 +52,26 @@
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <iterator>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <stack>
+#include <set>
 #include <string>
-#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
-#include <atomic>
 #include <sstream>
 #include "storage.h"
 #include "constants.h"
 
-void store_schema(const google::bigtable::admin::v2::Table& schema) {
+// Persist `schema`, together with the markers of the column families
+// `dropped_families` (in the `<table_name>/<family>` form) it no longer
+// has, whose cells are removed later.
+void store_schema(
+    const google::bigtable::admin::v2::Table& schema,
+    google::cloud::bigtable::emulator::StorageLayout storage_layout,
+    std::vector<std::string> const& dropped_families = {}) {
   auto* storage = google::cloud::bigtable::emulator::GetGlobalStorage();
   if (storage == nullptr) return;
   std::string table_key;
@@ -80,6 +93,14 @@ void store_schema(const google::bigtable::admin::v2::Table& schema) {
 
   std::vector<std::pair<std::string, std::string>> batch;
   batch.emplace_back(table_key, value);
+  batch.emplace_back(
+      kLayoutsPrefix + schema.name(),
+      google::cloud::bigtable::emulator::StorageLayoutName(storage_layout));
+  for (auto const& prefixed_cf_id : dropped_families) {
+    batch.emplace_back(
+        kDroppedFamiliesPrefix + prefixed_cf_id,
+        google::cloud::bigtable::emulator::StorageLayoutName(storage_layout));
+  }
 
   if (!present) {
     std::string new_manifest = manifest;
@@ -101,49 +122,34 @@ namespace emulator {
 
 namespace btadmin = ::google::bigtable::admin::v2;
 
-// Call StartGCThreadOnce instead of calling StartGCThread.
-void Table::StartGCThread() {
-  // This will move the thread.
-  gc_thread_ = std::thread([this]() {
-    std::unique_lock<std::mutex> lock(gc_mtx_);
-
-    while (!stop_flag_.load()) {
-      cv_.wait_for(lock, std::chrono::seconds(60),
-                   [this] { return stop_flag_.load(); });
-
-      if (stop_flag_.load()) {
-        return;
-      }
-
-      // RunGC takes the table lock.
-      RunGC();
-    }
-  });
-}
-
-void Table::StartGCThreadOnce() {
-  std::call_once(start_gc_once_flag_, &Table::StartGCThread, this);
-}
-
 StatusOr<std::shared_ptr<Table>> Table::Create(
-    google::bigtable::admin::v2::Table schema) {
+    google::bigtable::admin::v2::Table schema, StorageLayout storage_layout,
+    std::vector<std::string> initial_splits) {
   std::shared_ptr<Table> res(new Table);
-  auto status = res->Construct(std::move(schema));
+  auto status = res->Construct(std::move(schema), storage_layout,
+                               std::move(initial_splits));
   if (!status.ok()) {
     return status;
   }
 
-  res->StartGCThreadOnce();
+  GlobalGCScheduler().Register(res);
   return res;
 }
 
-Status Table::Construct(google::bigtable::admin::v2::Table schema) {
+Table::~Table() {
+  if (on_destroyed_) on_destroyed_();
+}
+
+Status Table::Construct(google::bigtable::admin::v2::Table schema,
+                        StorageLayout storage_layout,
+                        std::vector<std::string> initial_splits) {
   // Normally the constructor acts as a synchronization point. We don't have
   // that luxury here, so we need to make sure that the changes performed in
   // this member function are reflected in other threads. The simplest way to do
   // this is the mutex.
-  std::lock_guard<std::mutex> lock(mu_);
+  std::lock_guard<std::shared_mutex> lock(mu_);
   name_ = schema.name();
+  storage_layout_ = storage_layout;
   schema_ = std::move(schema);
   if (schema_.granularity() ==
       btadmin::Table::TIMESTAMP_GRANULARITY_UNSPECIFIED) {
@@ -203,17 +209,424 @@ Status Table::Construct(google::bigtable::admin::v2::Table schema) {
     column_families_[column_family_id] = cf.value();
   }
   schema_ = std::move(normalized_schema);
-  store_schema(schema_);
+  store_schema(schema_, storage_layout_);
+  LoadStats();
+  LoadTablets(std::move(initial_splits));
+
+  return Status();
+}
+
+void Table::LoadStats() {
+  stats_ = TableStats{};
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    auto const serialized = storage->GetRow(kStatsPrefix + name_);
+    if (!serialized.empty()) {
+      auto stats = TableStats::Parse(serialized);
+      if (stats) {
+        stats_ = *std::move(stats);
+      } else {
+        std::cerr << "Failed to parse the persisted stats of table " << name_
+                  << ": " << stats.status() << std::endl;
+      }
+    }
+  }
+  for (auto it = stats_.column_families.begin();
+       it != stats_.column_families.end();) {
+    if (column_families_.count(it->first) == 0) {
+      it = stats_.column_families.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto const& column_family : column_families_) {
+    stats_.column_families[column_family.first];
+  }
+}
+
+void Table::PersistStats() const {
+  auto* storage = GetGlobalStorage();
+  if (storage == nullptr) return;
+  if (!storage->PutRow(kStatsPrefix + name_, stats_.Serialize())) {
+    std::cerr << "Failed to persist the stats of table " << name_ << std::endl;
+  }
+}
+
+void Table::ApplyStatsDelta(TableStats const& delta) { stats_ += delta; }
+
+void Table::LoadTablets(std::vector<std::string> initial_splits) {
+  tablets_ = TabletMap(std::move(initial_splits));
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    if (tablets_.size() > 1) {
+      PersistTablets();
+    } else {
+      auto const serialized = storage->GetRow(kTabletsPrefix + name_);
+      if (!serialized.empty()) {
+        auto tablets = TabletMap::Parse(serialized);
+        if (tablets) {
+          tablets_ = *std::move(tablets);
+        } else {
+          std::cerr << "Failed to parse the persisted tablets of table "
+                    << name_ << ": " << tablets.status() << std::endl;
+        }
+      }
+    }
+  }
+  RemeasureTablets();
+}
+
+void Table::PersistTablets() const {
+  auto* storage = GetGlobalStorage();
+  if (storage == nullptr) return;
+  if (!storage->PutRow(kTabletsPrefix + name_, tablets_.Serialize())) {
+    std::cerr << "Failed to persist the tablets of table " << name_
+              << std::endl;
+  }
+}
+
+void Table::RemeasureTablets() {
+  for (std::size_t i = 0; i != tablets_.size(); ++i) {
+    auto& tablet = tablets_[i];
+    tablet.logical_bytes = MeasureRows(tablet.start_key, tablet.end_key);
+    tablet.unmeasured_bytes = 0;
+    tablet.next_split_bytes = 0;
+  }
+}
+
+void Table::UpdateTabletSize(std::string const& row_key,
+                             std::int64_t logical_bytes_delta) {
+  AddToTabletSize(tablets_[tablets_.Find(row_key)], logical_bytes_delta);
+}
+
+void Table::AddToTabletSize(Tablet& tablet, std::int64_t logical_bytes_delta) {
+  // The estimates of the stored sizes can't be updated incrementally.
+  if (GetGlobalStorage() != nullptr) {
+    tablet.unmeasured_bytes += logical_bytes_delta;
+  } else {
+    tablet.logical_bytes += logical_bytes_delta;
+  }
+  if (logical_bytes_delta > 0 && TabletNeedsSplit(tablet)) split_due_ = true;
+}
+
+bool Table::TabletNeedsSplit(Tablet const& tablet) const {
+  return tablet.logical_bytes + tablet.unmeasured_bytes >=
+         std::max(tablet_split_bytes_, tablet.next_split_bytes);
+}
+
+void Table::SplitTablets() {
+  std::lock_guard<std::mutex> split_lock(split_mu_);
+  if (!split_due_.exchange(false)) return;
+  auto* storage = GetGlobalStorage();
+  std::vector<Tablet> oversized;
+  TableSnapshot snapshot;
+  std::vector<std::string> cf_names;
+  {
+    std::lock_guard<std::shared_mutex> lock(mu_);
+    for (std::size_t i = 0; i != tablets_.size(); ++i) {
+      auto& tablet = tablets_[i];
+      if (storage != nullptr && tablet.unmeasured_bytes != 0 &&
+          TabletNeedsSplit(tablet)) {
+        tablet.logical_bytes = MeasureRows(tablet.start_key, tablet.end_key);
+        tablet.unmeasured_bytes = 0;
+      }
+      if (TabletNeedsSplit(tablet)) oversized.push_back(tablet);
+    }
+    if (oversized.empty()) return;
+    if (storage != nullptr) {
+      cf_names = StorageColumnFamilyNames();
+    } else {
+      snapshot = GetSnapshotNoLock();
+    }
+  }
+
+  std::vector<std::pair<absl::optional<std::string>, std::int64_t>> found;
+  for (auto const& tablet : oversized) {
+    std::int64_t bytes_before = 0;
+    auto split_key =
+        FindTabletSplitKey(tablet, snapshot, cf_names, bytes_before);
+    found.emplace_back(std::move(split_key), bytes_before);
+  }
+
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  bool split = false;
+  for (std::size_t i = 0; i != oversized.size(); ++i) {
+    auto const index = tablets_.Find(oversized[i].start_key);
+    auto const total_bytes = tablets_[index].logical_bytes;
+    auto& split_key = found[i].first;
+    if (!split_key || !tablets_.Split(index, *std::move(split_key))) {
+      // E.g. the tablet is a single large row. Don't look for a split key
+      // again until the tablet doubles in size.
+      auto& tablet = tablets_[index];
+      tablet.next_split_bytes =
+          2 * (tablet.logical_bytes + tablet.unmeasured_bytes);
+      continue;
+    }
+    split = true;
+    for (auto j : {index, index + 1}) {
+      auto& tablet = tablets_[j];
+      if (storage != nullptr) {
+        tablet.logical_bytes = MeasureRows(tablet.start_key, tablet.end_key);
+        tablet.unmeasured_bytes = 0;
+      } else {
+        // The mutations since the snapshot count towards the second half.
+        tablet.logical_bytes =
+            j == index ? found[i].second : total_bytes - found[i].second;
+      }
+      if (TabletNeedsSplit(tablet)) split_due_ = true;
+    }
+  }
+  if (split) PersistTablets();
+}
+
+absl::optional<std::string> Table::FindTabletSplitKey(
+    Tablet const& tablet, TableSnapshot const& snapshot,
+    std::vector<std::string> const& cf_names,
+    std::int64_t& bytes_before) const {
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    std::string const table_prefix = "/tables/" + name_ + "/";
+    auto const start = table_prefix + tablet.start_key;
+    auto const end = tablet.end_key.empty() ? CalculatePrefixEnd(table_prefix)
+                                            : table_prefix + tablet.end_key;
+    auto const total_bytes = storage->GetApproximateSize(cf_names, start, end);
+    auto row_key = FindStoredRow(cf_names, storage->FindApproximateSplitKey(
+                                               cf_names, start, end,
+                                               total_bytes / 2));
+    if (!row_key || !tablet.Contains(*row_key)) return absl::nullopt;
+    return row_key;
+  }
+
+  // Pick the row boundary which splits the tablet's bytes most evenly.
+  std::map<std::string, std::int64_t> row_bytes;
+  std::int64_t total_bytes = 0;
+  for (auto const& column_family : snapshot.column_families) {
+    column_family.second->ForEachRow(
+        tablet.start_key, tablet.end_key,
+        [&](std::string const& row_key, ColumnFamilyRow const& row) {
+          ColumnFamilyStats row_stats;
+          row_stats.AddRow(row_key, row);
+          row_bytes[row_key] += row_stats.logical_bytes;
+          total_bytes += row_stats.logical_bytes;
+        });
+  }
+  absl::optional<std::string> res;
+  auto best_imbalance = total_bytes;
+  std::int64_t bytes_so_far = 0;
+  for (auto const& row : row_bytes) {
+    auto const imbalance = std::abs(total_bytes - 2 * bytes_so_far);
+    if (bytes_so_far > 0 && imbalance < best_imbalance) {
+      res = row.first;
+      best_imbalance = imbalance;
+      bytes_before = bytes_so_far;
+    }
+    bytes_so_far += row.second;
+  }
+  return res;
+}
+
+std::int64_t Table::MeasureRows(std::string const& start_key,
+                                std::string const& end_key) const {
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    std::string const table_prefix = "/tables/" + name_ + "/";
+    return static_cast<std::int64_t>(storage->GetApproximateSize(
+        StorageColumnFamilyNames(), table_prefix + start_key,
+        end_key.empty() ? CalculatePrefixEnd(table_prefix)
+                        : table_prefix + end_key));
+  }
+  ColumnFamilyStats stats;
+  for (auto const& column_family : column_families_) {
+    column_family.second->ForEachRow(
+        start_key, end_key,
+        [&stats](std::string const& row_key, ColumnFamilyRow const& row) {
+          stats.AddRow(row_key, row);
+        });
+  }
+  return stats.logical_bytes;
+}
+
+std::vector<std::string> Table::StorageColumnFamilyNames() const {
+  std::vector<std::string> cf_names;
+  if (storage_layout_ == StorageLayout::kSingleColumnFamily) {
+    cf_names.emplace_back(SingleLayoutColumnFamilyName(name_));
+  } else {
+    for (auto const& column_family : column_families_) {
+      cf_names.emplace_back(name_ + "/" + column_family.first);
+    }
+  }
+  return cf_names;
+}
 
+absl::optional<std::string> Table::FindStoredRow(
+    std::vector<std::string> const& cf_names, std::string const& key) const {
+  std::string const table_prefix = "/tables/" + name_ + "/";
+  auto const cell_key =
+      GetGlobalStorage()->FindFirstKey(cf_names, std::max(key, table_prefix),
+                                       CalculatePrefixEnd(table_prefix));
+  if (!cell_key) return absl::nullopt;
+  auto const row_end = cell_key->find('/', table_prefix.size());
+  if (row_end == std::string::npos) return absl::nullopt;
+  return cell_key->substr(table_prefix.size(), row_end - table_prefix.size());
+}
+
+std::vector<Tablet> Table::GetTablets() const {
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  return std::vector<Tablet>(tablets_.begin(), tablets_.end());
+}
+
+void Table::SetTabletSplitBytes(std::int64_t split_bytes) {
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  tablet_split_bytes_ = split_bytes;
+}
+
+TableStats Table::GetStats() const {
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  return stats_;
+}
+
+bool Table::RowExistsNoLock(std::string const& row_key) const {
+  return std::any_of(column_families_.begin(), column_families_.end(),
+                     [&row_key](auto const& column_family) {
+                       return column_family.second->HasRow(row_key);
+                     });
+}
+
+Status Table::RunGC() {
+  std::vector<std::string> families;
+  {
+    std::lock_guard<std::shared_mutex> lock(mu_);
+    for (auto const& cf : column_families_) families.emplace_back(cf.first);
+  }
+  // Use a cursor of our own, so that the pass covers the whole family even
+  // if the GC scheduler runs slices concurrently.
+  for (auto const& family : families) {
+    std::string cursor;
+    for (bool done = false; !done;) {
+      auto const deadline = std::chrono::steady_clock::now() + kDefaultGCSlice;
+      FreezeColumnFamily(family, deadline);
+      std::lock_guard<std::shared_mutex> lock(mu_);
+      done = RunGCSliceNoLock(family, cursor, deadline);
+    }
+  }
   return Status();
 }
 
+bool Table::RunGCSlice(std::string const& column_family,
+                       std::chrono::steady_clock::duration budget) {
+  auto const deadline = std::chrono::steady_clock::now() + budget;
+  FreezeColumnFamily(column_family, deadline);
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  auto& cursor = gc_cursors_[column_family];
+  auto const done = RunGCSliceNoLock(column_family, cursor, deadline);
+  if (done) gc_cursors_.erase(column_family);
+  return done;
+}
+
+void Table::FreezeColumnFamily(std::string const& column_family,
+                               std::chrono::steady_clock::time_point deadline) {
+  std::shared_ptr<ColumnFamily> cf;
+  std::unique_ptr<ColumnFamily::FreezeJob> job;
+  {
+    std::lock_guard<std::shared_mutex> lock(mu_);
+    auto cf_it = column_families_.find(column_family);
+    if (cf_it == column_families_.end() || !cf_it->second->NeedsFreeze()) {
+      return;
+    }
+    cf = cf_it->second;
+    job = cf->PrepareFreeze(std::chrono::steady_clock::now());
+  }
+  job->Build(deadline);
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  // The family may have been dropped or replaced in the meantime.
+  auto cf_it = column_families_.find(column_family);
+  if (cf_it != column_families_.end() && cf_it->second == cf) {
+    cf->InstallFreeze(*job);
+  }
+}
+
+bool Table::RunGCSliceNoLock(std::string const& column_family,
+                             std::string& cursor,
+                             std::chrono::steady_clock::time_point deadline) {
+  auto cf_it = column_families_.find(column_family);
+  if (cf_it == column_families_.end()) return true;
+  auto& cf = *cf_it->second;
+  if (!cf.ReleaseDeletedRows(deadline)) return false;
+  if (!cf.CompactValues(deadline)) return false;
+
+  TableStats delta;
+  auto& cf_delta = delta.column_families[column_family];
+  bool done = false;
+  // Tablets may be split between the slices, so the cursor is a row key
+  // rather than a tablet index. The tablets keep their sizes up to date.
+  for (;;) {
+    auto& tablet = tablets_[tablets_.Find(cursor)];
+    auto const logical_bytes = cf_delta.logical_bytes;
+    std::vector<std::string> emptied_rows;
+    auto next =
+        cf.RunGC(cursor, tablet.end_key, deadline, &cf_delta, &emptied_rows);
+    for (auto const& row_key : emptied_rows) {
+      if (!RowExistsNoLock(row_key)) --delta.rows;
+    }
+    AddToTabletSize(tablet, cf_delta.logical_bytes - logical_bytes);
+    if (next.has_value()) {
+      cursor = *std::move(next);
+      break;
+    }
+    if (tablet.end_key.empty()) {
+      cursor.clear();
+      done = true;
+      break;
+    }
+    cursor = tablet.end_key;
+    if (std::chrono::steady_clock::now() >= deadline) break;
+  }
+  if (!delta.IsZero()) {
+    ApplyStatsDelta(delta);
+    PersistStats();
+  }
+  return done;
+}
+
+std::vector<std::pair<std::string, std::int64_t>> Table::GetGCCandidates()
+    const {
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  std::vector<std::pair<std::string, std::int64_t>> res;
+  for (auto const& cf : column_families_) {
+    std::int64_t eligible = 0;
+    auto const& gc_rule = cf.second->gc_rule();
+    auto stats = stats_.column_families.find(cf.first);
+    if (gc_rule.has_value() && stats != stats_.column_families.end()) {
+      eligible = EstimateGCEligibleCells(*gc_rule, stats->second);
+    }
+    if (eligible == 0 && (cf.second->HasDeletedRows() ||
+                          cf.second->NeedsValueCompaction() ||
+                          cf.second->NeedsFreeze())) {
+      eligible = 1;
+    }
+    if (eligible > 0) res.emplace_back(cf.first, eligible);
+  }
+  return res;
+}
+
 // NOLINTBEGIN(readability-function-cognitive-complexity)
 StatusOr<btadmin::Table> Table::ModifyColumnFamilies(
     btadmin::ModifyColumnFamiliesRequest const& request) {
-  std::unique_lock<std::mutex> lock(mu_);
+  // The background removal of dropped families is waited for only while
+  // holding `schema_mu_`, which blocks other schema changes but not the
+  // reads and writes of the table.
+  std::lock_guard<std::mutex> schema_lock(schema_mu_);
+  for (auto const& modification : request.modifications()) {
+    // The cells of a family dropped by an earlier request must be gone
+    // before this one's are written.
+    if (modification.has_create()) {
+      GlobalReclaimer().WaitFor(name_ + "/" + modification.id());
+    }
+  }
+  std::unique_lock<std::shared_mutex> lock(mu_);
   auto new_schema = schema_;
   auto new_column_families = column_families_;
+  bool dropped = false;
   for (auto const& modification : request.modifications()) {
     auto const& cf_id = modification.id();
     std::string prefixed_cf_id = name_ + "/" + cf_id;
@@ -229,10 +642,7 @@ StatusOr<btadmin::Table> Table::ModifyColumnFamilies(
                              GCP_ERROR_INFO().WithMetadata(
                                  "modification", modification.DebugString()));
       }
-      Storage* storage = GetGlobalStorage();
-      if (storage != nullptr) {
-        storage->DeleteColumnFamily(prefixed_cf_id);
-      }
+      dropped = true;
       if (new_schema.mutable_column_families()->erase(cf_id) == 0) {
         return InternalError("Column family with no schema.",
                              GCP_ERROR_INFO().WithMetadata(
@@ -350,17 +760,106 @@ StatusOr<btadmin::Table> Table::ModifyColumnFamilies(
                                         modification.DebugString()));
     }
   }
-  // Defer destroying potentially large objects to after releasing the lock.
+  // A family dropped and re-created by this request must not lose the cells
+  // written to it, so it is only published once the old family's cells are
+  // removed from the storage.
+  std::map<std::string, std::shared_ptr<ColumnFamily>> recreated;
+  auto published_schema = new_schema;
+  if (dropped) {
+    for (auto const& cf : column_families_) {
+      auto it = new_column_families.find(cf.first);
+      if (it == new_column_families.end() || it->second == cf.second) continue;
+      published_schema.mutable_column_families()->erase(cf.first);
+      recreated.insert(new_column_families.extract(it));
+    }
+  }
+  // The dropped families are recorded with the schema, so that their cells
+  // are removed on restart if the removal below is interrupted.
+  std::vector<std::string> dropped_families;
+  for (auto const& cf : column_families_) {
+    auto it = new_column_families.find(cf.first);
+    if (it == new_column_families.end() || it->second != cf.second) {
+      dropped_families.push_back(name_ + "/" + cf.first);
+    }
+  }
+  UpdateStatsForColumnFamilies(new_column_families);
   column_families_.swap(new_column_families);
-  schema_ = new_schema;
-  store_schema(schema_);
+  schema_ = published_schema;
+  store_schema(schema_, storage_layout_, dropped_families);
+  if (dropped) {
+    RemeasureTablets();
+    // `new_column_families` now holds the old families. The cells of the
+    // dropped ones are released, and removed from the storage along with
+    // their markers, in the background.
+    auto* storage = GetGlobalStorage();
+    for (auto& cf : new_column_families) {
+      auto it = column_families_.find(cf.first);
+      if (it != column_families_.end() && it->second == cf.second) continue;
+      auto prefixed_cf_id = name_ + "/" + cf.first;
+      GlobalReclaimer().Schedule(
+          prefixed_cf_id, [storage, table_name = name_, prefixed_cf_id,
+                           layout = storage_layout_,
+                           column_family = std::move(cf.second)]() mutable {
+            if (storage != nullptr) {
+              storage->DeleteColumnFamily(table_name, prefixed_cf_id, layout);
+            }
+            column_family.reset();
+          });
+    }
+  }
   lock.unlock();
+  if (recreated.empty()) return new_schema;
+
+  for (auto const& cf : recreated) {
+    GlobalReclaimer().WaitFor(name_ + "/" + cf.first);
+  }
+  lock.lock();
+  auto all_column_families = column_families_;
+  all_column_families.insert(recreated.begin(), recreated.end());
+  UpdateStatsForColumnFamilies(all_column_families);
+  column_families_.swap(all_column_families);
+  schema_ = new_schema;
+  store_schema(schema_, storage_layout_);
   return new_schema;
 }
 // NOLINTEND(readability-function-cognitive-complexity)
 
+void Table::UpdateStatsForColumnFamilies(
+    std::map<std::string, std::shared_ptr<ColumnFamily>> const&
+        new_column_families) {
+  bool changed = false;
+  for (auto const& column_family : column_families_) {
+    auto it = new_column_families.find(column_family.first);
+    if (it != new_column_families.end() && it->second == column_family.second) {
+      continue;
+    }
+    // The column family is dropped (and possibly re-created empty). Its rows
+    // which have no cells in the remaining column families disappear.
+    column_family.second->ForEachRow(
+        std::string(), std::string(),
+        [&](std::string const& row_key, ColumnFamilyRow const&) {
+          auto const in_other_family = std::any_of(
+              new_column_families.begin(), new_column_families.end(),
+              [&row_key](auto const& cf) {
+                return cf.second->HasRow(row_key);
+              });
+          if (!in_other_family) --stats_.rows;
+        });
+    stats_.column_families.erase(column_family.first);
+    changed = true;
+  }
+  for (auto const& column_family : new_column_families) {
+    changed |=
+        stats_.column_families.emplace(column_family.first, ColumnFamilyStats{})
+            .second;
+  }
+  if (changed) {
+    PersistStats();
+  }
+}
+
 google::bigtable::admin::v2::Table Table::GetSchema() const {
-  std::lock_guard<std::mutex> lock(mu_);
+  std::lock_guard<std::shared_mutex> lock(mu_);
   return schema_;
 }
 
@@ -387,10 +886,10 @@ Status Table::Update(google::bigtable::admin::v2::Table const& new_schema,
         "Update mask contains disallowed fields.",
         GCP_ERROR_INFO().WithMetadata("mask", disallowed_mask.DebugString()));
   }
-  std::lock_guard<std::mutex> lock(mu_);
+  std::lock_guard<std::shared_mutex> lock(mu_);
   FieldMaskUtil::MergeMessageTo(new_schema, to_update,
                                 FieldMaskUtil::MergeOptions(), &schema_);
-  store_schema(schema_);
+  store_schema(schema_, storage_layout_);
   return Status();
 }
 
@@ -411,7 +910,8 @@ StatusOr<std::reference_wrapper<ColumnFamily>> Table::FindColumnFamily(
 }
 
 Status Table::MutateRow(google::bigtable::v2::MutateRowRequest const& request) {
-  std::lock_guard<std::mutex> lock(mu_);
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  auto row_lock = row_locks_.Lock(request.row_key());
 
   return DoMutationsWithPossibleRollback(request.row_key(),
                                          request.mutations());
@@ -454,19 +954,19 @@ Status Table::DoMutationsWithPossibleRollback(
       if (!status.ok()) {
         return status;
       }
-    } else if (mutation.has_add_to_cell()) {
-      auto const& add_to_cell = mutation.add_to_cell();
+    } else if (mutation.has_add_to_cell() || mutation.has_merge_to_cell()) {
+      auto const& timestamp_value = mutation.has_add_to_cell()
+                                        ? mutation.add_to_cell().timestamp()
+                                        : mutation.merge_to_cell().timestamp();
 
       absl::optional<std::chrono::milliseconds> timestamp_override =
           absl::nullopt;
 
       std::chrono::milliseconds timestamp = std::chrono::milliseconds::zero();
 
-      if (add_to_cell.has_timestamp() &&
-          add_to_cell.timestamp().has_raw_timestamp_micros()) {
+      if (timestamp_value.has_raw_timestamp_micros()) {
         timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::microseconds(
-                add_to_cell.timestamp().raw_timestamp_micros()));
+            std::chrono::microseconds(timestamp_value.raw_timestamp_micros()));
       }
 
       // If no valid timestamp is provided, override with the system time.
@@ -476,14 +976,15 @@ Status Table::DoMutationsWithPossibleRollback(
         timestamp_override.emplace(std::move(timestamp));
       }
 
-      auto status = row_transaction.AddToCell(add_to_cell, timestamp_override);
+      auto status =
+          mutation.has_add_to_cell()
+              ? row_transaction.AddToCell(mutation.add_to_cell(),
+                                          timestamp_override)
+              : row_transaction.MergeToCell(mutation.merge_to_cell(),
+                                            timestamp_override);
       if (!status.ok()) {
         return status;
       }
-    } else if (mutation.has_merge_to_cell()) {
-      return UnimplementedError(
-          "Unsupported mutation type.",
-          GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
     } else if (mutation.has_delete_from_column()) {
       auto const& delete_from_column = mutation.delete_from_column();
       auto status = row_transaction.DeleteFromColumn(delete_from_column);
@@ -519,19 +1020,55 @@ Status Table::DoMutationsWithPossibleRollback(
 
 StatusOr<CellStream> Table::CreateCellStream(
     std::shared_ptr<StringRangeSet> range_set,
-    absl::optional<google::bigtable::v2::RowFilter> maybe_row_filter) const {
-  auto table_stream_ctor = [range_set = std::move(range_set), this] {
+    absl::optional<google::bigtable::v2::RowFilter> maybe_row_filter,
+    absl::optional<TableSnapshot> snapshot) const {
+  auto table_stream_ctor = [range_set = std::move(range_set),
+                            snapshot = std::move(snapshot), this] {
     if (GetGlobalStorage() == nullptr) {
       std::vector<std::unique_ptr<FilteredColumnFamilyStream>> per_cf_streams;
-      per_cf_streams.reserve(column_families_.size());
+      std::vector<std::unique_ptr<FrozenSegmentStream>> frozen_streams;
+      auto add_frozen_streams = [&](ColumnFamily const& column_family,
+                                    std::string const& name) {
+        auto streams = column_family.CreateFrozenStreams(name, range_set);
+        std::move(streams.begin(), streams.end(),
+                  std::back_inserter(frozen_streams));
+      };
+      if (snapshot) {
+        per_cf_streams.reserve(snapshot->column_families.size());
+        for (auto const& column_family : snapshot->column_families) {
+          per_cf_streams.emplace_back(
+              std::make_unique<FilteredColumnFamilyStream>(
+                  column_family.second, column_family.first, range_set));
+          add_frozen_streams(*column_family.second, column_family.first);
+        }
+      } else {
+        per_cf_streams.reserve(column_families_.size());
+        for (auto const& column_family : column_families_) {
+          per_cf_streams.emplace_back(
+              std::make_unique<FilteredColumnFamilyStream>(
+                  *column_family.second, column_family.first, range_set));
+          add_frozen_streams(*column_family.second, column_family.first);
+        }
+      }
+      return CellStream(std::make_unique<FilteredTableStream>(
+          std::move(per_cf_streams), std::move(frozen_streams)));
+    }
+    auto storage_snapshot =
+        snapshot ? snapshot->storage_snapshot : nullptr;
+
+    if (storage_layout_ == StorageLayout::kSingleColumnFamily) {
+      std::vector<std::string> column_families;
+      column_families.reserve(column_families_.size());
       for (auto const& column_family : column_families_) {
-        per_cf_streams.emplace_back(std::make_unique<FilteredColumnFamilyStream>(
-            *column_family.second, column_family.first, range_set));
+        column_families.emplace_back(column_family.first);
       }
-      return CellStream(
-          std::make_unique<FilteredTableStream>(std::move(per_cf_streams)));
+      return CellStream(std::make_unique<PersistentFilteredTableStream>(
+          name_, column_families, range_set, storage_snapshot,
+          GcReadMasksNoLock()));
     }
 
+    auto gc_masks = GcReadMasksNoLock();
+
     std::vector<std::unique_ptr<PersistentFilteredColumnFamilyStream>> per_cf_streams;
     per_cf_streams.reserve(column_families_.size());
     std::string const cf_prefix = name_ + "/";
@@ -540,8 +1077,10 @@ StatusOr<CellStream> Table::CreateCellStream(
       if (!absl::StartsWith(storage_cf_name, cf_prefix)) {
         storage_cf_name = cf_prefix + storage_cf_name;
       }
+      auto gc_mask = gc_masks.find(column_family.first);
       per_cf_streams.emplace_back(std::make_unique<PersistentFilteredColumnFamilyStream>(
-          name_, storage_cf_name, ""));
+          name_, storage_cf_name, "", range_set, storage_snapshot,
+          gc_mask == gc_masks.end() ? GcReadMask() : gc_mask->second));
     }
     return CellStream(
         std::make_unique<FilteredTableStream>(std::move(per_cf_streams)));
@@ -554,73 +1093,460 @@ StatusOr<CellStream> Table::CreateCellStream(
   return table_stream_ctor();
 }
 
-bool FilteredTableStream::ApplyFilter(InternalFilter const& internal_filter) {
-  if (!absl::holds_alternative<FamilyNameRegex>(internal_filter) &&
-      !absl::holds_alternative<ColumnRange>(internal_filter)) {
-    return MergeCellStreams::ApplyFilter(internal_filter);
+StatusOr<CellStream> Table::CreateParallelCellStream(
+    std::shared_ptr<StringRangeSet> const& range_set,
+    absl::optional<google::bigtable::v2::RowFilter> const& filter,
+    std::vector<std::string> const& split_keys,
+    TableSnapshot const& snapshot) const {
+  std::vector<CellStream> partitions;
+  for (std::size_t i = 0; i <= split_keys.size(); ++i) {
+    // Row filters see whole rows, as the partitions are split between rows.
+    auto partition_set = std::make_shared<StringRangeSet>(*range_set);
+    if (i == split_keys.size()) {
+      partition_set->Intersect(StringRangeSet::Range(
+          i == 0 ? "" : split_keys[i - 1], false,
+          StringRangeSet::Range::Infinity{}, false));
+    } else {
+      partition_set->Intersect(StringRangeSet::Range(
+          i == 0 ? "" : split_keys[i - 1], false, split_keys[i], true));
+    }
+    if (partition_set->disjoint_ranges().empty()) continue;
+    auto stream = CreateCellStream(std::move(partition_set), filter, snapshot);
+    if (!stream) return stream.status();
+    partitions.emplace_back(*std::move(stream));
+  }
+  if (partitions.size() == 1) return std::move(partitions.front());
+  return CellStream(std::make_unique<ParallelCellStream>(
+      ScanThreadPool(), std::move(partitions)));
+}
+
+namespace {
+
+// Scans are split into partitions of about this size, and only if they read
+// at least two.
+std::uint64_t constexpr kParallelScanPartitionBytes = 8 << 20;
+// Without a storage, the split keys are picked among samples of the rows
+// taken about this many times per partition.
+std::uint64_t constexpr kParallelScanSamplesPerPartition = 16;
+
+}  // namespace
+
+std::vector<std::string> Table::ParallelScanSplitKeys(
+    StringRangeSet const& row_set, TableSnapshot const& snapshot,
+    std::vector<std::string> const& cf_names,
+    std::uint64_t table_bytes) const {
+  auto const threads = ScanThreadPool().size();
+  std::vector<std::string> res;
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    // Split the table evenly using RocksDB's size estimates, like
+    // `SampleRowKeys()`. Partitions outside of `row_set` are skipped later.
+    std::string const table_prefix = "/tables/" + name_ + "/";
+    std::string const table_end = CalculatePrefixEnd(table_prefix);
+    auto const total_bytes =
+        storage->GetApproximateSize(cf_names, table_prefix, table_end);
+    auto const partitions = std::min<std::uint64_t>(
+        total_bytes / kParallelScanPartitionBytes, 4 * threads);
+    for (std::uint64_t i = 1; i < partitions; ++i) {
+      auto row_key = FindStoredRow(
+          cf_names, storage->FindApproximateSplitKey(
+                        cf_names, table_prefix, table_end,
+                        total_bytes * i / partitions));
+      if (row_key && !row_key->empty() &&
+          (res.empty() || *row_key > res.back())) {
+        res.emplace_back(*std::move(row_key));
+      }
+    }
+    return res;
+  }
+
+  // Without size estimates, sample the snapshot's rows in `row_set`. Each
+  // sample is a row key, and the bytes of the rows up to it since the
+  // previous sample. `ForEachRow()` visits runs of rows in key order (the
+  // tree, then each frozen segment), and the bytes of a run are not
+  // attributed to the samples of another one.
+  if (table_bytes < 2 * kParallelScanPartitionBytes) return res;
+  auto const sample_bytes =
+      std::max(kParallelScanPartitionBytes, table_bytes / (4 * threads)) /
+      kParallelScanSamplesPerPartition;
+  std::vector<std::pair<std::string, std::uint64_t>> samples;
+  std::string previous_key;
+  std::uint64_t pending_bytes = 0;
+  auto const end_run = [&] {
+    if (pending_bytes != 0) samples.emplace_back(previous_key, pending_bytes);
+    pending_bytes = 0;
+  };
+  for (auto const& range : row_set.disjoint_ranges()) {
+    if (range.IsEmpty()) continue;
+    std::string end_key;
+    if (absl::holds_alternative<std::string>(range.end())) {
+      end_key = absl::get<std::string>(range.end());
+      if (range.end_closed()) end_key.push_back('\0');
+    }
+    for (auto const& column_family : snapshot.column_families) {
+      column_family.second->ForEachRow(
+          range.start_finite(), end_key,
+          [&](std::string const& row_key, ColumnFamilyRow const& row) {
+            if (row_key <= previous_key) end_run();
+            auto const& totals = row.totals();
+            pending_bytes += static_cast<std::uint64_t>(
+                totals.cells * LogicalCellSize(row_key, {}, {}) +
+                totals.bytes);
+            previous_key = row_key;
+            if (pending_bytes >= sample_bytes) end_run();
+          });
+      end_run();
+    }
   }
 
-  for (auto stream_it = unfinished_streams_.begin();
-       stream_it != unfinished_streams_.end();) {
+  std::sort(samples.begin(), samples.end());
+  std::uint64_t total_bytes = 0;
+  for (auto const& sample : samples) total_bytes += sample.second;
+  if (total_bytes < 2 * kParallelScanPartitionBytes) return res;
+  auto const partitions = std::min<std::uint64_t>(
+      total_bytes / kParallelScanPartitionBytes, 4 * threads);
+  std::uint64_t bytes_so_far = 0;
+  for (auto& sample : samples) {
+    bytes_so_far += sample.second;
+    // The sampled row starts the next partition.
+    if (bytes_so_far * partitions >= (res.size() + 1) * total_bytes &&
+        res.size() + 1 < partitions && !sample.first.empty() &&
+        (res.empty() || sample.first > res.back())) {
+      res.emplace_back(std::move(sample.first));
+    }
+  }
+  return res;
+}
 
-    AbstractCellStreamImpl& impl = (*stream_it)->impl();
+TableSnapshot Table::GetSnapshot() const {
+  std::lock_guard<std::shared_mutex> lock(mu_);
+  return GetSnapshotNoLock();
+}
 
-    // --- obtain column family name (RAM or persistent) ---
-    std::string const* cf_name = nullptr;
+TableSnapshot Table::GetSnapshotNoLock() const {
+  TableSnapshot res;
+  auto* storage = GetGlobalStorage();
+  if (storage != nullptr) {
+    res.storage_snapshot = storage->GetSnapshot();
+    return res;
+  }
+  for (auto const& column_family : column_families_) {
+    res.column_families.emplace(column_family.first,
+                                column_family.second->Snapshot());
+  }
+  return res;
+}
 
-    if (auto* ram =
-            dynamic_cast<FilteredColumnFamilyStream*>(&impl)) {
-      cf_name = &ram->column_family_name();
-    } else if (auto* persistent =
-                   dynamic_cast<PersistentFilteredColumnFamilyStream*>(&impl)) {
-      cf_name = &persistent->column_family_name();
-    } else {
-      assert(false && "Unknown column-family stream implementation");
+std::map<std::string, GcReadMask, std::less<>> Table::GcReadMasksNoLock()
+    const {
+  auto const now = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch());
+  std::map<std::string, GcReadMask, std::less<>> res;
+  for (auto const& column_family : column_families_) {
+    auto const& gc_rule = column_family.second->gc_rule();
+    if (gc_rule.has_value()) {
+      res.emplace(column_family.first, GcReadMask(*gc_rule, now));
     }
+  }
+  return res;
+}
 
-    // --- prune streams ---
-    if ((absl::holds_alternative<FamilyNameRegex>(internal_filter) &&
-         !re2::RE2::PartialMatch(
-             *cf_name,
-             *absl::get<FamilyNameRegex>(internal_filter).regex)) ||
-        (absl::holds_alternative<ColumnRange>(internal_filter) &&
-         absl::get<ColumnRange>(internal_filter).column_family != *cf_name)) {
-      stream_it = unfinished_streams_.erase(stream_it);
+bool FilteredTableStream::ApplyFilter(InternalFilter const& internal_filter) {
+  auto const* family_name_regex =
+      absl::get_if<FamilyNameRegex>(&internal_filter);
+  auto const* column_range = absl::get_if<ColumnRange>(&internal_filter);
+  if (family_name_regex == nullptr && column_range == nullptr) {
+    return MergeCellStreams::ApplyFilter(internal_filter);
+  }
+
+  // Drop the streams of column families which are filtered out entirely and
+  // compact the survivors (and their names) to the front.
+  std::size_t kept = 0;
+  for (std::size_t i = 0; i != streams_.size(); ++i) {
+    auto const& cf_name = column_family_names_[i];
+    bool const keep = family_name_regex != nullptr
+                          ? family_name_regex->regex->PartialMatch(cf_name)
+                          : column_range->column_family == cf_name;
+    if (!keep) {
       continue;
     }
+    if (column_range != nullptr) {
+      streams_[i].ApplyFilter(internal_filter);
+    }
+    if (kept != i) {
+      streams_[kept] = std::move(streams_[i]);
+      column_family_names_[kept] = std::move(column_family_names_[i]);
+    }
+    ++kept;
+  }
+  streams_.erase(streams_.begin() + static_cast<std::ptrdiff_t>(kept),
+                 streams_.end());
+  column_family_names_.resize(kept);
+  return true;
+}
 
-    // --- forward ColumnRange only to RAM stream (for now) ---
-    if (absl::holds_alternative<ColumnRange>(internal_filter)) {
-      if (auto* ram =
-              dynamic_cast<FilteredColumnFamilyStream*>(&impl)) {
-        ram->ApplyFilter(internal_filter);
-      }
-      // Persistent stream ignores it for now (correct, not a bug)
+PersistentFilteredTableStream::PersistentFilteredTableStream(
+    std::string const& table_name,
+    std::vector<std::string> const& column_families,
+    std::shared_ptr<StringRangeSet const> row_ranges,
+    std::shared_ptr<rocksdb::Snapshot const> snapshot,
+    std::map<std::string, GcReadMask, std::less<>> gc_masks)
+    : storage_(GetGlobalStorage()),
+      table_name_(table_name),
+      table_prefix_("/tables/" + table_name + "/"),
+      column_families_(column_families.begin(), column_families.end()),
+      row_ranges_(std::move(row_ranges)),
+      column_ranges_(StringRangeSet::All()),
+      timestamp_ranges_(TimestampRangeSet::All()),
+      gc_masks_(std::move(gc_masks)),
+      snapshot_(std::move(snapshot)) {
+  if (storage_ != nullptr) {
+    it_.reset(storage_->NewIterator(SingleLayoutColumnFamilyName(table_name_),
+                                    snapshot_.get()));
+  }
+}
+
+bool PersistentFilteredTableStream::ApplyFilter(
+    InternalFilter const& internal_filter) {
+  // Do not allow applying filters after iteration started.
+  if (initialized_) {
+    return false;
+  }
+  return absl::visit(
+      [this](auto const& f) -> bool {
+        using T = std::decay_t<decltype(f)>;
+        if constexpr (std::is_same_v<T, ColumnRange>) {
+          // Like in `FilteredTableStream`, a column range excludes all the
+          // other column families.
+          bool const has_family = column_families_.count(f.column_family) > 0;
+          column_families_.clear();
+          if (has_family) {
+            column_families_.insert(f.column_family);
+          }
+          column_ranges_.Intersect(f.range);
+          return true;
+        } else if constexpr (std::is_same_v<T, FamilyNameRegex>) {
+          for (auto it = column_families_.begin();
+               it != column_families_.end();) {
+            it = f.regex->PartialMatch(*it) ? std::next(it)
+                                            : column_families_.erase(it);
+          }
+          return true;
+        } else if constexpr (std::is_same_v<T, TimestampRange>) {
+          timestamp_ranges_.Intersect(f.range);
+          return true;
+        } else if constexpr (std::is_same_v<T, RowKeyRegex>) {
+          row_regexes_.emplace_back(f.regex);
+          return true;
+        } else if constexpr (std::is_same_v<T, ColumnRegex>) {
+          column_regexes_.emplace_back(f.regex);
+          return true;
+        } else {
+          return false;
+        }
+      },
+      internal_filter);
+}
+
+void PersistentFilteredTableStream::InitializeIfNeeded() const {
+  if (initialized_) return;
+  initialized_ = true;
+  if (!it_ || column_families_.empty()) {
+    has_value_ = false;
+    return;
+  }
+  std::string search_key = table_prefix_;
+  if (row_ranges_ && !row_ranges_->disjoint_ranges().empty()) {
+    auto const& first = *row_ranges_->disjoint_ranges().begin();
+    if (auto const* start = absl::get_if<std::string>(&first.start())) {
+      search_key += *start;
     }
+  }
+  it_->Seek(search_key);
+  has_value_ = SkipToMatchingCell();
+}
 
-    ++stream_it;
+bool PersistentFilteredTableStream::HasValue() const {
+  InitializeIfNeeded();
+  return has_value_;
+}
+
+CellView const& PersistentFilteredTableStream::Value() const {
+  InitializeIfNeeded();
+  if (!current_view_.has_value()) {
+    current_view_.emplace(cur_row_, cur_family_, cur_qualifier_,
+                          cur_timestamp_, cur_value_);
   }
+  return current_view_.value();
+}
 
+bool PersistentFilteredTableStream::Next(NextMode mode) {
+  InitializeIfNeeded();
+  if (!has_value_) return false;
+  current_view_.reset();
+  switch (mode) {
+    case NextMode::kCell:
+      it_->Next();
+      break;
+    case NextMode::kColumn:
+      SeekPast(cur_row_ + "/" + cur_family_ + "/" + cur_qualifier_);
+      break;
+    case NextMode::kRow:
+      SeekPast(cur_row_);
+      break;
+  }
+  has_value_ = SkipToMatchingCell();
   return true;
 }
-std::vector<CellStream> FilteredTableStream::CreateCellStreams(
-    std::vector<std::unique_ptr<FilteredColumnFamilyStream>> cf_streams) {
-  std::vector<CellStream> res;
-  res.reserve(cf_streams.size());
-  for (auto& stream : cf_streams) {
-    res.emplace_back(std::move(stream));
+
+void PersistentFilteredTableStream::SeekPast(
+    absl::string_view key_prefix) const {
+  // All keys starting with `key_prefix + "/"` sort before `key_prefix + "0"`.
+  std::string target = table_prefix_;
+  target.append(key_prefix.data(), key_prefix.size());
+  target.push_back('/' + 1);
+  it_->Seek(target);
+}
+
+bool PersistentFilteredTableStream::SeekToRowRange(
+    absl::string_view row_key) const {
+  if (!row_ranges_) return true;
+  StringRangeSet::Range::Value const value{std::string(row_key)};
+  for (auto const& range : row_ranges_->disjoint_ranges()) {
+    if (range.IsWithin(row_key)) {
+      return true;
+    }
+    if (range.IsBelowStart(value)) {
+      // The ranges are sorted and disjoint, so this is the next one.
+      std::string const target = table_prefix_ + range.start_finite();
+      // Row keys are terminated by a `/` in the keys, so e.g. `a/...` sorts
+      // after `a-b`. Never seek backwards.
+      if (it_->key().compare(target) < 0) {
+        it_->Seek(target);
+      } else {
+        it_->Next();
+      }
+      return false;
+    }
   }
-  return res;
+  it_->Seek(CalculatePrefixEnd(table_prefix_));
+  return false;
 }
 
-std::vector<CellStream> FilteredTableStream::CreateCellStreams(
-    std::vector<std::unique_ptr<PersistentFilteredColumnFamilyStream>> cf_streams) {
-  std::vector<CellStream> res;
-  res.reserve(cf_streams.size());
-  for (auto& stream : cf_streams) {
-    res.emplace_back(std::move(stream));
+bool PersistentFilteredTableStream::RowMatches(
+    absl::string_view row_key) const {
+  for (auto const& regex : row_regexes_) {
+    if (!regex->PartialMatch(row_key)) return false;
   }
-  return res;
+  return true;
+}
+
+bool PersistentFilteredTableStream::ColumnMatches(
+    absl::string_view column_qualifier) const {
+  bool in_range = false;
+  for (auto const& range : column_ranges_.disjoint_ranges()) {
+    if (range.IsWithin(column_qualifier)) {
+      in_range = true;
+      break;
+    }
+  }
+  if (!in_range) return false;
+  for (auto const& regex : column_regexes_) {
+    if (!regex->PartialMatch(column_qualifier)) return false;
+  }
+  return true;
+}
+
+bool PersistentFilteredTableStream::TimestampMatches(
+    std::chrono::milliseconds timestamp) const {
+  for (auto const& range : timestamp_ranges_.disjoint_ranges()) {
+    if (range.IsWithin(timestamp)) return true;
+  }
+  return false;
+}
+
+// Keys have the form
+// /tables/<table_name>/<row_key>/<column_family>/<column_qualifier>/<timestamp>
+bool PersistentFilteredTableStream::SkipToMatchingCell() const {
+  while (it_->Valid()) {
+    auto const raw_key = it_->key();
+    absl::string_view key(raw_key.data(), raw_key.size());
+    if (!absl::ConsumePrefix(&key, table_prefix_)) {
+      return false;
+    }
+    auto const row_end = key.find('/');
+    auto const family_end = row_end == absl::string_view::npos
+                                ? absl::string_view::npos
+                                : key.find('/', row_end + 1);
+    auto const qualifier_end = family_end == absl::string_view::npos
+                                   ? absl::string_view::npos
+                                   : key.find('/', family_end + 1);
+    std::int64_t timestamp_ms;
+    if (qualifier_end == absl::string_view::npos ||
+        !absl::SimpleAtoi(key.substr(qualifier_end + 1), &timestamp_ms)) {
+      it_->Next();
+      continue;
+    }
+    auto const row_key = key.substr(0, row_end);
+    auto const family = key.substr(row_end + 1, family_end - row_end - 1);
+    auto const qualifier =
+        key.substr(family_end + 1, qualifier_end - family_end - 1);
+
+    // The row filters are only evaluated once per row.
+    if (!row_matched_ || row_key != cur_row_) {
+      row_matched_ = false;
+      if (!SeekToRowRange(row_key)) {
+        continue;
+      }
+      if (!RowMatches(row_key)) {
+        SeekPast(row_key);
+        continue;
+      }
+      cur_row_.assign(row_key.data(), row_key.size());
+      row_matched_ = true;
+    }
+    if (column_families_.find(family) == column_families_.end()) {
+      SeekPast(key.substr(0, family_end));
+      continue;
+    }
+    if (!ColumnMatches(qualifier)) {
+      SeekPast(key.substr(0, qualifier_end));
+      continue;
+    }
+    auto const timestamp = std::chrono::milliseconds(timestamp_ms);
+    if (!TimestampMatches(timestamp)) {
+      it_->Next();
+      continue;
+    }
+    auto const mask = gc_masks_.find(family);
+    if (mask != gc_masks_.end()) {
+      // The keys don't order the cells by timestamp, so the column's
+      // timestamps are read ahead to rank its cells, once per column.
+      if (!mask->second.version_limits().empty()) {
+        absl::string_view const column_prefix(
+            raw_key.data(), table_prefix_.size() + qualifier_end + 1);
+        if (column_prefix != ranked_column_) {
+          ranked_column_.assign(column_prefix.data(), column_prefix.size());
+          gc_limit_timestamps_ =
+              mask->second.FindLimitTimestamps(ReadColumnTimestamps(
+                  *it_, ranked_column_, raw_key.ToString()));
+          // Reading ahead moved the iterator, which `key` pointed into.
+          continue;
+        }
+      }
+      if (mask->second.Hides(timestamp, gc_limit_timestamps_)) {
+        it_->Next();
+        continue;
+      }
+    }
+    cur_family_.assign(family.data(), family.size());
+    cur_qualifier_.assign(qualifier.data(), qualifier.size());
+    cur_timestamp_ = timestamp;
+    auto const value = it_->value();
+    cur_value_.assign(value.data(), value.size());
+    return true;
+  }
+  return false;
 }
 
 StatusOr<StringRangeSet> CreateStringRangeSet(
@@ -659,9 +1585,10 @@ StatusOr<StringRangeSet> CreateStringRangeSet(
 StatusOr<google::bigtable::v2::CheckAndMutateRowResponse>
 Table::CheckAndMutateRow(
     google::bigtable::v2::CheckAndMutateRowRequest const& request) {
-  std::lock_guard<std::mutex> lock(mu_);
+  std::shared_lock<std::shared_mutex> lock(mu_);
 
   auto const& row_key = request.row_key();
+  auto row_lock = row_locks_.Lock(row_key);
 
   if (row_key.size() > kMaxRowLen) {
     return InvalidArgumentError(
@@ -690,23 +1617,26 @@ Table::CheckAndMutateRow(
   auto range_set = std::make_shared<StringRangeSet>();
   range_set->Sum(StringRangeSet::Range(row_key, false, row_key, false));
 
-  StatusOr<CellStream> maybe_stream;
-  if (request.has_predicate_filter()) {
-    maybe_stream =
-        CreateCellStream(range_set, std::move(request.predicate_filter()));
-  } else {
-    maybe_stream = CreateCellStream(range_set, absl::nullopt);
-  }
-
-  if (!maybe_stream) {
-    return maybe_stream.status();
-  }
-
   bool a_cell_is_found = false;
+  {
+    // Other rows' transactions may be modifying the in-memory rows.
+    std::lock_guard<std::mutex> rows_lock(rows_mu_);
+    StatusOr<CellStream> maybe_stream;
+    if (request.has_predicate_filter()) {
+      maybe_stream =
+          CreateCellStream(range_set, std::move(request.predicate_filter()));
+    } else {
+      maybe_stream = CreateCellStream(range_set, absl::nullopt);
+    }
 
-  CellStream& stream = *maybe_stream;
-  if (stream) {  // At least one cell/value found when filter is applied
-    a_cell_is_found = true;
+    if (!maybe_stream) {
+      return maybe_stream.status();
+    }
+
+    CellStream& stream = *maybe_stream;
+    if (stream) {  // At least one cell/value found when filter is applied
+      a_cell_is_found = true;
+    }
   }
 
   Status status;
@@ -744,19 +1674,53 @@ Status Table::ReadRows(google::bigtable::v2::ReadRowsRequest const& request,
   } else {
     row_set = std::make_shared<StringRangeSet>(StringRangeSet::All());
   }
-  std::lock_guard<std::mutex> lock(mu_);
-
-  StatusOr<CellStream> maybe_stream;
-  if (request.has_filter()) {
-    maybe_stream = CreateCellStream(row_set, std::move(request.filter()));
-  } else {
-    maybe_stream = CreateCellStream(row_set, absl::nullopt);
-  }
+  absl::optional<google::bigtable::v2::RowFilter> filter;
+  if (request.has_filter()) filter = request.filter();
+
+  // A limited read usually stops long before the end of its row set, so it
+  // is not split.
+  bool const split = request.rows_limit() <= 0;
+  TableSnapshot snapshot;
+  std::vector<std::string> split_keys;
+  std::vector<std::string> cf_names;
+  std::uint64_t table_bytes = 0;
+  {
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    // The transactions of other rows publish to the in-memory rows,
+    // `stats_` and `tablets_` under `rows_mu_`, so the snapshot pinned under
+    // it sees the mutations published before it and none after.
+    std::unique_lock<std::mutex> rows_lock(rows_mu_);
+    snapshot = GetSnapshotNoLock();
+    // The tablets are sized already.
+    if (split && tablets_.size() > 1) split_keys = tablets_.SplitKeys();
+    table_bytes = static_cast<std::uint64_t>(stats_.Total().logical_bytes);
+    rows_lock.unlock();
+    if (split) cf_names = StorageColumnFamilyNames();
+  }
+  // Planning the split reads the storage's size estimates or the snapshot,
+  // so neither transactions nor schema changes wait for it.
+  if (split && split_keys.empty()) {
+    split_keys =
+        ParallelScanSplitKeys(*row_set, snapshot, cf_names, table_bytes);
+  }
+
+  // With a storage, the streams read the column families of the current
+  // schema, which a concurrent schema change may have changed since the
+  // snapshot was pinned.
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  auto maybe_stream =
+      split_keys.empty()
+          ? CreateCellStream(row_set, filter, std::move(snapshot))
+          : CreateParallelCellStream(row_set, filter, split_keys, snapshot);
 
   if (!maybe_stream) {
     return maybe_stream.status();
   }
 
+  // The stream only reads from the snapshot, so mutations don't have to wait
+  // for a possibly slow client to consume it.
+  lock.unlock();
+
   std::int64_t rows_count = 0;
   absl::optional<std::string> current_row_key;
 
@@ -786,7 +1750,7 @@ Status Table::ReadRows(google::bigtable::v2::ReadRowsRequest const& request,
 }
 
 bool Table::IsDeleteProtected() const {
-  std::lock_guard<std::mutex> lock(mu_);
+  std::lock_guard<std::shared_mutex> lock(mu_);
   return IsDeleteProtectedNoLock();
 }
 
@@ -794,137 +1758,146 @@ bool Table::IsDeleteProtectedNoLock() const {
   return schema_.deletion_protection();
 }
 
-Status Table::SampleRowKeys(
-    double pass_probability,
-    grpc::ServerWriter<google::bigtable::v2::SampleRowKeysResponse>* writer) {
-  if (pass_probability <= 0.0) {
-    return InvalidArgumentError(
-        "The sampling probabality must be positive",
-        GCP_ERROR_INFO().WithMetadata("provided sampling probability",
-                                      absl::StrFormat("%f", pass_probability)));
-  }
+namespace {
 
-  auto sample_every =
-      static_cast<std::uint64_t>(std::ceil(1.0 / pass_probability));
+// `SampleRowKeys` splits tables into ranges of about this size, like tablets.
+std::uint64_t constexpr kSampleRowKeysRangeBytes = 64 << 20;
+std::size_t constexpr kSampleRowKeysMaxRanges = 256;
 
-  std::lock_guard<std::mutex> lock(mu_);
-
-  // First, stream all rows and cells and compute the offsets.
-  auto all_rows_set = std::make_shared<StringRangeSet>(StringRangeSet::All());
-  auto maybe_all_rows_stream = CreateCellStream(all_rows_set, absl::nullopt);
-  if (!maybe_all_rows_stream) {
-    return maybe_all_rows_stream.status();
-  }
-
-  auto& stream = *maybe_all_rows_stream;
+// The number of evenly sized ranges a table of `total_bytes` is split into.
+//
+// Non-empty tables are split in at least two ranges: client conformance tests
+// expect at least one row sample besides the final one when the table is not
+// empty.
+std::size_t SampleRowKeysRanges(std::uint64_t total_bytes) {
+  auto const ranges =
+      (total_bytes + kSampleRowKeysRangeBytes - 1) / kSampleRowKeysRangeBytes;
+  return static_cast<std::size_t>(
+      std::clamp<std::uint64_t>(ranges, 2, kSampleRowKeysMaxRanges));
+}
 
-  absl::optional<std::string> first_row_key;
-  // The first row read will be used as a constant estimate of row
-  // sizes. If we are sampling 1/n rows, the value added to the offset
-  // (which is to be regarded as the size of all the rows before the
-  // sampled one) will be (n * row_size_estimate).
-  //
-  // That is every time a row is sampled, we do: offset += (n *
-  // row_size_estimate).
-  std::size_t row_size_estimate = 0;
+void AddRowKeySample(
+    std::vector<google::bigtable::v2::SampleRowKeysResponse>& samples,
+    std::string row_key, std::int64_t offset_bytes) {
+  // Both the row keys and the offsets have to be strictly increasing.
+  if (!samples.empty() && (row_key <= samples.back().row_key() ||
+                           offset_bytes <= samples.back().offset_bytes())) {
+    return;
+  }
+  google::bigtable::v2::SampleRowKeysResponse sample;
+  sample.set_row_key(std::move(row_key));
+  sample.set_offset_bytes(offset_bytes);
+  samples.emplace_back(std::move(sample));
+}
 
-  for (; stream; ++stream) {
-    if (first_row_key.has_value() &&
-        stream->row_key() != first_row_key.value()) {
-      break;
+}  // namespace
+
+StatusOr<std::vector<google::bigtable::v2::SampleRowKeysResponse>>
+Table::SampleRowKeys() const {
+  std::unique_lock<std::shared_mutex> lock(mu_);
+  std::vector<google::bigtable::v2::SampleRowKeysResponse> samples;
+  std::uint64_t total_bytes = 0;
+
+  auto* storage = GetGlobalStorage();
+  if (tablets_.size() > 1) {
+    // The tablet boundaries are the split points, even for empty tablets.
+    std::int64_t offset = 0;
+    for (auto const& tablet : tablets_) {
+      if (!tablet.start_key.empty()) {
+        google::bigtable::v2::SampleRowKeysResponse sample;
+        sample.set_row_key(tablet.start_key);
+        sample.set_offset_bytes(
+            samples.empty()
+                ? offset
+                : std::max(offset, samples.back().offset_bytes() + 1));
+        samples.emplace_back(std::move(sample));
+      }
+      // With persistent storage the sizes are estimated again, since the
+      // tablets only track the mutations as unmeasured bytes.
+      offset += std::max<std::int64_t>(
+          storage != nullptr ? MeasureRows(tablet.start_key, tablet.end_key)
+                             : tablet.logical_bytes,
+          0);
     }
-
-    first_row_key = stream->row_key();
-
-    row_size_estimate += stream->row_key().size();
-    row_size_estimate += stream->column_qualifier().size();
-    row_size_estimate += stream->value().size();
-    row_size_estimate += sizeof(stream->timestamp());
-  }
-
-  if (!first_row_key.has_value()) {
-    // No rows in the table
-    google::bigtable::v2::SampleRowKeysResponse resp;
-    resp.set_row_key("");
-    resp.set_offset_bytes(0);
-
-    auto opts = grpc::WriteOptions();
-    opts.set_last_message();
-
-    writer->WriteLast(std::move(resp), opts);
-    return Status();
-  }
-
-  std::int64_t offset_delta = sample_every * row_size_estimate;
-
-  google::bigtable::v2::RowFilter sample_filter;
-  sample_filter.set_row_sample_filter(pass_probability);
-
-  auto maybe_stream = CreateCellStream(all_rows_set, sample_filter);
-  if (!maybe_stream) {
-    return maybe_stream.status();
-  }
-
-  auto& sampled_stream = *maybe_stream;
-
-  std::int64_t offset = 0;
-
-  bool wrote_a_sample;
-
-  for (; sampled_stream; sampled_stream.Next(NextMode::kRow)) {
-    google::bigtable::v2::SampleRowKeysResponse resp;
-    offset += offset_delta;
-    resp.set_row_key(sampled_stream->row_key());
-    resp.set_offset_bytes(offset);
-
-    writer->Write(std::move(resp));
-
-    wrote_a_sample = true;
-  }
-
-  // Cloud bigtable client tests expect that, if they populated the
-  // table with at least one row, then at least one row sample is
-  // returned.
-  //
-  // In such a case, return any string that represents the last key,
-  // and an offset that is the estimated row size * the number of rows
-  // in the largest column family. We can return any string because
-  // the keys returned need not be in the table. See the proto
-  // specification.
-  if (!wrote_a_sample) {
-    std::size_t row_count_estimate = 0;
-
-    for (auto const& cf : *get()) {
-      if (cf.second->size() > row_count_estimate) {
-        row_count_estimate = cf.second->size();
+    total_bytes = static_cast<std::uint64_t>(offset);
+  } else if (storage != nullptr) {
+    // Derive the split points from RocksDB's size estimates rather than
+    // reading the table.
+    auto const cf_names = StorageColumnFamilyNames();
+    std::string const table_prefix = "/tables/" + name_ + "/";
+    std::string const table_end = CalculatePrefixEnd(table_prefix);
+    total_bytes =
+        storage->GetApproximateSize(cf_names, table_prefix, table_end);
+    auto const ranges = total_bytes == 0 ? 1 : SampleRowKeysRanges(total_bytes);
+    for (std::size_t i = 1; i < ranges; ++i) {
+      auto row_key = FindStoredRow(
+          cf_names, storage->FindApproximateSplitKey(
+                        cf_names, table_prefix, table_end,
+                        total_bytes * i / ranges));
+      if (!row_key) break;
+      auto const offset = storage->GetApproximateSize(
+          cf_names, table_prefix, table_prefix + *row_key + "/");
+      AddRowKeySample(samples, *std::move(row_key),
+                      static_cast<std::int64_t>(offset));
+    }
+    // The estimates may miss a few small, freshly written rows.
+    if (samples.empty()) {
+      auto row_key = FindStoredRow(cf_names, table_prefix);
+      if (row_key) AddRowKeySample(samples, *std::move(row_key), 0);
+    }
+  } else {
+    // The stats use the same notion of size as the loop below.
+    total_bytes = static_cast<std::uint64_t>(stats_.Total().logical_bytes);
+    auto const ranges = total_bytes == 0 ? 1 : SampleRowKeysRanges(total_bytes);
+    auto all_rows_set = std::make_shared<StringRangeSet>(StringRangeSet::All());
+    auto maybe_stream =
+        CreateCellStream(all_rows_set, absl::nullopt, GetSnapshotNoLock());
+    if (!maybe_stream) {
+      return maybe_stream.status();
+    }
+    // The stats and the snapshot are consistent, the rest is just reading.
+    lock.unlock();
+    // Sample the rows containing the range boundaries, like the persistent
+    // path does.
+    std::uint64_t offset = 0;
+    std::uint64_t row_offset = 0;
+    std::size_t next_range = 1;
+    absl::optional<std::string> current_row;
+    for (auto& stream = *maybe_stream; stream && next_range < ranges;
+         ++stream) {
+      if (current_row != stream->row_key()) {
+        current_row = stream->row_key();
+        row_offset = offset;
+      }
+      offset += static_cast<std::uint64_t>(LogicalCellSize(
+          stream->row_key(), stream->column_qualifier(), stream->value()));
+      if (offset > total_bytes * next_range / ranges) {
+        AddRowKeySample(samples, *current_row,
+                        static_cast<std::int64_t>(row_offset));
+        while (next_range < ranges &&
+               offset > total_bytes * next_range / ranges) {
+          ++next_range;
+        }
       }
     }
-
-    std::int64_t this_offset = row_count_estimate * row_size_estimate;
-
-    google::bigtable::v2::SampleRowKeysResponse resp;
-    resp.set_row_key("last_key");
-    resp.set_offset_bytes(this_offset);
-    writer->Write(std::move(resp));
-
-    offset += this_offset;
   }
 
-  google::bigtable::v2::SampleRowKeysResponse resp;
-  resp.set_row_key("");
-  // Client test code expects offset_bytes to be strictly
-  // increasing.
-  resp.set_offset_bytes(offset + 1);
-  auto opts = grpc::WriteOptions();
-  opts.set_last_message();
-  writer->WriteLast(std::move(resp), opts);
-
-  return Status();
+  // The last sample covers the end of the table. Client test code expects
+  // offset_bytes to be strictly increasing.
+  auto last_offset = static_cast<std::int64_t>(total_bytes);
+  if (!samples.empty() && last_offset <= samples.back().offset_bytes()) {
+    last_offset = samples.back().offset_bytes() + 1;
+  }
+  google::bigtable::v2::SampleRowKeysResponse last;
+  last.set_row_key("");
+  last.set_offset_bytes(last_offset);
+  samples.emplace_back(std::move(last));
+  return samples;
 }
 
 Status Table::DropRowRange(
     ::google::bigtable::admin::v2::DropRowRangeRequest const& request) {
-  std::lock_guard<std::mutex> lock(mu_);
+  std::lock_guard<std::shared_mutex> lock(mu_);
 
   if (!request.has_row_key_prefix() &&
       !request.has_delete_all_data_from_table()) {
@@ -938,6 +1911,12 @@ Status Table::DropRowRange(
     for (auto& column_family : column_families_) {
       column_family.second->clear();
     }
+    stats_.rows = 0;
+    for (auto& column_family_stats : stats_.column_families) {
+      column_family_stats.second = ColumnFamilyStats{};
+    }
+    PersistStats();
+    RemeasureTablets();
 
     return Status();
   }
@@ -957,16 +1936,31 @@ Status Table::DropRowRange(
                                       request.DebugString()));
   }
 
+  // The end of the rows with the prefix, or empty if there is none.
+  auto prefix_end = CalculatePrefixEnd(row_key_prefix);
+  if (prefix_end <= row_key_prefix) prefix_end.clear();
+  TableStats dropped;
+  std::set<std::string> dropped_rows;
   for (auto& cf : column_families_) {
+    auto& dropped_cf = dropped.column_families[cf.first];
+    cf.second->ThawRows(row_key_prefix, prefix_end);
     for (auto row_it = cf.second->lower_bound(row_key_prefix);
          row_it != cf.second->end();) {
       if (absl::StartsWith(row_it->first, row_key_prefix)) {
+        dropped_cf.AddRow(row_it->first, row_it->second);
+        dropped_rows.insert(row_it->first);
         row_it = cf.second->erase(row_it);
       } else {
         break;
       }
     }
   }
+  dropped.rows = static_cast<std::int64_t>(dropped_rows.size());
+  if (!dropped.IsZero()) {
+    stats_ -= dropped;
+    PersistStats();
+    RemeasureTablets();
+  }
 
   return Status();
 }
@@ -981,9 +1975,10 @@ Table::ReadModifyWriteRow(
             "row_key size", absl::StrFormat("%zu", request.row_key().size())));
   }
 
-  std::lock_guard<std::mutex> lock(mu_);
+  std::shared_lock<std::shared_mutex> lock(mu_);
+  auto row_lock = row_locks_.Lock(request.row_key());
 
-  RowTransaction row_transaction(this->get(), request.row_key());
+  RowTransaction row_transaction(this->get(), request.row_key(), name_);
 
   auto maybe_response = row_transaction.ReadModifyWriteRow(request);
   if (!maybe_response) {
@@ -995,11 +1990,130 @@ Table::ReadModifyWriteRow(
   return std::move(maybe_response.value());
 }
 
-// NOLINTBEGIN(readability-convert-member-functions-to-static)
-Status RowTransaction::AddToCell(
-    ::google::bigtable::v2::Mutation_AddToCell const& add_to_cell,
-    absl::optional<std::chrono::milliseconds> timestamp_override) {
-  auto status = table_->FindColumnFamily(add_to_cell);
+namespace {
+
+// Whether `DeleteFromColumn` with `time_range` deletes the cell at
+// `timestamp`, like `ColumnRow::DeleteTimeRange`.
+bool InTimeRange(::google::bigtable::v2::TimestampRange const& time_range,
+                 std::chrono::milliseconds timestamp) {
+  auto const start = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::microseconds(time_range.start_timestamp_micros()));
+  auto const end = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::microseconds(time_range.end_timestamp_micros()));
+  return timestamp >= start && (end.count() == 0 || timestamp < end);
+}
+
+}  // namespace
+
+RowTransaction::StagedFamily& RowTransaction::Stage(
+    std::string const& family_name, ColumnFamily& column_family) {
+  auto& family = staged_[family_name];
+  family.column_family = &column_family;
+  return family;
+}
+
+bool RowTransaction::IsDeleted(StagedFamily const& family,
+                               StagedColumn const* column,
+                               std::chrono::milliseconds timestamp) {
+  if (family.cleared) return true;
+  if (column == nullptr) return false;
+  return std::any_of(column->deleted_ranges.begin(),
+                     column->deleted_ranges.end(),
+                     [timestamp](auto const& range) {
+                       return InTimeRange(range, timestamp);
+                     });
+}
+
+absl::optional<absl::string_view> RowTransaction::StagedValue(
+    StagedFamily const& family, std::string const& column_qualifier,
+    std::chrono::milliseconds timestamp) const {
+  auto column_it = family.columns.find(column_qualifier);
+  auto const* column =
+      column_it == family.columns.end() ? nullptr : &column_it->second;
+  if (column != nullptr) {
+    auto cell_it = column->cells.find(timestamp);
+    if (cell_it != column->cells.end()) return cell_it->second;
+  }
+  if (IsDeleted(family, column, timestamp)) return absl::nullopt;
+  return family.column_family->FindCell(row_key_, column_qualifier, timestamp);
+}
+
+absl::optional<std::pair<std::chrono::milliseconds, std::string>>
+RowTransaction::StagedNewestCell(StagedFamily const& family,
+                                 std::string const& column_qualifier) const {
+  absl::optional<std::pair<std::chrono::milliseconds, std::string>> res;
+  auto column_it = family.columns.find(column_qualifier);
+  auto const* column =
+      column_it == family.columns.end() ? nullptr : &column_it->second;
+  if (column != nullptr && !column->cells.empty()) {
+    res.emplace(column->cells.begin()->first,
+                std::string(column->cells.begin()->second));
+  }
+  if (family.cleared) return res;
+  // Other rows' transactions may be publishing to the in-memory rows.
+  std::lock_guard<std::mutex> rows_lock(table_->rows_mu_);
+  family.column_family->ForEachRow(
+      row_key_, row_key_ + '\0',
+      [&](std::string const&, ColumnFamilyRow const& row) {
+        auto base_it = row.lower_bound(column_qualifier);
+        if (base_it == row.end() || !(base_it->first == column_qualifier)) {
+          return;
+        }
+        // Newest first, and the staged cells win over the ones they
+        // overwrote.
+        for (auto const& cell : base_it->second) {
+          if (res && cell.first <= res->first) return;
+          if (!IsDeleted(family, column, cell.first)) {
+            res.emplace(cell.first, std::string(cell.second));
+            return;
+          }
+        }
+      });
+  return res;
+}
+
+bool RowTransaction::StagedRowExists(StagedFamily const& family) const {
+  bool partially_deleted = false;
+  for (auto const& column : family.columns) {
+    if (!column.second.cells.empty()) return true;
+    partially_deleted =
+        partially_deleted || !column.second.deleted_ranges.empty();
+  }
+  if (family.cleared) return false;
+  // Other rows' transactions may be publishing to the in-memory rows.
+  std::lock_guard<std::mutex> rows_lock(table_->rows_mu_);
+  if (!family.column_family->HasRow(row_key_)) return false;
+  if (!partially_deleted) return true;
+  bool exists = false;
+  family.column_family->ForEachRow(
+      row_key_, row_key_ + '\0',
+      [&](std::string const&, ColumnFamilyRow const& row) {
+        for (auto const& base_column : row) {
+          auto column_it = family.columns.find(base_column.first.name());
+          auto const* column =
+              column_it == family.columns.end() ? nullptr : &column_it->second;
+          for (auto const& cell : base_column.second) {
+            if (!IsDeleted(family, column, cell.first)) {
+              exists = true;
+              return;
+            }
+          }
+        }
+      });
+  return exists;
+}
+
+void RowTransaction::ClearFamily(StagedFamily& family) {
+  family.cleared = true;
+  family.columns.clear();
+}
+
+template <typename Mutation>
+Status RowTransaction::AggregateToCell(
+    Mutation const& mutation,
+    absl::optional<std::chrono::milliseconds> timestamp_override,
+    bool merge) {
+  auto status = table_->FindColumnFamily(mutation);
   if (!status.ok()) {
     return status.status();
   }
@@ -1011,94 +2125,128 @@ Status RowTransaction::AddToCell(
     return InvalidArgumentError(
         "column family is not configured to contain aggregation cells or "
         "aggregation type not properly configured",
-        GCP_ERROR_INFO().WithMetadata("column family",
-                                      add_to_cell.family_name()));
+        GCP_ERROR_INFO().WithMetadata("column family", mutation.family_name()));
   }
 
   // Ensure that we support the aggregation that is configured in the
   // column family.
-  switch (cf_value_type.value().aggregate_type().aggregator_case()) {
+  auto const aggregator_case =
+      cf_value_type.value().aggregate_type().aggregator_case();
+  switch (aggregator_case) {
     case google::bigtable::admin::v2::Type::Aggregate::kSum:
     case google::bigtable::admin::v2::Type::Aggregate::kMin:
     case google::bigtable::admin::v2::Type::Aggregate::kMax:
+    case google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount:
       break;
     default:
       return UnimplementedError(
           "column family configured with unimplemented aggregation",
           GCP_ERROR_INFO()
-              .WithMetadata("column family", add_to_cell.family_name())
+              .WithMetadata("column family", mutation.family_name())
               .WithMetadata("configured aggregation",
-                            absl::StrFormat("%d", cf_value_type.value()
-                                                      .aggregate_type()
-                                                      .aggregator_case())));
+                            absl::StrFormat("%d", aggregator_case)));
   }
+  bool const unique_count =
+      aggregator_case ==
+      google::bigtable::admin::v2::Type::Aggregate::kHllppUniqueCount;
 
-  if (!add_to_cell.has_input()) {
+  if (!mutation.has_input()) {
     return InvalidArgumentError(
         "input not set",
-        GCP_ERROR_INFO().WithMetadata("mutation", add_to_cell.DebugString()));
+        GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
   }
 
-  switch (add_to_cell.input().kind_case()) {
+  // The inputs of AddToCell are added to the cell's state, those of
+  // MergeToCell are states themselves. Only the state of the unique count,
+  // a sketch, is not an int64.
+  auto const& input = mutation.input();
+  switch (input.kind_case()) {
     case google::bigtable::v2::Value::kIntValue:
-      if (!add_to_cell.input().has_int_value()) {
-        return InvalidArgumentError("input value not set",
-                                    GCP_ERROR_INFO().WithMetadata(
-                                        "mutation", add_to_cell.DebugString()));
+      if (merge && unique_count) {
+        return InvalidArgumentError(
+            "only bytes values are supported",
+            GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
+      }
+      break;
+    case google::bigtable::v2::Value::kBytesValue:
+      if (!unique_count) {
+        return InvalidArgumentError(
+            "only int64 values are supported",
+            GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
+      }
+      break;
+    case google::bigtable::v2::Value::kStringValue:
+      if (!unique_count || merge) {
+        return InvalidArgumentError(
+            merge ? "only bytes values are supported"
+                  : "only int64 values are supported",
+            GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
       }
       break;
     default:
       return InvalidArgumentError(
           "only int64 values are supported",
-          GCP_ERROR_INFO().WithMetadata("mutation", add_to_cell.DebugString()));
+          GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
   }
-  auto int64_input = add_to_cell.input().int_value();
-
-  auto value = google::cloud::internal::EncodeBigEndian(int64_input);
-  auto row_key = row_key_;
-
   std::chrono::milliseconds ts_ms;
   if (timestamp_override.has_value()) {
     ts_ms = timestamp_override.value();
   } else {
     ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::microseconds(
-            add_to_cell.timestamp().raw_timestamp_micros()));
+        std::chrono::microseconds(mutation.timestamp().raw_timestamp_micros()));
   }
 
-  if (!add_to_cell.has_column_qualifier() ||
-      !add_to_cell.column_qualifier().has_raw_value()) {
+  if (!mutation.has_column_qualifier() ||
+      !mutation.column_qualifier().has_raw_value()) {
     return InvalidArgumentError(
         "column qualifier not set",
-        GCP_ERROR_INFO().WithMetadata("mutation", add_to_cell.DebugString()));
-  }
-  auto column_qualifier = add_to_cell.column_qualifier().raw_value();
-
-  auto maybe_old_value = cf.UpdateCell(row_key, column_qualifier, ts_ms, value);
-  if (!maybe_old_value) {
-    return maybe_old_value.status();
+        GCP_ERROR_INFO().WithMetadata("mutation", mutation.DebugString()));
+  }
+  auto column_qualifier = mutation.column_qualifier().raw_value();
+
+  auto& family = Stage(mutation.family_name(), cf);
+  StatusOr<std::string> value;
+  {
+    // The existing value may point into the in-memory rows, which other
+    // rows' transactions may be publishing to.
+    std::lock_guard<std::mutex> rows_lock(table_->rows_mu_);
+    auto const existing = StagedValue(family, column_qualifier, ts_ms);
+    switch (input.kind_case()) {
+      case google::bigtable::v2::Value::kIntValue:
+        value = cf.AddToValue(existing, input.int_value());
+        break;
+      case google::bigtable::v2::Value::kBytesValue:
+        value = merge ? cf.MergeToValue(existing, input.bytes_value())
+                      : cf.AddToValue(existing,
+                                      absl::string_view(input.bytes_value()));
+        break;
+      default:
+        value =
+            cf.AddToValue(existing, absl::string_view(input.string_value()));
+        break;
+    }
   }
-
-  if (!maybe_old_value.value()) {
-    DeleteValue delete_value{cf, add_to_cell.family_name(),
-                             std::move(column_qualifier), ts_ms};
-    undo_.emplace(std::move(delete_value));
-  } else {
-    RestoreValue restore_value{cf, std::move(column_qualifier), ts_ms,
-                               std::move(maybe_old_value.value().value())};
-    undo_.emplace(std::move(restore_value));
+  if (!value) {
+    return value.status();
   }
+  owned_values_.push_back(*std::move(value));
+  family.columns[column_qualifier].cells[ts_ms] = owned_values_.back();
 
   return Status();
 }
 
+Status RowTransaction::AddToCell(
+    ::google::bigtable::v2::Mutation_AddToCell const& add_to_cell,
+    absl::optional<std::chrono::milliseconds> timestamp_override) {
+  return AggregateToCell(add_to_cell, timestamp_override, /*merge=*/false);
+}
+
 Status RowTransaction::MergeToCell(
-    ::google::bigtable::v2::Mutation_MergeToCell const& merge_to_cell) {
-  return UnimplementedError(
-      "Unsupported mutation type.",
-      GCP_ERROR_INFO().WithMetadata("mutation", merge_to_cell.DebugString()));
+    ::google::bigtable::v2::Mutation_MergeToCell const& merge_to_cell,
+    absl::optional<std::chrono::milliseconds> timestamp_override) {
+  return AggregateToCell(merge_to_cell, timestamp_override, /*merge=*/true);
 }
-// NOLINTEND(readability-convert-member-functions-to-static)
+
 
 Status RowTransaction::DeleteFromColumn(
     ::google::bigtable::v2::Mutation_DeleteFromColumn const&
@@ -1132,25 +2280,16 @@ Status RowTransaction::DeleteFromColumn(
     }
   }
 
-  auto& column_family = maybe_column_family->get();
-
-  auto deleted_cells = column_family.DeleteColumn(
-      row_key_, delete_from_column.column_qualifier(),
-      delete_from_column.time_range());
-
-  std::string prefixed_cf_name = table_key_ + "/" + delete_from_column.family_name();
-  Storage* storage = GetGlobalStorage();
-  if (storage != nullptr) {
-    storage->DeleteColumn(table_key_, row_key_, prefixed_cf_name,
-                          delete_from_column.column_qualifier());
-  }
-
-  for (auto& cell : deleted_cells) {
-    RestoreValue restore_value{
-        column_family, delete_from_column.column_qualifier(),
-        std::move(cell.timestamp), std::move(cell.value)};
-    undo_.emplace(std::move(restore_value));
+  auto& column = Stage(delete_from_column.family_name(),
+                       maybe_column_family->get())
+                     .columns[delete_from_column.column_qualifier()];
+  auto const& time_range = delete_from_column.time_range();
+  for (auto cell_it = column.cells.begin(); cell_it != column.cells.end();) {
+    cell_it = InTimeRange(time_range, cell_it->first)
+                  ? column.cells.erase(cell_it)
+                  : std::next(cell_it);
   }
+  column.deleted_ranges.push_back(time_range);
 
   return Status();
 }
@@ -1158,28 +2297,16 @@ Status RowTransaction::DeleteFromColumn(
 Status RowTransaction::DeleteFromRow() {
   bool row_existed = false;
   for (auto& column_family : table_->column_families_) {
-    auto deleted_columns = column_family.second->DeleteRow(row_key_);
-
-    for (auto& column : deleted_columns) {
-      auto const& column_qualifier = column.first;
-      for (auto& cell : column.second) {
-        RestoreValue restore_value = {*column_family.second, column_qualifier,
-                                      cell.timestamp, std::move(cell.value)};
-        undo_.emplace(std::move(restore_value));
-        row_existed = true;
-      }
-    }
+    auto& family = Stage(column_family.first, *column_family.second);
+    if (StagedRowExists(family)) row_existed = true;
+    ClearFamily(family);
   }
 
   if (!row_existed) {
     return NotFoundError("row not found in table",
                          GCP_ERROR_INFO().WithMetadata("row", row_key_));
   }
-
-  Storage* storage = GetGlobalStorage();
-  if (storage != nullptr) {
-    storage->DeleteRow(table_key_, row_key_);
-  }
+  row_deleted_ = true;
 
   return Status();
 }
@@ -1192,30 +2319,16 @@ Status RowTransaction::DeleteFromFamily(
     return maybe_column_family.status();
   }
 
-  auto& column_family = maybe_column_family->get();
-  auto deleted_columns = column_family.DeleteRow(row_key_);
-  if (deleted_columns.empty()) {
+  auto& family =
+      Stage(delete_from_family.family_name(), maybe_column_family->get());
+  if (!StagedRowExists(family)) {
     return NotFoundError(
         "row key is not found in column family",
         GCP_ERROR_INFO()
             .WithMetadata("row key", row_key_)
             .WithMetadata("column family", delete_from_family.family_name()));
   }
-
-  for (auto& column : deleted_columns) {
-    auto const& column_qualifier = column.first;
-    for (auto& cell : column.second) {
-      RestoreValue restore_value{column_family, column_qualifier, cell.timestamp,
-                                 std::move(cell.value)};
-      undo_.emplace(std::move(restore_value));
-    }
-  }
-
-  std::string prefixed_cf_name = table_key_ + "/" + delete_from_family.family_name();
-  Storage* storage = GetGlobalStorage();
-  if (storage != nullptr) {
-    storage->DeleteCFRow(table_key_, row_key_, prefixed_cf_name);
-  }
+  ClearFamily(family);
 
   return Status();
 }
@@ -1239,60 +2352,13 @@ Status RowTransaction::SetCell(
     timestamp = timestamp_override.value();
   }
 
-  std::string family_with_table_name = table_key_ + "/" + set_cell.family_name();
-  Storage* storage = GetGlobalStorage();
-  if (storage != nullptr) {
-    storage->PutCell(table_key_, row_key_, family_with_table_name,
-                     set_cell.column_qualifier(), timestamp, set_cell.value());
-  }
-
-  auto maybe_old_value = column_family.SetCell(
-      row_key_, set_cell.column_qualifier(), timestamp, set_cell.value());
-
-  if (!maybe_old_value) {
-    DeleteValue delete_value{column_family, set_cell.family_name(),
-                             std::move(set_cell.column_qualifier()), timestamp};
-    undo_.emplace(std::move(delete_value));
-  } else {
-    RestoreValue restore_value{column_family,
-                               std::move(set_cell.column_qualifier()),
-                               timestamp, std::move(maybe_old_value.value())};
-    undo_.emplace(std::move(restore_value));
-  }
+  Stage(set_cell.family_name(), maybe_column_family->get())
+      .columns[set_cell.column_qualifier()]
+      .cells[timestamp] = set_cell.value();
 
   return Status();
 }
 
-// ProcessReadModifyWriteRuleResult records the result of a
-// ReadModifyWriteRule computation for possible undo in the undo log
-// and also updates the tmp_families temporary table (containing only
-// one row) with the modified cell for later return.
-void ProcessReadModifyWriteResult(
-    ColumnFamily& column_family, std::string const& row_key,
-    std::stack<absl::variant<DeleteValue, RestoreValue>>& undo,
-    google::bigtable::v2::ReadModifyWriteRule const& rule,
-    ReadModifyWriteCellResult& result,
-    std::map<std::string, ColumnFamily>& tmp_families) {
-  if (result.maybe_old_value.has_value()) {
-    // We overwrote a cell, we need to record a RestoreValue in the undo log
-    RestoreValue restore_value{column_family, rule.column_qualifier(),
-                               result.timestamp,
-                               std::move(result.maybe_old_value.value())};
-    undo.emplace(std::move(restore_value));
-  } else {
-    // We created a new cell -- we would need to delete it in any rollback
-    DeleteValue delete_value{column_family, rule.family_name(),
-                             rule.column_qualifier(), result.timestamp};
-    undo.emplace(std::move(delete_value));
-  }
-
-  // Record the cell in our local mini table here to use in
-  // assembling a row of changed cells for return.
-  tmp_families[rule.family_name()].SetCell(row_key, rule.column_qualifier(),
-                                           result.timestamp,
-                                           std::move(result.value));
-}
-
 google::bigtable::v2::ReadModifyWriteRowResponse
 FamiliesToReadModifyWriteResponse(
     std::string const& row_key,
@@ -1313,7 +2379,7 @@ FamiliesToReadModifyWriteResponse(
           cell->set_timestamp_micros(
               std::chrono::duration_cast<std::chrono::microseconds>(cr.first)
                   .count());
-          cell->set_value(std::move(cr.second));
+          cell->set_value(std::string(cr.second));
         }
       }
     }
@@ -1341,73 +2407,269 @@ RowTransaction::ReadModifyWriteRow(
     if (!maybe_column_family) {
       return maybe_column_family.status();
     }
+    if (!rule.has_append_value() && !rule.has_increment_amount()) {
+      return InvalidArgumentError(
+          "either append value or increment amount must be set",
+          GCP_ERROR_INFO().WithMetadata("rule", rule.DebugString()));
+    }
 
-    auto& column_family = maybe_column_family->get();
+    auto& family = Stage(rule.family_name(), maybe_column_family->get());
+    auto const newest = StagedNewestCell(family, rule.column_qualifier());
+    std::string value;
     if (rule.has_append_value()) {
-      auto result = column_family.ReadModifyWrite(
-          row_key_, rule.column_qualifier(), rule.append_value());
-
-      ProcessReadModifyWriteResult(column_family, row_key_, undo_, rule, result,
-                                   tmp_families);
-
-    } else if (rule.has_increment_amount()) {
-      auto maybe_result = column_family.ReadModifyWrite(
-          row_key_, rule.column_qualifier(), rule.increment_amount());
-      if (!maybe_result) {
-        return maybe_result.status();
+      value = newest ? absl::StrCat(newest->second, rule.append_value())
+                     : rule.append_value();
+    } else {
+      std::int64_t old_value = 0;
+      if (newest) {
+        auto maybe_old_value =
+            google::cloud::internal::DecodeBigEndian<std::int64_t>(
+                newest->second);
+        if (!maybe_old_value) {
+          return maybe_old_value.status();
+        }
+        old_value = *maybe_old_value;
       }
+      value = google::cloud::internal::EncodeBigEndian(
+          rule.increment_amount() + old_value);
+    }
 
-      auto& result = maybe_result.value();
-
-      ProcessReadModifyWriteResult(column_family, row_key_, undo_, rule, result,
-                                   tmp_families);
+    // A new cell at the current time, unless the newest cell is not older,
+    // in which case it is overwritten.
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    if (newest && newest->first >= timestamp) timestamp = newest->first;
 
-    } else {
-      return InvalidArgumentError(
-          "either append value or increment amount must be set",
-          GCP_ERROR_INFO().WithMetadata("rule", rule.DebugString()));
-    }
+    // Record the cell in our local mini table here to use in
+    // assembling a row of changed cells for return.
+    tmp_families[rule.family_name()].SetCell(row_key_, rule.column_qualifier(),
+                                             timestamp, value);
+    owned_values_.push_back(std::move(value));
+    family.columns[rule.column_qualifier()].cells[timestamp] =
+        owned_values_.back();
   }
 
   // Now assemble the returned value.
   return FamiliesToReadModifyWriteResponse(row_key_, tmp_families);
 }
 
-void RowTransaction::Undo() {
-  auto row_key = row_key_;
+namespace {
 
-  while (!undo_.empty()) {
-    auto op = undo_.top();
-    undo_.pop();
+// The cells of a row in a column family, see `Storage::ReadCellSizes()`.
+using StoredCells =
+    std::map<std::string, std::map<std::chrono::milliseconds, std::size_t>>;
 
-    auto* restore_value = absl::get_if<RestoreValue>(&op);
-    if (restore_value) {
-      restore_value->column_family.SetCell(
-          row_key, std::move(restore_value->column_qualifier),
-          restore_value->timestamp, std::move(restore_value->value));
-      continue;
+// The [start, end) milliseconds of the stored cells in `time_range`. An end
+// of 0 means no upper bound.
+std::pair<std::chrono::milliseconds, std::chrono::milliseconds>
+StorageTimeRange(::google::bigtable::v2::TimestampRange const& time_range) {
+  return {std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::microseconds(time_range.start_timestamp_micros())),
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::microseconds(time_range.end_timestamp_micros()))};
+}
+
+// The stats of a row whose stored cells in a column family are `cells`.
+ColumnFamilyStats StoredRowStats(std::string const& row_key,
+                                 StoredCells const& cells) {
+  ColumnFamilyStats stats;
+  if (cells.empty()) return stats;
+  stats.rows = 1;
+  for (auto const& column : cells) {
+    stats.AddColumn(column.second.size());
+    for (auto const& cell : column.second) {
+      ++stats.cells;
+      stats.logical_bytes += LogicalCellSize(row_key, column.first, {}) +
+                             static_cast<std::int64_t>(cell.second);
+    }
+  }
+  return stats;
+}
+
+}  // namespace
+
+void RowTransaction::commit() {
+  if (staged_.empty()) return;
+  Storage* storage = GetGlobalStorage();
+  // The storage is read before `rows_mu_` is taken. The row's lock keeps
+  // its stored cells from changing meanwhile.
+  absl::optional<TableStats> stored_stats_delta;
+  if (storage != nullptr && !table_key_.empty()) {
+    stored_stats_delta = StoredStatsDelta(*storage);
+  }
+  {
+    // Only the in-memory publication excludes other rows' transactions. The
+    // row lock keeps the row to ourselves while we write to the storage.
+    std::lock_guard<std::mutex> rows_lock(table_->rows_mu_);
+    bool const row_existed = table_->RowExistsNoLock(row_key_);
+    for (auto& family : staged_) {
+      Publish(family.first, family.second);
+    }
+    bool const row_exists = table_->RowExistsNoLock(row_key_);
+    if (row_exists != row_existed) {
+      stats_delta_.rows += row_exists ? 1 : -1;
     }
+    if (stored_stats_delta) stats_delta_ = *std::move(stored_stats_delta);
+    if (!stats_delta_.IsZero()) {
+      table_->ApplyStatsDelta(stats_delta_);
+      table_->UpdateTabletSize(row_key_, stats_delta_.Total().logical_bytes);
+    }
+  }
 
-    auto* delete_value = absl::get_if<DeleteValue>(&op);
-    if (delete_value) {
-      auto* storage = GetGlobalStorage();
-      if (storage != nullptr && !table_key_.empty()) {
-        storage->DeleteCell(table_key_, row_key,
-                            table_key_ + "/" + delete_value->family_name,
-                            delete_value->column_qualifier,
-                            delete_value->timestamp);
+  if (storage != nullptr) PublishToStorage(*storage);
+}
+
+void RowTransaction::Publish(std::string const& family_name,
+                             StagedFamily& family) {
+  auto& column_family = *family.column_family;
+  bool const row_existed = column_family.HasRow(row_key_);
+  if (family.cleared) {
+    auto deleted = column_family.DeleteRow(row_key_);
+    // The rows are accounted for below.
+    deleted.rows = 0;
+    stats_delta_.column_families[family_name] -= deleted;
+  }
+  for (auto& column : family.columns) {
+    auto const& column_qualifier = column.first;
+    auto const versions_before = ColumnVersions(column_family, column_qualifier);
+    std::int64_t logical_bytes_delta = 0;
+    for (auto const& time_range : column.second.deleted_ranges) {
+      for (auto const& cell :
+           column_family.DeleteColumn(row_key_, column_qualifier, time_range)) {
+        logical_bytes_delta -=
+            LogicalCellSize(row_key_, column_qualifier, cell.value);
       }
-      delete_value->column_family.DeleteTimeStamp(
-          row_key, delete_value->column_qualifier, delete_value->timestamp);
-      continue;
     }
+    for (auto const& cell : column.second.cells) {
+      auto old_value = column_family.SetCell(row_key_, column_qualifier,
+                                             cell.first, cell.second);
+      logical_bytes_delta +=
+          old_value ? static_cast<std::int64_t>(cell.second.size()) -
+                          static_cast<std::int64_t>(old_value->size())
+                    : LogicalCellSize(row_key_, column_qualifier, cell.second);
+    }
+    RecordColumnChange(family_name, versions_before,
+                       ColumnVersions(column_family, column_qualifier),
+                       logical_bytes_delta);
+  }
+  bool const row_exists = column_family.HasRow(row_key_);
+  if (row_exists != row_existed) {
+    stats_delta_.column_families[family_name].rows += row_exists ? 1 : -1;
+  }
+}
 
-    // If we get here, there is an type of undo log that has not been
-    // implemented!
-    std::abort();
+void RowTransaction::PublishToStorage(Storage& storage) {
+  // The cells and the change of the stats are written in one batch, so that
+  // the persisted stats always match the persisted cells.
+  rocksdb::WriteBatch batch;
+  bool staged = true;
+  if (!table_key_.empty()) {
+    auto const layout = table_->storage_layout_;
+    if (row_deleted_) storage.DeleteRow(batch, table_key_, row_key_);
+    for (auto const& family : staged_) {
+      auto const prefixed_cf_name = table_key_ + "/" + family.first;
+      if (family.second.cleared && !row_deleted_) {
+        storage.DeleteCFRow(batch, table_key_, row_key_, prefixed_cf_name,
+                            layout);
+      }
+      for (auto const& column : family.second.columns) {
+        // Deleted in the storage rather than by the cells `Publish()`
+        // found in memory, which lacks the cells stored before a restart.
+        for (auto const& time_range : column.second.deleted_ranges) {
+          auto const range = StorageTimeRange(time_range);
+          storage.DeleteColumn(batch, table_key_, row_key_, prefixed_cf_name,
+                               column.first, range.first, range.second,
+                               layout);
+        }
+        for (auto const& cell : column.second.cells) {
+          // Fails e.g. if the table was deleted meanwhile.
+          staged = storage.PutCell(batch, table_key_, row_key_,
+                                   prefixed_cf_name, column.first, cell.first,
+                                   cell.second, layout) &&
+                   staged;
+        }
+      }
+    }
+  }
+  if (!stats_delta_.IsZero()) {
+    storage.MergeTableStats(batch, table_->name_, stats_delta_.Serialize());
+  }
+  if (!staged || !storage.Write(batch)) {
+    std::cerr << "Failed to persist the mutations of row " << row_key_
+              << " in table " << table_->name_ << std::endl;
   }
 }
 
+TableStats RowTransaction::StoredStatsDelta(Storage& storage) const {
+  TableStats delta;
+  auto const layout = table_->storage_layout_;
+  // Whether the row has cells in the staged families.
+  bool row_existed = false;
+  bool row_exists = false;
+  for (auto const& family : staged_) {
+    auto const prefixed_cf_name = table_key_ + "/" + family.first;
+    // The same changes as `PublishToStorage()` makes, in the same order.
+    StoredCells cells =
+        storage.ReadCellSizes(table_key_, row_key_, prefixed_cf_name, layout);
+    auto const before = StoredRowStats(row_key_, cells);
+    if (row_deleted_ || family.second.cleared) cells.clear();
+    for (auto const& column : family.second.columns) {
+      auto& stored = cells[column.first];
+      for (auto const& time_range : column.second.deleted_ranges) {
+        auto const range = StorageTimeRange(time_range);
+        auto i = range.first.count() <= 0 && range.second.count() == 0
+                     ? stored.begin()
+                     : stored.lower_bound(range.first);
+        while (i != stored.end() &&
+               (range.second.count() == 0 || i->first < range.second)) {
+          i = stored.erase(i);
+        }
+      }
+      for (auto const& cell : column.second.cells) {
+        stored[cell.first] = cell.second.size();
+      }
+      if (stored.empty()) cells.erase(column.first);
+    }
+    auto const after = StoredRowStats(row_key_, cells);
+    row_existed = row_existed || before.rows != 0;
+    row_exists = row_exists || after.rows != 0;
+    auto& family_delta = delta.column_families[family.first];
+    family_delta += after;
+    family_delta -= before;
+  }
+  if (row_exists == row_existed) return delta;
+  // Then the row appeared or vanished, unless it has cells in a family the
+  // transaction didn't touch. `DeleteFromRow()` stages all the families.
+  for (auto const& column_family : table_->column_families_) {
+    if (staged_.count(column_family.first) != 0) continue;
+    if (storage.RowExistsInCF(table_key_, row_key_,
+                              table_key_ + "/" + column_family.first,
+                              layout)) {
+      return delta;
+    }
+  }
+  delta.rows = row_exists ? 1 : -1;
+  return delta;
+}
+
+std::size_t RowTransaction::ColumnVersions(
+    ColumnFamily const& column_family,
+    std::string const& column_qualifier) const {
+  return column_family.CountCells(row_key_, column_qualifier);
+}
+
+void RowTransaction::RecordColumnChange(std::string const& family_name,
+                                        std::size_t versions_before,
+                                        std::size_t versions_after,
+                                        std::int64_t logical_bytes_delta) {
+  auto& stats = stats_delta_.column_families[family_name];
+  if (versions_before > 0) stats.RemoveColumn(versions_before);
+  if (versions_after > 0) stats.AddColumn(versions_after);
+  stats.cells += static_cast<std::int64_t>(versions_after) -
+                 static_cast<std::int64_t>(versions_before);
+  stats.logical_bytes += logical_bytes_delta;
+}
+
 }  // namespace emulator
 }  // namespace bigtable
 }  // namespace cloud
@@ -17,28 +17,38 @@
 
 #include "google/cloud/status.h"
 #include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/optional.h"
 #include "absl/types/variant.h"
 #include "column_family.h"
 #include "filter.h"
+#include "frozen_segment.h"
+#include "gc_read_mask.h"
 #include "google/protobuf/repeated_ptr_field.h"
 #include "range_set.h"
+#include "regex_matcher.h"
+#include "row_lock_manager.h"
 #include "row_streamer.h"
+#include "table_stats.h"
+#include "tablet.h"
 #include <google/bigtable/admin/v2/bigtable_table_admin.pb.h>
 #include <google/bigtable/admin/v2/table.pb.h>
 #include <google/bigtable/v2/bigtable.pb.h>
 #include <google/bigtable/v2/data.pb.h>
 #include <google/protobuf/field_mask.pb.h>
 #include <grpcpp/support/sync_stream.h>
+#include <atomic>
 #include <chrono>
-#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
-#include <stack>
+#include <set>
+#include <shared_mutex>
 #include <string>
-#include <thread>
 #include <utility>
 #include <vector>
 #include "storage.h"
@@ -48,27 +58,52 @@ namespace cloud {
 namespace bigtable {
 namespace emulator {
 
+/**
+ * A consistent, read-only view of the cells of a `Table`.
+ *
+ * Streams created from it don't refer to the table, so they may be consumed
+ * without holding the table's lock, concurrently with mutations.
+ */
+struct TableSnapshot {
+  /// With persistent storage, the RocksDB snapshot to read from.
+  std::shared_ptr<rocksdb::Snapshot const> storage_snapshot;
+  /// Without it, copy-on-write snapshots of the column families.
+  std::map<std::string, std::shared_ptr<ColumnFamily const>> column_families;
+};
+
 /// Objects of this class represent Bigtable tables.
 class Table : public std::enable_shared_from_this<Table> {
  public:
-  ~Table() {
-    // Signal the GC thread to stop and wait for it to terminate.
-    {
-      std::unique_lock<std::mutex> lock(gc_mtx_);
-      stop_flag_ = true;
-    }
-    cv_.notify_one();
+  /**
+   * Create a new table.
+   *
+   * @param schema the schema of the table.
+   * @param storage_layout how the table's cells are laid out in the persistent
+   *     storage, if there is one. It is persisted with the schema.
+   * @param initial_splits the row keys at which the table is initially split
+   *     into tablets. If empty, the persisted tablets, if any, are loaded.
+   */
+  static StatusOr<std::shared_ptr<Table>> Create(
+      google::bigtable::admin::v2::Table schema,
+      StorageLayout storage_layout = StorageLayout::kColumnFamilyPerFamily,
+      std::vector<std::string> initial_splits = {});
 
-    if (gc_thread_.joinable()) {
-      gc_thread_.join();
-    }
-  }
+  ~Table();
 
-  static StatusOr<std::shared_ptr<Table>> Create(
-      google::bigtable::admin::v2::Table schema);
+  /**
+   * Calls `fn` when the table is destroyed, i.e. once the last RPC using the
+   * deleted table has finished. It must be set before the cluster releases
+   * the table.
+   */
+  void OnDestroyed(std::function<void()> fn) { on_destroyed_ = std::move(fn); }
+
+  /// Tablets are split in two once they grow past this many logical bytes.
+  static std::int64_t constexpr kDefaultTabletSplitBytes = 64 << 20;
 
   google::bigtable::admin::v2::Table GetSchema() const;
 
+  StorageLayout storage_layout() const { return storage_layout_; }
+
   Status Update(google::bigtable::admin::v2::Table const& new_schema,
                 google::protobuf::FieldMask const& to_update);
 
@@ -84,14 +119,38 @@ class Table : public std::enable_shared_from_this<Table> {
       std::string const& row_key,
       google::protobuf::RepeatedPtrField<google::bigtable::v2::Mutation> const&
           mutations) {
-    std::lock_guard<std::mutex> lock(mu_);
+    std::shared_lock<std::shared_mutex> lock(mu_);
+    auto row_lock = row_locks_.Lock(row_key);
 
     return DoMutationsWithPossibleRollback(row_key, mutations);
   }
 
+  /**
+   * Create a stream of the table's cells.
+   *
+   * @param snapshot if set, the stream reads from it rather than from the
+   *     table, so it may be consumed without holding the table's lock.
+   */
   StatusOr<CellStream> CreateCellStream(
       std::shared_ptr<StringRangeSet> range_set,
-      absl::optional<google::bigtable::v2::RowFilter>) const;
+      absl::optional<google::bigtable::v2::RowFilter>,
+      absl::optional<TableSnapshot> snapshot = absl::nullopt) const;
+
+  /**
+   * Like `CreateCellStream()`, but the rows are split into partitions at
+   * `split_keys`, which are scanned and filtered in parallel on
+   * `ScanThreadPool()`, see `ParallelCellStream`.
+   *
+   * @param split_keys sorted, unique and non-empty row keys.
+   */
+  StatusOr<CellStream> CreateParallelCellStream(
+      std::shared_ptr<StringRangeSet> const& range_set,
+      absl::optional<google::bigtable::v2::RowFilter> const& filter,
+      std::vector<std::string> const& split_keys,
+      TableSnapshot const& snapshot) const;
+
+  /// A snapshot of the table's current contents, see `TableSnapshot`.
+  TableSnapshot GetSnapshot() const;
 
   Status ReadRows(google::bigtable::v2::ReadRowsRequest const& request,
                   RowStreamer& row_streamer) const;
@@ -111,29 +170,94 @@ class Table : public std::enable_shared_from_this<Table> {
     return column_families_.find(column_family);
   }
 
-  Status SampleRowKeys(
-      double pass_probability,
-      grpc::ServerWriter<google::bigtable::v2::SampleRowKeysResponse>* writer);
+  /**
+   * Split the table into evenly sized row ranges.
+   *
+   * If the table has more than one tablet, the ranges are the tablets.
+   * Otherwise, with persistent storage the sizes come from RocksDB's
+   * metadata, so the table is not read.
+   *
+   * @return the first row key of each range but the first, with the
+   *     approximate size of the rows preceding it. The last sample has an
+   *     empty row key and the size of the whole table.
+   */
+  StatusOr<std::vector<google::bigtable::v2::SampleRowKeysResponse>>
+  SampleRowKeys() const;
+
+  /// The tablets the table's rows are currently partitioned into.
+  std::vector<Tablet> GetTablets() const;
+
+  /// Override `kDefaultTabletSplitBytes`; it only affects future mutations.
+  void SetTabletSplitBytes(std::int64_t split_bytes);
+
+  /// Whether a mutation grew a tablet past the split size since the last
+  /// `SplitTablets()`.
+  bool NeedsTabletSplit() const { return split_due_.load(); }
+
+  /**
+   * Split the tablets which grew past the split size in two.
+   *
+   * Mutations only flag the tablets which grew too large; the GC scheduler
+   * calls this in the background. The split keys are searched in a snapshot
+   * (or in RocksDB's size estimates) without holding the table's locks, which
+   * are only taken to pick the tablets and to apply the splits.
+   */
+  void SplitTablets();
+
+  /**
+   * The number of rows, columns, cells and bytes in the table and in each of
+   * its column families.
+   *
+   * The stats are maintained incrementally by the mutations, so this doesn't
+   * read the table. With persistent storage they are persisted with the
+   * table and survive restarts.
+   */
+  TableStats GetStats() const;
+
+  /// How often single-row transactions waited for each other's row locks.
+  LockContentionStats GetRowLockStats() const { return row_locks_.Stats(); }
 
   std::shared_ptr<Table> get() { return shared_from_this(); }
 
   Status DropRowRange(
       ::google::bigtable::admin::v2::DropRowRangeRequest const& request);
 
-  // Runs GC for each of the column families. It takes the table lock
-  // at the beginning and only releases when GC for the last column
-  // family is completed.
-  Status RunGC() {
-    std::lock_guard<std::mutex> lock(mu_);
-
-    for (auto& cf : column_families_) {
-      cf.second->RunGC();
-    }
-
-    return Status();
-  }
-
-  void StartGCThreadOnce();
+  /**
+   * Runs GC for each of the column families.
+   *
+   * The table lock is released every `kDefaultGCSlice`, so that other
+   * operations don't wait for the whole table to be collected.
+   */
+  Status RunGC();
+
+  /**
+   * Runs GC for `column_family` for about `budget`, holding the table lock.
+   *
+   * Every column family has a cursor, so that consecutive slices continue
+   * where the previous one stopped. At least one row is collected. The
+   * values of deleted rows are released, and a compaction of the family's
+   * values, if one is due, is finished first (see
+   * `ColumnFamily::ReleaseDeletedRows()` and `ColumnFamily::CompactValues()`).
+   * Before that, the cold rows are frozen without holding the lock, see
+   * `ColumnFamily::PrepareFreeze()`.
+   *
+   * @return whether the slice finished a pass over the column family; the
+   *     next slice starts a new one.
+   */
+  bool RunGCSlice(std::string const& column_family,
+                  std::chrono::steady_clock::duration budget);
+
+  /**
+   * The column families with a GC rule which may collect any cells, and the
+   * estimated number of cells it may collect.
+   *
+   * The estimates are computed from the table's stats, see
+   * `EstimateGCEligibleCells()`. Column families with deleted rows to
+   * release or values to compact are included with an estimate of 1.
+   */
+  std::vector<std::pair<std::string, std::int64_t>> GetGCCandidates() const;
+
+  static std::chrono::milliseconds constexpr kDefaultGCSlice{5};
 
  private:
   Table() = default;
@@ -144,59 +268,134 @@ class Table : public std::enable_shared_from_this<Table> {
   StatusOr<std::reference_wrapper<ColumnFamily>> FindColumnFamily(
       MESSAGE const& message) const;
   bool IsDeleteProtectedNoLock() const;
-  Status Construct(google::bigtable::admin::v2::Table schema);
+  Status Construct(google::bigtable::admin::v2::Table schema,
+                   StorageLayout storage_layout,
+                   std::vector<std::string> initial_splits);
   Status DoMutationsWithPossibleRollback(
       std::string const& row_key,
       google::protobuf::RepeatedPtrField<google::bigtable::v2::Mutation> const&
           mutations);
-
-  mutable std::mutex mu_;
+  bool RowExistsNoLock(std::string const& row_key) const;
+  TableSnapshot GetSnapshotNoLock() const;
+  // The `GcReadMask` of the column families with a GC rule, as of now.
+  std::map<std::string, GcReadMask, std::less<>> GcReadMasksNoLock() const;
+  // Where to split a scan of `row_set` in `snapshot` of a single tablet
+  // table to read it in parallel; empty if the scan is not worth
+  // parallelizing. `cf_names` and `table_bytes` are the table's
+  // `StorageColumnFamilyNames()` and logical size when the snapshot was
+  // taken. It takes no lock, and needs none.
+  std::vector<std::string> ParallelScanSplitKeys(
+      StringRangeSet const& row_set, TableSnapshot const& snapshot,
+      std::vector<std::string> const& cf_names,
+      std::uint64_t table_bytes) const;
+  // Add `delta` to `stats_`. The caller persists the change.
+  void ApplyStatsDelta(TableStats const& delta);
+  // Account for the column families which `new_column_families` drops or
+  // creates, before it replaces `column_families_`.
+  void UpdateStatsForColumnFamilies(
+      std::map<std::string, std::shared_ptr<ColumnFamily>> const&
+          new_column_families);
+  void LoadStats();
+  void PersistStats() const;
+  // Collect `column_family` from `cursor` on until `deadline`, advancing
+  // `cursor`. Returns true, and clears `cursor`, at the end of the family.
+  bool RunGCSliceNoLock(std::string const& column_family, std::string& cursor,
+                        std::chrono::steady_clock::time_point deadline);
+  // Freeze the cold rows of `column_family`, if due, until `deadline`. The
+  // segments are built without holding `mu_`.
+  void FreezeColumnFamily(std::string const& column_family,
+                          std::chrono::steady_clock::time_point deadline);
+
+  // Tablets bookkeeping. The tablet sizes are not persisted, `LoadTablets()`
+  // and `RemeasureTablets()` recompute them.
+  void LoadTablets(std::vector<std::string> initial_splits);
+  void PersistTablets() const;
+  void RemeasureTablets();
+  // Add `logical_bytes_delta` to the size of the tablet holding `row_key`,
+  // and flag it for `SplitTablets()` if it grew too large.
+  void UpdateTabletSize(std::string const& row_key,
+                        std::int64_t logical_bytes_delta);
+  void AddToTabletSize(Tablet& tablet, std::int64_t logical_bytes_delta);
+  bool TabletNeedsSplit(Tablet const& tablet) const;
+  // A row key about halfway through `tablet`, if there is one, found in
+  // `snapshot` or, with persistent storage, in the RocksDB column families
+  // `cf_names`. Without storage, `bytes_before` is set to the size of the
+  // tablet's rows before the key.
+  absl::optional<std::string> FindTabletSplitKey(
+      Tablet const& tablet, TableSnapshot const& snapshot,
+      std::vector<std::string> const& cf_names,
+      std::int64_t& bytes_before) const;
+  // The logical size of the rows in [start_key, end_key); with persistent
+  // storage it is estimated from RocksDB's metadata instead.
+  std::int64_t MeasureRows(std::string const& start_key,
+                           std::string const& end_key) const;
+
+  // The RocksDB column families holding the table's cells.
+  std::vector<std::string> StorageColumnFamilyNames() const;
+  // The row of the first stored cell at or after the storage key `key`.
+  absl::optional<std::string> FindStoredRow(
+      std::vector<std::string> const& cf_names, std::string const& key) const;
+
+  // Single-row transactions (`MutateRow`, `CheckAndMutateRow`,
+  // `ReadModifyWriteRow` and the `MutateRows` entries) hold `mu_` shared plus
+  // their row's lock in `row_locks_`, so transactions on different rows run
+  // concurrently. `ReadRows` too holds `mu_` shared, and `rows_mu_` while it
+  // takes its snapshot. Everything else, including schema changes,
+  // `DropRowRange`, GC and the other snapshots, holds `mu_` exclusively.
+  //
+  // The in-memory rows, `stats_` and `tablets_` are not safe for concurrent
+  // modification, so the transactions latch `rows_mu_` while they read the
+  // rows and while they publish their changes, but not while they write to
+  // the persistent storage.
+  mutable std::shared_mutex mu_;
+  mutable std::mutex rows_mu_;
+  // Serializes `ModifyColumnFamilies()`, which waits for the removal of
+  // dropped families without holding `mu_`. Acquired before `mu_`.
+  std::mutex schema_mu_;
+  RowLockManager row_locks_;
   google::bigtable::admin::v2::Table schema_;
   std::map<std::string, std::shared_ptr<ColumnFamily>> column_families_;
-
-  // Support for starting at most one GC thread and for signaling it
-  // to stop.
-  std::once_flag start_gc_once_flag_;
-  std::atomic<bool> stop_flag_{false};
-  std::mutex gc_mtx_;
-  std::condition_variable cv_;
-  std::thread gc_thread_;
+  TableStats stats_;
+  TabletMap tablets_;
+  std::int64_t tablet_split_bytes_ = kDefaultTabletSplitBytes;
+  // Set by the mutations which grow a tablet past the split size.
+  std::atomic<bool> split_due_{false};
+  // Serializes `SplitTablets()`, so that the tablets it picked are not split
+  // while it searches them without `mu_`.
+  std::mutex split_mu_;
+
+  // Where the next `RunGCSlice()` of each column family starts.
+  std::map<std::string, std::string> gc_cursors_;
 
   std::string name_;
-
-  void StartGCThread();
-};
-
-struct RestoreValue {
-  ColumnFamily& column_family;
-  std::string column_qualifier;
-  std::chrono::milliseconds timestamp;
-  std::string value;
-};
-
-struct DeleteValue {
-  ColumnFamily& column_family;
-  std::string family_name;
-  std::string column_qualifier;
-  std::chrono::milliseconds timestamp;
+  StorageLayout storage_layout_ = StorageLayout::kColumnFamilyPerFamily;
+  std::function<void()> on_destroyed_;
 };
 
+/**
+ * The mutations of a single row, applied atomically.
+ *
+ * The mutations are staged in the transaction, and only applied to the
+ * table's column families and the persistent storage by `commit()`. So a
+ * transaction which fails, or is dropped without `commit()`, leaves no trace.
+ * Each mutation sees the effects of the preceding ones.
+ *
+ * The staged cells refer to the values in the mutations, which therefore
+ * have to outlive the transaction.
+ */
 class RowTransaction {
  public:
+  // The caller has to hold the table's `mu_` (shared) and the row's lock.
+  // The transaction only takes the table's `rows_mu_` while it reads or
+  // publishes the in-memory rows.
   explicit RowTransaction(std::shared_ptr<Table> table,
                           std::string const& row_key, std::string table_name = "")
       : row_key_(row_key), table_key_(table_name) {
     table_ = std::move(table);
-    committed_ = false;
   };
 
-  ~RowTransaction() {
-    if (!committed_) {
-      Undo();
-    }
-  };
-
-  void commit() { committed_ = true; }
+  // Apply the staged mutations, and their changes to the table's stats.
+  void commit();
 
   // timestamp_override, if provided, will be used instead of
   // set_cell.timestamp. The override is used to set the timestamp to
@@ -208,7 +407,8 @@ class RowTransaction {
       ::google::bigtable::v2::Mutation_AddToCell const& add_to_cell,
       absl::optional<std::chrono::milliseconds> timestamp_override);
   Status MergeToCell(
-      ::google::bigtable::v2::Mutation_MergeToCell const& merge_to_cell);
+      ::google::bigtable::v2::Mutation_MergeToCell const& merge_to_cell,
+      absl::optional<std::chrono::milliseconds> timestamp_override);
   Status DeleteFromColumn(
       ::google::bigtable::v2::Mutation_DeleteFromColumn const&
           delete_from_column);
@@ -222,11 +422,68 @@ class RowTransaction {
       google::bigtable::v2::ReadModifyWriteRowRequest const& request);
 
  private:
-  void Undo();
+  // A column of the row as the transaction changed it.
+  struct StagedColumn {
+    // The time ranges in which the column's cells from before the
+    // transaction are deleted.
+    std::vector<::google::bigtable::v2::TimestampRange> deleted_ranges;
+    // The cells written by the transaction, newest first.
+    std::map<std::chrono::milliseconds, absl::string_view, std::greater<>>
+        cells;
+  };
+  // A column family of the row as the transaction changed it.
+  struct StagedFamily {
+    ColumnFamily* column_family = nullptr;
+    // Whether all the row's cells from before the transaction are deleted.
+    bool cleared = false;
+    std::map<std::string, StagedColumn, std::less<>> columns;
+  };
+
+  StagedFamily& Stage(std::string const& family_name,
+                      ColumnFamily& column_family);
+  // Whether the cell from before the transaction at `timestamp` is deleted.
+  static bool IsDeleted(StagedFamily const& family, StagedColumn const* column,
+                        std::chrono::milliseconds timestamp);
+  // The value of a cell, as the transaction sees it. Requires `rows_mu_`
+  // while the result is used.
+  absl::optional<absl::string_view> StagedValue(
+      StagedFamily const& family, std::string const& column_qualifier,
+      std::chrono::milliseconds timestamp) const;
+  // The newest cell of a column, as the transaction sees it.
+  absl::optional<std::pair<std::chrono::milliseconds, std::string>>
+  StagedNewestCell(StagedFamily const& family,
+                   std::string const& column_qualifier) const;
+  // Whether the row has cells in the family, as the transaction sees it.
+  bool StagedRowExists(StagedFamily const& family) const;
+  static void ClearFamily(StagedFamily& family);
+
+  // The common part of `AddToCell()` and `MergeToCell()`, whose mutations
+  // have the same fields. `merge` tells which one `mutation` is.
+  template <typename Mutation>
+  Status AggregateToCell(
+      Mutation const& mutation,
+      absl::optional<std::chrono::milliseconds> timestamp_override,
+      bool merge);
+
+  // Apply the staged changes to a column family, and record them in
+  // `stats_delta_`.
+  void Publish(std::string const& family_name, StagedFamily& family);
+  // Mirror the staged changes in the persistent storage.
+  void PublishToStorage(Storage& storage);
+  // The change of the table's stats made by the staged changes, computed
+  // from the row's stored cells rather than from the in-memory ones, which
+  // lack the cells stored before a restart.
+  TableStats StoredStatsDelta(Storage& storage) const;
+
+  // The number of cells in the row's column `column_qualifier`.
+  std::size_t ColumnVersions(ColumnFamily const& column_family,
+                             std::string const& column_qualifier) const;
+  void RecordColumnChange(std::string const& family_name,
+                          std::size_t versions_before,
+                          std::size_t versions_after,
+                          std::int64_t logical_bytes_delta);
 
-  bool committed_;
   std::shared_ptr<Table> table_;
-  std::stack<absl::variant<DeleteValue, RestoreValue>> undo_;
   // row_key_ is initialized from the request proto and therefore it
   // is safe to access it while the mutation request is ongoing. We
   // store a reference to it to avoid copying a potentially very large
@@ -235,6 +492,16 @@ class RowTransaction {
   
   // prefix + table name, i.e. projects/p/instances/i/tables/{table_name}
   std::string table_key_;
+
+  std::map<std::string, StagedFamily> staged_;
+  // The values computed by the transaction, which its staged cells refer to.
+  std::deque<std::string> owned_values_;
+  // Whether `DeleteFromRow()` was staged, so that the storage deletes the
+  // whole row.
+  bool row_deleted_ = false;
+
+  // The changes to the table's stats, computed by `commit()`.
+  TableStats stats_delta_;
 };
 
 google::bigtable::v2::ReadModifyWriteRowResponse
@@ -254,23 +521,125 @@ FamiliesToReadModifyWriteResponse(
  */
 class FilteredTableStream : public MergeCellStreams {
  public:
-  // FilteredTableStream() : MergeCellStreams({}) {}
-  
+  // `frozen_streams` read the rows of the column families which are frozen.
   explicit FilteredTableStream(
-      std::vector<std::unique_ptr<FilteredColumnFamilyStream>> cf_streams)
-      : MergeCellStreams(CreateCellStreams(std::move(cf_streams))) {}
-  
+      std::vector<std::unique_ptr<FilteredColumnFamilyStream>> cf_streams,
+      std::vector<std::unique_ptr<FrozenSegmentStream>> frozen_streams = {})
+      : FilteredTableStream(CreateCellStreams(std::move(cf_streams),
+                                              std::move(frozen_streams))) {}
+
   explicit FilteredTableStream(
-      std::vector<std::unique_ptr<PersistentFilteredColumnFamilyStream>> cf_streams)
-      : MergeCellStreams(CreateCellStreams(std::move(cf_streams))) {}
+      std::vector<std::unique_ptr<PersistentFilteredColumnFamilyStream>>
+          cf_streams)
+      : FilteredTableStream(CreateCellStreams(std::move(cf_streams))) {}
+
+  bool ApplyFilter(InternalFilter const& internal_filter) override;
+
+ private:
+  // The per column family streams and, at the same positions, the names of
+  // their column families.
+  struct ColumnFamilyStreams {
+    std::vector<CellStream> streams;
+    std::vector<std::string> column_family_names;
+  };
+
+  explicit FilteredTableStream(ColumnFamilyStreams cf_streams)
+      : MergeCellStreams(std::move(cf_streams.streams)),
+        column_family_names_(std::move(cf_streams.column_family_names)) {}
+
+  template <typename ColumnFamilyStream>
+  static ColumnFamilyStreams CreateCellStreams(
+      std::vector<std::unique_ptr<ColumnFamilyStream>> cf_streams,
+      std::vector<std::unique_ptr<FrozenSegmentStream>> frozen_streams = {}) {
+    ColumnFamilyStreams res;
+    res.streams.reserve(cf_streams.size() + frozen_streams.size());
+    res.column_family_names.reserve(cf_streams.size() + frozen_streams.size());
+    for (auto& stream : cf_streams) {
+      res.column_family_names.emplace_back(stream->column_family_name());
+      res.streams.emplace_back(std::move(stream));
+    }
+    for (auto& stream : frozen_streams) {
+      res.column_family_names.emplace_back(stream->column_family_name());
+      res.streams.emplace_back(std::move(stream));
+    }
+    return res;
+  }
+
+  // Parallel to `streams_`.
+  std::vector<std::string> column_family_names_;
+};
+
+/**
+ * A `AbstractCellStreamImpl` which streams filtered contents of a persisted
+ * table in the `StorageLayout::kSingleColumnFamily` layout.
+ *
+ * All column families are read through a single RocksDB iterator, which
+ * returns the cells in the order of row, column family, column qualifier and
+ * timestamp, so unlike `FilteredTableStream` there is nothing to merge.
+ * Rows, column families and columns which are filtered out are skipped with a
+ * `Seek()` rather than by visiting all their cells.
+ */
+class PersistentFilteredTableStream : public AbstractCellStreamImpl {
+ public:
+  // If `snapshot` is not null, the stream reads from it. Like in
+  // `PersistentFilteredColumnFamilyStream`, the iterator is created here.
+  // `gc_masks` holds the `GcReadMask` of the column families which have one.
+  PersistentFilteredTableStream(
+      std::string const& table_name,
+      std::vector<std::string> const& column_families,
+      std::shared_ptr<StringRangeSet const> row_ranges,
+      std::shared_ptr<rocksdb::Snapshot const> snapshot = nullptr,
+      std::map<std::string, GcReadMask, std::less<>> gc_masks = {});
 
   bool ApplyFilter(InternalFilter const& internal_filter) override;
+  bool HasValue() const override;
+  CellView const& Value() const override;
+  bool Next(NextMode mode) override;
 
  private:
-  static std::vector<CellStream> CreateCellStreams(
-      std::vector<std::unique_ptr<FilteredColumnFamilyStream>> cf_streams);
-  static std::vector<CellStream> CreateCellStreams(
-    std::vector<std::unique_ptr<PersistentFilteredColumnFamilyStream>> cf_streams);
+  void InitializeIfNeeded() const;
+  // Advance the iterator to the first cell at or after its current position
+  // which passes all the filters. Returns false if there is none.
+  bool SkipToMatchingCell() const;
+  // Whether `row_key` is in `row_ranges_`. If it is not, it also seeks to the
+  // next range.
+  bool SeekToRowRange(absl::string_view row_key) const;
+  bool RowMatches(absl::string_view row_key) const;
+  bool ColumnMatches(absl::string_view column_qualifier) const;
+  bool TimestampMatches(std::chrono::milliseconds timestamp) const;
+  // Seek past all the keys starting with `key_prefix` followed by a `/`.
+  void SeekPast(absl::string_view key_prefix) const;
+
+  Storage* storage_;
+  std::string table_name_;
+  std::string table_prefix_;
+  // The column families which can still be returned; filters narrow it.
+  std::set<std::string, std::less<>> column_families_;
+  std::shared_ptr<StringRangeSet const> row_ranges_;
+  std::vector<std::shared_ptr<RegexMatcher const>> row_regexes_;
+  StringRangeSet column_ranges_;
+  std::vector<std::shared_ptr<RegexMatcher const>> column_regexes_;
+  TimestampRangeSet timestamp_ranges_;
+  std::map<std::string, GcReadMask, std::less<>> gc_masks_;
+  // The key prefix of the column whose cells are ranked in
+  // `gc_limit_timestamps_`, see `GcReadMask::Hides()`.
+  mutable std::string ranked_column_;
+  mutable std::vector<absl::optional<std::chrono::milliseconds>>
+      gc_limit_timestamps_;
+
+  // Declared before `it_`, which has to be destroyed first.
+  std::shared_ptr<rocksdb::Snapshot const> snapshot_;
+  mutable std::unique_ptr<rocksdb::Iterator> it_;
+  mutable bool initialized_ = false;
+  mutable bool has_value_ = false;
+  // Whether `cur_row_` holds a row which has already passed the row filters.
+  mutable bool row_matched_ = false;
+  mutable std::string cur_row_;
+  mutable std::string cur_family_;
+  mutable std::string cur_qualifier_;
+  mutable std::chrono::milliseconds cur_timestamp_;
+  mutable std::string cur_value_;
+  mutable absl::optional<CellView> current_view_;
 };
 
 }  // namespace emulator
@@ -0,0 +1,107 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "range_set.h"
+#include "storage.h"
+#include "table.h"
+#include <benchmark/benchmark.h>
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+// Scan a persisted table of `kRows` rows with one cell in each of
+// `state.range(1)` column families, stored in the layout `state.range(0)`.
+std::size_t constexpr kRows = 2000;
+
+Storage& GetStorage() {
+  static auto* storage = [] {
+    auto const path = std::filesystem::temp_directory_path() /
+                      ("table_layout_benchmark_" + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    if (InitGlobalStorage(path.c_str()) != 0) std::abort();
+    return GetGlobalStorage();
+  }();
+  return *storage;
+}
+
+std::shared_ptr<Table> CreatePopulatedTable(StorageLayout layout,
+                                            std::size_t num_families) {
+  GetStorage();
+  static int table_count = 0;
+  google::bigtable::admin::v2::Table schema;
+  schema.set_name("projects/p/instances/i/tables/t" +
+                  std::to_string(table_count++));
+  for (std::size_t i = 0; i != num_families; ++i) {
+    (*schema.mutable_column_families())["cf" + std::to_string(i)] =
+        google::bigtable::admin::v2::ColumnFamily{};
+  }
+  auto table = Table::Create(schema, layout);
+  if (!table) std::abort();
+
+  for (std::size_t row = 0; row != kRows; ++row) {
+    google::bigtable::v2::MutateRowRequest request;
+    request.set_table_name(schema.name());
+    request.set_row_key("row" + std::to_string(1000000 + row));
+    for (std::size_t i = 0; i != num_families; ++i) {
+      auto* set_cell = request.add_mutations()->mutable_set_cell();
+      set_cell->set_family_name("cf" + std::to_string(i));
+      set_cell->set_column_qualifier("col");
+      set_cell->set_timestamp_micros(1000);
+      set_cell->set_value("value");
+    }
+    if (!(*table)->MutateRow(request).ok()) std::abort();
+  }
+  return *std::move(table);
+}
+
+void BM_PersistentTableScan(benchmark::State& state) {
+  auto const layout = static_cast<StorageLayout>(state.range(0));
+  auto const num_families = static_cast<std::size_t>(state.range(1));
+  auto table = CreatePopulatedTable(layout, num_families);
+  auto all_rows = std::make_shared<StringRangeSet>(StringRangeSet::All());
+
+  for (auto _ : state) {
+    auto stream = table->CreateCellStream(all_rows, absl::nullopt);
+    std::size_t cells = 0;
+    for (; stream->HasValue(); stream->Next(NextMode::kCell)) ++cells;
+    benchmark::DoNotOptimize(cells);
+  }
+  state.SetLabel(layout == StorageLayout::kSingleColumnFamily ? "single"
+                                                              : "per_family");
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          kRows * num_families);
+}
+
+BENCHMARK(BM_PersistentTableScan)
+    ->ArgsProduct({{static_cast<int>(StorageLayout::kColumnFamilyPerFamily),
+                    static_cast<int>(StorageLayout::kSingleColumnFamily)},
+                   {1, 2, 16}});
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -15,10 +15,13 @@
 #include "table.h"
 #include "storage.h"
 #include "constants.h"
+#include "range_set.h"
+#include "reclaimer.h"
 #include "google/cloud/testing_util/status_matchers.h"
 #include <google/bigtable/admin/v2/table.pb.h>
 #include <google/bigtable/v2/bigtable.pb.h>
 #include <google/protobuf/field_mask.pb.h>
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <unistd.h>
 #include <atomic>
@@ -26,6 +29,7 @@
 #include <sstream>
 #include <string>
 #include <system_error>
+#include <vector>
 
 namespace google {
 namespace cloud {
@@ -34,6 +38,9 @@ namespace emulator {
 namespace {
 
 namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+using ::testing::ElementsAre;
+using ::testing::UnorderedElementsAre;
 
 std::string MakeUniqueDbPath() {
   static std::atomic<int> counter{0};
@@ -75,6 +82,52 @@ btadmin::Table ReadPersistedSchema(Storage& storage,
   return persisted;
 }
 
+std::shared_ptr<Table> CreateTable(std::string const& table_name,
+                                   std::vector<std::string> const& families,
+                                   StorageLayout storage_layout) {
+  btadmin::Table schema;
+  schema.set_name(table_name);
+  for (auto const& family : families) {
+    (*schema.mutable_column_families())[family] = btadmin::ColumnFamily{};
+  }
+  auto maybe_table = Table::Create(schema, storage_layout);
+  EXPECT_STATUS_OK(maybe_table);
+  return maybe_table ? *maybe_table : nullptr;
+}
+
+void SetCell(Table& table, std::string const& row_key,
+             std::string const& family, std::string const& qualifier,
+             std::int64_t timestamp_ms, std::string const& value) {
+  btproto::MutateRowRequest request;
+  request.set_table_name(table.GetSchema().name());
+  request.set_row_key(row_key);
+  auto* set_cell = request.add_mutations()->mutable_set_cell();
+  set_cell->set_family_name(family);
+  set_cell->set_column_qualifier(qualifier);
+  set_cell->set_timestamp_micros(timestamp_ms * 1000);
+  set_cell->set_value(value);
+  EXPECT_STATUS_OK(table.MutateRow(request));
+}
+
+// Read the whole table, formatting each cell as `row/family/column/ts=value`.
+std::vector<std::string> ReadCells(
+    Table const& table,
+    absl::optional<btproto::RowFilter> filter = absl::nullopt,
+    StringRangeSet row_set = StringRangeSet::All()) {
+  auto maybe_stream = table.CreateCellStream(
+      std::make_shared<StringRangeSet>(std::move(row_set)), std::move(filter));
+  EXPECT_STATUS_OK(maybe_stream);
+  std::vector<std::string> res;
+  if (!maybe_stream) return res;
+  for (auto& stream = *maybe_stream; stream; ++stream) {
+    res.emplace_back(stream->row_key() + "/" + stream->column_family() + "/" +
+                     stream->column_qualifier() + "/" +
+                     std::to_string(stream->timestamp().count()) + "=" +
+                     std::string(stream->value()));
+  }
+  return res;
+}
+
 class TablePersistenceTest : public ::testing::Test {
  protected:
   static void SetUpTestSuite() {
@@ -240,6 +293,316 @@ TEST_F(TablePersistenceTest, FailedMutateRowRollsBackPersistedSetCell) {
   EXPECT_FALSE(storage().RowExists(table_name, row_key));
 }
 
+TEST_F(TablePersistenceTest, CreatePersistsStorageLayout) {
+  auto const per_family_name = MakeUniqueTableName();
+  auto const single_name = MakeUniqueTableName();
+
+  auto per_family = CreateTable(per_family_name, {"cf1"},
+                                StorageLayout::kColumnFamilyPerFamily);
+  auto single =
+      CreateTable(single_name, {"cf1"}, StorageLayout::kSingleColumnFamily);
+  ASSERT_NE(nullptr, per_family);
+  ASSERT_NE(nullptr, single);
+
+  EXPECT_EQ(StorageLayout::kSingleColumnFamily, single->storage_layout());
+  EXPECT_EQ(StorageLayout::kColumnFamilyPerFamily,
+            storage().GetTableLayout(per_family_name));
+  EXPECT_EQ(StorageLayout::kSingleColumnFamily,
+            storage().GetTableLayout(single_name));
+
+  SetCell(*single, "r1", "cf1", "c1", 1, "v1");
+  EXPECT_TRUE(storage().CFExists(SingleLayoutColumnFamilyName(single_name)));
+  EXPECT_FALSE(storage().CFExists(single_name + "/cf1"));
+}
+
+TEST_F(TablePersistenceTest, SingleColumnFamilyLayoutReadsMatchPerFamily) {
+  std::vector<std::string> const families = {"cf1", "cf2", "cf3"};
+  auto per_family = CreateTable(MakeUniqueTableName(), families,
+                                StorageLayout::kColumnFamilyPerFamily);
+  auto single = CreateTable(MakeUniqueTableName(), families,
+                            StorageLayout::kSingleColumnFamily);
+  ASSERT_NE(nullptr, per_family);
+  ASSERT_NE(nullptr, single);
+
+  for (auto* table : {per_family.get(), single.get()}) {
+    for (auto const* row : {"r1", "r10", "r2", "r3"}) {
+      SetCell(*table, row, "cf1", "a", 1, "v1");
+      SetCell(*table, row, "cf1", "a", 2, "v2");
+      SetCell(*table, row, "cf1", "b", 1, "v3");
+      SetCell(*table, row, "cf3", "c", 5, "v4");
+    }
+    SetCell(*table, "r2", "cf2", "b", 3, "v5");
+    SetCell(*table, "r2", "cf2", "d", 3, "v6");
+  }
+
+  auto const all = ReadCells(*per_family);
+  EXPECT_EQ(18U, all.size());
+  EXPECT_EQ(all, ReadCells(*single));
+
+  std::vector<btproto::RowFilter> filters(7);
+  filters[0].set_family_name_regex_filter("cf[12]");
+  filters[1].mutable_column_range_filter()->set_family_name("cf2");
+  filters[1].mutable_column_range_filter()->set_start_qualifier_closed("b");
+  filters[1].mutable_column_range_filter()->set_end_qualifier_open("c");
+  filters[2].set_column_qualifier_regex_filter("^[bc]$");
+  filters[3].set_row_key_regex_filter("^r1");
+  filters[4].mutable_timestamp_range_filter()->set_start_timestamp_micros(
+      2000);
+  filters[5].set_cells_per_column_limit_filter(1);
+  auto& chain = *filters[6].mutable_chain();
+  chain.add_filters()->set_family_name_regex_filter("cf");
+  chain.add_filters()->set_cells_per_row_limit_filter(2);
+  for (auto const& filter : filters) {
+    SCOPED_TRACE("filter: " + filter.DebugString());
+    auto const expected = ReadCells(*per_family, filter);
+    EXPECT_FALSE(expected.empty());
+    EXPECT_EQ(expected, ReadCells(*single, filter));
+  }
+
+  StringRangeSet row_set;
+  row_set.Sum(StringRangeSet::Range("r1", false, "r2", true));
+  row_set.Sum(StringRangeSet::Range("r3", false, "r3", false));
+  auto const expected = ReadCells(*per_family, absl::nullopt, row_set);
+  EXPECT_EQ(12U, expected.size());
+  EXPECT_EQ(expected, ReadCells(*single, absl::nullopt, row_set));
+}
+
+TEST_F(TablePersistenceTest, SingleColumnFamilyLayoutDeletes) {
+  auto const table_name = MakeUniqueTableName();
+  auto table = CreateTable(table_name, {"cf1", "cf2"},
+                           StorageLayout::kSingleColumnFamily);
+  ASSERT_NE(nullptr, table);
+  for (auto const* row : {"r1", "r2"}) {
+    SetCell(*table, row, "cf1", "a", 1, "v1");
+    SetCell(*table, row, "cf1", "b", 1, "v2");
+    SetCell(*table, row, "cf2", "a", 1, "v3");
+  }
+
+  btproto::MutateRowRequest request;
+  request.set_table_name(table_name);
+  request.set_row_key("r1");
+  auto* delete_column = request.add_mutations()->mutable_delete_from_column();
+  delete_column->set_family_name("cf1");
+  delete_column->set_column_qualifier("a");
+  request.add_mutations()->mutable_delete_from_family()->set_family_name(
+      "cf2");
+  ASSERT_STATUS_OK(table->MutateRow(request));
+  EXPECT_EQ((std::vector<std::string>{"r1/cf1/b/1=v2", "r2/cf1/a/1=v1",
+                                      "r2/cf1/b/1=v2", "r2/cf2/a/1=v3"}),
+            ReadCells(*table));
+
+  btadmin::ModifyColumnFamiliesRequest modify;
+  modify.set_name(table_name);
+  auto* mod = modify.add_modifications();
+  mod->set_id("cf1");
+  mod->set_drop(true);
+  ASSERT_STATUS_OK(table->ModifyColumnFamilies(modify));
+  EXPECT_EQ((std::vector<std::string>{"r2/cf2/a/1=v3"}), ReadCells(*table));
+
+  // Re-creating the family must not resurrect the dropped cells.
+  mod->clear_drop();
+  mod->mutable_create();
+  ASSERT_STATUS_OK(table->ModifyColumnFamilies(modify));
+  EXPECT_EQ((std::vector<std::string>{"r2/cf2/a/1=v3"}), ReadCells(*table));
+
+  // Nor must reclaiming a family dropped and re-created by one request
+  // remove the cells written to it afterwards.
+  SetCell(*table, "r3", "cf1", "a", 1, "v4");
+  modify.clear_modifications();
+  mod = modify.add_modifications();
+  mod->set_id("cf1");
+  mod->set_drop(true);
+  mod = modify.add_modifications();
+  mod->set_id("cf1");
+  mod->mutable_create();
+  ASSERT_STATUS_OK(table->ModifyColumnFamilies(modify));
+  SetCell(*table, "r4", "cf1", "a", 1, "v5");
+  GlobalReclaimer().Drain();
+  EXPECT_EQ((std::vector<std::string>{"r2/cf2/a/1=v3", "r4/cf1/a/1=v5"}),
+            ReadCells(*table));
+}
+
+TEST_F(TablePersistenceTest, SampleRowKeysUsesApproximateSizes) {
+  for (auto layout : {StorageLayout::kColumnFamilyPerFamily,
+                      StorageLayout::kSingleColumnFamily}) {
+    SCOPED_TRACE("layout: " + StorageLayoutName(layout));
+    auto table = CreateTable(MakeUniqueTableName(), {"cf1", "cf2"}, layout);
+    ASSERT_NE(nullptr, table);
+
+    auto empty = table->SampleRowKeys();
+    ASSERT_STATUS_OK(empty);
+    ASSERT_EQ(1U, empty->size());
+    EXPECT_EQ("", (*empty)[0].row_key());
+    EXPECT_EQ(0, (*empty)[0].offset_bytes());
+
+    for (int i = 0; i != 200; ++i) {
+      auto const row_key = "row" + std::to_string(1000 + i);
+      SetCell(*table, row_key, "cf1", "c1", 1, std::string(100, 'x'));
+      SetCell(*table, row_key, "cf2", "c1", 1, std::string(100, 'y'));
+    }
+
+    auto samples = table->SampleRowKeys();
+    ASSERT_STATUS_OK(samples);
+    ASSERT_LE(2U, samples->size());
+    EXPECT_EQ("", samples->back().row_key());
+    EXPECT_LT(0, samples->back().offset_bytes());
+    for (std::size_t i = 0; i + 1 < samples->size(); ++i) {
+      auto const& row_key = (*samples)[i].row_key();
+      EXPECT_LE("row1000", row_key);
+      EXPECT_GE("row1199", row_key);
+      EXPECT_LT((*samples)[i].offset_bytes(),
+                (*samples)[i + 1].offset_bytes());
+      if (i > 0) EXPECT_LT((*samples)[i - 1].row_key(), row_key);
+    }
+  }
+}
+
+TEST_F(TablePersistenceTest, StatsArePersistedAndDeletedWithTable) {
+  auto const table_name = MakeUniqueTableName();
+  auto table = CreateTable(table_name, {"cf1", "cf2"},
+                           StorageLayout::kColumnFamilyPerFamily);
+  ASSERT_NE(nullptr, table);
+  SetCell(*table, "r1", "cf1", "a", 1, "v1");
+  SetCell(*table, "r1", "cf2", "a", 1, "v2");
+  SetCell(*table, "r2", "cf1", "a", 1, "v3");
+  auto const stats = table->GetStats();
+  EXPECT_EQ(2, stats.rows);
+  EXPECT_EQ(2, stats.column_families.at("cf1").cells);
+
+  // A restart re-creates the table from the persisted schema.
+  auto restored = Table::Create(ReadPersistedSchema(storage(), table_name),
+                                storage().GetTableLayout(table_name));
+  ASSERT_STATUS_OK(restored);
+  EXPECT_EQ(stats, (*restored)->GetStats());
+
+  storage().DeleteTable(table_name);
+  EXPECT_TRUE(storage().GetRow(kStatsPrefix + table_name).empty());
+}
+
+TEST_F(TablePersistenceTest, DeleteFromColumnAfterRestart) {
+  for (auto const layout : {StorageLayout::kColumnFamilyPerFamily,
+                            StorageLayout::kSingleColumnFamily}) {
+    auto const table_name = MakeUniqueTableName();
+    auto table = CreateTable(table_name, {"cf1"}, layout);
+    ASSERT_NE(nullptr, table);
+    for (std::int64_t ts : {1, 2, 10, 20}) {
+      SetCell(*table, "r1", "cf1", "a", ts, "v" + std::to_string(ts));
+    }
+    SetCell(*table, "r1", "cf1", "b", 1, "b1");
+
+    // The restored table only has the cells in the storage.
+    auto restored = Table::Create(ReadPersistedSchema(storage(), table_name),
+                                  storage().GetTableLayout(table_name));
+    ASSERT_STATUS_OK(restored);
+    btproto::MutateRowRequest request;
+    request.set_table_name(table_name);
+    request.set_row_key("r1");
+    auto* delete_column =
+        request.add_mutations()->mutable_delete_from_column();
+    delete_column->set_family_name("cf1");
+    delete_column->set_column_qualifier("a");
+    // Numerically, but not lexicographically, 2 <= 10 < 20.
+    delete_column->mutable_time_range()->set_start_timestamp_micros(2000);
+    delete_column->mutable_time_range()->set_end_timestamp_micros(20000);
+    ASSERT_STATUS_OK((*restored)->MutateRow(request));
+    EXPECT_THAT(ReadCells(**restored),
+                UnorderedElementsAre("r1/cf1/a/1=v1", "r1/cf1/a/20=v20",
+                                     "r1/cf1/b/1=b1"));
+
+    delete_column->clear_time_range();
+    ASSERT_STATUS_OK((*restored)->MutateRow(request));
+    EXPECT_THAT(ReadCells(**restored), ElementsAre("r1/cf1/b/1=b1"));
+  }
+}
+
+TEST_F(TablePersistenceTest, StreamsHideVersionsOverMaxNumVersions) {
+  for (auto const layout : {StorageLayout::kColumnFamilyPerFamily,
+                            StorageLayout::kSingleColumnFamily}) {
+    auto const table_name = MakeUniqueTableName();
+    btadmin::Table schema;
+    schema.set_name(table_name);
+    (*schema.mutable_column_families())["cf1"]
+        .mutable_gc_rule()
+        ->set_max_num_versions(2);
+    auto table = Table::Create(schema, layout);
+    ASSERT_STATUS_OK(table);
+    // The keys order the timestamps as 1, 10, 2, 20.
+    for (std::int64_t ts : {1, 2, 10, 20}) {
+      SetCell(**table, "r1", "cf1", "a", ts, "v" + std::to_string(ts));
+    }
+    SetCell(**table, "r1", "cf1", "b", 1, "b1");
+
+    EXPECT_THAT(ReadCells(**table),
+                UnorderedElementsAre("r1/cf1/a/10=v10", "r1/cf1/a/20=v20",
+                                     "r1/cf1/b/1=b1"));
+    // The filters don't change the ranks.
+    btproto::RowFilter filter;
+    filter.mutable_timestamp_range_filter()->set_end_timestamp_micros(15000);
+    EXPECT_THAT(ReadCells(**table, filter),
+                UnorderedElementsAre("r1/cf1/a/10=v10", "r1/cf1/b/1=b1"));
+  }
+}
+
+TEST_F(TablePersistenceTest, TabletsArePersistedAndDeletedWithTable) {
+  auto const table_name = MakeUniqueTableName();
+  btadmin::Table schema;
+  schema.set_name(table_name);
+  (*schema.mutable_column_families())["cf1"] = btadmin::ColumnFamily{};
+  auto table = Table::Create(schema, StorageLayout::kColumnFamilyPerFamily,
+                             {"r5", "r2"});
+  ASSERT_STATUS_OK(table);
+  EXPECT_EQ(3U, (*table)->GetTablets().size());
+
+  // A restart re-creates the table without the initial splits.
+  auto restored = Table::Create(ReadPersistedSchema(storage(), table_name),
+                                storage().GetTableLayout(table_name));
+  ASSERT_STATUS_OK(restored);
+  auto const tablets = (*restored)->GetTablets();
+  ASSERT_EQ(3U, tablets.size());
+  EXPECT_EQ("r2", tablets[1].start_key);
+  EXPECT_EQ("r5", tablets[2].start_key);
+
+  storage().DeleteTable(table_name);
+  EXPECT_TRUE(storage().GetRow(kTabletsPrefix + table_name).empty());
+}
+
+TEST_F(TablePersistenceTest, SnapshotStreamIgnoresLaterMutations) {
+  for (auto layout : {StorageLayout::kColumnFamilyPerFamily,
+                      StorageLayout::kSingleColumnFamily}) {
+    SCOPED_TRACE("layout: " + StorageLayoutName(layout));
+    auto const table_name = MakeUniqueTableName();
+    auto table = CreateTable(table_name, {"cf1", "cf2"}, layout);
+    ASSERT_NE(nullptr, table);
+    SetCell(*table, "r1", "cf1", "a", 1, "v1");
+    SetCell(*table, "r2", "cf2", "a", 1, "v2");
+
+    auto maybe_stream = table->CreateCellStream(
+        std::make_shared<StringRangeSet>(StringRangeSet::All()),
+        absl::nullopt, table->GetSnapshot());
+    ASSERT_STATUS_OK(maybe_stream);
+
+    // Mutate the table before the stream is consumed.
+    SetCell(*table, "r0", "cf1", "a", 1, "v0");
+    SetCell(*table, "r1", "cf1", "b", 1, "v3");
+    btproto::MutateRowRequest request;
+    request.set_table_name(table_name);
+    request.set_row_key("r2");
+    request.add_mutations()->mutable_delete_from_row();
+    ASSERT_STATUS_OK(table->MutateRow(request));
+
+    std::vector<std::string> cells;
+    for (auto& stream = *maybe_stream; stream; ++stream) {
+      cells.emplace_back(stream->row_key() + "/" + stream->column_family() +
+                         "/" + stream->column_qualifier() + "=" +
+                         std::string(stream->value()));
+    }
+    EXPECT_EQ((std::vector<std::string>{"r1/cf1/a=v1", "r2/cf2/a=v2"}), cells);
+    EXPECT_EQ((std::vector<std::string>{"r0/cf1/a/1=v0", "r1/cf1/a/1=v1",
+                                        "r1/cf1/b/1=v3"}),
+              ReadCells(*table));
+  }
+}
+
 }  // namespace
 }  // namespace emulator
 }  // namespace bigtable
@@ -0,0 +1,233 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "table_stats.h"
+#include "google/cloud/internal/make_status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_split.h"
+#include "column_family.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+double Ratio(std::int64_t numerator, std::int64_t denominator) {
+  if (denominator <= 0) return 0;
+  return static_cast<double>(numerator) / static_cast<double>(denominator);
+}
+
+}  // namespace
+
+std::int64_t LogicalCellSize(absl::string_view row_key,
+                             absl::string_view column_qualifier,
+                             absl::string_view value) {
+  return static_cast<std::int64_t>(row_key.size() + column_qualifier.size() +
+                                   value.size() +
+                                   sizeof(std::chrono::milliseconds));
+}
+
+std::size_t VersionsHistogramBucket(std::size_t versions) {
+  std::size_t bucket = 0;
+  while (versions > 1 && bucket + 1 < kVersionsHistogramBuckets) {
+    versions >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+void ColumnFamilyStats::AddColumn(std::size_t versions) {
+  ++columns;
+  ++versions_histogram[VersionsHistogramBucket(versions)];
+}
+
+void ColumnFamilyStats::RemoveColumn(std::size_t versions) {
+  --columns;
+  --versions_histogram[VersionsHistogramBucket(versions)];
+}
+
+void ColumnFamilyStats::AddRow(std::string const& row_key,
+                               ColumnFamilyRow const& row) {
+  ++rows;
+  for (auto const& column : row) {
+    AddColumn(column.second.size());
+    for (auto const& cell : column.second) {
+      ++cells;
+      logical_bytes +=
+          LogicalCellSize(row_key, column.first.name(), cell.second);
+    }
+  }
+}
+
+ColumnFamilyStats& ColumnFamilyStats::operator+=(
+    ColumnFamilyStats const& other) {
+  rows += other.rows;
+  columns += other.columns;
+  cells += other.cells;
+  logical_bytes += other.logical_bytes;
+  for (std::size_t i = 0; i != kVersionsHistogramBuckets; ++i) {
+    versions_histogram[i] += other.versions_histogram[i];
+  }
+  return *this;
+}
+
+ColumnFamilyStats& ColumnFamilyStats::operator-=(
+    ColumnFamilyStats const& other) {
+  rows -= other.rows;
+  columns -= other.columns;
+  cells -= other.cells;
+  logical_bytes -= other.logical_bytes;
+  for (std::size_t i = 0; i != kVersionsHistogramBuckets; ++i) {
+    versions_histogram[i] -= other.versions_histogram[i];
+  }
+  return *this;
+}
+
+bool ColumnFamilyStats::IsZero() const { return *this == ColumnFamilyStats{}; }
+
+bool operator==(ColumnFamilyStats const& lhs, ColumnFamilyStats const& rhs) {
+  return lhs.rows == rhs.rows && lhs.columns == rhs.columns &&
+         lhs.cells == rhs.cells && lhs.logical_bytes == rhs.logical_bytes &&
+         lhs.versions_histogram == rhs.versions_histogram;
+}
+
+ColumnFamilyStats ComputeColumnFamilyStats(ColumnFamily const& column_family) {
+  ColumnFamilyStats res;
+  column_family.ForEachRow(
+      std::string(), std::string(),
+      [&res](std::string const& row_key, ColumnFamilyRow const& row) {
+        res.AddRow(row_key, row);
+      });
+  return res;
+}
+
+TableStats& TableStats::operator+=(TableStats const& other) {
+  rows += other.rows;
+  for (auto const& column_family : other.column_families) {
+    column_families[column_family.first] += column_family.second;
+  }
+  return *this;
+}
+
+TableStats& TableStats::operator-=(TableStats const& other) {
+  rows -= other.rows;
+  for (auto const& column_family : other.column_families) {
+    column_families[column_family.first] -= column_family.second;
+  }
+  return *this;
+}
+
+bool TableStats::IsZero() const {
+  if (rows != 0) return false;
+  for (auto const& column_family : column_families) {
+    if (!column_family.second.IsZero()) return false;
+  }
+  return true;
+}
+
+ColumnFamilyStats TableStats::Total() const {
+  ColumnFamilyStats res;
+  for (auto const& column_family : column_families) {
+    res += column_family.second;
+  }
+  return res;
+}
+
+bool operator==(TableStats const& lhs, TableStats const& rhs) {
+  return lhs.rows == rhs.rows && lhs.column_families == rhs.column_families;
+}
+
+// The encoding is line based:
+//   rows <rows>
+//   family <name> <rows> <columns> <cells> <logical_bytes> <histogram...>
+// Column family names cannot contain whitespace.
+std::string TableStats::Serialize() const {
+  std::ostringstream os;
+  os << "rows " << rows << "\n";
+  for (auto const& column_family : column_families) {
+    auto const& stats = column_family.second;
+    os << "family " << column_family.first << " " << stats.rows << " "
+       << stats.columns << " " << stats.cells << " " << stats.logical_bytes;
+    for (auto count : stats.versions_histogram) os << " " << count;
+    os << "\n";
+  }
+  return std::move(os).str();
+}
+
+StatusOr<TableStats> TableStats::Parse(std::string const& serialized) {
+  auto error = [&serialized](std::string const& line) {
+    return InvalidArgumentError(
+        "Malformed table stats.",
+        GCP_ERROR_INFO().WithMetadata("line", line).WithMetadata(
+            "serialized", serialized));
+  };
+  TableStats res;
+  for (absl::string_view line :
+       absl::StrSplit(serialized, '\n', absl::SkipEmpty())) {
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    if (fields.size() == 2 && fields[0] == "rows") {
+      if (!absl::SimpleAtoi(fields[1], &res.rows)) {
+        return error(std::string(line));
+      }
+      continue;
+    }
+    if (fields.size() != 6 + kVersionsHistogramBuckets ||
+        fields[0] != "family") {
+      return error(std::string(line));
+    }
+    auto& stats = res.column_families[std::string(fields[1])];
+    std::vector<std::int64_t*> values = {&stats.rows, &stats.columns,
+                                         &stats.cells, &stats.logical_bytes};
+    for (auto& count : stats.versions_histogram) values.push_back(&count);
+    for (std::size_t i = 0; i != values.size(); ++i) {
+      if (!absl::SimpleAtoi(fields[i + 2], values[i])) {
+        return error(std::string(line));
+      }
+    }
+  }
+  return res;
+}
+
+google::bigtable::admin::v2::ColumnFamilyStats ToProto(
+    ColumnFamilyStats const& stats) {
+  google::bigtable::admin::v2::ColumnFamilyStats res;
+  res.set_average_columns_per_row(Ratio(stats.columns, stats.rows));
+  res.set_average_cells_per_column(Ratio(stats.cells, stats.columns));
+  res.set_logical_data_bytes(stats.logical_bytes);
+  return res;
+}
+
+google::bigtable::admin::v2::TableStats ToProto(TableStats const& stats) {
+  auto const total = stats.Total();
+  google::bigtable::admin::v2::TableStats res;
+  res.set_row_count(stats.rows);
+  res.set_average_columns_per_row(Ratio(total.columns, stats.rows));
+  res.set_average_cells_per_column(Ratio(total.cells, total.columns));
+  res.set_logical_data_bytes(total.logical_bytes);
+  return res;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
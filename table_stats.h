@@ -0,0 +1,127 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLE_STATS_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLE_STATS_H
+
+#include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+class ColumnFamily;
+class ColumnFamilyRow;
+
+/// The number of buckets in `ColumnFamilyStats::versions_histogram`.
+std::size_t constexpr kVersionsHistogramBuckets = 8;
+
+/**
+ * The logical size of a cell, i.e. roughly how many bytes it takes to stream
+ * it out of the table.
+ */
+std::int64_t LogicalCellSize(absl::string_view row_key,
+                             absl::string_view column_qualifier,
+                             absl::string_view value);
+
+/// The bucket of `ColumnFamilyStats::versions_histogram` for `versions`.
+std::size_t VersionsHistogramBucket(std::size_t versions);
+
+/**
+ * Counters describing the contents of a column family.
+ *
+ * A column is a (row, column qualifier) pair with at least one cell.
+ */
+struct ColumnFamilyStats {
+  std::int64_t rows = 0;
+  std::int64_t columns = 0;
+  std::int64_t cells = 0;
+  std::int64_t logical_bytes = 0;
+  /**
+   * `versions_histogram[i]` is the number of columns with [2^i, 2^(i+1))
+   * cells. The last bucket also counts all the larger columns.
+   */
+  std::array<std::int64_t, kVersionsHistogramBuckets> versions_histogram{};
+
+  /// Account for a column with `versions` cells.
+  void AddColumn(std::size_t versions);
+  /// Undo `AddColumn(versions)`.
+  void RemoveColumn(std::size_t versions);
+  /// Account for a row and all its cells.
+  void AddRow(std::string const& row_key, ColumnFamilyRow const& row);
+
+  ColumnFamilyStats& operator+=(ColumnFamilyStats const& other);
+  ColumnFamilyStats& operator-=(ColumnFamilyStats const& other);
+  bool IsZero() const;
+};
+
+bool operator==(ColumnFamilyStats const& lhs, ColumnFamilyStats const& rhs);
+inline bool operator!=(ColumnFamilyStats const& lhs,
+                       ColumnFamilyStats const& rhs) {
+  return !(lhs == rhs);
+}
+
+/// Compute the stats of `column_family` by visiting all its cells.
+ColumnFamilyStats ComputeColumnFamilyStats(ColumnFamily const& column_family);
+
+/**
+ * Counters describing the contents of a table.
+ *
+ * Tables maintain them incrementally as they are mutated, so reading them
+ * doesn't require a scan. The same type describes the changes made by a
+ * mutation.
+ */
+struct TableStats {
+  /// The number of distinct rows in all the column families.
+  std::int64_t rows = 0;
+  std::map<std::string, ColumnFamilyStats> column_families;
+
+  TableStats& operator+=(TableStats const& other);
+  TableStats& operator-=(TableStats const& other);
+  bool IsZero() const;
+  /// The sum of the stats of all column families.
+  ColumnFamilyStats Total() const;
+
+  /// A text encoding of the stats, used to persist them.
+  std::string Serialize() const;
+  /// The inverse of `Serialize()`.
+  static StatusOr<TableStats> Parse(std::string const& serialized);
+};
+
+bool operator==(TableStats const& lhs, TableStats const& rhs);
+inline bool operator!=(TableStats const& lhs, TableStats const& rhs) {
+  return !(lhs == rhs);
+}
+
+/// The stats of a column family, as returned with `Table::STATS_VIEW`.
+google::bigtable::admin::v2::ColumnFamilyStats ToProto(
+    ColumnFamilyStats const& stats);
+
+/// The stats of a table, as returned with `Table::STATS_VIEW`.
+google::bigtable::admin::v2::TableStats ToProto(TableStats const& stats);
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLE_STATS_H
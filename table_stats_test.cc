@@ -0,0 +1,316 @@
+// Copyright 2025 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "table_stats.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "column_family.h"
+#include "table.h"
+#include <google/bigtable/admin/v2/bigtable_table_admin.pb.h>
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+auto constexpr kTableName = "projects/test/instances/test/tables/stats";
+
+std::shared_ptr<Table> CreateTable(std::vector<std::string> const& families,
+                                   btadmin::GcRule const& gc_rule = {}) {
+  btadmin::Table schema;
+  schema.set_name(kTableName);
+  for (auto const& family : families) {
+    auto& column_family = (*schema.mutable_column_families())[family];
+    if (gc_rule.rule_case() != btadmin::GcRule::RULE_NOT_SET) {
+      *column_family.mutable_gc_rule() = gc_rule;
+    }
+  }
+  auto maybe_table = Table::Create(schema);
+  EXPECT_STATUS_OK(maybe_table);
+  return maybe_table ? *maybe_table : nullptr;
+}
+
+btproto::Mutation SetCell(std::string const& family,
+                          std::string const& qualifier,
+                          std::int64_t timestamp_ms, std::string const& value) {
+  btproto::Mutation mutation;
+  auto* set_cell = mutation.mutable_set_cell();
+  set_cell->set_family_name(family);
+  set_cell->set_column_qualifier(qualifier);
+  set_cell->set_timestamp_micros(timestamp_ms * 1000);
+  set_cell->set_value(value);
+  return mutation;
+}
+
+Status Mutate(Table& table, std::string const& row_key,
+              std::vector<btproto::Mutation> const& mutations) {
+  btproto::MutateRowRequest request;
+  request.set_table_name(kTableName);
+  request.set_row_key(row_key);
+  for (auto const& mutation : mutations) *request.add_mutations() = mutation;
+  return table.MutateRow(request);
+}
+
+// The stats computed by visiting all the cells of `table`.
+TableStats ComputeStats(Table& table) {
+  TableStats res;
+  std::set<std::string> rows;
+  for (auto const& column_family : table) {
+    res.column_families[column_family.first] =
+        ComputeColumnFamilyStats(*column_family.second);
+    for (auto const& row : *column_family.second) rows.insert(row.first);
+  }
+  res.rows = static_cast<std::int64_t>(rows.size());
+  return res;
+}
+
+TEST(TableStats, VersionsHistogramBucket) {
+  EXPECT_EQ(0U, VersionsHistogramBucket(1));
+  EXPECT_EQ(1U, VersionsHistogramBucket(2));
+  EXPECT_EQ(1U, VersionsHistogramBucket(3));
+  EXPECT_EQ(2U, VersionsHistogramBucket(4));
+  EXPECT_EQ(6U, VersionsHistogramBucket(127));
+  EXPECT_EQ(7U, VersionsHistogramBucket(128));
+  EXPECT_EQ(kVersionsHistogramBuckets - 1, VersionsHistogramBucket(100000));
+}
+
+TEST(TableStats, SerializeRoundTrip) {
+  TableStats stats;
+  stats.rows = 3;
+  auto& cf1 = stats.column_families["cf1"];
+  cf1.rows = 3;
+  cf1.AddColumn(1);
+  cf1.AddColumn(5);
+  cf1.cells = 6;
+  cf1.logical_bytes = 123;
+  stats.column_families["cf2"];
+
+  auto parsed = TableStats::Parse(stats.Serialize());
+  ASSERT_STATUS_OK(parsed);
+  EXPECT_EQ(stats, *parsed);
+}
+
+TEST(TableStats, ParseRejectsMalformedInput) {
+  EXPECT_FALSE(TableStats::Parse("rows x\n").ok());
+  EXPECT_FALSE(TableStats::Parse("family cf1 1 2 3\n").ok());
+  EXPECT_FALSE(TableStats::Parse("bogus\n").ok());
+  auto empty = TableStats::Parse("");
+  ASSERT_STATUS_OK(empty);
+  EXPECT_TRUE(empty->IsZero());
+}
+
+TEST(TableStats, ToProto) {
+  TableStats stats;
+  stats.rows = 2;
+  auto& cf1 = stats.column_families["cf1"];
+  cf1.rows = 2;
+  cf1.AddColumn(1);
+  cf1.AddColumn(3);
+  cf1.cells = 4;
+  cf1.logical_bytes = 100;
+  auto& cf2 = stats.column_families["cf2"];
+  cf2.rows = 1;
+  cf2.AddColumn(2);
+  cf2.cells = 2;
+  cf2.logical_bytes = 50;
+
+  auto const table_proto = ToProto(stats);
+  EXPECT_EQ(2, table_proto.row_count());
+  EXPECT_DOUBLE_EQ(1.5, table_proto.average_columns_per_row());
+  EXPECT_DOUBLE_EQ(2.0, table_proto.average_cells_per_column());
+  EXPECT_EQ(150, table_proto.logical_data_bytes());
+
+  auto const cf_proto = ToProto(cf1);
+  EXPECT_DOUBLE_EQ(1.0, cf_proto.average_columns_per_row());
+  EXPECT_DOUBLE_EQ(2.0, cf_proto.average_cells_per_column());
+  EXPECT_EQ(100, cf_proto.logical_data_bytes());
+
+  auto const empty_proto = ToProto(TableStats{});
+  EXPECT_EQ(0, empty_proto.row_count());
+  EXPECT_DOUBLE_EQ(0.0, empty_proto.average_cells_per_column());
+}
+
+TEST(TableStatsTracking, SetCells) {
+  auto table = CreateTable({"cf1", "cf2"});
+  ASSERT_NE(nullptr, table);
+  EXPECT_TRUE(table->GetStats().IsZero());
+
+  ASSERT_STATUS_OK(Mutate(*table, "row1",
+                          {SetCell("cf1", "a", 1, "v1"),
+                           SetCell("cf1", "a", 2, "v2"),
+                           SetCell("cf2", "b", 1, "value")}));
+  ASSERT_STATUS_OK(Mutate(*table, "row2", {SetCell("cf1", "a", 1, "v")}));
+  // Overwriting a cell changes only its size.
+  ASSERT_STATUS_OK(Mutate(*table, "row1", {SetCell("cf1", "a", 2, "longer")}));
+
+  auto const stats = table->GetStats();
+  EXPECT_EQ(ComputeStats(*table), stats);
+  EXPECT_EQ(2, stats.rows);
+  auto const& cf1 = stats.column_families.at("cf1");
+  EXPECT_EQ(2, cf1.rows);
+  EXPECT_EQ(2, cf1.columns);
+  EXPECT_EQ(3, cf1.cells);
+  EXPECT_EQ(1, cf1.versions_histogram[0]);
+  EXPECT_EQ(1, cf1.versions_histogram[1]);
+  EXPECT_EQ(LogicalCellSize("row1", "a", "v1") +
+                LogicalCellSize("row1", "a", "longer") +
+                LogicalCellSize("row2", "a", "v"),
+            cf1.logical_bytes);
+  EXPECT_EQ(1, stats.column_families.at("cf2").rows);
+}
+
+TEST(TableStatsTracking, Deletes) {
+  auto table = CreateTable({"cf1", "cf2"});
+  ASSERT_NE(nullptr, table);
+  for (auto const* row : {"row1", "row2", "row3"}) {
+    ASSERT_STATUS_OK(Mutate(*table, row,
+                            {SetCell("cf1", "a", 1, "v1"),
+                             SetCell("cf1", "a", 2, "v2"),
+                             SetCell("cf1", "b", 1, "v3"),
+                             SetCell("cf2", "c", 1, "v4")}));
+  }
+
+  btproto::Mutation delete_from_column;
+  delete_from_column.mutable_delete_from_column()->set_family_name("cf1");
+  delete_from_column.mutable_delete_from_column()->set_column_qualifier("a");
+  delete_from_column.mutable_delete_from_column()
+      ->mutable_time_range()
+      ->set_start_timestamp_micros(2000);
+  ASSERT_STATUS_OK(Mutate(*table, "row1", {delete_from_column}));
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+
+  btproto::Mutation delete_from_family;
+  delete_from_family.mutable_delete_from_family()->set_family_name("cf2");
+  ASSERT_STATUS_OK(Mutate(*table, "row2", {delete_from_family}));
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+  EXPECT_EQ(3, table->GetStats().rows);
+
+  btproto::Mutation delete_from_row;
+  delete_from_row.mutable_delete_from_row();
+  ASSERT_STATUS_OK(Mutate(*table, "row3", {delete_from_row}));
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+  EXPECT_EQ(2, table->GetStats().rows);
+}
+
+TEST(TableStatsTracking, FailedMutationIsNotCounted) {
+  auto table = CreateTable({"cf1"});
+  ASSERT_NE(nullptr, table);
+  ASSERT_STATUS_OK(Mutate(*table, "row1", {SetCell("cf1", "a", 1, "v")}));
+  auto const before = table->GetStats();
+
+  EXPECT_FALSE(Mutate(*table, "row2",
+                      {SetCell("cf1", "a", 1, "v"),
+                       SetCell("no_such_family", "a", 1, "v")})
+                   .ok());
+  EXPECT_EQ(before, table->GetStats());
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+}
+
+TEST(TableStatsTracking, ReadModifyWriteRow) {
+  auto table = CreateTable({"cf1"});
+  ASSERT_NE(nullptr, table);
+
+  btproto::ReadModifyWriteRowRequest request;
+  request.set_table_name(kTableName);
+  request.set_row_key("row1");
+  auto* rule = request.add_rules();
+  rule->set_family_name("cf1");
+  rule->set_column_qualifier("a");
+  rule->set_append_value("abc");
+  ASSERT_STATUS_OK(table->ReadModifyWriteRow(request));
+  ASSERT_STATUS_OK(table->ReadModifyWriteRow(request));
+
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+  EXPECT_EQ(1, table->GetStats().rows);
+}
+
+TEST(TableStatsTracking, DropRowRange) {
+  auto table = CreateTable({"cf1", "cf2"});
+  ASSERT_NE(nullptr, table);
+  for (auto const* row : {"a1", "a2", "b1"}) {
+    ASSERT_STATUS_OK(Mutate(*table, row,
+                            {SetCell("cf1", "a", 1, "v"),
+                             SetCell("cf2", "a", 1, "v")}));
+  }
+
+  btadmin::DropRowRangeRequest request;
+  request.set_row_key_prefix("a");
+  ASSERT_STATUS_OK(table->DropRowRange(request));
+  EXPECT_EQ(ComputeStats(*table), table->GetStats());
+  EXPECT_EQ(1, table->GetStats().rows);
+
+  request.set_delete_all_data_from_table(true);
+  ASSERT_STATUS_OK(table->DropRowRange(request));
+  EXPECT_TRUE(table->GetStats().IsZero());
+}
+
+TEST(TableStatsTracking, GarbageCollection) {
+  btadmin::GcRule gc_rule;
+  gc_rule.set_max_num_versions(1);
+  auto table = CreateTable({"cf1"}, gc_rule);
+  ASSERT_NE(nullptr, table);
+  ASSERT_STATUS_OK(Mutate(*table, "row1",
+                          {SetCell("cf1", "a", 1, "v1"),
+                           SetCell("cf1", "a", 2, "v2"),
+                           SetCell("cf1", "a", 3, "v3")}));
+  EXPECT_EQ(3, table->GetStats().column_families.at("cf1").cells);
+
+  ASSERT_STATUS_OK(table->RunGC());
+  auto const stats = table->GetStats();
+  EXPECT_EQ(ComputeStats(*table), stats);
+  EXPECT_EQ(1, stats.column_families.at("cf1").cells);
+  EXPECT_EQ(1, stats.column_families.at("cf1").versions_histogram[0]);
+}
+
+TEST(TableStatsTracking, ModifyColumnFamilies) {
+  auto table = CreateTable({"cf1", "cf2"});
+  ASSERT_NE(nullptr, table);
+  ASSERT_STATUS_OK(Mutate(*table, "row1", {SetCell("cf1", "a", 1, "v")}));
+  ASSERT_STATUS_OK(Mutate(*table, "row2",
+                          {SetCell("cf1", "a", 1, "v"),
+                           SetCell("cf2", "a", 1, "v")}));
+
+  btadmin::ModifyColumnFamiliesRequest request;
+  request.set_name(kTableName);
+  auto* drop = request.add_modifications();
+  drop->set_id("cf1");
+  drop->set_drop(true);
+  auto* create = request.add_modifications();
+  create->set_id("cf3");
+  *create->mutable_create() = btadmin::ColumnFamily{};
+  ASSERT_STATUS_OK(table->ModifyColumnFamilies(request));
+
+  auto const stats = table->GetStats();
+  EXPECT_EQ(ComputeStats(*table), stats);
+  EXPECT_EQ(1, stats.rows);
+  EXPECT_EQ(0U, stats.column_families.count("cf1"));
+  EXPECT_EQ(1U, stats.column_families.count("cf3"));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
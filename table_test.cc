@@ -20,11 +20,15 @@
 #include "filter.h"
 #include "range_set.h"
 #include "re2/re2.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
 #include <gtest/gtest.h>
+#include <cstdint>
 #include <memory>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -84,7 +88,8 @@ TEST(FilteredTableStream, ColumnFamiliesAreFiltered) {
   FilteredTableStream stream(std::move(fams));
   auto family_pattern = std::make_shared<re2::RE2>("fam1");
   ASSERT_TRUE(family_pattern->ok());
-  stream.ApplyFilter(FamilyNameRegex{family_pattern});
+  stream.ApplyFilter(
+      FamilyNameRegex{std::make_shared<RegexMatcher const>(family_pattern)});
   EXPECT_EQ("row0 fam1:col0 @10ms: foo\n", DumpStream(stream));
 }
 
@@ -131,15 +136,18 @@ TEST(FilteredTableStream, OtherFiltersArePropagated) {
 
   auto row_key_pattern = std::make_shared<re2::RE2>("row1");
   ASSERT_TRUE(row_key_pattern->ok());
-  EXPECT_TRUE(stream.ApplyFilter(RowKeyRegex{row_key_pattern}));
+  EXPECT_TRUE(stream.ApplyFilter(
+      RowKeyRegex{std::make_shared<RegexMatcher const>(row_key_pattern)}));
 
   auto family_pattern = std::make_shared<re2::RE2>("fam1");
   ASSERT_TRUE(family_pattern->ok());
-  EXPECT_TRUE(stream.ApplyFilter(FamilyNameRegex{family_pattern}));
+  EXPECT_TRUE(stream.ApplyFilter(
+      FamilyNameRegex{std::make_shared<RegexMatcher const>(family_pattern)}));
 
   auto qualifier_pattern = std::make_shared<re2::RE2>("1$");
   ASSERT_TRUE(qualifier_pattern->ok());
-  EXPECT_TRUE(stream.ApplyFilter(ColumnRegex{qualifier_pattern}));
+  EXPECT_TRUE(stream.ApplyFilter(
+      ColumnRegex{std::make_shared<RegexMatcher const>(qualifier_pattern)}));
 
   EXPECT_TRUE(stream.ApplyFilter(
       ColumnRange{"fam1", StringRangeSet::Range("co", false, "com", false)}));
@@ -150,6 +158,117 @@ TEST(FilteredTableStream, OtherFiltersArePropagated) {
   EXPECT_EQ("row1 fam1:col1 @10ms: foo\n", DumpStream(stream));
 }
 
+std::shared_ptr<Table> CreateTableWithRows(int num_rows) {
+  ::google::bigtable::admin::v2::Table schema;
+  schema.set_name("projects/p/instances/i/tables/sample");
+  (*schema.mutable_column_families())["cf"] =
+      ::google::bigtable::admin::v2::ColumnFamily();
+  auto table = Table::Create(schema);
+  EXPECT_TRUE(table.ok());
+  for (int i = 0; i != num_rows; ++i) {
+    ::google::bigtable::v2::MutateRowRequest request;
+    request.set_table_name(schema.name());
+    request.set_row_key("row" + std::to_string(100 + i));
+    auto* set_cell = request.add_mutations()->mutable_set_cell();
+    set_cell->set_family_name("cf");
+    set_cell->set_column_qualifier("col");
+    set_cell->set_timestamp_micros(1000);
+    set_cell->set_value("value");
+    EXPECT_TRUE((*table)->MutateRow(request).ok());
+  }
+  return *table;
+}
+
+TEST(TableSampleRowKeys, Empty) {
+  auto samples = CreateTableWithRows(0)->SampleRowKeys();
+  ASSERT_TRUE(samples.ok());
+  ASSERT_EQ(1U, samples->size());
+  EXPECT_EQ("", (*samples)[0].row_key());
+  EXPECT_EQ(0, (*samples)[0].offset_bytes());
+}
+
+TEST(TableSampleRowKeys, SplitsInEvenlySizedRanges) {
+  // Each cell is `row1xx` + `col` + `value` + the timestamp.
+  std::int64_t const row_size = 6 + 3 + 5 + 8;
+  auto samples = CreateTableWithRows(100)->SampleRowKeys();
+  ASSERT_TRUE(samples.ok());
+  ASSERT_EQ(2U, samples->size());
+  EXPECT_EQ("row150", (*samples)[0].row_key());
+  EXPECT_EQ(50 * row_size, (*samples)[0].offset_bytes());
+  EXPECT_EQ("", (*samples)[1].row_key());
+  EXPECT_EQ(100 * row_size, (*samples)[1].offset_bytes());
+}
+
+TEST(TableSampleRowKeys, SingleRow) {
+  auto samples = CreateTableWithRows(1)->SampleRowKeys();
+  ASSERT_TRUE(samples.ok());
+  ASSERT_EQ(2U, samples->size());
+  EXPECT_EQ("row100", (*samples)[0].row_key());
+  EXPECT_EQ(0, (*samples)[0].offset_bytes());
+  EXPECT_EQ("", (*samples)[1].row_key());
+  EXPECT_LT(0, (*samples)[1].offset_bytes());
+}
+
+std::vector<std::string> ReadRowKeys(Table const& table,
+                                     absl::optional<TableSnapshot> snapshot) {
+  auto stream = table.CreateCellStream(
+      std::make_shared<StringRangeSet>(StringRangeSet::All()), absl::nullopt,
+      std::move(snapshot));
+  EXPECT_TRUE(stream.ok());
+  std::vector<std::string> res;
+  if (!stream) return res;
+  for (; *stream; ++*stream) {
+    if (res.empty() || res.back() != (*stream)->row_key()) {
+      res.push_back((*stream)->row_key());
+    }
+  }
+  return res;
+}
+
+TEST(TableSnapshot, StreamIgnoresLaterMutations) {
+  auto table = CreateTableWithRows(3);
+  auto snapshot = table->GetSnapshot();
+
+  ::google::bigtable::v2::MutateRowRequest request;
+  request.set_table_name(table->GetSchema().name());
+  request.set_row_key("row101");
+  request.add_mutations()->mutable_delete_from_row();
+  ASSERT_TRUE(table->MutateRow(request).ok());
+
+  EXPECT_EQ((std::vector<std::string>{"row100", "row101", "row102"}),
+            ReadRowKeys(*table, snapshot));
+  EXPECT_EQ((std::vector<std::string>{"row100", "row102"}),
+            ReadRowKeys(*table, absl::nullopt));
+}
+
+TEST(TableSnapshot, StreamIsConcurrentWithMutations) {
+  auto table = CreateTableWithRows(100);
+  auto snapshot = table->GetSnapshot();
+
+  std::thread writer([&table] {
+    for (int i = 0; i != 100; ++i) {
+      ::google::bigtable::v2::MutateRowRequest request;
+      request.set_table_name(table->GetSchema().name());
+      request.set_row_key("row" + std::to_string(100 + i));
+      if (i % 2 == 0) {
+        request.add_mutations()->mutable_delete_from_row();
+      } else {
+        auto* set_cell = request.add_mutations()->mutable_set_cell();
+        set_cell->set_family_name("cf");
+        set_cell->set_column_qualifier("col");
+        set_cell->set_timestamp_micros(2000);
+        set_cell->set_value("new");
+      }
+      EXPECT_TRUE(table->MutateRow(request).ok());
+    }
+  });
+  auto const row_keys = ReadRowKeys(*table, std::move(snapshot));
+  writer.join();
+
+  EXPECT_EQ(100U, row_keys.size());
+  EXPECT_EQ(50U, ReadRowKeys(*table, absl::nullopt).size());
+}
+
 }  // anonymous namespace
 }  // namespace emulator
 }  // namespace bigtable
@@ -0,0 +1,107 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tablet.h"
+#include "google/cloud/internal/make_status.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_split.h"
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+TabletMap::TabletMap(std::vector<std::string> split_keys) {
+  std::sort(split_keys.begin(), split_keys.end());
+  split_keys.erase(std::unique(split_keys.begin(), split_keys.end()),
+                   split_keys.end());
+  tablets_.emplace_back();
+  for (auto& key : split_keys) {
+    if (key.empty()) continue;
+    tablets_.back().end_key = key;
+    Tablet tablet;
+    tablet.start_key = std::move(key);
+    tablets_.emplace_back(std::move(tablet));
+  }
+}
+
+std::size_t TabletMap::Find(absl::string_view row_key) const {
+  auto it = std::upper_bound(
+      tablets_.begin(), tablets_.end(), row_key,
+      [](absl::string_view key, Tablet const& tablet) {
+        return key < tablet.start_key;
+      });
+  return static_cast<std::size_t>(it - tablets_.begin()) - 1;
+}
+
+bool TabletMap::Split(std::size_t index, std::string split_key) {
+  auto& tablet = tablets_[index];
+  if (split_key <= tablet.start_key || !tablet.Contains(split_key)) {
+    return false;
+  }
+  Tablet second;
+  second.start_key = split_key;
+  second.end_key = std::move(tablet.end_key);
+  tablet.end_key = std::move(split_key);
+  tablets_.insert(tablets_.begin() + static_cast<std::ptrdiff_t>(index) + 1,
+                  std::move(second));
+  return true;
+}
+
+std::vector<std::string> TabletMap::SplitKeys() const {
+  std::vector<std::string> res;
+  for (std::size_t i = 1; i < tablets_.size(); ++i) {
+    res.push_back(tablets_[i].start_key);
+  }
+  return res;
+}
+
+std::string TabletMap::Serialize() const {
+  // One C-escaped split key per line; escaping takes care of any newlines in
+  // the keys.
+  std::string res;
+  for (auto const& key : SplitKeys()) {
+    res += absl::CEscape(key);
+    res += '\n';
+  }
+  return res;
+}
+
+StatusOr<TabletMap> TabletMap::Parse(std::string const& serialized) {
+  std::vector<std::string> split_keys;
+  for (absl::string_view line :
+       absl::StrSplit(serialized, '\n', absl::SkipEmpty())) {
+    std::string key;
+    if (!absl::CUnescape(line, &key) || key.empty() ||
+        (!split_keys.empty() && key <= split_keys.back())) {
+      return InvalidArgumentError(
+          "Malformed tablet boundaries.",
+          GCP_ERROR_INFO()
+              .WithMetadata("line", std::string(line))
+              .WithMetadata("serialized", serialized));
+    }
+    split_keys.emplace_back(std::move(key));
+  }
+  return TabletMap(std::move(split_keys));
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
@@ -0,0 +1,112 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLET_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLET_H
+
+#include "google/cloud/status_or.h"
+#include "absl/strings/string_view.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * A contiguous range of a table's rows.
+ *
+ * Tablets partition the rows for splitting, sampling and scans, and track
+ * their size. They are not a unit of locking: the in-memory rows of all the
+ * tablets share one map per column family, so the writes to different
+ * tablets publish under the table's `rows_mu_` like any other rows.
+ */
+struct Tablet {
+  /// The first row of the tablet, empty for the first tablet.
+  std::string start_key;
+  /// The first row past the tablet, empty for the last tablet.
+  std::string end_key;
+  /// The logical size of the tablet's cells, see `LogicalCellSize()`. With
+  /// persistent storage, RocksDB's estimate of their stored size instead.
+  std::int64_t logical_bytes = 0;
+  /// With persistent storage, the logical size of the mutations since
+  /// `logical_bytes` was estimated. It only tells when to estimate again.
+  std::int64_t unmeasured_bytes = 0;
+  /// A failed split is not retried until the tablet grows past this size.
+  std::int64_t next_split_bytes = 0;
+
+  bool Contains(absl::string_view row_key) const {
+    return start_key <= row_key && (end_key.empty() || row_key < end_key);
+  }
+};
+
+/**
+ * The partitioning of a table's rows into tablets.
+ *
+ * The tablets are ordered by their row ranges, which cover all row keys
+ * without overlapping. This class is not thread safe.
+ */
+class TabletMap {
+ public:
+  /// A single tablet holding all rows.
+  TabletMap() : TabletMap(std::vector<std::string>{}) {}
+
+  /**
+   * Tablets starting at each of `split_keys`, plus the first tablet.
+   *
+   * The keys need not be sorted or unique, empty keys are ignored.
+   */
+  explicit TabletMap(std::vector<std::string> split_keys);
+
+  std::size_t size() const { return tablets_.size(); }
+  Tablet& operator[](std::size_t index) { return tablets_[index]; }
+  Tablet const& operator[](std::size_t index) const { return tablets_[index]; }
+  std::vector<Tablet>::const_iterator begin() const { return tablets_.begin(); }
+  std::vector<Tablet>::const_iterator end() const { return tablets_.end(); }
+
+  /// The index of the tablet holding `row_key`.
+  std::size_t Find(absl::string_view row_key) const;
+
+  /**
+   * Split the tablet at `index` in two, the second starting at `split_key`.
+   *
+   * The second tablet gets index `index + 1`. Both halves have to be
+   * remeasured by the caller.
+   *
+   * @return false, leaving the tablets unchanged, if `split_key` is not
+   *     strictly inside the tablet.
+   */
+  bool Split(std::size_t index, std::string split_key);
+
+  /// The start keys of all tablets but the first.
+  std::vector<std::string> SplitKeys() const;
+
+  /// A text encoding of the tablet boundaries, used to persist them.
+  std::string Serialize() const;
+  /// The inverse of `Serialize()`. The tablet sizes are not persisted.
+  static StatusOr<TabletMap> Parse(std::string const& serialized);
+
+ private:
+  std::vector<Tablet> tablets_;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_TABLET_H
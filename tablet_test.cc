@@ -0,0 +1,238 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "tablet.h"
+#include "google/cloud/testing_util/status_matchers.h"
+#include "table.h"
+#include <google/bigtable/admin/v2/table.pb.h>
+#include <google/bigtable/v2/bigtable.pb.h>
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+namespace btadmin = ::google::bigtable::admin::v2;
+namespace btproto = ::google::bigtable::v2;
+
+using ::testing::ElementsAre;
+
+auto constexpr kTableName = "projects/test/instances/test/tables/tablets";
+
+std::shared_ptr<Table> CreateTable(std::vector<std::string> initial_splits,
+                                   btadmin::GcRule const& gc_rule = {}) {
+  btadmin::Table schema;
+  schema.set_name(kTableName);
+  auto& column_family = (*schema.mutable_column_families())["cf"];
+  if (gc_rule.rule_case() != btadmin::GcRule::RULE_NOT_SET) {
+    *column_family.mutable_gc_rule() = gc_rule;
+  }
+  auto maybe_table =
+      Table::Create(schema, StorageLayout::kColumnFamilyPerFamily,
+                    std::move(initial_splits));
+  EXPECT_STATUS_OK(maybe_table);
+  return maybe_table ? *maybe_table : nullptr;
+}
+
+Status SetCell(Table& table, std::string const& row_key,
+               std::string const& qualifier, std::int64_t timestamp_ms,
+               std::string const& value) {
+  btproto::MutateRowRequest request;
+  request.set_table_name(kTableName);
+  request.set_row_key(row_key);
+  auto* set_cell = request.add_mutations()->mutable_set_cell();
+  set_cell->set_family_name("cf");
+  set_cell->set_column_qualifier(qualifier);
+  set_cell->set_timestamp_micros(timestamp_ms * 1000);
+  set_cell->set_value(value);
+  return table.MutateRow(request);
+}
+
+std::vector<std::string> StartKeys(std::vector<Tablet> const& tablets) {
+  std::vector<std::string> res;
+  for (auto const& tablet : tablets) res.push_back(tablet.start_key);
+  return res;
+}
+
+TEST(TabletMap, SingleTablet) {
+  TabletMap tablets;
+  ASSERT_EQ(1U, tablets.size());
+  EXPECT_EQ("", tablets[0].start_key);
+  EXPECT_EQ("", tablets[0].end_key);
+  EXPECT_EQ(0U, tablets.Find(""));
+  EXPECT_EQ(0U, tablets.Find("zzz"));
+}
+
+TEST(TabletMap, SplitKeysAreSortedAndDeduplicated) {
+  TabletMap tablets({"m", "", "c", "m"});
+  ASSERT_EQ(3U, tablets.size());
+  EXPECT_THAT(tablets.SplitKeys(), ElementsAre("c", "m"));
+  EXPECT_EQ("c", tablets[0].end_key);
+  EXPECT_EQ("m", tablets[1].end_key);
+  EXPECT_EQ("", tablets[2].end_key);
+
+  EXPECT_EQ(0U, tablets.Find(""));
+  EXPECT_EQ(0U, tablets.Find("bzz"));
+  EXPECT_EQ(1U, tablets.Find("c"));
+  EXPECT_EQ(1U, tablets.Find("lzz"));
+  EXPECT_EQ(2U, tablets.Find("m"));
+  EXPECT_EQ(2U, tablets.Find("zzz"));
+}
+
+TEST(TabletMap, Split) {
+  TabletMap tablets({"m"});
+  EXPECT_FALSE(tablets.Split(0, ""));
+  EXPECT_FALSE(tablets.Split(0, "m"));
+  EXPECT_FALSE(tablets.Split(1, "m"));
+  EXPECT_FALSE(tablets.Split(1, "a"));
+  EXPECT_TRUE(tablets.Split(1, "t"));
+  EXPECT_TRUE(tablets.Split(0, "f"));
+  EXPECT_THAT(tablets.SplitKeys(), ElementsAre("f", "m", "t"));
+  EXPECT_EQ("f", tablets[0].end_key);
+  EXPECT_EQ("f", tablets[1].start_key);
+  EXPECT_EQ("m", tablets[1].end_key);
+  EXPECT_EQ("", tablets[3].end_key);
+}
+
+TEST(TabletMap, SerializeRoundTrip) {
+  TabletMap tablets({"a\nb", "plain", std::string("\0\xff", 2)});
+  auto parsed = TabletMap::Parse(tablets.Serialize());
+  ASSERT_STATUS_OK(parsed);
+  EXPECT_EQ(tablets.SplitKeys(), parsed->SplitKeys());
+
+  auto empty = TabletMap::Parse("");
+  ASSERT_STATUS_OK(empty);
+  EXPECT_EQ(1U, empty->size());
+}
+
+TEST(TabletMap, ParseRejectsMalformedInput) {
+  EXPECT_FALSE(TabletMap::Parse("b\na\n").ok());
+  EXPECT_FALSE(TabletMap::Parse("a\na\n").ok());
+  EXPECT_FALSE(TabletMap::Parse("bad\\escape\n").ok());
+}
+
+TEST(TableTablets, InitialSplits) {
+  auto table = CreateTable({"row5", "row2"});
+  ASSERT_NE(nullptr, table);
+  EXPECT_THAT(StartKeys(table->GetTablets()), ElementsAre("", "row2", "row5"));
+
+  ASSERT_STATUS_OK(SetCell(*table, "row1", "col", 1, "value"));
+  ASSERT_STATUS_OK(SetCell(*table, "row3", "col", 1, "value"));
+  ASSERT_STATUS_OK(SetCell(*table, "row4", "col", 1, "value"));
+  auto const tablets = table->GetTablets();
+  ASSERT_EQ(3U, tablets.size());
+  EXPECT_LT(0, tablets[0].logical_bytes);
+  EXPECT_EQ(2 * tablets[0].logical_bytes, tablets[1].logical_bytes);
+  EXPECT_EQ(0, tablets[2].logical_bytes);
+  EXPECT_EQ(table->GetStats().Total().logical_bytes,
+            tablets[0].logical_bytes + tablets[1].logical_bytes);
+}
+
+TEST(TableTablets, SampleRowKeysReturnsTabletBoundaries) {
+  auto table = CreateTable({"row2", "row5"});
+  ASSERT_NE(nullptr, table);
+
+  // Even an empty table is sampled at its tablet boundaries.
+  auto samples = table->SampleRowKeys();
+  ASSERT_STATUS_OK(samples);
+  ASSERT_EQ(3U, samples->size());
+  EXPECT_EQ("row2", (*samples)[0].row_key());
+  EXPECT_EQ("row5", (*samples)[1].row_key());
+  EXPECT_EQ("", (*samples)[2].row_key());
+  EXPECT_LT((*samples)[0].offset_bytes(), (*samples)[1].offset_bytes());
+  EXPECT_LT((*samples)[1].offset_bytes(), (*samples)[2].offset_bytes());
+
+  ASSERT_STATUS_OK(SetCell(*table, "row1", "col", 1, "value"));
+  ASSERT_STATUS_OK(SetCell(*table, "row3", "col", 1, "value"));
+  ASSERT_STATUS_OK(SetCell(*table, "row6", "col", 1, "value"));
+  auto const tablets = table->GetTablets();
+  samples = table->SampleRowKeys();
+  ASSERT_STATUS_OK(samples);
+  ASSERT_EQ(3U, samples->size());
+  EXPECT_EQ(tablets[0].logical_bytes, (*samples)[0].offset_bytes());
+  EXPECT_EQ(tablets[0].logical_bytes + tablets[1].logical_bytes,
+            (*samples)[1].offset_bytes());
+  EXPECT_EQ(table->GetStats().Total().logical_bytes,
+            (*samples)[2].offset_bytes());
+}
+
+TEST(TableTablets, SplitsBySize) {
+  auto table = CreateTable({});
+  ASSERT_NE(nullptr, table);
+  table->SetTabletSplitBytes(1000);
+
+  for (int i = 0; i != 10; ++i) {
+    ASSERT_STATUS_OK(SetCell(*table, "row" + std::to_string(i), "col", 1,
+                             std::string(150, 'x')));
+  }
+  // The mutations only flag the tablet, the split is done separately.
+  EXPECT_EQ(1U, table->GetTablets().size());
+  EXPECT_TRUE(table->NeedsTabletSplit());
+  table->SplitTablets();
+  auto const tablets = table->GetTablets();
+  ASSERT_LT(1U, tablets.size());
+  std::int64_t total_bytes = 0;
+  for (auto const& tablet : tablets) {
+    EXPECT_GT(1000, tablet.logical_bytes);
+    total_bytes += tablet.logical_bytes;
+  }
+  EXPECT_EQ(table->GetStats().Total().logical_bytes, total_bytes);
+}
+
+TEST(TableTablets, SingleRowIsNotSplit) {
+  auto table = CreateTable({});
+  ASSERT_NE(nullptr, table);
+  table->SetTabletSplitBytes(1000);
+
+  for (int i = 0; i != 10; ++i) {
+    ASSERT_STATUS_OK(SetCell(*table, "row", "col" + std::to_string(i), 1,
+                             std::string(150, 'x')));
+    table->SplitTablets();
+  }
+  EXPECT_EQ(1U, table->GetTablets().size());
+  // The failed split is not retried until the tablet doubles in size.
+  EXPECT_FALSE(table->NeedsTabletSplit());
+}
+
+TEST(TableTablets, GarbageCollectionShrinksTablets) {
+  btadmin::GcRule gc_rule;
+  gc_rule.set_max_num_versions(1);
+  auto table = CreateTable({"row2"}, gc_rule);
+  ASSERT_NE(nullptr, table);
+
+  for (std::int64_t ts = 1; ts <= 3; ++ts) {
+    ASSERT_STATUS_OK(SetCell(*table, "row1", "col", ts, "value"));
+    ASSERT_STATUS_OK(SetCell(*table, "row3", "col", ts, "value"));
+  }
+  auto const before = table->GetTablets();
+  ASSERT_STATUS_OK(table->RunGC());
+  auto const after = table->GetTablets();
+  ASSERT_EQ(2U, after.size());
+  EXPECT_EQ(before[0].logical_bytes / 3, after[0].logical_bytes);
+  EXPECT_EQ(before[1].logical_bytes / 3, after[1].logical_bytes);
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
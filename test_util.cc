@@ -45,6 +45,18 @@ Status SetCells(
   return table->MutateRow(mutation_request);
 }
 
+google::bigtable::admin::v2::GcRule MaxVersions(std::int32_t versions) {
+  google::bigtable::admin::v2::GcRule rule;
+  rule.set_max_num_versions(versions);
+  return rule;
+}
+
+google::bigtable::admin::v2::GcRule MaxAge(std::int64_t seconds) {
+  google::bigtable::admin::v2::GcRule rule;
+  rule.mutable_max_age()->set_seconds(seconds);
+  return rule;
+}
+
 }  // namespace emulator
 }  // namespace bigtable
 }  // namespace cloud
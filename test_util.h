@@ -18,6 +18,7 @@
 #include "google/cloud/status.h"
 #include "google/cloud/status_or.h"
 #include "table.h"
+#include <google/bigtable/admin/v2/table.pb.h>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -43,6 +44,12 @@ Status SetCells(
 StatusOr<std::shared_ptr<Table>> CreateTable(
     std::string const& table_name, std::vector<std::string>& column_families);
 
+// A GC rule keeping at most `versions` versions of each column.
+google::bigtable::admin::v2::GcRule MaxVersions(std::int32_t versions);
+
+// A GC rule keeping cells for at most `seconds` seconds.
+google::bigtable::admin::v2::GcRule MaxAge(std::int64_t seconds);
+
 }  // namespace emulator
 }  // namespace bigtable
 }  // namespace cloud
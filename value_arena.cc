@@ -0,0 +1,87 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "value_arena.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+absl::string_view ValueArena::Store(absl::string_view value) {
+  if (value.empty()) return {};
+  char* data;
+  if (value.size() > kBlockSize / 4) {
+    // Keep the current block for the smaller values which follow.
+    data = AllocateBlock(value.size());
+  } else {
+    if (value.size() > remaining_) {
+      next_ = AllocateBlock(kBlockSize);
+      writable_begin_ = next_;
+      remaining_ = kBlockSize;
+    }
+    data = next_;
+    next_ += value.size();
+    remaining_ -= value.size();
+  }
+  std::memcpy(data, value.data(), value.size());
+  stored_bytes_ += value.size();
+  return {data, value.size()};
+}
+
+void ValueArena::Release(absl::string_view value) {
+  if (Owns(value)) released_bytes_ += value.size();
+}
+
+bool ValueArena::Owns(absl::string_view value) const {
+  if (value.empty()) return false;
+  auto it = blocks_.lower_bound(value.data());
+  return it != blocks_.end() && value.data() < it->first + it->second.size;
+}
+
+bool ValueArena::Overwrite(absl::string_view value, absl::string_view bytes) {
+  if (value.empty() || value.size() != bytes.size()) return false;
+  // As addresses, since `value` may be in another block.
+  auto const begin = reinterpret_cast<std::uintptr_t>(writable_begin_);
+  auto const end = reinterpret_cast<std::uintptr_t>(next_);
+  auto const data = reinterpret_cast<std::uintptr_t>(value.data());
+  if (data < begin || data + value.size() > end) {
+    if (value.size() <= kBlockSize / 4) return false;
+    auto it = blocks_.find(value.data());
+    if (it == blocks_.end() || it->second.size != value.size() ||
+        it->second.seals != seals_) {
+      return false;
+    }
+  }
+  std::memcpy(const_cast<char*>(value.data()), bytes.data(), bytes.size());
+  return true;
+}
+
+char* ValueArena::AllocateBlock(std::size_t size) {
+  // Not `std::make_unique()`, which would zero the block.
+  std::unique_ptr<char[]> data(new char[size]);
+  auto* res = data.get();
+  blocks_.emplace(res, Block{std::move(data), size, seals_});
+  allocated_bytes_ += size;
+  return res;
+}
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
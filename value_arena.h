@@ -0,0 +1,115 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_VALUE_ARENA_H
+#define GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_VALUE_ARENA_H
+
+#include "absl/strings/string_view.h"
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+
+/**
+ * Storage for the cell values of an in-memory column family.
+ *
+ * Values are copied into large blocks, rather than each allocated on its
+ * own, and stay there until the arena is destroyed. Values which are
+ * overwritten or deleted are only accounted for with `Release()`; the
+ * space is reclaimed by copying the live values to a new arena once enough
+ * of it is garbage (see `ColumnFamily::CompactValues()`).
+ *
+ * Values can be read concurrently with `Store()`, since the bytes of a
+ * stored value never change once the arena is sealed (see `Overwrite()`).
+ * Otherwise the class is not thread safe.
+ */
+class ValueArena {
+ public:
+  /// The size of the blocks the values are copied into. Values larger than
+  /// a quarter of it get a block of their own.
+  static std::size_t constexpr kBlockSize = 64 << 10;
+
+  ValueArena() = default;
+  ValueArena(ValueArena const&) = delete;
+  ValueArena& operator=(ValueArena const&) = delete;
+
+  /// Copy `value` into the arena. Empty values take no space.
+  absl::string_view Store(absl::string_view value);
+
+  /// Account for a value returned by `Store()` which is no longer used.
+  /// Values which this arena doesn't own are ignored.
+  void Release(absl::string_view value);
+
+  /// Whether `value` points into this arena.
+  bool Owns(absl::string_view value) const;
+
+  /**
+   * Replace the bytes of `value` with `bytes` of the same size in place.
+   *
+   * Only values stored since the last `Seal()` can be overwritten: those at
+   * the end of the current block, and those with a block of their own.
+   *
+   * @return whether `value` was overwritten.
+   */
+  bool Overwrite(absl::string_view value, absl::string_view bytes);
+
+  /// Prevent `Overwrite()` of the values stored so far, e.g. because a
+  /// snapshot which may be read concurrently refers to them.
+  void Seal() {
+    writable_begin_ = next_;
+    ++seals_;
+  }
+
+  /// The bytes of all the values stored.
+  std::size_t stored_bytes() const { return stored_bytes_; }
+  /// The bytes of the values stored and not released.
+  std::size_t live_bytes() const { return stored_bytes_ - released_bytes_; }
+  /// The bytes of the blocks allocated.
+  std::size_t allocated_bytes() const { return allocated_bytes_; }
+
+ private:
+  struct Block {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+    // The value of `seals_` when the block was allocated.
+    std::size_t seals;
+  };
+
+  char* AllocateBlock(std::size_t size);
+
+  // Keyed by the start of the block, from the last one.
+  std::map<char const*, Block, std::greater<>> blocks_;
+  // The unused tail of the current block.
+  char* next_ = nullptr;
+  // The values in the current block in [`writable_begin_`, `next_`) may be
+  // overwritten.
+  char* writable_begin_ = nullptr;
+  std::size_t seals_ = 0;
+  std::size_t remaining_ = 0;
+  std::size_t stored_bytes_ = 0;
+  std::size_t released_bytes_ = 0;
+  std::size_t allocated_bytes_ = 0;
+};
+
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google
+
+#endif  // GOOGLE_CLOUD_CPP_GOOGLE_CLOUD_BIGTABLE_EMULATOR_VALUE_ARENA_H
@@ -0,0 +1,324 @@
+// Copyright 2026 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "value_arena.h"
+#include "column_family.h"
+#include "table_stats.h"
+#include <google/bigtable/admin/v2/types.pb.h>
+#include <google/bigtable/v2/data.pb.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace google {
+namespace cloud {
+namespace bigtable {
+namespace emulator {
+namespace {
+
+using std::chrono::milliseconds;
+
+TEST(ValueArena, StoresValues) {
+  ValueArena arena;
+  std::string value = "foo";
+  auto const foo = arena.Store(value);
+  value = "bar";
+  auto const bar = arena.Store(value);
+  EXPECT_EQ("foo", foo);
+  EXPECT_EQ("bar", bar);
+  // Small values are packed into the same block.
+  EXPECT_EQ(foo.data() + foo.size(), bar.data());
+  EXPECT_TRUE(arena.Owns(foo));
+  EXPECT_FALSE(arena.Owns(value));
+  EXPECT_EQ(6U, arena.stored_bytes());
+  EXPECT_EQ(ValueArena::kBlockSize, arena.allocated_bytes());
+
+  auto const empty = arena.Store("");
+  EXPECT_TRUE(empty.empty());
+  EXPECT_FALSE(arena.Owns(empty));
+  EXPECT_EQ(6U, arena.stored_bytes());
+}
+
+TEST(ValueArena, LargeValuesGetTheirOwnBlock) {
+  ValueArena arena;
+  auto const small = arena.Store("small");
+  std::string const large_value(ValueArena::kBlockSize / 2, 'x');
+  auto const large = arena.Store(large_value);
+  auto const next = arena.Store("next");
+  EXPECT_EQ(large_value, large);
+  EXPECT_TRUE(arena.Owns(large));
+  EXPECT_EQ(small.data() + small.size(), next.data());
+  EXPECT_EQ(ValueArena::kBlockSize + large_value.size(),
+            arena.allocated_bytes());
+}
+
+TEST(ValueArena, Release) {
+  ValueArena arena;
+  auto const foo = arena.Store("foo");
+  arena.Store("barbaz");
+  arena.Release(foo);
+  EXPECT_EQ(9U, arena.stored_bytes());
+  EXPECT_EQ(6U, arena.live_bytes());
+  // Values from elsewhere are ignored.
+  ValueArena other;
+  arena.Release(other.Store("qux"));
+  EXPECT_EQ(6U, arena.live_bytes());
+}
+
+TEST(ValueArena, OverwritesUnsealedValues) {
+  ValueArena arena;
+  auto const foo = arena.Store("foo");
+  EXPECT_TRUE(arena.Overwrite(foo, "bar"));
+  EXPECT_EQ("bar", foo);
+  EXPECT_FALSE(arena.Overwrite(foo, "barbaz"));
+  arena.Seal();
+  EXPECT_FALSE(arena.Overwrite(foo, "baz"));
+  EXPECT_EQ("bar", foo);
+  auto const qux = arena.Store("qux");
+  EXPECT_TRUE(arena.Overwrite(qux, "quy"));
+  EXPECT_EQ("quy", qux);
+  ValueArena other;
+  EXPECT_FALSE(arena.Overwrite(other.Store("foo"), "bar"));
+  EXPECT_EQ(6U, arena.stored_bytes());
+}
+
+std::string ReadValue(ColumnFamily const& cf, std::string const& row_key) {
+  auto const row = cf.lower_bound(row_key);
+  if (row == cf.end() || row->first != row_key) return "<missing>";
+  return std::string(row->second.begin()->second.begin()->second);
+}
+
+TEST(ColumnFamilyValues, OverwritesAreCompacted) {
+  ColumnFamily cf;
+  std::size_t constexpr kValueSize = 1024;
+  // The sizes alternate, so that the values are not overwritten in place.
+  for (int i = 0; i != 2048; ++i) {
+    cf.SetCell("row", "col", milliseconds(0),
+               std::string(kValueSize - (i + 1) % 2,
+                           static_cast<char>('a' + i % 26)));
+  }
+  cf.SetCell("other", "col", milliseconds(0), "other value");
+  EXPECT_TRUE(cf.NeedsValueCompaction());
+  auto const snapshot = cf.Snapshot();
+
+  EXPECT_TRUE(cf.CompactValues(std::chrono::steady_clock::time_point::max()));
+  EXPECT_FALSE(cf.NeedsValueCompaction());
+  EXPECT_EQ(kValueSize + 11, cf.arena().stored_bytes());
+  EXPECT_EQ(cf.arena().stored_bytes(), cf.arena().live_bytes());
+  EXPECT_EQ(std::string(kValueSize, static_cast<char>('a' + 2047 % 26)),
+            ReadValue(cf, "row"));
+  EXPECT_EQ("other value", ReadValue(cf, "other"));
+  // The snapshot still reads the values from the old arena.
+  EXPECT_EQ(ReadValue(cf, "row"), ReadValue(*snapshot, "row"));
+  EXPECT_EQ("other value", ReadValue(*snapshot, "other"));
+}
+
+TEST(ColumnFamilyValues, SetCellOverwritesInPlace) {
+  ColumnFamily cf;
+  cf.SetCell("row", "col", milliseconds(0), "foo");
+  auto const snapshot = cf.Snapshot();
+
+  // The snapshot's value is not overwritten.
+  EXPECT_EQ("foo", cf.SetCell("row", "col", milliseconds(0), "bar"));
+  EXPECT_EQ(6U, cf.arena().stored_bytes());
+  // The new one is.
+  EXPECT_EQ("bar", cf.SetCell("row", "col", milliseconds(0), "qux"));
+  EXPECT_EQ(6U, cf.arena().stored_bytes());
+  EXPECT_EQ(3U, cf.arena().live_bytes());
+  EXPECT_EQ("qux", ReadValue(cf, "row"));
+  EXPECT_EQ("foo", ReadValue(*snapshot, "row"));
+}
+
+TEST(ColumnFamilyValues, AddToCellOverwritesInPlace) {
+  google::bigtable::admin::v2::Type sum;
+  sum.mutable_aggregate_type()->mutable_sum();
+  auto cf = ColumnFamily::ConstructColumnFamily(sum).value();
+  for (int i = 1; i <= 100; ++i) {
+    ASSERT_TRUE(cf->AddToCell("row", "col", milliseconds(0), i).ok());
+  }
+  auto const snapshot = cf->Snapshot();
+  EXPECT_EQ(std::string("\0\0\0\0\0\0\x13\xba", 8), ReadValue(*cf, "row"));
+  EXPECT_EQ(8U, cf->arena().stored_bytes());
+
+  // The snapshot's value is not overwritten.
+  auto old_value = cf->AddToCell("row", "col", milliseconds(0), -5050);
+  ASSERT_TRUE(old_value.ok());
+  EXPECT_EQ(ReadValue(*snapshot, "row"), old_value->value());
+  EXPECT_EQ(std::string(8, '\0'), ReadValue(*cf, "row"));
+  EXPECT_EQ(16U, cf->arena().stored_bytes());
+  EXPECT_EQ(8U, cf->arena().live_bytes());
+  EXPECT_EQ(std::string("\0\0\0\0\0\0\x13\xba", 8),
+            ReadValue(*snapshot, "row"));
+
+  EXPECT_FALSE(ColumnFamily().AddToCell("row", "col", milliseconds(0), 1).ok());
+}
+
+TEST(ColumnFamilyValues, DeletedRowsAreReleasedLater) {
+  ColumnFamily cf;
+  cf.SetCell("row", "col", milliseconds(0), "foo");
+  cf.SetCell("row", "col", milliseconds(1), "barbaz");
+  cf.SetCell("other", "col", milliseconds(0), "x");
+  auto const snapshot = cf.Snapshot();
+
+  auto const deleted = cf.DeleteRow("row");
+  EXPECT_EQ(1, deleted.rows);
+  EXPECT_EQ(2, deleted.cells);
+  EXPECT_EQ(LogicalCellSize("row", "col", "foo") +
+                LogicalCellSize("row", "col", "barbaz"),
+            deleted.logical_bytes);
+  EXPECT_EQ("<missing>", ReadValue(cf, "row"));
+  EXPECT_TRUE(cf.HasDeletedRows());
+  EXPECT_EQ(10U, cf.arena().live_bytes());
+
+  // At least one row is released, even if the deadline has passed.
+  EXPECT_TRUE(
+      cf.ReleaseDeletedRows(std::chrono::steady_clock::time_point::min()));
+  EXPECT_FALSE(cf.HasDeletedRows());
+  EXPECT_EQ(1U, cf.arena().live_bytes());
+  EXPECT_EQ("barbaz", ReadValue(*snapshot, "row"));
+}
+
+TEST(ColumnFamilyValues, DeleteRowUsesTheRowTotals) {
+  auto row_stats = [](ColumnFamily const& cf, std::string const& row_key) {
+    ColumnFamilyStats stats;
+    stats.AddRow(row_key, cf.lower_bound(row_key)->second);
+    return stats;
+  };
+  ColumnFamily cf;
+  for (int i = 0; i != 10; ++i) {
+    cf.SetCell("row", "col" + std::to_string(i % 3), milliseconds(i),
+               std::string(static_cast<std::size_t>(i), 'x'));
+  }
+  cf.SetCell("row", "col0", milliseconds(0), "overwritten");
+  auto const snapshot = cf.Snapshot();
+  google::bigtable::v2::TimestampRange range;
+  range.set_start_timestamp_micros(3000);
+  range.set_end_timestamp_micros(7000);
+  cf.DeleteColumn("row", "col0", range);
+  cf.DeleteTimeStamp("row", "col1", milliseconds(1));
+  cf.DeleteTimeStamp("row", "col2", milliseconds(2));
+  cf.SetCell("row", "new column", milliseconds(0), "v");
+  auto const expected = row_stats(cf, "row");
+  EXPECT_EQ(expected, cf.DeleteRow("row"));
+  EXPECT_EQ(ColumnFamilyStats(), cf.DeleteRow("row"));
+
+  // The snapshot's copy of the row kept its totals.
+  auto const& totals = snapshot->lower_bound("row")->second.totals();
+  auto const snapshot_stats = row_stats(*snapshot, "row");
+  EXPECT_EQ(snapshot_stats.cells, totals.cells);
+  EXPECT_EQ(snapshot_stats.versions_histogram, totals.versions_histogram);
+}
+
+TEST(ColumnFamilyValues, LargeDeletedRowsAreReleasedIncrementally) {
+  ColumnFamily cf;
+  for (int column = 0; column != 10; ++column) {
+    for (int i = 0; i != 1000; ++i) {
+      cf.SetCell("row", "col" + std::to_string(column), milliseconds(i), "x");
+    }
+  }
+  cf.SetCell("other", "col", milliseconds(0), "o");
+  auto snapshot = cf.Snapshot();
+  EXPECT_EQ(10000, cf.DeleteRow("row").cells);
+
+  auto const past = std::chrono::steady_clock::time_point::min();
+  EXPECT_FALSE(cf.ReleaseDeletedRows(past));
+  auto const live_bytes = cf.arena().live_bytes();
+  EXPECT_GT(10001U, live_bytes);
+  EXPECT_LT(1U, live_bytes);
+  // The snapshot's copy of the row is left alone.
+  EXPECT_EQ("x", ReadValue(*snapshot, "row"));
+  EXPECT_FALSE(cf.ReleaseDeletedRows(past));
+  EXPECT_GT(live_bytes, cf.arena().live_bytes());
+
+  // Once the snapshot is gone, the rest of the row is freed as it is
+  // released.
+  snapshot.reset();
+  int calls = 1;
+  while (!cf.ReleaseDeletedRows(past)) ++calls;
+  EXPECT_LT(1, calls);
+  EXPECT_FALSE(cf.HasDeletedRows());
+  EXPECT_EQ(1U, cf.arena().live_bytes());
+}
+
+TEST(ColumnFamilyValues, CompactionDropsUnusedQualifiers) {
+  ColumnFamily cf;
+  auto const rows = static_cast<int>(ColumnFamily::kMinCompactionQualifiers);
+  for (int i = 0; i != rows; ++i) {
+    cf.SetCell("row" + std::to_string(i), "col" + std::to_string(i),
+               milliseconds(0), "v");
+  }
+  cf.SetCell("other", "col0", milliseconds(0), "other value");
+  auto const snapshot = cf.Snapshot();
+  for (int i = 1; i != rows; ++i) cf.DeleteRow("row" + std::to_string(i));
+  EXPECT_TRUE(
+      cf.ReleaseDeletedRows(std::chrono::steady_clock::time_point::max()));
+  EXPECT_EQ(ColumnFamily::kMinCompactionQualifiers, cf.qualifiers().size());
+  // Too little garbage to compact the values alone.
+  EXPECT_TRUE(cf.NeedsValueCompaction());
+
+  EXPECT_TRUE(cf.CompactValues(std::chrono::steady_clock::time_point::max()));
+  EXPECT_FALSE(cf.NeedsValueCompaction());
+  EXPECT_EQ(1U, cf.qualifiers().size());
+  EXPECT_EQ("col0", std::as_const(cf).find("other")->second.begin()->first);
+  EXPECT_EQ("other value", ReadValue(cf, "other"));
+  cf.SetCell("other", "col1", milliseconds(0), "v");
+  EXPECT_EQ(2U, cf.qualifiers().size());
+  // The snapshot still uses the old dictionary.
+  EXPECT_EQ("col5", snapshot->lower_bound("row5")->second.begin()->first);
+  EXPECT_EQ(ColumnFamily::kMinCompactionQualifiers,
+            snapshot->qualifiers().size());
+}
+
+TEST(ColumnFamilyValues, IncrementalCompaction) {
+  ColumnFamily cf;
+  auto value = [](int i, std::size_t size = 1000) {
+    return std::string(size, static_cast<char>('a' + i % 26));
+  };
+  for (int row = 0; row != 1000; ++row) {
+    // Overwrite each value twice, so that 2/3 of the bytes are garbage. The
+    // sizes differ, so that the values are not overwritten in place.
+    for (int i = 0; i != 3; ++i) {
+      cf.SetCell("row" + std::to_string(row), "col", milliseconds(0),
+                 value(row + i, 998 + i));
+    }
+  }
+  ASSERT_TRUE(cf.NeedsValueCompaction());
+
+  // Every call copies a few rows, even if the deadline has passed.
+  auto const past = std::chrono::steady_clock::time_point::min();
+  EXPECT_FALSE(cf.CompactValues(past));
+  EXPECT_TRUE(cf.NeedsValueCompaction());
+  // Writes during the compaction go to the new arena.
+  cf.SetCell("row999", "col", milliseconds(0), "new");
+  cf.SetCell("row0", "col", milliseconds(0), "new");
+  int calls = 1;
+  while (!cf.CompactValues(past)) ++calls;
+  EXPECT_LT(1, calls);
+  EXPECT_FALSE(cf.NeedsValueCompaction());
+
+  EXPECT_EQ(998 * 1000 + 6, cf.arena().live_bytes());
+  EXPECT_EQ(value(1 + 2), ReadValue(cf, "row1"));
+  EXPECT_EQ(value(500 + 2), ReadValue(cf, "row500"));
+  EXPECT_EQ("new", ReadValue(cf, "row999"));
+  EXPECT_EQ("new", ReadValue(cf, "row0"));
+}
+
+}  // namespace
+}  // namespace emulator
+}  // namespace bigtable
+}  // namespace cloud
+}  // namespace google